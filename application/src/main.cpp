@@ -1,14 +1,52 @@
+#include "Logger.hpp"
 #include "OrionWebServer.hpp"
 
+#include <csignal>
+#include <iostream>
+
+#include <pthread.h>
+
 using namespace ORION;
 
 int main(int argc, char* argv[])
 {
-    OrionWebServer WebServer;
-    WebServer.Start(5000);
+    // Read the settings from the command line (and the config file it names, if any)
+    std::string ParseError;
+    const auto  OPTIONS = OrionWebServerOptions::Parse(std::vector<std::string>(argv + 1, argv + argc), ParseError);
+    if (!OPTIONS)
+    {
+        if (!ParseError.empty())
+        {
+            std::cerr << ParseError << std::endl << std::endl;
+        }
+        std::cerr << OrionWebServerOptions::GetUsage(argv[0]);
+        return ParseError.empty() ? 0 : 1;
+    }
+
+    // Block SIGTERM and SIGINT before any thread is started (threads inherit the mask), so they are only delivered to the sigwait below
+    sigset_t StopSignals;
+    sigemptyset(&StopSignals);
+    sigaddset(&StopSignals, SIGTERM);
+    sigaddset(&StopSignals, SIGINT);
+    pthread_sigmask(SIG_BLOCK, &StopSignals, nullptr);
+
+    // By default, serve the web interface and API on port 5000, and the /orion/ws WebSocket endpoint on port 5001
+    OrionWebServer WebServer(*OPTIONS);
+    WebServer.Start();
+    if (!WebServer.IsRunning())
+    {
+        Log::Error("server", "The Orion web server failed to start");
+        return 1;
+    }
+
+    // Drain and stop on SIGTERM (e.g. a rolling restart) or SIGINT, so the runs in flight aren't cut off
+    int Signal = 0;
+    sigwait(&StopSignals, &Signal);
+    Log::Info("server", "Stopping", {{"signal", Signal == SIGTERM ? "SIGTERM" : "SIGINT"}});
+    WebServer.Stop();
 
-    // Wait for the web server to stop via a call to WebServer.Stop()
+    // Close the listener
     WebServer.Wait();
 
     return 0;
-}
\ No newline at end of file
+}
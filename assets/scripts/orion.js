@@ -122,42 +122,13 @@ document.getElementById('send-button').addEventListener('mouseup', function (eve
     if (messageInput.trim() !== '' || fileInput.length > 0) {
         console.log('fileInput:', fileInput);
 
-        // Create a promise to read the files
-        const promise = new Promise((resolve, reject) => {
-            const Files = [];
-            let filesRead = 0;
+        // The files are sent as they are (raw bytes in a multipart body), without reading them first
+        const Files = [...fileInput];
 
-            if (fileInput.length === 0) {
-                resolve(Files);
-            }
-
-            // Read the files and add them to the Files array
-            for (let i = 0; i < fileInput.length; i++) {
-                let file = fileInput[i]; // Use let to create a block-scoped variable
-                let reader = new FileReader();
-                reader.onload = function (e) {
-                    Files.push({name: file.name, data: e.target.result.split(',')[1]}); // Remove the data URL prefix
-                    filesRead++;
-                    if (filesRead === fileInput.length) {
-                        resolve(Files); // Resolve the promise when all files are read
-                    }
-                };
-                reader.onerror = function (e) {
-                    reject(e); // Reject the promise if there's an error reading a file
-                };
-                reader.readAsDataURL(file);
-            }
-        });
-
-        // Wait for the files to be read
-        promise.then((Files) => {
-            // Add the message to the chat area
-            addMessageToChatAsync(messageInput, Files);
-            document.getElementById('message-input').value = '';
-            document.getElementById('file-input').value = '';
-        }).catch((error) => {
-            console.error('Error reading files:', error);
-        });
+        // Add the message to the chat area
+        addMessageToChatAsync(messageInput, Files);
+        document.getElementById('message-input').value = '';
+        document.getElementById('file-input').value = '';
     }
 });
 
@@ -170,42 +141,13 @@ document.getElementById('send-button').addEventListener('touchend', function (ev
     if (messageInput.trim() !== '' || fileInput.length > 0) {
         console.log('fileInput:', fileInput);
 
-        // Create a promise to read the files
-        const promise = new Promise((resolve, reject) => {
-            const Files = [];
-            let filesRead = 0;
-
-            if (fileInput.length === 0) {
-                resolve(Files);
-            }
+        // The files are sent as they are (raw bytes in a multipart body), without reading them first
+        const Files = [...fileInput];
 
-            // Read the files and add them to the Files array
-            for (var i = 0; i < fileInput.length; i++) {
-                let file = fileInput[i]; // Use let to create a block-scoped variable
-                let reader = new FileReader();
-                reader.onload = function (e) {
-                    Files.push({name: file.name, data: e.target.result.split(',')[1]}); // Remove the data URL prefix
-                    filesRead++;
-                    if (filesRead === fileInput.length) {
-                        resolve(Files); // Resolve the promise when all files are read
-                    }
-                };
-                reader.onerror = function (e) {
-                    reject(e); // Reject the promise if there's an error reading a file
-                };
-                reader.readAsDataURL(file);
-            }
-        });
-
-        // Wait for the files to be read
-        promise.then((Files) => {
-            // Add the message to the chat area
-            addMessageToChatAsync(messageInput, Files);
-            document.getElementById('message-input').value = '';
-            document.getElementById('file-input').value = '';
-        }).catch((error) => {
-            console.error('Error reading files:', error);
-        });
+        // Add the message to the chat area
+        addMessageToChatAsync(messageInput, Files);
+        document.getElementById('message-input').value = '';
+        document.getElementById('file-input').value = '';
     }
 });
 document.getElementById('send-button').addEventListener('mouseleave', function (event) {
@@ -215,7 +157,7 @@ document.getElementById('send-button').addEventListener('mouseleave', function (
 });
 
 // Listen for server-sent events
-const orionEventsSource = new EventSource('/orion/events');
+const orionEventsSource = new EventSource('/orion/events?user_id=' + encodeURIComponent(localStorage.getItem('user_id')));
 orionEventsSource.addEventListener('message.started', function (event) {
     // This event is triggered when Orion starts to compose a message
 
@@ -470,6 +412,15 @@ orionEventsSource.addEventListener('upload.file.requested', function (event) {
     console.log('Requested upload file:', filePath);
 });
 
+orionEventsSource.addEventListener('events.resync', function (event) {
+    // This event is triggered when the connection was restored but the events missed in the meantime are no longer available
+
+    // Throw away the partially streamed message state and reload the chat history
+    currentMessageBeingComposed = '';
+    currentAnnotations = [];
+    loadChatHistory();
+});
+
 orionEventsSource.addEventListener('tool.started', function (event) {
     // This event is triggered when a tool starts
     const jdata = JSON.parse(event.data);
@@ -601,42 +552,13 @@ document.getElementById('message-input').addEventListener('keypress', function (
         if (messageInput.trim() !== '' || fileInput.length > 0) {
             console.log('fileInput:', fileInput);
 
-            // Create a promise to read the files
-            const promise = new Promise((resolve, reject) => {
-                const Files = [];
-                let filesRead = 0;
+            // The files are sent as they are (raw bytes in a multipart body), without reading them first
+            const Files = [...fileInput];
 
-                if (fileInput.length === 0) {
-                    resolve(Files);
-                }
-
-                // Read the files and add them to the Files array
-                for (let i = 0; i < fileInput.length; i++) {
-                    let file = fileInput[i]; // Use let to create a block-scoped variable
-                    let reader = new FileReader();
-                    reader.onload = function (e) {
-                        Files.push({name: file.name, data: e.target.result.split(',')[1]}); // Remove the data URL prefix
-                        filesRead++;
-                        if (filesRead === fileInput.length) {
-                            resolve(Files); // Resolve the promise when all files are read
-                        }
-                    };
-                    reader.onerror = function (e) {
-                        reject(e); // Reject the promise if there's an error reading a file
-                    };
-                    reader.readAsDataURL(file);
-                }
-            });
-
-            // Wait for the files to be read
-            promise.then((Files) => {
-                // Add the message to the chat area
-                addMessageToChatAsync(messageInput, Files).then(() => {
-                    document.getElementById('message-input').value = '';
-                    document.getElementById('file-input').value = '';
-                });
-            }).catch((error) => {
-                console.error('Error reading files:', error);
+            // Add the message to the chat area
+            addMessageToChatAsync(messageInput, Files).then(() => {
+                document.getElementById('message-input').value = '';
+                document.getElementById('file-input').value = '';
             });
         }
     }
@@ -681,15 +603,23 @@ document.addEventListener('DOMContentLoaded', async function () {
 
     console.log('Plugins enabled:', plugins_results);
 
-    // Get the chat area
-    const chatArea = document.getElementById('chat-area');
+    // Load the chat history
+    loadChatHistory();
+});
 
+/**
+ * Load the chat history from the server and show it in the chat area, replacing the messages already shown
+ */
+function loadChatHistory() {
     // Get the chat history from the server
     OrionAPI.getChatHistoryAsync()
         .then(messages => {
             let newMessage;
             const chatArea = document.getElementById('chat-area');
 
+            // Clear any messages already shown (the history is reloaded after missing server events)
+            chatArea.innerHTML = '';
+
             // Loop through the messages and add them to the chat area
             for (let i = 0; i < messages.length; i++) {
                 if (messages[i].role === 'user') {
@@ -716,7 +646,7 @@ document.addEventListener('DOMContentLoaded', async function () {
             chatArea.scrollTop = chatArea.scrollHeight;
 
         });
-});
+}
 
 // Function to process when the user leaves the page
 window.onbeforeunload = function () {
@@ -33,7 +33,7 @@ class OrionAPI {
     /**
      * Sends a chat message to orion.
      * @param message {string} The message to send. This can be a simple text message or a markdown message.
-     * @param files {FileList} A list of files to send with the message. max 10 files per message.
+     * @param files {FileList|File[]} A list of files to send with the message. max 10 files per message.
      * @param shouldProcessMarkdown {boolean} If true, the message will be processed as markdown (markdown will be rendered and html returned).
      * @returns {Promise<Response>} The response from the server. This can be used to check if the message was sent successfully.
      * The server will send sse events back to the client with orion's response as it's streamed in via the 'message.delta' event.
@@ -58,6 +58,21 @@ class OrionAPI {
             body.files = body.files.slice(0, 10);
         }
 
+        // Files (File or Blob objects) are sent as raw bytes in a multipart body, a third smaller than base64.
+        // Files already read as base64 ({name, data}) are sent as JSON
+        if (body.files.every(file => file instanceof Blob)) {
+            const form = new FormData();
+            form.append('message', body.message);
+            body.files.forEach(file => form.append('files', file, file.name || 'file'));
+
+            // The browser sets the multipart Content-Type with its boundary
+            return fetch('/orion/send_message?markdown=' + shouldProcessMarkdown, {
+                method: 'POST', headers: {
+                    'X-User-Id': localStorage.getItem('user_id')
+                }, body: form
+            });
+        }
+
         // Send the message to the server
         return fetch('/orion/send_message?markdown=' + shouldProcessMarkdown, {
             method: 'POST', headers: {
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace ORION
+{
+    /// @brief  The limits enforced by an AdmissionController
+    struct AdmissionControlOptions
+    {
+        /// @brief  The rate at which each user's bucket refills (runs per second)
+        double TokensPerSecond = 0.5;
+
+        /// @brief  The size of each user's bucket (the number of runs a user can start back to back)
+        double BurstSize = 5.0;
+
+        /// @brief  The maximum number of runs in flight across all users. 0 means unlimited
+        size_t MaxInFlightRuns = 64;
+    };
+
+    /**
+     * @class AdmissionController
+     * @brief Decides whether a new Orion run (a message sent to Orion) may start.
+     *
+     * Each user has a token bucket limiting how often they can start runs, and the number of runs in flight across all users is capped.
+     * A run holds a RunTicket for as long as it is in flight; the slot is released when the ticket is destroyed.
+     */
+    class AdmissionController final
+    {
+    public:
+        /// @brief  The outcome of an admission request
+        enum class EDecision
+        {
+            Admitted,    ///< The run may start
+            RateLimited, ///< The user is sending too fast (HTTP 429)
+            Overloaded,  ///< The server has too many runs in flight (HTTP 503)
+            Draining,    ///< The server is shutting down and accepts no new runs (HTTP 503)
+        };
+
+        /// @brief  Holds an in-flight run slot. The slot is released when the ticket is destroyed
+        class RunTicket final
+        {
+        public:
+            explicit RunTicket(AdmissionController& InController)
+                : m_Controller(InController)
+            {
+            }
+
+            ~RunTicket()
+            {
+                m_Controller.ReleaseRun();
+            }
+
+            RunTicket(const RunTicket&)            = delete;
+            RunTicket& operator=(const RunTicket&) = delete;
+
+        private:
+            /// @brief  The controller the slot belongs to
+            AdmissionController& m_Controller;
+        };
+
+        /// @brief  The result of an admission request
+        struct Admission
+        {
+            /// @brief  Whether the run may start
+            EDecision Decision = EDecision::Admitted;
+
+            /// @brief  How long the client should wait before retrying (when not admitted)
+            std::chrono::seconds RetryAfter {0};
+
+            /// @brief  The slot of the admitted run (null when not admitted). Keep it alive until the run completes
+            std::shared_ptr<RunTicket> pTicket;
+        };
+
+        /// @brief  Counters of the admission decisions since the controller was created
+        struct Stats
+        {
+            uint64_t Admitted    = 0;
+            uint64_t RateLimited = 0;
+            uint64_t Overloaded  = 0;
+            uint64_t Draining    = 0;
+            uint64_t InFlight    = 0;
+        };
+
+        /// @brief  Constructor
+        /// @param  InOptions The limits to enforce
+        explicit AdmissionController(const AdmissionControlOptions& InOptions = AdmissionControlOptions());
+
+        AdmissionController(const AdmissionController&)            = delete;
+        AdmissionController& operator=(const AdmissionController&) = delete;
+
+        /// @brief  Request to start a run for a user. Safe to call from any thread
+        /// @param  UserID The id of the user
+        /// @return The decision, with a ticket if the run was admitted
+        Admission TryAdmit(const std::string& UserID);
+
+        /// @brief  Get the admission counters
+        Stats GetStats() const;
+
+        /// @brief  Refuse every new run from now on (the runs in flight are unaffected). Used to drain the server before it stops
+        void BeginDrain();
+
+        /// @brief  Check whether the controller is draining
+        bool IsDraining() const;
+
+        /// @brief  Wait until no run is in flight
+        /// @param  TIMEOUT How long to wait at most
+        /// @return Whether every run completed in time
+        bool WaitForInFlightRuns(const std::chrono::steady_clock::duration& TIMEOUT);
+
+    private:
+        /// @brief  The token bucket of a user
+        struct Bucket
+        {
+            /// @brief  The tokens currently in the bucket
+            double Tokens = 0.0;
+
+            /// @brief  When the bucket was last refilled
+            std::chrono::steady_clock::time_point LastRefill;
+        };
+
+        /// @brief  Called by RunTicket when a run completes
+        void ReleaseRun();
+
+        /// @brief  Add the tokens earned since the last refill to a bucket
+        void Refill(Bucket& InBucket, const std::chrono::steady_clock::time_point& Now) const;
+
+        /// @brief  Remove the buckets that are full again (they are indistinguishable from new ones). Called with the mutex held
+        void PruneIdleBuckets(const std::chrono::steady_clock::time_point& Now);
+
+        /// @brief  The limits enforced by the controller
+        AdmissionControlOptions m_Options;
+
+        /// @brief  The token buckets, keyed by user id
+        std::unordered_map<std::string, Bucket> m_Buckets;
+
+        /// @brief  The bucket count above which idle buckets are pruned
+        size_t m_PruneThreshold = 1024;
+
+        /// @brief  The mutex for the buckets and the in-flight count
+        mutable std::mutex m_Mutex;
+
+        /// @brief  The number of runs in flight
+        size_t m_InFlightRuns = 0;
+
+        /// @brief  Notified when the last run in flight completes
+        std::condition_variable m_IdleConditionVariable;
+
+        /// @brief  Whether new runs are refused
+        std::atomic<bool> m_IsDraining = false;
+
+        /// @brief  The decision counters
+        std::atomic<uint64_t> m_AdmittedCount    = 0;
+        std::atomic<uint64_t> m_RateLimitedCount = 0;
+        std::atomic<uint64_t> m_OverloadedCount  = 0;
+        std::atomic<uint64_t> m_DrainingCount    = 0;
+    };
+} // namespace ORION
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace ORION
+{
+    /**
+     * @class AssetCache
+     * @brief An in-memory cache of the static asset files served by the web server.
+     *
+     * Files are loaded once (at startup or on first request) together with a strong ETag and, for compressible types, their gzip and brotli
+     * encodings. Cached files are revalidated against the file's modification time and size at most once per revalidation interval, so
+     * edits on disk are picked up without hitting the disk on every request.
+     *
+     * When the library is built with the embedded asset bundle (ORION_EMBEDDED_ASSETS, see EmbeddedAssets.hpp), the bundled assets are
+     * served straight from the binary: their entries point into the bundle and are found without locking or touching the filesystem.
+     * Only the files that aren't bundled (e.g. audio) are read from the root directory.
+     */
+    class AssetCache final
+    {
+    public:
+        /// @brief  A cached asset file
+        struct Entry
+        {
+            /// @brief  The absolute path of the file (empty for embedded assets)
+            std::filesystem::path FilePath;
+
+            /// @brief  The MIME type of the file
+            std::string ContentType;
+
+            /// @brief  The opaque tag identifying the file content (a content hash, or the size and modification time for files not held
+            ///         in memory). See GetETag
+            std::string Tag;
+
+            /// @brief  Whether the content is held in memory. Files larger than the cache limit are sent from a mapping of the file
+            bool IsInMemory = false;
+
+            /// @brief  The file content (if in memory)
+            std::string_view Content;
+
+            /// @brief  The gzip encoded content (empty if not compressible or not smaller)
+            std::string_view GzipContent;
+
+            /// @brief  The brotli encoded content (empty if not compressible, not smaller or brotli is unavailable)
+            std::string_view BrotliContent;
+
+            /// @brief  The storage behind Content for files loaded from disk (embedded assets point into the binary)
+            std::string ContentStorage;
+
+            /// @brief  The storage behind GzipContent for files loaded from disk
+            std::string GzipContentStorage;
+
+            /// @brief  The storage behind BrotliContent for files loaded from disk
+            std::string BrotliContentStorage;
+
+            /// @brief  The modification time of the file when it was loaded
+            std::filesystem::file_time_type LastWriteTime;
+
+            /// @brief  The size of the file when it was loaded
+            uintmax_t FileSize = 0;
+        };
+
+        /// @brief  Constructor
+        /// @param  RootDirectory The directory the assets are served from
+        /// @param  ExcludedDirectories The directories (relative to the root) that are never served
+        /// @param  MAX_CACHED_FILE_SIZE Files larger than this are not held in memory
+        /// @param  REVALIDATE_INTERVAL How long a cached file is trusted before its modification time is checked again
+        explicit AssetCache(const std::filesystem::path&    RootDirectory,
+                            const std::vector<std::string>& ExcludedDirectories  = {},
+                            const uintmax_t                 MAX_CACHED_FILE_SIZE = 4 * 1024 * 1024,
+                            const std::chrono::milliseconds REVALIDATE_INTERVAL  = std::chrono::seconds(2));
+
+        /// @brief  Load every file under the root directory into the cache. Embedded assets are not loaded from disk
+        /// @param  SkippedDirectories Additional directories (relative to the root) that are served but not preloaded (e.g. generated files)
+        void Preload(const std::vector<std::string>& SkippedDirectories = {});
+
+        /// @brief  Find an asset, loading or revalidating it if needed
+        /// @param  RelativePath The path of the asset relative to the root directory
+        /// @return The asset, or nullptr if it doesn't exist or is outside the served directories
+        std::shared_ptr<const Entry> Find(const std::string& RelativePath);
+
+        /// @brief  Get the ETag of a representation of an asset. Each content coding gets its own ETag
+        /// @param  InEntry The asset
+        /// @param  ContentEncoding The content coding token of the representation ("gzip", "br", or empty)
+        static std::string GetETag(const Entry& InEntry, const std::string_view& ContentEncoding);
+
+        /// @brief  Check whether an If-None-Match header matches any representation of an asset (weak comparison, as required for If-None-Match)
+        static bool IsNotModified(const Entry& InEntry, const std::string& IfNoneMatch);
+
+    private:
+        /// @brief  A cache slot
+        struct Slot
+        {
+            /// @brief  The cached asset
+            std::shared_ptr<const Entry> pEntry;
+
+            /// @brief  When the asset was last checked against the file on disk
+            std::chrono::steady_clock::time_point LastValidated;
+        };
+
+        /// @brief  Normalize a relative path and check that it stays inside the root directory and out of the excluded directories
+        /// @return The normalized path, or an empty path if it must not be served
+        std::filesystem::path NormalizePath(const std::string& RelativePath) const;
+
+        /// @brief  Find an embedded asset
+        /// @param  Key The normalized relative path of the asset
+        /// @return The asset, or nullptr if it isn't embedded (or the library was built without the bundle)
+        std::shared_ptr<const Entry> FindEmbeddedEntry(const std::string& Key) const;
+
+        /// @brief  Load a file from disk
+        /// @return The entry, or nullptr if the file can't be read
+        std::shared_ptr<const Entry> LoadEntry(const std::filesystem::path& FilePath) const;
+
+        /// @brief  The directory the assets are served from (canonical)
+        std::filesystem::path m_RootDirectory;
+
+        /// @brief  The directories (relative to the root) that are never served
+        std::vector<std::filesystem::path> m_ExcludedDirectories;
+
+        /// @brief  Files larger than this are not held in memory
+        uintmax_t m_MaxCachedFileSize;
+
+        /// @brief  How long a cached file is trusted before it is checked again
+        std::chrono::milliseconds m_RevalidateInterval;
+
+        /// @brief  The entries of the embedded assets, in bundle order (empty without the bundle)
+        std::vector<std::shared_ptr<const Entry>> m_EmbeddedEntries;
+
+        /// @brief  The cached assets, keyed by normalized relative path
+        std::unordered_map<std::string, Slot> m_Slots;
+
+        /// @brief  The mutex for the slots
+        std::mutex m_Mutex;
+    };
+} // namespace ORION
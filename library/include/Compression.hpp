@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace ORION
+{
+    /// @brief  The settings of the compression of dynamic responses (JSON and the event stream). Higher levels trade CPU for bandwidth
+    struct ResponseCompressionOptions
+    {
+        /// @brief  Whether dynamic responses are compressed at all
+        bool IsEnabled = true;
+
+        /// @brief  JSON responses smaller than this are sent uncompressed (the headers and CPU cost more than the savings)
+        size_t MinimumSize = 1024;
+
+        /// @brief  The zlib level for gzip and deflate (1-9)
+        int Level = 5;
+
+        /// @brief  The brotli quality (0-11). Qualities above 5 are slow for content compressed on every request
+        int BrotliQuality = 4;
+
+        /// @brief  Whether the /orion/events stream is compressed. Each delivery is flushed, so events still arrive immediately
+        bool IsEventStreamCompressed = true;
+    };
+
+    /**
+     * @brief HTTP content codings (RFC 9110) used to compress responses.
+     */
+    namespace Compression
+    {
+        /// @brief  The content codings, in order of preference
+        enum class EContentCoding
+        {
+            Identity,
+            Deflate,
+            Gzip,
+            Brotli,
+        };
+
+        /// @brief  Get the Content-Encoding token of a coding ("deflate", "gzip", "br", or empty for identity)
+        std::string_view GetContentEncodingToken(const EContentCoding CODING);
+
+        /// @brief  Check whether a coding is listed as acceptable (q > 0) in an Accept-Encoding header
+        /// @param  AcceptEncoding The value of the Accept-Encoding header
+        /// @param  CODING The coding
+        bool IsAccepted(const std::string& AcceptEncoding, const EContentCoding CODING);
+
+        /// @brief  Pick the preferred coding the client accepts (brotli, then gzip, then deflate)
+        /// @param  AcceptEncoding The value of the Accept-Encoding header
+        /// @param  ALLOW_BROTLI Whether brotli may be picked (if the library was built with it)
+        EContentCoding Negotiate(const std::string& AcceptEncoding, const bool ALLOW_BROTLI = true);
+
+        /// @brief  Check whether content of a MIME type is worth compressing (text, scripts, JSON, SVG, ...)
+        bool IsCompressible(const std::string& ContentType);
+
+        /// @brief  Check whether the library was built with brotli support
+        bool IsBrotliAvailable();
+
+        /// @brief  Compress data with gzip
+        /// @param  Data The data
+        /// @param  LEVEL The zlib compression level (1-9)
+        /// @return The compressed data, or nothing if compression failed
+        std::optional<std::string> Gzip(const std::string_view& Data, const int LEVEL = 6);
+
+        /// @brief  Compress data with brotli
+        /// @param  Data The data
+        /// @param  QUALITY The brotli quality (0-11)
+        /// @return The compressed data, or nothing if compression failed or brotli is not available
+        std::optional<std::string> Brotli(const std::string_view& Data, const int QUALITY = 5);
+
+        /// @brief  Compress data with deflate (the zlib format, as the HTTP deflate coding requires)
+        /// @param  Data The data
+        /// @param  LEVEL The zlib compression level (1-9)
+        /// @return The compressed data, or nothing if compression failed
+        std::optional<std::string> Deflate(const std::string_view& Data, const int LEVEL = 6);
+
+        /// @brief  Compress data with a coding
+        /// @param  Data The data
+        /// @param  CODING The coding (identity returns the data)
+        /// @param  LEVEL The zlib level for gzip and deflate, the quality for brotli
+        /// @return The compressed data, or nothing if compression failed
+        std::optional<std::string> Compress(const std::string_view& Data, const EContentCoding CODING, const int LEVEL);
+
+        /**
+         * @class StreamCompressor
+         * @brief Compresses a response body that is produced piece by piece (e.g. an event stream).
+         *
+         * Every piece is flushed, so the client can decode everything sent so far while the compression context (and its ratio) carries
+         * over between pieces. Not thread safe.
+         */
+        class StreamCompressor final
+        {
+        public:
+            /// @brief  Constructor
+            /// @param  CODING The coding (gzip, deflate or brotli)
+            /// @param  LEVEL The zlib level for gzip and deflate, the quality for brotli
+            StreamCompressor(const EContentCoding CODING, const int LEVEL);
+
+            ~StreamCompressor();
+
+            StreamCompressor(const StreamCompressor&)            = delete;
+            StreamCompressor& operator=(const StreamCompressor&) = delete;
+
+            /// @brief  Check whether the compressor could be created
+            bool IsValid() const;
+
+            /// @brief  Compress a piece of the body and flush it
+            /// @return The compressed bytes to send, or nothing if compression failed (the stream can't be continued)
+            std::optional<std::string> CompressAndFlush(const std::string_view& Data);
+
+        private:
+            /// @brief  The compression context of the coding
+            struct Context;
+
+            /// @brief  The compression context (null if it couldn't be created)
+            std::unique_ptr<Context> m_pContext;
+        };
+    } // namespace Compression
+} // namespace ORION
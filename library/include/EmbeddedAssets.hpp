@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace ORION
+{
+    /**
+     * @brief The web assets compiled into the library at build time (see tools/AssetBundler.cpp).
+     *
+     * Every asset is stored minified, with its gzip and brotli encodings, in constant arrays. Paths are looked up through a perfect hash
+     * table generated with the bundle, so finding an asset is a hash, an array access and one string compare.
+     */
+    namespace EmbeddedAssets
+    {
+        /// @brief  An embedded asset. All views point to static storage
+        struct Asset
+        {
+            /// @brief  The path of the asset relative to the assets directory (e.g. scripts/orion.js)
+            std::string_view Path;
+
+            /// @brief  The MIME type of the asset
+            std::string_view ContentType;
+
+            /// @brief  The opaque tag identifying the asset content (used for the ETag)
+            std::string_view Tag;
+
+            /// @brief  The (minified) content
+            std::string_view Content;
+
+            /// @brief  The gzip encoded content (empty if not smaller than the content)
+            std::string_view GzipContent;
+
+            /// @brief  The brotli encoded content (empty if not smaller than the content or brotli was unavailable)
+            std::string_view BrotliContent;
+        };
+
+        /// @brief  The hash of the perfect hash table. Shared by the bundler and the generated lookup
+        /// @param  Path The path of an asset
+        /// @param  SEED The seed found by the bundler
+        constexpr uint64_t HashPath(const std::string_view& Path, const uint64_t SEED)
+        {
+            // FNV-1a with a seeded offset basis, then a finalizer to spread the bits over the low end used for the slot index
+            uint64_t Hash = 14695981039346656037ull ^ (SEED * 0x9E3779B97F4A7C15ull);
+            for (const char C : Path)
+            {
+                Hash ^= static_cast<unsigned char>(C);
+                Hash *= 1099511628211ull;
+            }
+
+            Hash ^= Hash >> 33;
+            Hash *= 0xFF51AFD7ED558CCDull;
+            Hash ^= Hash >> 33;
+            return Hash;
+        }
+
+        /// @brief  Find an embedded asset
+        /// @param  Path The path of the asset relative to the assets directory (normalized, without a leading slash)
+        /// @return The asset, or nullptr if there is no such asset
+        const Asset* Find(const std::string_view& Path);
+
+        /// @brief  Get all embedded assets
+        const Asset* GetAssets();
+
+        /// @brief  Get the number of embedded assets
+        size_t GetAssetCount();
+    } // namespace EmbeddedAssets
+} // namespace ORION
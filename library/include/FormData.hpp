@@ -0,0 +1,86 @@
+#pragma once
+
+#include "OpenAIClient.hpp"
+
+#include <cpprest/http_msg.h>
+
+#include <cstddef>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace ORION
+{
+    /**
+     * @brief A streaming reader of multipart/form-data bodies (RFC 7578).
+     *
+     * The body is parsed as it arrives, a chunk at a time, so it is never held whole. The value of a field is kept in memory; the content
+     * of a file is kept in memory up to a threshold and written to a temporary file past it, which is removed once the last copy of its
+     * payload is gone. Files arrive as raw bytes, so they are a third smaller than base64 in JSON and are never decoded.
+     */
+    namespace FormData
+    {
+        /// @brief  The limits of a body
+        struct ReadOptions
+        {
+            /// @brief  The most bytes of a file kept in memory. Larger files are written to a temporary file
+            size_t MemoryLimit = 1024 * 1024;
+
+            /// @brief  The most bytes of a body. 0 for no limit
+            size_t MaxSize = 512 * 1024 * 1024;
+
+            /// @brief  The most bytes of the value of a field (a part without a file name)
+            size_t MaxFieldSize = 1024 * 1024;
+        };
+
+        /// @brief  A part of a body
+        struct Part
+        {
+            /// @brief  The name of the form field
+            std::string Name;
+
+            /// @brief  The file name, if the part is a file
+            std::string FileName;
+
+            /// @brief  The content type of the part. Empty if not given
+            std::string ContentType;
+
+            /// @brief  The value, if the part is a field
+            std::string Value;
+
+            /// @brief  The content, if the part is a file
+            std::optional<OpenAI::FilePayload> File;
+        };
+
+        /**
+         * @class ParseError
+         * @brief A body that isn't valid multipart/form-data, or that is over a limit.
+         */
+        class ParseError final : public std::runtime_error
+        {
+        public:
+            ParseError(const web::http::status_code STATUS, const std::string& Message);
+
+            /// @brief  Get the status to reply with (400, or 413 for a body over a limit)
+            web::http::status_code GetStatus() const
+            {
+                return m_Status;
+            }
+
+        private:
+            web::http::status_code m_Status;
+        };
+
+        /// @brief  Get the boundary of a multipart/form-data content type
+        /// @param  ContentType The value of the Content-Type header
+        /// @return The boundary, or empty if the content type isn't multipart/form-data (or has no boundary)
+        std::string GetBoundary(const std::string& ContentType);
+
+        /// @brief  Read the parts of a body
+        /// @param  Body The body
+        /// @param  Boundary The boundary of the parts (GetBoundary)
+        /// @return The parts, in the order of the body. Fails with ParseError, or the error of the stream
+        pplx::task<std::vector<Part>> ReadAsync(const concurrency::streams::istream& Body, const std::string& Boundary, const ReadOptions& Options);
+    } // namespace FormData
+} // namespace ORION
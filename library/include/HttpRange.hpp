@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace ORION
+{
+    /**
+     * @brief HTTP range requests (RFC 9110, section 14) for single byte ranges.
+     */
+    namespace HttpRange
+    {
+        /// @brief  The result of parsing a Range header
+        enum class EResult
+        {
+            /// @brief  No usable range (absent, malformed, multiple ranges or another unit). The whole representation is sent
+            Ignored,
+
+            /// @brief  A satisfiable byte range. A 206 response with the range is sent
+            Satisfiable,
+
+            /// @brief  A byte range that starts past the end of the representation. A 416 response is sent
+            Unsatisfiable,
+        };
+
+        /// @brief  A parsed Range header
+        struct ByteRange
+        {
+            /// @brief  The result of parsing
+            EResult Result = EResult::Ignored;
+
+            /// @brief  The offset of the first byte (if satisfiable)
+            uint64_t Offset = 0;
+
+            /// @brief  The number of bytes (if satisfiable)
+            uint64_t Length = 0;
+        };
+
+        /// @brief  Parse a Range header against a representation
+        /// @param  Range The value of the Range header (e.g. bytes=0-1023, bytes=1024- or bytes=-512)
+        /// @param  SIZE The size of the representation
+        ByteRange Parse(const std::string& Range, const uint64_t SIZE);
+
+        /// @brief  Format the Content-Range header of a range response
+        /// @param  InRange The range (a 416 response when unsatisfiable)
+        /// @param  SIZE The size of the representation
+        std::string FormatContentRange(const ByteRange& InRange, const uint64_t SIZE);
+    } // namespace HttpRange
+} // namespace ORION
@@ -0,0 +1,209 @@
+#pragma once
+
+#include "MPSCQueue.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <initializer_list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace ORION
+{
+    /**
+     * @brief Leveled, structured logging written as JSON lines by a background thread.
+     *
+     * A log call checks the level of its module, copies the message and fields (long values are truncated) and pushes the record onto a
+     * lock-free queue; formatting and writing happen on the writer thread, so request and event stream threads never wait on the output.
+     * Records are dropped (and counted) when the writer falls too far behind, rather than blocking the caller.
+     *
+     * Each line is one JSON object: {"time":"2024-01-01T00:00:00.000Z","level":"info","module":"orion.events","message":"...", <fields>}
+     */
+    namespace Log
+    {
+        /// @brief  The severity of a record
+        enum class ELevel
+        {
+            Trace,
+            Debug,
+            Info,
+            Warning,
+            Error,
+            Off,
+        };
+
+        /// @brief  A field of a record, as a key and a value. Views, so fields of records that are filtered out aren't copied
+        using Field = std::pair<std::string_view, std::string_view>;
+
+        /// @brief  The settings of the logger
+        struct LogOptions
+        {
+            /// @brief  The level of modules without their own level
+            ELevel Level = ELevel::Info;
+
+            /// @brief  The levels of modules, as module=level pairs separated by commas (e.g. orion.events=debug,plugins=warning). A module
+            ///         applies to its submodules (plugins applies to plugins.weather)
+            std::string ModuleLevels;
+
+            /// @brief  The file the log is appended to. Empty for stderr
+            std::string FilePath;
+
+            /// @brief  The length field values are truncated to (web pages, recalled memories and instructions are logged as fields)
+            size_t MaxFieldLength = 1024;
+
+            /// @brief  The number of records that may wait for the writer before new ones are dropped
+            size_t QueueCapacity = 16384;
+        };
+
+        /// @brief  Parse a level name (trace, debug, info, warning, error, off)
+        std::optional<ELevel> ParseLevel(const std::string_view& Name);
+
+        /// @brief  Get the name of a level
+        std::string_view GetLevelName(const ELevel LEVEL);
+
+        /**
+         * @class Logger
+         * @brief The logger of the process. Starts its writer thread on first use and flushes the queue when the process exits.
+         */
+        class Logger final
+        {
+        public:
+            /// @brief  Get the logger of the process
+            static Logger& Get();
+
+            ~Logger();
+
+            Logger(const Logger&)            = delete;
+            Logger& operator=(const Logger&) = delete;
+
+            /// @brief  Apply new settings. Safe to call while other threads log
+            /// @param  OutError The error, if the module levels are invalid or the file can't be opened (the other settings are still applied)
+            /// @return Whether the settings were valid
+            bool Configure(const LogOptions& Options, std::string& OutError);
+
+            /// @brief  Check if records of a level and module are written. Use it to skip building expensive fields
+            bool IsEnabled(const ELevel LEVEL, const std::string_view& Module) const;
+
+            /// @brief  Queue a record, if its level is enabled for its module
+            void Write(const ELevel LEVEL, const std::string_view& Module, const std::string_view& Message, std::initializer_list<Field> Fields = {});
+
+            /// @brief  Wait until the records queued so far are written
+            void Flush();
+
+            /// @brief  Get the number of records dropped because the queue was full
+            uint64_t GetDroppedCount() const
+            {
+                return m_DroppedCount.load(std::memory_order_relaxed);
+            }
+
+        private:
+            Logger();
+
+            /// @brief  A queued record
+            struct Record final : MPSCQueueNode<Record>
+            {
+                std::chrono::system_clock::time_point            Time;
+                ELevel                                           Level = ELevel::Info;
+                std::string                                      Module;
+                std::string                                      Message;
+                std::vector<std::pair<std::string, std::string>> Fields;
+            };
+
+            /// @brief  The levels in effect. Replaced as a whole by Configure, so log calls read it without a lock
+            struct Filter
+            {
+                ELevel                                     Level = ELevel::Info;
+                std::map<std::string, ELevel, std::less<>> ModuleLevels;
+
+                /// @brief  The lowest level of any module, to reject most records without looking up their module
+                ELevel MinimumLevel = ELevel::Info;
+
+                size_t MaxFieldLength = 1024;
+                size_t QueueCapacity  = 16384;
+            };
+
+            /// @brief  The writer thread handler
+            void WriterThreadHandler();
+
+            /// @brief  Format a record as a JSON line
+            static void FormatRecord(const Record& InRecord, std::string& OutLine);
+
+            /// @brief  The levels in effect
+            std::shared_ptr<const Filter> m_pFilter;
+
+            /// @brief  The records waiting to be written
+            MPSCQueue<Record> m_Queue;
+
+            /// @brief  The number of records in the queue
+            std::atomic<size_t> m_QueuedCount = 0;
+
+            /// @brief  The number of records dropped because the queue was full
+            std::atomic<uint64_t> m_DroppedCount = 0;
+
+            /// @brief  The number of records queued and written, for Flush
+            std::atomic<uint64_t> m_PushedCount  = 0;
+            std::atomic<uint64_t> m_WrittenCount = 0;
+
+            /// @brief  The output. Only used by the writer thread once it is started (Configure swaps it under m_OutputMutex)
+            FILE*      m_pOutput = stderr;
+            std::mutex m_OutputMutex;
+
+            /// @brief  The writer thread
+            std::thread m_WriterThread;
+
+            /// @brief  Whether the writer thread is (about to be) waiting for records. Producers only touch the mutex when this is set
+            std::atomic<bool> m_IsSleeping = false;
+
+            /// @brief  Whether the logger is running (cleared on destruction)
+            std::atomic<bool> m_IsRunning = true;
+
+            /// @brief  The mutex for the wake condition variable
+            std::mutex m_WakeMutex;
+
+            /// @brief  Signaled when a record is queued while the writer is sleeping, and when a batch is written (for Flush)
+            std::condition_variable m_WakeConditionVariable;
+            std::condition_variable m_FlushedConditionVariable;
+        };
+
+        /// @brief  Write a record with the logger of the process
+        inline void Write(const ELevel LEVEL, const std::string_view& Module, const std::string_view& Message, std::initializer_list<Field> Fields = {})
+        {
+            Logger::Get().Write(LEVEL, Module, Message, Fields);
+        }
+
+        inline void Trace(const std::string_view& Module, const std::string_view& Message, std::initializer_list<Field> Fields = {})
+        {
+            Write(ELevel::Trace, Module, Message, Fields);
+        }
+
+        inline void Debug(const std::string_view& Module, const std::string_view& Message, std::initializer_list<Field> Fields = {})
+        {
+            Write(ELevel::Debug, Module, Message, Fields);
+        }
+
+        inline void Info(const std::string_view& Module, const std::string_view& Message, std::initializer_list<Field> Fields = {})
+        {
+            Write(ELevel::Info, Module, Message, Fields);
+        }
+
+        inline void Warning(const std::string_view& Module, const std::string_view& Message, std::initializer_list<Field> Fields = {})
+        {
+            Write(ELevel::Warning, Module, Message, Fields);
+        }
+
+        inline void Error(const std::string_view& Module, const std::string_view& Message, std::initializer_list<Field> Fields = {})
+        {
+            Write(ELevel::Error, Module, Message, Fields);
+        }
+    } // namespace Log
+} // namespace ORION
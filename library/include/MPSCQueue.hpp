@@ -0,0 +1,115 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+namespace ORION
+{
+    /**
+     * @brief The intrusive hook a type must derive from to be stored in an MPSCQueue.
+     *
+     * @tparam T The type deriving from this hook (CRTP)
+     */
+    template <typename T>
+    struct MPSCQueueNode
+    {
+        /// @brief  The next node in the queue. Owned by the queue while the node is queued
+        T* pMPSCNext = nullptr;
+    };
+
+    /**
+     * @brief A lock-free, unbounded, intrusive multi-producer/single-consumer queue.
+     *
+     * Any number of threads may call Push concurrently; a push is a single compare-and-swap and never allocates or takes a lock.
+     * Only a single thread (the consumer) may call Drain, which takes every queued node with one atomic exchange and hands them
+     * to the consumer in push order, so the consumer pays one atomic operation per batch instead of per element.
+     *
+     * The queue owns the nodes between Push and Drain. Nodes are passed in and out as std::unique_ptr.
+     *
+     * @tparam T The type of the nodes. Must derive from MPSCQueueNode<T>.
+     */
+    template <typename T>
+    class MPSCQueue final
+    {
+        static_assert(std::is_base_of_v<MPSCQueueNode<T>, T>, "MPSCQueue nodes must derive from MPSCQueueNode");
+
+    public:
+        MPSCQueue() = default;
+
+        MPSCQueue(const MPSCQueue&)            = delete;
+        MPSCQueue& operator=(const MPSCQueue&) = delete;
+
+        ~MPSCQueue()
+        {
+            Drain([](std::unique_ptr<T>) {});
+        }
+
+        /**
+         * @brief Push a node onto the queue. Safe to call from any thread.
+         *
+         * @param pNode The node to push. The queue takes ownership
+         * @return Whether the queue was empty before the push (the consumer may need to be woken up)
+         */
+        bool Push(std::unique_ptr<T> pNode)
+        {
+            T* pRawNode = pNode.release();
+            T* pHead    = m_pHead.load(std::memory_order_relaxed);
+            do
+            {
+                pRawNode->pMPSCNext = pHead;
+            } while (!m_pHead.compare_exchange_weak(pHead, pRawNode, std::memory_order_release, std::memory_order_relaxed));
+
+            return pHead == nullptr;
+        }
+
+        /**
+         * @brief Take every queued node and hand them to the consumer in the order they were pushed. Must only be called from the consumer thread.
+         *
+         * @param Consumer Called with ownership of each node (std::unique_ptr<T>)
+         * @return The number of nodes drained
+         */
+        template <typename ConsumerFunc>
+        size_t Drain(ConsumerFunc&& Consumer)
+        {
+            // Take the whole (LIFO) chain at once, then reverse it into push order
+            T* pStack = m_pHead.exchange(nullptr, std::memory_order_acquire);
+
+            T* pOrdered = nullptr;
+            while (pStack)
+            {
+                T* pNext          = pStack->pMPSCNext;
+                pStack->pMPSCNext = pOrdered;
+                pOrdered          = pStack;
+                pStack            = pNext;
+            }
+
+            size_t Count = 0;
+            while (pOrdered)
+            {
+                T* pNext            = pOrdered->pMPSCNext;
+                pOrdered->pMPSCNext = nullptr;
+                Consumer(std::unique_ptr<T>(pOrdered));
+                pOrdered = pNext;
+                ++Count;
+            }
+
+            return Count;
+        }
+
+        /**
+         * @brief Check if the queue is empty. The result is only a snapshot when producers are active.
+         *
+         * @return Whether there are no nodes queued
+         */
+        bool IsEmpty() const
+        {
+            return m_pHead.load(std::memory_order_acquire) == nullptr;
+        }
+
+    private:
+        /// @brief  The most recently pushed node. The nodes form a LIFO chain through MPSCQueueNode::pMPSCNext
+        std::atomic<T*> m_pHead = nullptr;
+    };
+} // namespace ORION
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+
+namespace ORION
+{
+    /**
+     * @class MappedFile
+     * @brief A read-only memory mapping of a whole file.
+     *
+     * Responses for large files are sent straight from the mapping, so the file content goes from the page cache to the socket without
+     * being read into a buffer first. The mapping stays valid after the file is replaced (renamed over) or deleted, but not if the file is
+     * truncated in place, so writers of served files must replace them instead of rewriting them.
+     */
+    class MappedFile final
+    {
+    public:
+        /// @brief  Map a file
+        /// @param  FilePath The path of the file
+        /// @return The mapping, or nullptr if the file can't be opened or mapped
+        static std::shared_ptr<const MappedFile> Open(const std::filesystem::path& FilePath);
+
+        MappedFile(const MappedFile&)            = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        ~MappedFile();
+
+        /// @brief  Get the mapped content
+        const uint8_t* GetData() const
+        {
+            return m_pData;
+        }
+
+        /// @brief  Get the size of the mapped content
+        uint64_t GetSize() const
+        {
+            return m_Size;
+        }
+
+    private:
+        MappedFile(const uint8_t* pData, const uint64_t SIZE);
+
+        /// @brief  The mapped content (nullptr for empty files, which can't be mapped)
+        const uint8_t* m_pData;
+
+        /// @brief  The size of the mapped content
+        uint64_t m_Size;
+    };
+} // namespace ORION
@@ -0,0 +1,218 @@
+#pragma once
+
+#include <cpprest/http_client.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ORION
+{
+    /**
+     * @brief Counters, gauges and histograms exposed at /metrics in the Prometheus text format.
+     *
+     * Updating a metric is a few relaxed atomic operations. Looking one up by name and labels takes a shared lock, so hot paths with fixed
+     * labels should keep the reference (metrics are never removed, references stay valid for the life of the process).
+     */
+    namespace Metrics
+    {
+        /// @brief  The labels of a series, as name/value pairs
+        using Labels = std::vector<std::pair<std::string, std::string>>;
+
+        /// @brief  A value that only goes up (requests served, bytes sent, ...)
+        class Counter final
+        {
+        public:
+            /// @brief  Add to the counter
+            void Increment(const uint64_t AMOUNT = 1)
+            {
+                m_Value.fetch_add(AMOUNT, std::memory_order_relaxed);
+            }
+
+            /// @brief  Get the value of the counter
+            uint64_t GetValue() const
+            {
+                return m_Value.load(std::memory_order_relaxed);
+            }
+
+        private:
+            /// @brief  The value
+            std::atomic<uint64_t> m_Value = 0;
+        };
+
+        /// @brief  A value that goes up and down (connections open, runs in flight, ...)
+        class Gauge final
+        {
+        public:
+            /// @brief  Set the gauge
+            void Set(const int64_t VALUE)
+            {
+                m_Value.store(VALUE, std::memory_order_relaxed);
+            }
+
+            /// @brief  Add to the gauge (negative to subtract)
+            void Add(const int64_t AMOUNT)
+            {
+                m_Value.fetch_add(AMOUNT, std::memory_order_relaxed);
+            }
+
+            /// @brief  Get the value of the gauge
+            int64_t GetValue() const
+            {
+                return m_Value.load(std::memory_order_relaxed);
+            }
+
+        private:
+            /// @brief  The value
+            std::atomic<int64_t> m_Value = 0;
+        };
+
+        /// @brief  The distribution of observed values (usually durations in seconds) over fixed buckets
+        class Histogram final
+        {
+        public:
+            /// @brief  Constructor
+            /// @param  InUpperBounds The upper bounds of the buckets, ascending. A +Inf bucket is implied
+            explicit Histogram(std::vector<double> InUpperBounds);
+
+            /// @brief  Record a value
+            void Observe(const double VALUE);
+
+            /// @brief  Get the upper bounds of the buckets (without +Inf)
+            const std::vector<double>& GetUpperBounds() const
+            {
+                return m_UpperBounds;
+            }
+
+            /// @brief  Get the number of values in each bucket (not cumulative), the last one being +Inf
+            std::vector<uint64_t> GetBucketCounts() const;
+
+            /// @brief  Get the sum of the observed values
+            double GetSum() const
+            {
+                return m_Sum.load(std::memory_order_relaxed);
+            }
+
+        private:
+            /// @brief  The upper bounds of the buckets
+            std::vector<double> m_UpperBounds;
+
+            /// @brief  The number of values in each bucket, plus +Inf
+            std::unique_ptr<std::atomic<uint64_t>[]> m_BucketCounts;
+
+            /// @brief  The sum of the observed values
+            std::atomic<double> m_Sum = 0.0;
+        };
+
+        /// @brief  Observes the time from its construction to its destruction (in seconds) in a histogram
+        class ScopedTimer final
+        {
+        public:
+            explicit ScopedTimer(Histogram& InHistogram)
+                : m_Histogram(InHistogram),
+                  m_Start(std::chrono::steady_clock::now())
+            {
+            }
+
+            ~ScopedTimer()
+            {
+                m_Histogram.Observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - m_Start).count());
+            }
+
+            ScopedTimer(const ScopedTimer&)            = delete;
+            ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+        private:
+            /// @brief  The histogram the duration is recorded in
+            Histogram& m_Histogram;
+
+            /// @brief  When the timer was started
+            std::chrono::steady_clock::time_point m_Start;
+        };
+
+        /// @brief  The buckets used for latencies: 5ms to 60s
+        const std::vector<double>& GetLatencyBuckets();
+
+        /**
+         * @class Registry
+         * @brief Owns the metrics of the process and renders them in the Prometheus text format.
+         */
+        class Registry final
+        {
+        public:
+            /// @brief  The kind of a metric family
+            enum class EType
+            {
+                Counter,
+                Gauge,
+                Histogram,
+            };
+
+            /// @brief  Get the registry of the process
+            static Registry& Get();
+
+            /// @brief  Get (or create) a counter
+            /// @param  Name The name of the metric (e.g. orion_http_requests_total)
+            /// @param  Help The description of the metric
+            /// @param  InLabels The labels of the series
+            Counter& GetCounter(const std::string& Name, const std::string& Help, const Labels& InLabels = {});
+
+            /// @brief  Get (or create) a gauge
+            Gauge& GetGauge(const std::string& Name, const std::string& Help, const Labels& InLabels = {});
+
+            /// @brief  Get (or create) a histogram
+            /// @param  UpperBounds The upper bounds of the buckets (only used when the series is created)
+            Histogram& GetHistogram(const std::string& Name, const std::string& Help, const Labels& InLabels = {},
+                                    const std::vector<double>& UpperBounds = GetLatencyBuckets());
+
+            /// @brief  Add a counter or gauge whose value is read when the metrics are rendered (for values another component already tracks)
+            /// @param  TYPE Counter or Gauge
+            /// @param  Read Returns the current value. Called from the thread rendering the metrics
+            void AddCallback(const EType TYPE, const std::string& Name, const std::string& Help, const Labels& InLabels, std::function<double()> Read);
+
+            /// @brief  Remove a callback added with AddCallback (e.g. when the object it reads is destroyed)
+            void RemoveCallback(const std::string& Name, const Labels& InLabels);
+
+            /// @brief  Render every metric in the Prometheus text exposition format (version 0.0.4)
+            std::string Serialize() const;
+
+        private:
+            /// @brief  The series of a metric, keyed by their rendered labels
+            struct Family
+            {
+                EType                                             Type = EType::Counter;
+                std::string                                       Help;
+                std::map<std::string, std::unique_ptr<Counter>>   Counters;
+                std::map<std::string, std::unique_ptr<Gauge>>     Gauges;
+                std::map<std::string, std::unique_ptr<Histogram>> Histograms;
+                std::map<std::string, std::function<double()>>    Callbacks;
+            };
+
+            /// @brief  Get (or create) a family. Called with the mutex held exclusively
+            Family& GetFamily(const std::string& Name, const std::string& Help, const EType TYPE);
+
+            /// @brief  The metric families, keyed by name (rendered in name order)
+            std::map<std::string, Family> m_Families;
+
+            /// @brief  The mutex for the families (shared for lookups and rendering)
+            mutable std::shared_mutex m_Mutex;
+        };
+
+        /// @brief  Record the latency and status of every request an http client sends, per endpoint. Ids in the path (thread_..., file-...)
+        ///         are collapsed so the number of series stays bounded
+        /// @param  Client The client
+        /// @param  Service The name of the service the client talks to (the "service" label, e.g. openai)
+        void InstrumentClient(web::http::client::http_client& Client, const std::string& Service);
+
+        /// @brief  Collapse the ids in a request path so it can be used as a label (threads/thread_abc/runs -> threads/:id/runs). Versions and
+        ///         short numbers are kept (customsearch/v1, data/2.5/weather)
+        std::string GetEndpointLabel(const std::string& Path);
+    } // namespace Metrics
+} // namespace ORION
@@ -0,0 +1,256 @@
+#pragma once
+
+#include <cpprest/http_client.h>
+#include <cpprest/json.h>
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace ORION
+{
+    /**
+     * @brief The typed layer over the OpenAI API that Orion and the web server call instead of building requests by hand.
+     *
+     * Each operation sets the headers the API expects and is retried with jittered exponential backoff (or after the Retry-After the API
+     * asks for) when it fails transiently: a 408, 429 or 5xx, or no response at all. Operations that would be repeated if sent twice
+     * (creating a message, a run, an assistant, uploading a file) are only retried when the API refused them without processing them
+     * (429). A process-wide circuit breaker stops calls for a while once the API keeps failing, so a struggling API isn't hammered and
+     * callers fail fast. Calls, retries and latency are exposed per operation (orion_openai_* metrics).
+     *
+     * The calls of all clients share the budgets of the organization's quota: each endpoint class has a request and a token budget per
+     * minute, and a call waits until its class can pay for it rather than being sent to be refused. Waiting interactive calls (runs,
+     * messages, transcriptions) go before waiting background ones (embeddings, speech). A 429 pauses its class for the Retry-After.
+     */
+    namespace OpenAI
+    {
+        /// @brief  How failed calls are retried, and when the circuit breaker stops calls
+        struct RetryOptions
+        {
+            /// @brief  The retries of a failed call, after its first attempt
+            size_t MaxRetries = 3;
+
+            /// @brief  The backoff before the first retry. Each retry doubles it up to MaxBackoff; the actual delay is random up to that (full jitter)
+            std::chrono::milliseconds InitialBackoff = std::chrono::milliseconds(500);
+            std::chrono::milliseconds MaxBackoff     = std::chrono::seconds(8);
+
+            /// @brief  The longest Retry-After honoured. A call asked to wait longer fails instead
+            std::chrono::milliseconds MaxRetryAfter = std::chrono::seconds(60);
+
+            /// @brief  The failed attempts in a row (5xx or no response) that open the circuit. 0 disables the breaker
+            size_t BreakerThreshold = 5;
+
+            /// @brief  How long the circuit stays open before a trial call is let through
+            std::chrono::milliseconds BreakerCooldown = std::chrono::seconds(30);
+        };
+
+        /// @brief  The budget of an endpoint class. A rate of 0 is no limit
+        struct RateBudget
+        {
+            /// @brief  The calls per minute
+            double RequestsPerMinute = 0.0;
+
+            /// @brief  The tokens per minute, estimated from the request (a token is about four characters)
+            double TokensPerMinute = 0.0;
+        };
+
+        /// @brief  The budgets of the endpoint classes, shared by the whole process
+        struct RateLimitOptions
+        {
+            /// @brief  Assistants, threads, messages, runs and files
+            RateBudget Assistants = {1000.0, 0.0};
+
+            /// @brief  Chat completions
+            RateBudget Chat = {500.0, 200000.0};
+
+            /// @brief  Embeddings
+            RateBudget Embeddings = {3000.0, 1000000.0};
+
+            /// @brief  Speech and transcriptions
+            RateBudget Audio = {50.0, 0.0};
+        };
+
+        /// @brief  The endpoint classes, each with a budget of its own
+        enum class EEndpointClass
+        {
+            Assistants,
+            Chat,
+            Embeddings,
+            Audio,
+        };
+
+        /// @brief  The lane a call waits in for its budget. Interactive calls go first
+        enum class EPriority
+        {
+            Interactive,
+            Background,
+        };
+
+        /// @brief  Apply the retry settings to all clients
+        void Configure(const RetryOptions& Options);
+
+        /// @brief  Apply the budgets to all clients. Calls waiting for a budget are paced by the new one
+        void Configure(const RateLimitOptions& Options);
+
+        /**
+         * @class APIError
+         * @brief A call that failed after its retries, or that the open circuit refused.
+         */
+        class APIError final : public std::runtime_error
+        {
+        public:
+            APIError(std::string Operation, const web::http::status_code STATUS, const std::string& Message);
+
+            /// @brief  Get the operation that failed (create_thread, upload_file, ...)
+            const std::string& GetOperation() const
+            {
+                return m_Operation;
+            }
+
+            /// @brief  Get the status of the last response. 0 if none arrived (or the circuit is open)
+            web::http::status_code GetStatus() const
+            {
+                return m_Status;
+            }
+
+        private:
+            std::string            m_Operation;
+            web::http::status_code m_Status;
+        };
+
+        /**
+         * @class FilePayload
+         * @brief The content of a file to upload: bytes in memory, base64 text, or a file on disk. Copies share the content.
+         *
+         * The content is read in chunks as the body of the upload is built, so base64 text is decoded straight into the body and a file is
+         * never loaded whole. Bodies larger than a few megabytes are built in a temporary file and streamed from it.
+         */
+        class FilePayload final
+        {
+        public:
+            /// @brief  Bytes in memory
+            static FilePayload FromMemory(std::vector<unsigned char> Data);
+
+            /// @brief  Base64 text, decoded as it is read
+            /// @param  Base64 The text. It isn't copied: pOwner keeps it alive
+            /// @param  pOwner The owner of the text
+            static FilePayload FromBase64(const std::string_view Base64, std::shared_ptr<const void> pOwner);
+
+            /// @brief  A file on disk, read as the body is built
+            /// @param  pOwner Kept alive with the payload, e.g. to remove a temporary file once the last copy is gone
+            static FilePayload FromFile(std::string Path, std::shared_ptr<const void> pOwner = nullptr);
+
+            /// @brief  Get the size of the content in bytes (decoded). 0 for a file that can't be read
+            size_t GetSize() const;
+
+            /// @brief  Pass the content to a sink in chunks
+            /// @throw  std::runtime_error If the content can't be read (a missing file, invalid base64)
+            void Read(const std::function<void(const unsigned char* pData, const size_t SIZE)>& Sink) const;
+
+        private:
+            FilePayload() = default;
+
+            /// @brief  The bytes, if in memory
+            std::shared_ptr<const std::vector<unsigned char>> m_pData;
+
+            /// @brief  The base64 text, if base64
+            std::string_view m_Base64;
+
+            /// @brief  The owner of the base64 text or the file
+            std::shared_ptr<const void> m_pOwner;
+
+            /// @brief  The path, if a file
+            std::string m_Path;
+        };
+
+        /**
+         * @class Client
+         * @brief The operations of the OpenAI API, for one API key. Clients share the pooled connection of Upstream::GetOpenAIClient.
+         *
+         * JSON operations complete with the response's JSON; streamed ones (runs, speech, file content) with the response, whose body is
+         * read by the caller. All fail with APIError.
+         */
+        class Client final
+        {
+        public:
+            explicit Client(std::string APIKey);
+
+            /// @brief  Assistants
+            pplx::task<web::json::value> ListAssistants() const;
+            pplx::task<web::json::value> CreateAssistant(const web::json::value& Body) const;
+            pplx::task<web::json::value> UpdateAssistant(const std::string& AssistantID, const web::json::value& Body) const;
+
+            /// @brief  Threads and messages
+            pplx::task<web::json::value> CreateThread() const;
+            pplx::task<web::json::value> CreateMessage(const std::string& ThreadID, const web::json::value& Body) const;
+            pplx::task<web::json::value> ListMessages(const std::string& ThreadID, const size_t LIMIT, const std::string& Order) const;
+
+            /// @brief  Runs. Created runs and submitted tool outputs are streamed: the response's body is the run's event stream
+            pplx::task<web::http::http_response> CreateRunStream(const std::string& ThreadID, web::json::value Body) const;
+            pplx::task<web::http::http_response> SubmitToolOutputsStream(const std::string& ThreadID, const std::string& RunID, const web::json::value& ToolOutputs) const;
+            pplx::task<web::json::value>         CancelRun(const std::string& ThreadID, const std::string& RunID) const;
+
+            /// @brief  Files
+            pplx::task<web::json::value> UploadFile(const std::string& FileName, const std::string& MimeType, FilePayload Payload, const std::string& Purpose = "assistants") const;
+            pplx::task<web::json::value>         GetFile(const std::string& FileID) const;
+            pplx::task<web::http::http_response> GetFileContent(const std::string& FileID) const;
+
+            /// @brief  Embeddings and chat completions
+            pplx::task<web::json::value> CreateEmbeddings(const web::json::value& Body) const;
+            pplx::task<web::json::value> CreateChatCompletion(const web::json::value& Body) const;
+
+            /// @brief  Audio. The speech is streamed in the response's body
+            pplx::task<web::http::http_response> CreateSpeech(const web::json::value& Body) const;
+            pplx::task<web::json::value>         CreateTranscription(const std::string& FileName, const std::string& MimeType, FilePayload Payload, const std::string& Model) const;
+
+        private:
+            /// @brief  What an operation is, for its retries and its budget
+            struct Operation
+            {
+                /// @brief  The name of the operation in metrics and errors (create_thread, upload_file, ...)
+                std::string_view Name;
+
+                /// @brief  Whether sending the operation twice is harmless (then it is retried on any transient failure)
+                bool IsIdempotent = false;
+
+                /// @brief  The budget the operation is paid from, and the lane it waits in
+                EEndpointClass Class    = EEndpointClass::Assistants;
+                EPriority      Priority = EPriority::Interactive;
+            };
+
+            /// @brief  Builds the request of an attempt (a request can only be sent once, so each attempt gets a new one). Requests with a body
+            ///         streamed from a file complete once the file is open
+            using RequestFactory = std::function<pplx::task<web::http::http_request>()>;
+
+            /// @brief  Create a request without a body. Requests only capture the API key, so calls outlive the client
+            RequestFactory CreateRequest(const web::http::method& Method, const std::string& Path) const;
+
+            /// @brief  Create a request with a JSON body
+            RequestFactory CreateJsonRequest(const web::http::method& Method, const std::string& Path, const web::json::value& Body) const;
+
+            /// @brief  Send an operation with a multipart/form-data body of fields and a file. The body is built once, off the calling thread, and
+            ///         shared by the attempts
+            pplx::task<web::json::value> SendMultipart(const Operation& OPERATION, const std::string& Path, const std::vector<std::pair<std::string, std::string>>& Fields,
+                                                       const std::string& FileName, const std::string& MimeType, FilePayload Payload) const;
+
+            /// @brief  Send an operation with retries. Completes with its successful response, or fails with APIError
+            /// @param  TOKENS The estimated tokens of the operation, paid from its class's token budget by each attempt
+            pplx::task<web::http::http_response> Send(const Operation& OPERATION, RequestFactory CreateAttemptRequest, const double TOKENS = 0.0) const;
+
+            /// @brief  Send an operation with retries and extract the JSON of its response
+            pplx::task<web::json::value> SendForJson(const Operation& OPERATION, RequestFactory CreateAttemptRequest, const double TOKENS = 0.0) const;
+
+            /// @brief  The API key
+            std::string m_APIKey;
+
+            /// @brief  The pooled client of the OpenAI API
+            std::shared_ptr<web::http::client::http_client> m_pHttpClient;
+        };
+    } // namespace OpenAI
+} // namespace ORION
@@ -1,11 +1,14 @@
 #pragma once
 #include "ETTSAudioFormat.hpp"
+#include "OpenAIClient.hpp"
 
 #include <cpprest/http_client.h>
 #include <cpprest/http_msg.h>
 #include <cpprest/json.h>
 #include <cstdint>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
 #include <thread>
 #include <vector>
@@ -66,6 +69,16 @@ namespace ORION
         Default = Base
     };
 
+    /// @brief  A file attached to a message
+    struct MessageFile
+    {
+        /// @brief  The name of the file. Its extension gives its mime type
+        std::string Name;
+
+        /// @brief  The content of the file
+        OpenAI::FilePayload Payload;
+    };
+
     /// @brief  A class that represents ORION. This is the main class that should be
     /// used to interact with ORION
     class Orion
@@ -124,11 +137,19 @@ namespace ORION
          */
         bool Initialize(class OrionWebServer& WebServer, const web::http::http_request& Request);
 
-        /// @brief  Send a message to the server asynchronously. Responses from the server will be sent back to the client using Server-Sent Events
+        /// @brief  Send a message to the server asynchronously. Responses from the server will be sent back to the client using Server-Sent Events.
+        /// Returns right away: no thread waits on the network for the message, its run or the run's event stream
         /// @param  Message The message to send
-        /// @param Files The files to send
-        /// @return Nothing
-        pplx::task<void> SendMessageAsync(const std::string& Message, const web::json::array& Files = web::json::value::array().as_array());
+        /// @param  Files The files to send
+        /// @return A task that completes once the run has ended, or fails if the message or the run could not be created
+        pplx::task<void> SendMessageAsync(const std::string& Message, std::vector<MessageFile> Files = {});
+
+        /// @brief  Send a message with files given as JSON ({name, data (base64)}). Malformed files are left out
+        pplx::task<void> SendMessageAsync(const std::string& Message, web::json::array Files);
+
+        /// @brief  Cancel the assistant run in progress, if any. Its event stream ends shortly after. Safe to call from any thread
+        /// @return A task that completes once the API has answered (a failure is logged, not thrown)
+        pplx::task<void> CancelCurrentRun();
 
         /// @brief  Speak a message asynchronously. This function will segment the message into multiple parts if it is too long and call the
         /// SpeakSingleAsync function to speak each part.
@@ -177,6 +198,11 @@ namespace ORION
             return m_OpenAIAPIKey;
         }
 
+        /// @brief  Get the process-wide client of an API, shared by all instances (and plugins) so requests reuse its warm connections
+        /// @param  BaseURL The base URL of the API (a fixed one; clients are shared per base URL)
+        /// @param  Service The name the client's requests are measured and traced as
+        static std::shared_ptr<web::http::client::http_client> GetHttpClient(const std::string& BaseURL, const std::string& Service);
+
         /// @brief  Get the OpenWeather API Key
         /// @return The OpenWeather API Key
         inline std::string GetOpenWeatherAPIKey() const
@@ -311,14 +337,43 @@ namespace ORION
         /// @return The message split into multiple parts
         pplx::task<std::vector<std::string>> SplitMessageAsync(const std::string& Message) const;
 
+        /// @brief  Upload the files of a message, up to MAX_PARALLEL_UPLOADS at a time
+        /// @param  pFiles The files
+        /// @return The attachments of the message for the files that were uploaded, in the order of the files
+        pplx::task<web::json::value> UploadFilesAsync(std::shared_ptr<const std::vector<MessageFile>> pFiles);
+
         /**
          * @brief Process the OpenAI Event Stream. This function is called when the OpenAI API sends an event stream in response to a request
          *
          * @param EventStream The stream to process
+         * @return A task that completes once the stream has ended (with the streams of the tool outputs submitted meanwhile)
          */
-        void ProcessOpenAIEventStream(const concurrency::streams::istream& EventStream);
+        pplx::task<void> ProcessOpenAIEventStreamAsync(const concurrency::streams::istream& EventStream);
 
     private:
+        /// @brief  The most files of a message uploaded at the same time
+        static constexpr size_t MAX_PARALLEL_UPLOADS = 4;
+
+        /// @brief  The uploads of the files of a message
+        struct FileUploads;
+
+        /// @brief  Upload the next file of a message that no upload has taken yet, then the next one, and so on
+        void UploadNextFile(const std::shared_ptr<FileUploads>& pUploads);
+
+        /// @brief  An OpenAI event stream being read
+        struct OpenAIEventStream;
+
+        /// @brief  Read the lines of an event stream until it ends or has to wait for the stream of submitted tool outputs
+        void ReadOpenAIEventStream(const std::shared_ptr<OpenAIEventStream>& pStream);
+
+        /// @brief  Process a line read from an event stream
+        /// @return Whether to read the next line (false once the stream ended, failed, or waits for the stream of submitted tool outputs)
+        bool ProcessOpenAIEventStreamLine(const std::shared_ptr<OpenAIEventStream>& pStream, const pplx::task<size_t>& ReadLineTask, const std::string& Line);
+
+        /// @brief  Process the event assembled from the lines of an event stream
+        /// @return The task of the stream of the tool outputs the event submitted, if it did
+        std::optional<pplx::task<void>> ProcessOpenAIEvent(OpenAIEventStream& Stream);
+
         std::string                              m_Name;
         std::string                              m_Instructions;
         std::string                              m_Description;
@@ -333,10 +388,13 @@ namespace ORION
         EOrionVoice                              m_CurrentVoice;
         EOrionIntelligence                       m_CurrentIntelligence;
         std::string                              m_CurrentAssistantRunID;
+
+        /// @brief  The mutex for m_CurrentAssistantRunID (the run's event stream sets it while other threads may cancel the run)
+        std::mutex m_CurrentAssistantRunMutex;
         std::vector<std::unique_ptr<PluginModule>>    m_Plugins;
 
         /// @brief The client used to communicate with the OpenAI API
-        std::unique_ptr<web::http::client::http_client> m_OpenAIClient;
+        std::unique_ptr<OpenAI::Client> m_OpenAIClient;
 
         /** @brief The Web Server that this instance is associated with. This is used to send responses back to the client (Server-Sent Events Etc.)
          *
@@ -0,0 +1,252 @@
+#pragma once
+
+#include "MPSCQueue.hpp"
+
+#include <cpprest/json.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace ORION
+{
+    /**
+     * @class OrionEventDispatcher
+     * @brief Delivers Orion server events (SSE) to the subscribed clients of each user.
+     *
+     * Events are partitioned into shards by user id. Each shard owns a lock-free MPSC queue and a worker thread, so all events
+     * of a given user are delivered in order by the same thread while different users are delivered in parallel.
+     *
+     * Every event gets an id that increases monotonically per user, and the most recent events of each user are kept in a ring buffer.
+     * A client reconnecting with the id of the last event it saw (SSE Last-Event-ID) is sent exactly the events it missed before it
+     * receives any new ones. If those events are no longer buffered, it is sent a RESYNC_EVENT_NAME event instead. The events of a user
+     * without clients are kept for CHANNEL_RETENTION after its last event or client, then dropped (its clients are resynced).
+     *
+     * The dispatcher knows nothing about the transports; each subscriber is a sink that formats and writes the events for its connection
+     * (SSE, WebSocket, ...).
+     */
+    class OrionEventDispatcher final
+    {
+    public:
+        /// @brief  A single event waiting to be delivered. Owns all of its data and is move-only; it is handed from the producer to the
+        ///         shard thread through the queue without being copied
+        struct Event final : MPSCQueueNode<Event>
+        {
+            inline Event(const std::string& InUserID, const std::string_view& InName, web::json::value&& InData)
+                : UserID(InUserID),
+                  Name(InName),
+                  Data(std::move(InData))
+            {
+            }
+
+            Event(const Event&)            = delete;
+            Event& operator=(const Event&) = delete;
+            Event(Event&&)                 = default;
+            Event& operator=(Event&&)      = default;
+
+            /// @brief  The id of the user the event is for
+            std::string UserID;
+
+            /// @brief  The event name (one of OrionWebServer::SSEOrionEventNames)
+            std::string Name;
+
+            /// @brief  The event data
+            web::json::value Data;
+        };
+
+        /// @brief  An event that was delivered to (or replayed for) a subscriber
+        struct RecordedEvent
+        {
+            /// @brief  The per-user sequence number of the event (see FormatEventID)
+            uint64_t Sequence = 0;
+
+            /// @brief  The event name
+            std::string Name;
+
+            /// @brief  The serialized event data (JSON)
+            std::string Data;
+        };
+
+        /// @brief  Writes a batch of events (in order) to a subscribed client. Called from the shard threads, and from Subscribe for replays
+        using EventSink = std::function<void(const std::vector<const RecordedEvent*>& Events)>;
+
+        /// @brief  The event sent to a reconnecting client whose missed events are no longer buffered. The client must reload its state
+        static constexpr std::string_view RESYNC_EVENT_NAME = "events.resync";
+
+        /// @brief  The default number of recent events kept per user for replay
+        static constexpr size_t DEFAULT_REPLAY_BUFFER_SIZE = 256;
+
+        /// @brief  How long the events of a user without clients are kept after its last event or client, for a client to reconnect
+        static constexpr std::chrono::minutes CHANNEL_RETENTION = std::chrono::minutes(10);
+
+        /// @brief  Constructor
+        /// @param  SHARD_COUNT The number of shards (worker threads). 0 means one shard per hardware thread
+        /// @param  REPLAY_BUFFER_SIZE The number of recent events kept per user for replay to reconnecting clients
+        explicit OrionEventDispatcher(const size_t SHARD_COUNT = 0, const size_t REPLAY_BUFFER_SIZE = DEFAULT_REPLAY_BUFFER_SIZE);
+
+        /// @brief  Destructor. Stops the worker threads
+        ~OrionEventDispatcher();
+
+        OrionEventDispatcher(const OrionEventDispatcher&)            = delete;
+        OrionEventDispatcher& operator=(const OrionEventDispatcher&) = delete;
+
+        /// @brief  Start the shard worker threads
+        void Start();
+
+        /// @brief  Stop the shard worker threads. Events still queued are delivered before the threads exit
+        void Stop();
+
+        /// @brief  Queue an event for delivery to all clients subscribed for the given user. Safe to call from any thread; never takes a lock
+        ///         unless the shard thread is asleep
+        /// @param  UserID The id of the user the event is for
+        /// @param  Name The event name
+        /// @param  Data The event data
+        void Dispatch(const std::string& UserID, const std::string_view& Name, web::json::value&& Data);
+
+        /// @brief  Subscribe a client to the events of a user
+        /// @param  UserID The id of the user
+        /// @param  Sink Writes the events to the client. Must not block on the network and must not call back into the dispatcher
+        /// @param  LastEventID The id of the last event the client received (SSE Last-Event-ID), or empty for a new client. The events after
+        ///         it are written to the client before any new event
+        /// @return The id of the subscription, to be passed to Unsubscribe
+        uint64_t Subscribe(const std::string& UserID, EventSink Sink, const std::string& LastEventID = {});
+
+        /// @brief  Unsubscribe a client, e.g. because its connection was closed
+        /// @param  UserID The id of the user
+        /// @param  SubscriptionID The id returned by Subscribe
+        void Unsubscribe(const std::string& UserID, const uint64_t SubscriptionID);
+
+        /// @brief  Format the id of an event as sent to the clients ("<epoch>-<sequence>")
+        /// @param  SEQUENCE The sequence number of the event
+        std::string FormatEventID(const uint64_t SEQUENCE) const;
+
+        /// @brief  Get the number of shards (worker threads)
+        inline size_t GetShardCount() const
+        {
+            return m_Shards.size();
+        }
+
+        /// @brief  Counters of the dispatcher
+        struct Stats
+        {
+            uint64_t Subscribers     = 0;
+            uint64_t QueuedEvents    = 0;
+            uint64_t DeliveredEvents = 0;
+        };
+
+        /// @brief  Get the number of subscribed clients, the events waiting to be delivered and the events delivered so far
+        Stats GetStats() const;
+
+    private:
+        /// @brief  A client subscribed to the events of a user
+        struct Subscriber
+        {
+            /// @brief  The id of the subscription
+            uint64_t SubscriptionID = 0;
+
+            /// @brief  Writes the events to the client
+            EventSink Sink;
+        };
+
+        /// @brief  The delivery state of a single user
+        struct UserChannel
+        {
+            /// @brief  The sequence number of the last event of the user (the sequence the channel started at if none yet)
+            uint64_t LastSequence = 0;
+
+            /// @brief  The sequence number of the first event of the channel. Earlier events were dropped with an evicted channel
+            uint64_t FirstSequence = 1;
+
+            /// @brief  When the user last had an event or a client left. A channel without clients is evicted CHANNEL_RETENTION later
+            std::chrono::steady_clock::time_point LastActivity = std::chrono::steady_clock::now();
+
+            /// @brief  The ring buffer of the most recent events of the user. Slot (Sequence % size) holds the event with that sequence
+            std::vector<RecordedEvent> RecentEvents;
+
+            /// @brief  The clients subscribed to the events of the user
+            std::vector<Subscriber> Subscribers;
+        };
+
+        struct Shard
+        {
+            /// @brief  The events waiting to be delivered by this shard
+            MPSCQueue<Event> Queue;
+
+            /// @brief  The worker thread delivering the events
+            std::thread Thread;
+
+            /// @brief  Whether the worker thread is (about to be) waiting for new events. Producers only touch the mutex when this is set
+            std::atomic<bool> IsSleeping = false;
+
+            /// @brief  The mutex for the wake condition variable
+            std::mutex WakeMutex;
+
+            /// @brief  Signaled when an event is queued while the worker thread is sleeping
+            std::condition_variable WakeConditionVariable;
+
+            /// @brief  The delivery state of the users in this shard, keyed by user id
+            std::unordered_map<std::string, UserChannel> Channels;
+
+            /// @brief  The mutex for the channels
+            std::mutex ChannelsMutex;
+
+            /// @brief  The highest sequence number of the channels evicted so far. New channels start after it, so an id issued before an
+            ///         eviction never names an event of the new channel
+            uint64_t EvictedSequence = 0;
+
+            /// @brief  When the shard thread next evicts the idle channels
+            std::chrono::steady_clock::time_point NextSweep = std::chrono::steady_clock::now();
+        };
+
+        /// @brief  Get the shard responsible for a user
+        Shard& GetShard(const std::string& UserID) const;
+
+        /// @brief  Get the channel of a user, creating it if needed. The channels mutex of the shard must be held
+        static UserChannel& GetChannel(Shard& InShard, const std::string& UserID);
+
+        /// @brief  Evict the channels without clients that have been idle for CHANNEL_RETENTION, if a sweep is due. Called by the shard thread
+        static void SweepChannels(Shard& InShard);
+
+        /// @brief  The worker thread handler of a shard
+        void ShardThreadHandler(Shard& InShard);
+
+        /// @brief  Wake the worker thread of a shard if it is sleeping
+        void WakeShard(Shard& InShard);
+
+        /// @brief  Parse a Last-Event-ID sent by a client
+        /// @return The sequence number, or nothing if the id is malformed or was issued by another dispatcher (e.g. before a restart)
+        std::optional<uint64_t> ParseEventID(const std::string& EventID) const;
+
+        /// @brief  Write a batch of events to every client of a user
+        static void DeliverToSubscribers(const UserChannel& Channel, const std::vector<const RecordedEvent*>& Events);
+
+        /// @brief  The shards
+        std::vector<std::unique_ptr<Shard>> m_Shards;
+
+        /// @brief  The number of recent events kept per user
+        size_t m_ReplayBufferSize;
+
+        /// @brief  Prefixed to every event id so that ids issued before a restart are recognized as stale
+        uint64_t m_Epoch;
+
+        /// @brief  The id of the last subscription
+        std::atomic<uint64_t> m_LastSubscriptionID = 0;
+
+        /// @brief  Whether the worker threads are running
+        std::atomic<bool> m_IsRunning = false;
+
+        /// @brief  The counters reported by GetStats
+        std::atomic<uint64_t> m_SubscriberCount     = 0;
+        std::atomic<uint64_t> m_QueuedEventCount    = 0;
+        std::atomic<uint64_t> m_DeliveredEventCount = 0;
+    };
+} // namespace ORION
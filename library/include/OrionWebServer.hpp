@@ -1,13 +1,22 @@
 #pragma once
 
+#include "AdmissionController.hpp"
+#include "AssetCache.hpp"
+#include "Compression.hpp"
+#include "Metrics.hpp"
 #include "Orion.hpp"
+#include "OrionEventDispatcher.hpp"
+#include "OrionWebServerOptions.hpp"
+#include "OrionWebSocketServer.hpp"
 #include "User.hpp"
+#include "UserStore.hpp"
 #include <cpprest/http_listener.h>
 #include <cpprest/producerconsumerstream.h>
 #include <memory>
 #include <optional>
 #include <regex>
 #include <thread>
+#include <unordered_map>
 #include <vector>
 
 namespace ORION
@@ -49,6 +58,7 @@ namespace ORION
 #define AUDIO_DIR_TEMPLATE "{audio_dir}"               // The placeholder for the audio directory in template strings
 #define DATABASE_DIR "database"                        // The directory where the web server will look for database files
 #define USERS_DATABASE_FILE_NAME "users.db"            // The users database file
+#define UPLOADS_DATABASE_FILE_NAME "uploads.db"        // The upload cache database file
 #define OPENAI_API_KEY_FILE_NAME ".openai_api_key.txt" // The file containing the OpenAI API key
 
             /// @brief  The root directory where the web server will look for static assets not specific to an Orion instance
@@ -77,6 +87,9 @@ namespace ORION
             /// @brief  The directory where the web server will look for the users database file
             static constexpr auto DATABASE_FILE = ASSETS_DIR "/" DATABASE_DIR "/" USERS_DATABASE_FILE_NAME;
 
+            /// @brief  The database of the files already uploaded to OpenAI
+            static constexpr auto UPLOADS_DATABASE_FILE = ASSETS_DIR "/" DATABASE_DIR "/" UPLOADS_DATABASE_FILE_NAME;
+
             /// @brief  The file containing the OpenAI API key
             static constexpr auto OPENAI_API_KEY_FILE = OPENAI_API_KEY_FILE_NAME;
 
@@ -142,6 +155,7 @@ namespace ORION
 #undef PLUGINS_DIR
 #undef DATABASE_DIR
 #undef USERS_DATABASE_FILE_NAME
+#undef UPLOADS_DATABASE_FILE_NAME
 #undef OPENAI_API_KEY_FILE_NAME
         };
 
@@ -183,28 +197,61 @@ namespace ORION
             static constexpr std::string_view TOOL_STARTED               = "tool.started";
             static constexpr std::string_view TOOL_DELTA                 = "tool.delta";
             static constexpr std::string_view TOOL_COMPLETED             = "tool.completed";
+            static constexpr std::string_view EVENTS_RESYNC              = OrionEventDispatcher::RESYNC_EVENT_NAME;
         };
 
+        /// @brief  Constructor
+        /// @param  OPTIONS The settings of the server (ports, TLS, thread pools, limits, compression)
+        explicit OrionWebServer(const OrionWebServerOptions& OPTIONS = OrionWebServerOptions());
+
         /// @brief  Destructor (virtual for inheritance)
-        virtual ~OrionWebServer() = default;
+        virtual ~OrionWebServer();
 
-        /// @brief  Start the web server
+        /// @brief  Start the web server with the configured settings
+        void Start();
+
+        /// @brief  Start the web server on the given ports (overriding the configured ones)
         /// @param  PORT The port to listen on
-        void Start(const int PORT);
+        /// @param  WEBSOCKET_PORT The port to serve the /orion/ws WebSocket endpoint on. 0 disables the endpoint
+        void Start(const int PORT, const int WEBSOCKET_PORT = 0);
+
+        /// @brief  Get the settings of the server
+        const OrionWebServerOptions& GetOptions() const
+        {
+            return m_Options;
+        }
 
-        /// @brief  Stop the web server
+        /// @brief  Stop the web server gracefully: refuse new messages, let the runs in flight finish (cancelling those still running after the
+        ///         drain timeout), deliver their pending events, end the event streams and close the WebSocket connections. Wait() then
+        ///         closes the listener. Blocks until the drain is over
         void Stop();
 
+        /// @brief  Check whether the web server is running (false if it failed to start, or once it has stopped)
+        bool IsRunning() const
+        {
+            return m_IsRunning;
+        }
+
         /// @brief  Wait for the web server to stop
         void Wait();
 
         /**
-         * @brief Sends an SSE to the client.
+         * @brief Sends an SSE to the clients of a user.
+         *
+         * @param UserID The id of the user the event is for.
+         * @param Event The event name.
+         * @param Data The data associated with the event (JSON format: `{message: Data}`).
+         */
+        void SendServerEvent(const std::string& UserID, const OrionEventName& Event, const web::json::value& Data);
+
+        /**
+         * @brief Sends an SSE to the clients of a user, taking ownership of the data (no copy on the streaming hot path).
          *
+         * @param UserID The id of the user the event is for.
          * @param Event The event name.
          * @param Data The data associated with the event (JSON format: `{message: Data}`).
          */
-        void SendServerEvent(const OrionEventName& Event, const web::json::value& Data);
+        void SendServerEvent(const std::string& UserID, const OrionEventName& Event, web::json::value&& Data);
 
         /**
          * @brief Get User ID associated with an Orion instance.
@@ -237,6 +284,8 @@ namespace ORION
         /// @example Response: "Hello, user!"
         /// @example curl -X POST -d {"message": "Hello, Orion!"} http://localhost:5000/orion/send_message?markdown=true
         /// @example Response: {"message": "<p>Hello, user!</p>"}
+        /// @note   Messages are subject to admission control: a user sending too fast gets 429 Too Many Requests and an overloaded server
+        ///         replies 503 Service Unavailable, both with a Retry-After header
         void HandleSendMessageEndpoint(web::http::http_request Request);
 
         /// @brief  The / endpoint is used to serve the Orion web interface
@@ -246,12 +295,49 @@ namespace ORION
         void HandleRootEndpoint(web::http::http_request Request);
 
         /// @brief  The /<file> endpoint is used to serve asset files (images, stylesheets, scripts, etc.)
-        ///         This is a catch-all endpoint that will serve any file in the assets directory.
+        ///         This is a catch-all endpoint that will serve any file in the assets directory (except the database).
         /// @param  Request The HTTP request
         /// @example curl -X GET http://localhost:5000/image.png
         /// @example Response: The contents of the image.png file served from the assets directory
         void HandleAssetFileEndpoint(web::http::http_request Request);
 
+        /// @brief  Reply with an asset from the asset cache. The response carries an ETag and Cache-Control, is compressed when the client
+        ///         accepts it, and is 304 Not Modified when the client's If-None-Match matches
+        /// @param  Request The HTTP request
+        /// @param  RelativePath The path of the asset relative to the assets directory
+        void ReplyWithAsset(web::http::http_request Request, const std::string& RelativePath);
+
+        /// @brief  Reply with JSON, compressed with the client's preferred coding when it is larger than the compression threshold
+        /// @param  Request The HTTP request
+        /// @param  STATUS The status code
+        /// @param  Body The JSON body
+        void ReplyWithJson(web::http::http_request Request, const web::http::status_code STATUS, const web::json::value& Body) const;
+
+        /// @brief  Reply with a text body, compressed like ReplyWithJson
+        /// @param  Request The HTTP request
+        /// @param  STATUS The status code
+        /// @param  Body The body
+        /// @param  ContentType The content type of the body
+        void ReplyWithText(web::http::http_request Request, const web::http::status_code STATUS, std::string Body, const std::string& ContentType) const;
+
+        /**
+         * @brief Handles the /metrics endpoint: the metrics of the server and Orion in the Prometheus text format.
+         *
+         * @param Request The HTTP request.
+         */
+        void HandleMetricsEndpoint(web::http::http_request Request) const;
+
+        /**
+         * @brief Handles the /debug/traces endpoint: the latency traces of recent messages. /debug/traces lists them (newest first),
+         *        /debug/traces/{trace_id} returns the timeline of one, or its OTLP/JSON export with ?format=otlp.
+         *
+         * @param Request The HTTP request.
+         */
+        void HandleTracesEndpoint(web::http::http_request Request) const;
+
+        /// @brief  Register the metrics read from the server's components (runs, event delivery, connections). Removed by the destructor
+        void RegisterMetrics();
+
         /// @brief  The /markdown endpoint is used to convert a message to markdown
         /// @param  Request The HTTP request
         /// @example curl -X POST -d {"message": "Hello, Orion!"} http://localhost:5000/markdown
@@ -305,10 +391,11 @@ namespace ORION
         void HandleTranscribeEndpoint(web::http::http_request Request) const;
 
         /**
-         * @brief Handles the /orion/events endpoint. This endpoint is used to subscribe to Orion events.
+         * @brief Handles the /orion/events endpoint. This endpoint is used to subscribe to the Orion events of a user.
+         * The user is identified by the X-User-Id header or the user_id query parameter (EventSource can't set headers).
          *
          * @param Request The HTTP request
-         * @example curl -X GET http://localhost:5000/orion/events
+         * @example curl -X GET http://localhost:5000/orion/events?user_id=1234
          * @example Response: Status 200 OK
          */
         void HandleOrionEventsEndpoint(web::http::http_request Request);
@@ -336,6 +423,51 @@ namespace ORION
          */
         void HandleOrionPluginsEndpoint(web::http::http_request Request) const;
 
+        /**
+         * @brief Validates a connection to the /orion/ws WebSocket endpoint. The endpoint carries the Orion events of a user and accepts
+         * messages for Orion over a single connection, so clients don't need the /orion/events stream and a POST per message.
+         * The user is identified by the user_id query parameter (browsers can't set headers on WebSockets). A reconnecting client can
+         * pass the id of the last event it received in the last_event_id query parameter to have the missed events replayed.
+         *
+         * @param Resource The requested path and query
+         * @return Whether the connection is accepted (the path is /orion/ws and the user is logged in)
+         * @example wss://localhost:5001/orion/ws?user_id=1234&last_event_id=1700000000-42
+         */
+        bool HandleWebSocketValidate(const std::string& Resource);
+
+        /// @brief  Subscribes a new /orion/ws connection to the Orion events of its user
+        /// @param  CONNECTION_ID The connection
+        /// @param  Resource The requested path and query
+        void HandleWebSocketOpen(const OrionWebSocketServer::ConnectionID CONNECTION_ID, const std::string& Resource);
+
+        /**
+         * @brief Handles a message received on an /orion/ws connection. Messages are JSON objects with a type field.
+         *
+         * Client to server:
+         *  - {"type": "send_message", "message": "Hello, Orion!", "files": [...], "request_id": "1"} sends a message to Orion (as /orion/send_message)
+         *  - {"type": "ping", "request_id": "2"} checks the connection
+         *
+         * Server to client:
+         *  - {"type": "event", "id": "...", "event": "message.delta", "data": {...}} an Orion event (see SSEOrionEventNames)
+         *  - {"type": "ack", "request_id": "1"} the message was accepted
+         *  - {"type": "pong", "request_id": "2"} the reply to a ping
+         *  - {"type": "error", "message": "...", "request_id": "1"} the message was rejected. Rejections by admission control also carry
+         *    a status (429 or 503) and retry_after (seconds)
+         *
+         * @param CONNECTION_ID The connection
+         * @param Message The message
+         */
+        void HandleWebSocketMessage(const OrionWebSocketServer::ConnectionID CONNECTION_ID, const std::string& Message);
+
+        /// @brief  Unsubscribes a closed /orion/ws connection
+        /// @param  CONNECTION_ID The connection
+        void HandleWebSocketClose(const OrionWebSocketServer::ConnectionID CONNECTION_ID);
+
+        /// @brief  Find the Orion instance of a logged in user
+        /// @param  UserID The id of the user
+        /// @return The Orion instance, or nullptr if the user is not logged in or has no instance
+        Orion* FindOrionInstance(const std::string& UserID) const;
+
         /// @brief  Instantiates a new Orion instance and returns the new instance. If an Orion instance with the given id already exists on
         /// the server A new local Orion instance is created from the data of the existing server instance. If an Orion instance with the given id
         /// exists locally, the existing instance is returned. If an Orion instance with the given id does not exist, a new instance is created on the
@@ -345,12 +477,6 @@ namespace ORION
         /// @return The Orion instance.
         const Orion& InstantiateOrionInstance(const std::string& ExistingOrionInstanceID = "");
 
-        /**
-         * @brief The Orion Event thread handler. Processes Orion events in the event queue and sends them to the client. This function is run in a
-         * separate thread.
-         */
-        void OrionEventThreadHandler();
-
         /// @brief  The orion instances that were created this session
         std::vector<std::unique_ptr<Orion>> m_OrionInstances;
 
@@ -360,9 +486,15 @@ namespace ORION
         /// @brief  Whether the web server is running
         std::atomic<bool> m_IsRunning = false;
 
+        /// @brief  Whether the web server is stopping (draining)
+        std::atomic<bool> m_IsStopping = false;
+
         /// @brief  The condition variable for the web server. Signaled when the web server is stopped
         std::condition_variable m_ConditionVariable;
 
+        /// @brief  The settings of the server
+        OrionWebServerOptions m_Options;
+
         /// @brief  The mutex for the web server
         std::mutex m_Mutex;
 
@@ -370,34 +502,57 @@ namespace ORION
         std::vector<User> m_LoggedInUsers;
 
         /**
-         * @brief The queue of Orion events to be processed.
+         * @brief Delivers Orion events to the subscribed clients, sharded by user id.
          */
-        std::queue<std::pair<OpenAIEventName, web::json::value>> m_OrionEventQueue;
+        OrionEventDispatcher m_EventDispatcher;
 
         /**
-         * @brief The mutex for the Orion event queue.
+         * @brief Limits how fast each user can send messages to Orion and how many runs are in flight.
          */
-        std::mutex m_OrionEventQueueMutex;
+        AdmissionController m_AdmissionController;
 
         /**
-         * @brief The condition variable for the Orion event queue.
+         * @brief The static assets, held in memory with their ETags and compressed variants.
          */
-        std::condition_variable m_OrionEventQueueConditionVariable;
+        AssetCache m_AssetCache;
 
         /**
-         * @brief Registered Orion Event Clients
+         * @brief The registered users. Opened once when the server starts.
          */
-        std::vector<concurrency::streams::producer_consumer_buffer<uint8_t>> m_OrionEventClients;
+        UserStore m_UserStore;
 
-        /**
-         * @brief The mutex for the Orion event clients.
-         */
-        std::mutex m_OrionEventClientsMutex;
 
-        /**
-         * @brief The Orion Event thread.
-         */
-        std::thread m_OrionEventThread;
+        /// @brief  An open /orion/ws connection
+        struct WebSocketSession
+        {
+            /// @brief  The id of the user of the connection
+            std::string UserID;
+
+            /// @brief  The subscription of the connection to the user's events
+            uint64_t SubscriptionID = 0;
+        };
+
+        /// @brief  The bodies of the open /orion/events responses, keyed by subscription id. Closed when the server stops so the clients see
+        ///         the stream end (and reconnect) instead of a reset connection
+        std::unordered_map<uint64_t, concurrency::streams::producer_consumer_buffer<uint8_t>> m_EventStreams;
+
+        /// @brief  The mutex for the event streams
+        std::mutex m_EventStreamsMutex;
+
+        /// @brief  The metric callbacks registered by RegisterMetrics (name and labels)
+        std::vector<std::pair<std::string, Metrics::Labels>> m_MetricCallbacks;
+
+        /// @brief  The certificate, key and session ticket keys of the listener and the /orion/ws endpoint (null if TLS is off)
+        std::shared_ptr<const TLSServerContext> m_pTLSContext;
+
+        /// @brief  The server for the /orion/ws endpoint (null if disabled)
+        std::unique_ptr<OrionWebSocketServer> m_pWebSocketServer;
+
+        /// @brief  The open /orion/ws connections
+        std::unordered_map<OrionWebSocketServer::ConnectionID, WebSocketSession> m_WebSocketSessions;
+
+        /// @brief  The mutex for the WebSocket sessions
+        std::mutex m_WebSocketSessionsMutex;
 
         /**
          * @brief the current endpoint request.
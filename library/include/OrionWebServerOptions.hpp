@@ -0,0 +1,112 @@
+#pragma once
+
+#include "AdmissionController.hpp"
+#include "Compression.hpp"
+#include "FormData.hpp"
+#include "Logger.hpp"
+#include "OpenAIClient.hpp"
+#include "OrionEventDispatcher.hpp"
+#include "TLSServerContext.hpp"
+#include "UploadCache.hpp"
+#include "Upstream.hpp"
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace ORION
+{
+    /**
+     * @brief The settings of an OrionWebServer.
+     *
+     * Every setting can be given on the command line (--port 5000 or --port=5000) or in a config file (port = 5000, one per line, # starts a
+     * comment) passed with --config. Command line settings override the config file. See GetUsage for the list.
+     */
+    struct OrionWebServerOptions
+    {
+        /// @brief  The port of the web interface and API
+        int Port = 5000;
+
+        /// @brief  The address the listeners bind to
+        std::string BindAddress = "0.0.0.0";
+
+        /// @brief  Whether the listener serves HTTPS (and the WebSocket endpoint, which requires TLS, is available). Turn it off when a local
+        ///         reverse proxy terminates TLS
+        bool IsTLSEnabled = true;
+
+        /// @brief  The certificate, key, ciphers and session resumption of the listener and the WebSocket endpoint
+        TLSOptions TLS;
+
+        /// @brief  The port of the /orion/ws WebSocket endpoint. 0 disables it
+        int WebSocketPort = 5001;
+
+        /// @brief  The number of threads of the worker pool. cpprestsdk runs both the listener's io and all pplx continuations on this pool,
+        ///         and request handlers block on it, so it is sized well above the core count. 0 picks GetDefaultWorkerThreadCount
+        size_t WorkerThreadCount = 0;
+
+        /// @brief  The number of event dispatch shards (threads). 0 picks one per core
+        size_t EventDispatchShardCount = 0;
+
+        /// @brief  The number of events kept per user to replay to reconnecting clients
+        size_t EventReplayBufferSize = OrionEventDispatcher::DEFAULT_REPLAY_BUFFER_SIZE;
+
+        /// @brief  The number of pooled connections to the users database
+        size_t UserStoreConnectionCount = 4;
+
+        /// @brief  How long Stop() waits for the runs in flight to finish before cancelling them
+        size_t DrainTimeoutSeconds = 30;
+
+        /// @brief  The per-user rate limit and global in-flight cap for messages sent to Orion
+        AdmissionControlOptions Admission;
+
+        /// @brief  The compression of JSON responses and the event stream
+        ResponseCompressionOptions Compression;
+
+        /// @brief  The levels, output and truncation of the log
+        Log::LogOptions Logging;
+
+        /// @brief  The number of message traces kept for /debug/traces. 0 disables tracing
+        size_t TraceBufferSize = 100;
+
+        /// @brief  The directory finished message traces are written to as OTLP/JSON files. Empty to not write them
+        std::string TraceDirectory;
+
+        /// @brief  Whether /metrics and /debug/traces are served to every client. Off, only to clients on the loopback interface that don't
+        ///         come through a proxy, since traces name the runs of every user
+        bool IsDebugEndpointPublic = false;
+
+        /// @brief  The base URL of the OpenAI API, and whether its responses are recorded to or replayed from a cassette
+        Upstream::UpstreamOptions OpenAI;
+
+        /// @brief  How failed OpenAI calls are retried, and when the circuit breaker stops them
+        OpenAI::RetryOptions OpenAIRetries;
+
+        /// @brief  The per-minute budgets of the OpenAI endpoint classes, shared by all Orion instances
+        OpenAI::RateLimitOptions OpenAIRateLimits;
+
+        /// @brief  How long uploaded attachments are reused, and how often they are verified
+        UploadCacheOptions UploadCache;
+
+        /// @brief  The limits of multipart/form-data messages: their size, and the size of a file kept in memory before it is written to disk
+        FormData::ReadOptions MessageUploads;
+
+        /// @brief  Get the worker thread count used when none is configured: four per core, but at least cpprestsdk's default of 40
+        static size_t GetDefaultWorkerThreadCount();
+
+        /// @brief  Get the worker thread count after resolving 0 to the default
+        size_t GetWorkerThreadCount() const;
+
+        /// @brief  Parse the command line (and the config file it names)
+        /// @param  Arguments The arguments, without the program name
+        /// @param  OutError The error, if parsing failed
+        /// @return The options, or nothing if an argument is invalid (or --help was given, with an empty error)
+        static std::optional<OrionWebServerOptions> Parse(const std::vector<std::string>& Arguments, std::string& OutError);
+
+        /// @brief  Get the description of the command line options
+        static std::string GetUsage(const std::string& ProgramName);
+
+        /// @brief  Describe the effective settings in one line (for the startup log)
+        std::string Describe() const;
+    };
+} // namespace ORION
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "TLSServerContext.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace ORION
+{
+    /**
+     * @class OrionWebSocketServer
+     * @brief A minimal TLS WebSocket server (cpprestsdk's http_listener can't upgrade connections, so this runs on its own port).
+     *
+     * The server only manages connections and frames; what the messages mean is up to the owner, which is notified through the
+     * callbacks. Connections are identified by an id that stays valid until OnClose is called for it.
+     */
+    class OrionWebSocketServer final
+    {
+    public:
+        /// @brief  Identifies a connection
+        using ConnectionID = uint64_t;
+
+        /// @brief  The callbacks of the server. They are called from the server's thread and must not block
+        struct Callbacks
+        {
+            /// @brief  Called during the handshake with the requested resource (path and query). Return false to reject the connection
+            std::function<bool(const std::string& Resource)> OnValidate;
+
+            /// @brief  Called when a connection is established
+            std::function<void(const ConnectionID CONNECTION_ID, const std::string& Resource)> OnOpen;
+
+            /// @brief  Called for each text message received on a connection
+            std::function<void(const ConnectionID CONNECTION_ID, const std::string& Message)> OnMessage;
+
+            /// @brief  Called when a connection is closed (or failed). The connection id is invalid afterwards
+            std::function<void(const ConnectionID CONNECTION_ID)> OnClose;
+        };
+
+        /// @brief  Constructor
+        /// @param  InCallbacks The callbacks of the server
+        explicit OrionWebSocketServer(Callbacks InCallbacks);
+
+        /// @brief  Destructor. Stops the server
+        ~OrionWebSocketServer();
+
+        OrionWebSocketServer(const OrionWebSocketServer&)            = delete;
+        OrionWebSocketServer& operator=(const OrionWebSocketServer&) = delete;
+
+        /// @brief  Start listening and serving connections on a background thread
+        /// @param  BindAddress The address to listen on
+        /// @param  PORT The port to listen on
+        /// @param  pTLSContext The certificate, key and session ticket keys shared with the other listeners
+        /// @return Whether the server is listening
+        bool Start(const std::string& BindAddress, const int PORT, std::shared_ptr<const TLSServerContext> pTLSContext);
+
+        /// @brief  Stop listening, close all connections and wait for the server thread to exit
+        void Stop();
+
+        /// @brief  Send a text message on a connection. Safe to call from any thread; the message is queued and sent asynchronously
+        /// @param  CONNECTION_ID The connection
+        /// @param  Message The message
+        /// @return Whether the message was queued (false if the connection is gone)
+        bool Send(const ConnectionID CONNECTION_ID, const std::string& Message);
+
+    private:
+        /// @brief  The websocketpp endpoint and connection table (kept out of the header so websocketpp isn't a public dependency)
+        struct Impl;
+
+        /// @brief  The implementation
+        std::unique_ptr<Impl> m_pImpl;
+    };
+} // namespace ORION
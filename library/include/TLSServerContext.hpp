@@ -0,0 +1,68 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+// OpenSSL's SSL_CTX (the native handle of an asio ssl context), declared here so OpenSSL isn't a public dependency
+struct ssl_ctx_st;
+
+namespace ORION
+{
+    /// @brief  The TLS settings of the listener and the WebSocket endpoint
+    struct TLSOptions
+    {
+        /// @brief  The PEM certificate chain file (leaf first). ECDSA P-256 certificates make handshakes several times cheaper than RSA
+        std::string CertificateFile = "cert.pem";
+
+        /// @brief  The PEM private key file (unencrypted)
+        std::string PrivateKeyFile = "key.pem";
+
+        /// @brief  The OpenSSL cipher list for TLS 1.2 (TLS 1.3 always uses OpenSSL's suites). Forward secret AEAD ciphers only
+        std::string Ciphers = "ECDHE-ECDSA-AES128-GCM-SHA256:ECDHE-RSA-AES128-GCM-SHA256:ECDHE-ECDSA-AES256-GCM-SHA384:ECDHE-RSA-AES256-GCM-SHA384:"
+                              "ECDHE-ECDSA-CHACHA20-POLY1305:ECDHE-RSA-CHACHA20-POLY1305";
+
+        /// @brief  Whether clients may resume sessions with session tickets (an abbreviated handshake without the certificate and key exchange)
+        bool IsSessionResumptionEnabled = true;
+    };
+
+    /**
+     * @class TLSServerContext
+     * @brief The certificate, key and session ticket keys shared by every TLS connection of the server.
+     *
+     * cpprestsdk and websocketpp create a new ssl context for every connection. Configuring each of them from the PEM files parses the files
+     * on every handshake, and each context would otherwise generate its own ticket keys, so no session could ever be resumed. This loads the
+     * files once and gives every context the same parsed credentials and the same ticket keys (generated at startup, so tickets don't survive
+     * a restart).
+     */
+    class TLSServerContext final
+    {
+    public:
+        /// @brief  Load the certificate and key and check the settings
+        /// @param  OPTIONS The settings
+        /// @param  OutError The error, if the context couldn't be created
+        /// @return The context, or null on failure
+        static std::shared_ptr<const TLSServerContext> Create(const TLSOptions& OPTIONS, std::string& OutError);
+
+        ~TLSServerContext();
+
+        TLSServerContext(const TLSServerContext&)            = delete;
+        TLSServerContext& operator=(const TLSServerContext&) = delete;
+
+        /// @brief  Configure a connection's ssl context: protocols, ciphers, credentials and session tickets
+        /// @param  pContext The context (boost::asio::ssl::context::native_handle())
+        /// @return Whether the context was configured
+        bool Apply(ssl_ctx_st* pContext) const;
+
+    private:
+        /// @brief  The parsed credentials and ticket keys (kept out of the header so OpenSSL isn't a public dependency)
+        struct Credentials;
+
+        explicit TLSServerContext(const TLSOptions& OPTIONS);
+
+        /// @brief  The settings
+        TLSOptions m_Options;
+
+        /// @brief  The credentials
+        std::unique_ptr<Credentials> m_pCredentials;
+    };
+} // namespace ORION
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace ORION
+{
+    /**
+     * @class TimerQueue
+     * @brief Runs callbacks once they are due, on a thread of its own.
+     *
+     * For code that has to wait without holding a thread of the worker pool (pplx has no timers): the replay of recorded upstream
+     * responses, and the OpenAI stand-in of the load test. Callbacks run one at a time and must not block; callbacks due at the same time
+     * run in the order they were scheduled.
+     */
+    class TimerQueue final
+    {
+    public:
+        TimerQueue();
+
+        /// @brief  Destructor. Callbacks that aren't due yet are dropped
+        ~TimerQueue();
+
+        TimerQueue(const TimerQueue&)            = delete;
+        TimerQueue& operator=(const TimerQueue&) = delete;
+
+        /// @brief  Run a callback once a delay has passed
+        void Schedule(const std::chrono::steady_clock::duration DELAY, std::function<void()> Callback)
+        {
+            ScheduleAt(std::chrono::steady_clock::now() + DELAY, std::move(Callback));
+        }
+
+        /// @brief  Run a callback at a point in time (right away if it has passed)
+        void ScheduleAt(const std::chrono::steady_clock::time_point DUE, std::function<void()> Callback);
+
+    private:
+        /// @brief  A scheduled callback
+        struct Timer
+        {
+            std::chrono::steady_clock::time_point Due;
+            uint64_t                              Sequence = 0;
+            std::function<void()>                 Callback;
+
+            /// @brief  Order for the queue: earliest first, then in the order scheduled
+            bool operator>(const Timer& Other) const
+            {
+                return Due != Other.Due ? Due > Other.Due : Sequence > Other.Sequence;
+            }
+        };
+
+        /// @brief  The timer thread handler
+        void TimerThreadHandler();
+
+        /// @brief  The scheduled callbacks, earliest first
+        std::priority_queue<Timer, std::vector<Timer>, std::greater<>> m_Timers;
+
+        /// @brief  The sequence of the next callback scheduled
+        uint64_t m_NextSequence = 0;
+
+        /// @brief  Whether the queue is running (cleared on destruction)
+        bool m_IsRunning = true;
+
+        /// @brief  The mutex for the timers, and the condition variable signaled when an earlier timer is scheduled or the queue stops
+        std::mutex              m_Mutex;
+        std::condition_variable m_ConditionVariable;
+
+        /// @brief  The timer thread. Declared last, so it starts once the other members are constructed
+        std::thread m_TimerThread;
+    };
+} // namespace ORION
@@ -0,0 +1,268 @@
+#pragma once
+
+#include <cpprest/http_client.h>
+#include <cpprest/json.h>
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ORION
+{
+    /**
+     * @brief Per-message latency traces: a timeline of spans (upstream requests, event stream phases, tool executions) for each message.
+     *
+     * Traces are kept in memory for the debug endpoint (/debug/traces) and can be written as OTLP/JSON files, which an OpenTelemetry
+     * collector or Jaeger can import. The active trace is tracked per thread (see TraceScope), so code that doesn't know about tracing
+     * (e.g. an http client pipeline stage) can add spans to it.
+     */
+    namespace Tracing
+    {
+        /// @brief  The id of a span within its trace. 0 is no span
+        using SpanID = uint64_t;
+
+        /// @brief  The attributes of a span, as key/value pairs
+        using Attributes = std::vector<std::pair<std::string, std::string>>;
+
+        /**
+         * @class Trace
+         * @brief The spans recorded while handling one message. Thread safe: spans are added from the threads the message is processed on.
+         */
+        class Trace final
+        {
+        public:
+            /// @brief  Constructor. Starts the root span
+            /// @param  Name The name of the root span (e.g. send_message)
+            /// @param  InAttributes The attributes of the root span
+            Trace(const std::string& Name, Attributes InAttributes);
+
+            /// @brief  Get the id of the trace (32 hex characters, as in W3C trace context)
+            const std::string& GetTraceID() const
+            {
+                return m_TraceID;
+            }
+
+            /// @brief  Get the id of the root span
+            SpanID GetRootSpanID() const
+            {
+                return m_RootSpanID;
+            }
+
+            /// @brief  Start a span
+            /// @param  Name The name of the span
+            /// @param  PARENT_ID The parent of the span (0 for the root span)
+            /// @return The id of the span
+            SpanID StartSpan(const std::string& Name, const SpanID PARENT_ID = 0);
+
+            /// @brief  End a span. Does nothing if the span has already ended
+            /// @param  SPAN_ID The span
+            /// @param  InAttributes Attributes to add to the span
+            /// @param  IS_ERROR Whether the operation the span covers failed
+            void EndSpan(const SpanID SPAN_ID, const Attributes& InAttributes = {}, const bool IS_ERROR = false);
+
+            /// @brief  Add an attribute to a span
+            void SetAttribute(const SpanID SPAN_ID, const std::string& Key, const std::string& Value);
+
+            /// @brief  Record a point in time within a span (an event of the upstream event stream, ...)
+            void AddEvent(const SpanID SPAN_ID, const std::string& Name);
+
+            /// @brief  Record that the first token of the reply arrived. Only the first call counts
+            /// @return True if this was the first token
+            bool MarkFirstToken();
+
+            /// @brief  Get the time from the start of the trace to the first token, if it arrived
+            std::optional<std::chrono::steady_clock::duration> GetTimeToFirstToken() const;
+
+            /// @brief  End the root span and any span still open. Called once the reply is complete (or failed)
+            /// @param  IS_ERROR Whether the message failed
+            void Finish(const bool IS_ERROR = false);
+
+            /// @brief  Check if the trace is finished
+            bool IsFinished() const;
+
+            /// @brief  Get a short summary of the trace (id, name, start, duration, time to first token)
+            web::json::value ToSummaryJson() const;
+
+            /// @brief  Get the timeline of the trace. Times are milliseconds from the start of the trace
+            web::json::value ToJson() const;
+
+            /// @brief  Get the trace in the OTLP/JSON format (an ExportTraceServiceRequest)
+            web::json::value ToOTLPJson() const;
+
+        private:
+            /// @brief  A point in time within a span
+            struct Event
+            {
+                std::string                           Name;
+                std::chrono::steady_clock::time_point Time;
+            };
+
+            /// @brief  A timed operation
+            struct Span
+            {
+                SpanID                                ID       = 0;
+                SpanID                                ParentID = 0;
+                std::string                           Name;
+                std::chrono::steady_clock::time_point Start;
+                std::chrono::steady_clock::time_point End;
+                bool                                  IsEnded = false;
+                bool                                  IsError = false;
+                Attributes                            SpanAttributes;
+                std::vector<Event>                    Events;
+            };
+
+            /// @brief  Find a span. Called with the mutex held
+            Span* FindSpan(const SpanID SPAN_ID);
+
+            /// @brief  Convert a time of the trace to milliseconds from its start
+            double ToMilliseconds(const std::chrono::steady_clock::time_point& Time) const;
+
+            /// @brief  Convert a time of the trace to nanoseconds since the unix epoch (as a string, as OTLP/JSON encodes 64 bit integers)
+            std::string ToUnixNanoseconds(const std::chrono::steady_clock::time_point& Time) const;
+
+            /// @brief  The id of the trace
+            std::string m_TraceID;
+
+            /// @brief  The id of the root span
+            SpanID m_RootSpanID = 0;
+
+            /// @brief  When the trace started (steady clock for durations, system clock for the timestamps of the exports)
+            std::chrono::steady_clock::time_point m_Start;
+            std::chrono::system_clock::time_point m_SystemStart;
+
+            /// @brief  When the first token arrived
+            std::optional<std::chrono::steady_clock::time_point> m_FirstToken;
+
+            /// @brief  The spans, in start order. The root span is first
+            std::vector<Span> m_Spans;
+
+            /// @brief  Whether the trace is finished
+            bool m_IsFinished = false;
+
+            /// @brief  The mutex for the spans
+            mutable std::mutex m_Mutex;
+        };
+
+        /**
+         * @class TraceScope
+         * @brief Makes a trace the active trace of the current thread until it is destroyed. Set it at the start of each continuation that
+         *        works on the message, since continuations run on pool threads.
+         */
+        class TraceScope final
+        {
+        public:
+            /// @brief  Constructor
+            /// @param  pTrace The trace (nullptr when tracing is disabled, which makes every span a no-op)
+            /// @param  PARENT_ID The span new spans are parented to (0 for the root span)
+            explicit TraceScope(std::shared_ptr<Trace> pTrace, const SpanID PARENT_ID = 0);
+
+            ~TraceScope();
+
+            TraceScope(const TraceScope&)            = delete;
+            TraceScope& operator=(const TraceScope&) = delete;
+
+            /// @brief  Get the active trace of the current thread (nullptr if there is none)
+            static std::shared_ptr<Trace> GetCurrentTrace();
+
+            /// @brief  Get the span new spans of the current thread are parented to
+            static SpanID GetCurrentSpanID();
+
+        private:
+            /// @brief  The trace and parent span that were active before this scope
+            std::shared_ptr<Trace> m_pPreviousTrace;
+            SpanID                 m_PreviousSpanID = 0;
+        };
+
+        /**
+         * @class ScopedSpan
+         * @brief A span of the active trace that lasts until it is destroyed. Spans started on the same thread meanwhile are its children.
+         */
+        class ScopedSpan final
+        {
+        public:
+            /// @brief  Constructor. Does nothing if the thread has no active trace
+            /// @param  Name The name of the span
+            /// @param  InAttributes The attributes of the span
+            explicit ScopedSpan(const std::string& Name, const Attributes& InAttributes = {});
+
+            ~ScopedSpan();
+
+            ScopedSpan(const ScopedSpan&)            = delete;
+            ScopedSpan& operator=(const ScopedSpan&) = delete;
+
+            /// @brief  Add an attribute to the span
+            void SetAttribute(const std::string& Key, const std::string& Value);
+
+            /// @brief  Mark the operation the span covers as failed
+            void SetError()
+            {
+                m_IsError = true;
+            }
+
+        private:
+            /// @brief  The trace of the span (nullptr if there was no active trace)
+            std::shared_ptr<Trace> m_pTrace;
+
+            /// @brief  The span, and the span that was the parent of new spans before it
+            SpanID m_SpanID         = 0;
+            SpanID m_PreviousSpanID = 0;
+
+            /// @brief  Whether the operation failed
+            bool m_IsError = false;
+        };
+
+        /**
+         * @class TraceStore
+         * @brief Keeps the most recent traces of the process and writes finished traces to disk.
+         */
+        class TraceStore final
+        {
+        public:
+            /// @brief  Get the store of the process
+            static TraceStore& Get();
+
+            /// @brief  Configure the store
+            /// @param  CAPACITY The number of traces kept in memory. 0 disables tracing
+            /// @param  OTLPDirectory The directory finished traces are written to as OTLP/JSON files (empty to not write them)
+            void Configure(const size_t CAPACITY, const std::string& OTLPDirectory);
+
+            /// @brief  Start a trace and keep it (traces are visible while in progress)
+            /// @return The trace, or nullptr if tracing is disabled
+            std::shared_ptr<Trace> StartTrace(const std::string& Name, Attributes InAttributes = {});
+
+            /// @brief  Finish a trace and write it to disk if configured to
+            void FinishTrace(const std::shared_ptr<Trace>& pTrace, const bool IS_ERROR = false);
+
+            /// @brief  Get the most recent traces, newest first
+            std::vector<std::shared_ptr<Trace>> GetRecentTraces() const;
+
+            /// @brief  Find a trace by id
+            /// @return The trace, or nullptr if it isn't (or no longer) kept
+            std::shared_ptr<Trace> FindTrace(const std::string& TraceID) const;
+
+        private:
+            /// @brief  The traces, oldest first
+            std::deque<std::shared_ptr<Trace>> m_Traces;
+
+            /// @brief  The number of traces kept
+            size_t m_Capacity = 100;
+
+            /// @brief  The directory finished traces are written to
+            std::string m_OTLPDirectory;
+
+            /// @brief  The mutex for the traces and the configuration
+            mutable std::mutex m_Mutex;
+        };
+
+        /// @brief  Add a span to the active trace for every request an http client sends. The span ends when the response headers arrive
+        /// @param  Client The client
+        /// @param  Service The name of the service the client talks to (prefixes the name of the spans, e.g. openai POST threads/:id/runs)
+        void InstrumentClient(web::http::client::http_client& Client, const std::string& Service);
+    } // namespace Tracing
+} // namespace ORION
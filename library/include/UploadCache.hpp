@@ -0,0 +1,119 @@
+#pragma once
+
+#include "OpenAIClient.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+
+namespace ORION
+{
+    /// @brief  The settings of the upload cache
+    struct UploadCacheOptions
+    {
+        /// @brief  How long an uploaded file is reused for. 0 disables the cache
+        std::chrono::hours TTL = std::chrono::hours(24 * 7);
+
+        /// @brief  How long a reused file is trusted before the API is asked whether it still exists. 0 asks on every reuse
+        std::chrono::seconds VerifyInterval = std::chrono::hours(1);
+    };
+
+    /**
+     * @class UploadCache
+     * @brief The files already uploaded to OpenAI, by content, so a file attached again (in the same session or another) isn't uploaded again.
+     *
+     * Files are keyed by the SHA-256 of their content, their purpose and the API key they were uploaded with (files of one organization
+     * aren't visible to another; the key is stored hashed). The content is hashed on the thread pool as it is read, without a copy. An
+     * entry is used for TTL after its upload; one that hasn't been verified for VerifyInterval is first looked up (GET files/{id}), and a
+     * file that was deleted (or whose size changed) is uploaded again. Lookups are counted by result (orion_upload_cache_lookups_total).
+     *
+     * The cache is a SQLite database next to the users database, shared by the whole process. It is small and written once per upload,
+     * so one connection serves every lookup.
+     */
+    class UploadCache final
+    {
+    public:
+        /// @brief  Get the cache of the process
+        static UploadCache& Get();
+
+        UploadCache(const UploadCache&)            = delete;
+        UploadCache& operator=(const UploadCache&) = delete;
+
+        ~UploadCache();
+
+        /// @brief  Open the database (create it if needed, migrate the schema) and drop the expired entries. Until it is open, every file is
+        ///         uploaded
+        /// @return Whether the cache is usable (true if disabled)
+        bool Open(const std::filesystem::path& DatabasePath, const UploadCacheOptions& Options);
+
+        /// @brief  Get the id of a file with the same content uploaded before, or upload it
+        /// @param  APIKey The API key the file is uploaded with
+        /// @return The id of the file. Fails like OpenAI::Client::UploadFile
+        pplx::task<std::string> UploadFile(const std::string& APIKey, const std::string& FileName, const std::string& MimeType, OpenAI::FilePayload Payload,
+                                           const std::string& Purpose = "assistants");
+
+        /// @brief  The key of a file: the SHA-256 (lowercase hex) of its content and API key, and its purpose
+        struct Key
+        {
+            std::string ContentHash;
+            std::string KeyHash;
+            std::string Purpose;
+        };
+
+        /// @brief  Get the key of a file. Reads the whole content
+        /// @throw  std::runtime_error If the content can't be read
+        static Key GetKey(const std::string& APIKey, const OpenAI::FilePayload& Payload, const std::string& Purpose);
+
+    private:
+        UploadCache();
+
+        /// @brief  A file uploaded before
+        struct Entry
+        {
+            /// @brief  The id of the file
+            std::string FileID;
+
+            /// @brief  The size of the file in bytes
+            size_t Size = 0;
+
+            /// @brief  When the API last confirmed the file exists (seconds since the epoch)
+            int64_t VerifiedAt = 0;
+        };
+
+        /// @brief  The database connection with its prepared statements
+        struct Connection;
+
+        /// @brief  Whether files are looked up (the cache is enabled and open)
+        bool IsEnabled();
+
+        /// @brief  Find the entry of a file that hasn't expired
+        std::optional<Entry> Find(const Key& FileKey);
+
+        /// @brief  Add (or replace) the entry of a file just uploaded
+        void Store(const Key& FileKey, const Entry& FileEntry);
+
+        /// @brief  Record that the API confirmed a file exists
+        void Touch(const Key& FileKey, const int64_t VERIFIED_AT);
+
+        /// @brief  Remove the entry of a file that no longer exists
+        void Remove(const Key& FileKey);
+
+        /// @brief  Upload a file and add its entry
+        pplx::task<std::string> UploadAndStore(const std::string& APIKey, const std::string& FileName, const std::string& MimeType, OpenAI::FilePayload Payload,
+                                               const Key& FileKey);
+
+        /// @brief  The settings
+        UploadCacheOptions m_Options;
+
+        /// @brief  The connection, once open
+        std::unique_ptr<Connection> m_pConnection;
+
+        /// @brief  The mutex for the connection
+        std::mutex m_Mutex;
+    };
+} // namespace ORION
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cpprest/http_client.h>
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace ORION
+{
+    /**
+     * @brief The connection to the OpenAI API: its base URL, and a transport that records the responses of a session to a cassette file
+     *        or replays them without the network.
+     *
+     * A cassette keeps every response with its timing (the time to the headers, and when each chunk of the body arrived), so a replayed
+     * event stream reaches ProcessOpenAIEventStreamAsync in the same chunks and at the same pace as it was recorded, or faster. Requests are
+     * matched to recorded responses by method and path (ids included) in the order they were recorded; once a request has used up its
+     * responses they are replayed from the first again, so a short recording can drive a long benchmark.
+     *
+     * While recording or replaying, the OpenAI client talks to a server on the loopback interface, which passes the requests on to the API
+     * and records the responses, or answers with the recorded ones. The client receives real responses either way.
+     *
+     * The cassette is a JSON-lines file, one exchange per line: {"method","path","status","reason","headers","latency_ms","chunks":
+     * [{"at_ms","data" (base64)}]}, where at_ms is counted from the arrival of the headers.
+     *
+     * Clients are shared by the whole process, one per base URL, so requests reuse the kept-alive (and TLS-established) connections of
+     * the client's pool instead of connecting anew. The requests in flight to a host are capped; a request holds its connection until its
+     * body has arrived, and requests over the cap wait for one to finish. Event streams (runs) count only until their headers arrive, so
+     * the cap doesn't limit the runs in flight (which admission control does).
+     */
+    namespace Upstream
+    {
+        /// @brief  What the clients of the OpenAI API do with requests
+        enum class ETransportMode
+        {
+            /// @brief  Send them to the API
+            Live,
+
+            /// @brief  Send them to the API and record the responses
+            Record,
+
+            /// @brief  Answer them with recorded responses
+            Replay,
+        };
+
+        /// @brief  The settings of the connection to the OpenAI API
+        struct UpstreamOptions
+        {
+            /// @brief  The base URL of the API. Empty for OPENAI_BASE_URL, or https://api.openai.com/v1/ if that isn't set either
+            std::string BaseURL;
+
+            /// @brief  What the clients do with requests
+            ETransportMode Mode = ETransportMode::Live;
+
+            /// @brief  The cassette responses are recorded to (appended) or replayed from
+            std::string CassetteFile;
+
+            /// @brief  The speed of a replay relative to the recording (4 replays four times as fast). 0 replays without any delay
+            double ReplaySpeed = 1.0;
+
+            /// @brief  The most requests in flight to any one host (OpenAI or the APIs of plugins), not counting event streams once their
+            ///         headers have arrived. 0 for no limit
+            size_t MaxConnectionsPerHost = 64;
+        };
+
+        /// @brief  Get the name of a transport mode (live, record, replay)
+        std::string_view GetModeName(const ETransportMode MODE);
+
+        /// @brief  Apply the settings. Clients created afterwards use them
+        /// @param  OutError The error, if the cassette can't be opened or read (the transport then stays live)
+        /// @return Whether the settings could be applied
+        bool Configure(const UpstreamOptions& Options, std::string& OutError);
+
+        /// @brief  Get the base URL in effect. Always ends with a slash
+        std::string GetBaseURL();
+
+        /// @brief  Get the shared client of the OpenAI API, with the configured base URL and transport. Its requests are measured (Metrics)
+        ///         and traced (Tracing) as the openai service
+        std::shared_ptr<web::http::client::http_client> GetOpenAIClient();
+
+        /// @brief  Get the shared client of another API (always live), created on first use
+        /// @param  BaseURL The base URL of the API. Clients are shared per base URL, so use a fixed one (not the URL of each request)
+        /// @param  Service The name the client's requests are measured and traced as (e.g. openweathermap)
+        std::shared_ptr<web::http::client::http_client> GetClient(const std::string& BaseURL, const std::string& Service);
+    } // namespace Upstream
+} // namespace ORION
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "User.hpp"
+
+#include <condition_variable>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace ORION
+{
+    /**
+     * @class UserStore
+     * @brief The persistent store of registered users (the users SQLite database).
+     *
+     * The database is opened once, migrated once and kept open. It runs in WAL mode so logins (readers) never wait for a registration
+     * (writer), and every connection keeps its statements prepared. Connections are pooled: a request borrows one for the duration of a
+     * query, so concurrent requests don't share a connection and writers wait on the busy timeout instead of failing with SQLITE_BUSY.
+     */
+    class UserStore final
+    {
+    public:
+        /// @brief  The result of looking up a user by name and password
+        enum class ELoginResult
+        {
+            /// @brief  The credentials are valid
+            Success,
+
+            /// @brief  There is no user with the name (or id)
+            UnknownUser,
+
+            /// @brief  The user exists but the password doesn't match
+            InvalidPassword,
+
+            /// @brief  The database could not be queried
+            Error,
+        };
+
+        /// @brief  The result of adding a user
+        enum class EAddResult
+        {
+            /// @brief  The user was added
+            Added,
+
+            /// @brief  The username is already taken
+            UsernameTaken,
+
+            /// @brief  The database could not be written
+            Error,
+        };
+
+        /// @brief  Constructor. The database is opened by Open
+        /// @param  DatabasePath The path of the database file
+        /// @param  CONNECTION_COUNT The number of pooled connections
+        explicit UserStore(std::filesystem::path DatabasePath, const size_t CONNECTION_COUNT = 4);
+
+        ~UserStore();
+
+        /// @brief  Open the database: create it if needed, migrate the schema and open the connection pool
+        /// @return Whether the database is usable
+        bool Open();
+
+        /// @brief  Log a user in
+        /// @param  UsernameLower The lowercase username (ignored if a user id is given)
+        /// @param  Password The password
+        /// @param  UserID The id of the user (a returning session), or empty to log in by name and password
+        /// @param  OutUser The user, if the login succeeded
+        ELoginResult Login(const std::string& UsernameLower, const std::string& Password, const std::string& UserID, User& OutUser);
+
+        /// @brief  Check whether a username is taken
+        bool IsUsernameTaken(const std::string& UsernameLower);
+
+        /// @brief  Add a user
+        /// @param  NewUser The ids of the user
+        /// @param  UsernameLower The lowercase username
+        /// @param  Password The password
+        EAddResult AddUser(const User& NewUser, const std::string& UsernameLower, const std::string& Password);
+
+    private:
+        /// @brief  A database connection with its prepared statements
+        struct Connection;
+
+        /// @brief  A connection borrowed from the pool, returned on destruction
+        class ConnectionLease;
+
+        /// @brief  Borrow a connection, waiting for one to be returned if all are in use
+        ConnectionLease AcquireConnection();
+
+        /// @brief  The path of the database file
+        std::filesystem::path m_DatabasePath;
+
+        /// @brief  The number of pooled connections
+        size_t m_ConnectionCount;
+
+        /// @brief  The pooled connections
+        std::vector<std::unique_ptr<Connection>> m_Connections;
+
+        /// @brief  The connections not borrowed
+        std::vector<Connection*> m_IdleConnections;
+
+        /// @brief  The mutex for the idle connections
+        std::mutex m_PoolMutex;
+
+        /// @brief  Signaled when a connection is returned
+        std::condition_variable m_PoolConditionVariable;
+    };
+} // namespace ORION
@@ -0,0 +1,141 @@
+#include "AdmissionController.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace ORION;
+
+AdmissionController::AdmissionController(const AdmissionControlOptions& InOptions)
+    : m_Options(InOptions)
+{
+}
+
+AdmissionController::Admission AdmissionController::TryAdmit(const std::string& UserID)
+{
+    const auto NOW = std::chrono::steady_clock::now();
+
+    Admission Result;
+    {
+        std::lock_guard<std::mutex> LockGuard(m_Mutex);
+
+        // New users start with a full bucket
+        auto [BucketIter, IS_NEW_BUCKET] = m_Buckets.try_emplace(UserID, Bucket {m_Options.BurstSize, NOW});
+        auto& UserBucket                 = BucketIter->second;
+        if (!IS_NEW_BUCKET)
+        {
+            Refill(UserBucket, NOW);
+        }
+
+        if (m_IsDraining)
+        {
+            // Retry soon: the client reaches the replacement server once this one has stopped
+            Result.Decision   = EDecision::Draining;
+            Result.RetryAfter = std::chrono::seconds(1);
+        }
+        else if (UserBucket.Tokens < 1.0)
+        {
+            // Tell the client when the next token will be available
+            const double WAIT_SECONDS = m_Options.TokensPerSecond > 0.0 ? (1.0 - UserBucket.Tokens) / m_Options.TokensPerSecond : 60.0;
+            Result.Decision           = EDecision::RateLimited;
+            Result.RetryAfter         = std::chrono::seconds(static_cast<int64_t>(std::ceil(WAIT_SECONDS)));
+        }
+        else if (m_Options.MaxInFlightRuns > 0 && m_InFlightRuns >= m_Options.MaxInFlightRuns)
+        {
+            // The user's token is not spent; the rejection isn't their fault
+            Result.Decision   = EDecision::Overloaded;
+            Result.RetryAfter = std::chrono::seconds(1);
+        }
+        else
+        {
+            UserBucket.Tokens -= 1.0;
+            ++m_InFlightRuns;
+            Result.Decision = EDecision::Admitted;
+        }
+
+        if (m_Buckets.size() > m_PruneThreshold)
+        {
+            PruneIdleBuckets(NOW);
+        }
+    }
+
+    switch (Result.Decision)
+    {
+        case EDecision::Admitted:
+            ++m_AdmittedCount;
+            Result.pTicket = std::make_shared<RunTicket>(*this);
+            break;
+        case EDecision::RateLimited:
+            ++m_RateLimitedCount;
+            break;
+        case EDecision::Overloaded:
+            ++m_OverloadedCount;
+            break;
+        case EDecision::Draining:
+            ++m_DrainingCount;
+            break;
+    }
+
+    return Result;
+}
+
+AdmissionController::Stats AdmissionController::GetStats() const
+{
+    Stats Result;
+    Result.Admitted    = m_AdmittedCount;
+    Result.RateLimited = m_RateLimitedCount;
+    Result.Overloaded  = m_OverloadedCount;
+    Result.Draining    = m_DrainingCount;
+
+    std::lock_guard<std::mutex> LockGuard(m_Mutex);
+    Result.InFlight = m_InFlightRuns;
+
+    return Result;
+}
+
+void AdmissionController::BeginDrain()
+{
+    std::lock_guard<std::mutex> LockGuard(m_Mutex);
+    m_IsDraining = true;
+}
+
+bool AdmissionController::IsDraining() const
+{
+    return m_IsDraining;
+}
+
+bool AdmissionController::WaitForInFlightRuns(const std::chrono::steady_clock::duration& TIMEOUT)
+{
+    std::unique_lock<std::mutex> Lock(m_Mutex);
+    return m_IdleConditionVariable.wait_for(Lock, TIMEOUT, [this] { return m_InFlightRuns == 0; });
+}
+
+void AdmissionController::ReleaseRun()
+{
+    {
+        std::lock_guard<std::mutex> LockGuard(m_Mutex);
+        if (--m_InFlightRuns > 0)
+        {
+            return;
+        }
+    }
+    m_IdleConditionVariable.notify_all();
+}
+
+void AdmissionController::Refill(Bucket& InBucket, const std::chrono::steady_clock::time_point& Now) const
+{
+    const double ELAPSED_SECONDS = std::chrono::duration<double>(Now - InBucket.LastRefill).count();
+    InBucket.Tokens              = std::min(m_Options.BurstSize, InBucket.Tokens + ELAPSED_SECONDS * m_Options.TokensPerSecond);
+    InBucket.LastRefill          = Now;
+}
+
+void AdmissionController::PruneIdleBuckets(const std::chrono::steady_clock::time_point& Now)
+{
+    for (auto BucketIter = m_Buckets.begin(); BucketIter != m_Buckets.end();)
+    {
+        Refill(BucketIter->second, Now);
+        BucketIter = BucketIter->second.Tokens >= m_Options.BurstSize ? m_Buckets.erase(BucketIter) : std::next(BucketIter);
+    }
+
+    // Don't prune again until the map has grown substantially
+    m_PruneThreshold = std::max<size_t>(1024, m_Buckets.size() * 2);
+}
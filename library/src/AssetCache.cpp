@@ -0,0 +1,327 @@
+#include "AssetCache.hpp"
+#include "Compression.hpp"
+#include "Logger.hpp"
+#include "MimeTypes.hpp"
+
+#ifdef ORION_EMBEDDED_ASSETS
+#include "EmbeddedAssets.hpp"
+#endif
+
+#include <openssl/evp.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+using namespace ORION;
+
+namespace
+{
+    /// @brief  Check whether a path is inside a directory (both relative, or both absolute)
+    bool IsInDirectory(const std::filesystem::path& Path, const std::filesystem::path& Directory)
+    {
+        auto PathIter = Path.begin();
+        for (const auto& Component : Directory)
+        {
+            if (PathIter == Path.end() || *PathIter != Component)
+            {
+                return false;
+            }
+            ++PathIter;
+        }
+        return true;
+    }
+
+    /// @brief  Hash content into a hex tag (the first 128 bits of its SHA-256)
+    std::string HashContent(const std::string_view& Content)
+    {
+        unsigned char Digest[EVP_MAX_MD_SIZE];
+        unsigned int  DigestSize = 0;
+        EVP_Digest(Content.data(), Content.size(), Digest, &DigestSize, EVP_sha256(), nullptr);
+
+        std::ostringstream TagStream;
+        for (unsigned int Index = 0; Index < std::min(DigestSize, 16u); ++Index)
+        {
+            TagStream << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(Digest[Index]);
+        }
+        return TagStream.str();
+    }
+} // namespace
+
+AssetCache::AssetCache(const std::filesystem::path&    RootDirectory,
+                       const std::vector<std::string>& ExcludedDirectories,
+                       const uintmax_t                 MAX_CACHED_FILE_SIZE,
+                       const std::chrono::milliseconds REVALIDATE_INTERVAL)
+    : m_RootDirectory(std::filesystem::weakly_canonical(RootDirectory)),
+      m_ExcludedDirectories(ExcludedDirectories.begin(), ExcludedDirectories.end()),
+      m_MaxCachedFileSize(MAX_CACHED_FILE_SIZE),
+      m_RevalidateInterval(REVALIDATE_INTERVAL)
+{
+#ifdef ORION_EMBEDDED_ASSETS
+    // The entries only point into the bundle, so this costs a few hundred bytes per asset
+    m_EmbeddedEntries.reserve(EmbeddedAssets::GetAssetCount());
+    for (size_t Index = 0; Index < EmbeddedAssets::GetAssetCount(); ++Index)
+    {
+        const auto& ASSET     = EmbeddedAssets::GetAssets()[Index];
+        auto        pEntry    = std::make_shared<Entry>();
+        pEntry->ContentType   = ASSET.ContentType;
+        pEntry->Tag           = ASSET.Tag;
+        pEntry->IsInMemory    = true;
+        pEntry->Content       = ASSET.Content;
+        pEntry->GzipContent   = ASSET.GzipContent;
+        pEntry->BrotliContent = ASSET.BrotliContent;
+        pEntry->FileSize      = ASSET.Content.size();
+        m_EmbeddedEntries.push_back(std::move(pEntry));
+    }
+#endif
+}
+
+void AssetCache::Preload(const std::vector<std::string>& SkippedDirectories)
+{
+    std::error_code ErrorCode;
+    size_t          LoadedCount = 0;
+    uintmax_t       LoadedBytes = 0;
+
+    for (auto Iter = std::filesystem::recursive_directory_iterator(m_RootDirectory, ErrorCode); !ErrorCode && Iter != std::filesystem::recursive_directory_iterator();
+         Iter.increment(ErrorCode))
+    {
+        if (!Iter->is_regular_file())
+        {
+            continue;
+        }
+
+        const auto RELATIVE_PATH = Iter->path().lexically_relative(m_RootDirectory);
+        if (NormalizePath(RELATIVE_PATH.string()).empty() || FindEmbeddedEntry(RELATIVE_PATH.generic_string()) ||
+            std::any_of(SkippedDirectories.begin(), SkippedDirectories.end(), [&RELATIVE_PATH](const std::string& Directory) { return IsInDirectory(RELATIVE_PATH, Directory); }))
+        {
+            continue;
+        }
+
+        if (auto pEntry = LoadEntry(Iter->path()))
+        {
+            LoadedBytes += pEntry->ContentStorage.size() + pEntry->GzipContentStorage.size() + pEntry->BrotliContentStorage.size();
+            ++LoadedCount;
+
+            std::lock_guard<std::mutex> LockGuard(m_Mutex);
+            m_Slots[RELATIVE_PATH.generic_string()] = Slot {std::move(pEntry), std::chrono::steady_clock::now()};
+        }
+    }
+
+    Log::Info("assets", "Preloaded the assets",
+              {{"count", std::to_string(LoadedCount)},
+               {"kib", std::to_string(LoadedBytes / 1024)},
+               {"directory", m_RootDirectory.string()},
+               {"embedded", std::to_string(m_EmbeddedEntries.size())}});
+}
+
+std::shared_ptr<const AssetCache::Entry> AssetCache::Find(const std::string& RelativePath)
+{
+    const auto NORMALIZED_PATH = NormalizePath(RelativePath);
+    if (NORMALIZED_PATH.empty())
+    {
+        return nullptr;
+    }
+
+    const auto KEY = NORMALIZED_PATH.generic_string();
+
+    // Embedded assets never change
+    if (auto pEmbeddedEntry = FindEmbeddedEntry(KEY))
+    {
+        return pEmbeddedEntry;
+    }
+
+    const auto NOW = std::chrono::steady_clock::now();
+
+    std::shared_ptr<const Entry> pCachedEntry;
+    {
+        std::lock_guard<std::mutex> LockGuard(m_Mutex);
+        if (const auto SLOT_ITER = m_Slots.find(KEY); SLOT_ITER != m_Slots.end())
+        {
+            if (NOW - SLOT_ITER->second.LastValidated < m_RevalidateInterval)
+            {
+                return SLOT_ITER->second.pEntry;
+            }
+            pCachedEntry = SLOT_ITER->second.pEntry;
+        }
+    }
+
+    // Check the file on disk (outside the lock)
+    const auto      FILE_PATH = m_RootDirectory / NORMALIZED_PATH;
+    std::error_code ErrorCode;
+    const auto      LAST_WRITE_TIME = std::filesystem::last_write_time(FILE_PATH, ErrorCode);
+    const auto      FILE_SIZE       = ErrorCode ? 0 : std::filesystem::file_size(FILE_PATH, ErrorCode);
+
+    if (ErrorCode)
+    {
+        // The file is gone (or never existed)
+        std::lock_guard<std::mutex> LockGuard(m_Mutex);
+        m_Slots.erase(KEY);
+        return nullptr;
+    }
+
+    if (pCachedEntry && pCachedEntry->LastWriteTime == LAST_WRITE_TIME && pCachedEntry->FileSize == FILE_SIZE)
+    {
+        // Unchanged, trust it for another interval
+        std::lock_guard<std::mutex> LockGuard(m_Mutex);
+        m_Slots[KEY].LastValidated = NOW;
+        return pCachedEntry;
+    }
+
+    auto pEntry = LoadEntry(FILE_PATH);
+    if (!pEntry)
+    {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> LockGuard(m_Mutex);
+    m_Slots[KEY] = Slot {pEntry, NOW};
+    return pEntry;
+}
+
+std::string AssetCache::GetETag(const Entry& InEntry, const std::string_view& ContentEncoding)
+{
+    std::string ETag = InEntry.IsInMemory ? "\"" : "W/\"";
+    ETag.append(InEntry.Tag);
+    if (!ContentEncoding.empty())
+    {
+        ETag.append("-").append(ContentEncoding);
+    }
+    ETag.append("\"");
+    return ETag;
+}
+
+bool AssetCache::IsNotModified(const Entry& InEntry, const std::string& IfNoneMatch)
+{
+    // If-None-Match: "tag1", W/"tag2"
+    size_t Start = 0;
+    while (Start < IfNoneMatch.size())
+    {
+        const auto  END  = std::min(IfNoneMatch.find(',', Start), IfNoneMatch.size());
+        std::string Item = IfNoneMatch.substr(Start, END - Start);
+        Start            = END + 1;
+
+        Item.erase(0, Item.find_first_not_of(" \t"));
+        Item.erase(Item.find_last_not_of(" \t") + 1);
+
+        if (Item == "*")
+        {
+            return true;
+        }
+
+        // Weak comparison: ignore the weakness indicator
+        if (Item.rfind("W/", 0) == 0)
+        {
+            Item.erase(0, 2);
+        }
+
+        if (Item.size() < 2 || Item.front() != '"' || Item.back() != '"')
+        {
+            continue;
+        }
+
+        // Any representation of the current content matches
+        const std::string_view OPAQUE_TAG(Item.data() + 1, Item.size() - 2);
+        if (OPAQUE_TAG.substr(0, InEntry.Tag.size()) == InEntry.Tag &&
+            (OPAQUE_TAG.size() == InEntry.Tag.size() || OPAQUE_TAG.substr(InEntry.Tag.size()) == "-gzip" || OPAQUE_TAG.substr(InEntry.Tag.size()) == "-br"))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+std::shared_ptr<const AssetCache::Entry> AssetCache::FindEmbeddedEntry(const std::string& Key) const
+{
+#ifdef ORION_EMBEDDED_ASSETS
+    if (const auto pAsset = EmbeddedAssets::Find(Key))
+    {
+        return m_EmbeddedEntries[static_cast<size_t>(pAsset - EmbeddedAssets::GetAssets())];
+    }
+#else
+    (void)Key;
+#endif
+    return nullptr;
+}
+
+std::filesystem::path AssetCache::NormalizePath(const std::string& RelativePath) const
+{
+    // Remove the leading slashes and resolve . and .. lexically
+    const auto NORMALIZED_PATH = std::filesystem::path(RelativePath.substr(std::min(RelativePath.find_first_not_of('/'), RelativePath.size()))).lexically_normal();
+
+    if (NORMALIZED_PATH.empty() || NORMALIZED_PATH.is_absolute() || *NORMALIZED_PATH.begin() == ".." || !NORMALIZED_PATH.has_filename())
+    {
+        return {};
+    }
+
+    for (const auto& ExcludedDirectory : m_ExcludedDirectories)
+    {
+        if (IsInDirectory(NORMALIZED_PATH, ExcludedDirectory))
+        {
+            return {};
+        }
+    }
+
+    return NORMALIZED_PATH;
+}
+
+std::shared_ptr<const AssetCache::Entry> AssetCache::LoadEntry(const std::filesystem::path& FilePath) const
+{
+    std::error_code ErrorCode;
+
+    // Make sure symlinks don't lead outside the root directory
+    const auto CANONICAL_PATH = std::filesystem::canonical(FilePath, ErrorCode);
+    if (ErrorCode || !IsInDirectory(CANONICAL_PATH, m_RootDirectory) || !std::filesystem::is_regular_file(CANONICAL_PATH, ErrorCode))
+    {
+        return nullptr;
+    }
+
+    auto pEntry           = std::make_shared<Entry>();
+    pEntry->FilePath      = CANONICAL_PATH;
+    pEntry->ContentType   = MimeTypes::GetMimeType(CANONICAL_PATH.filename().string());
+    pEntry->LastWriteTime = std::filesystem::last_write_time(CANONICAL_PATH, ErrorCode);
+    pEntry->FileSize      = std::filesystem::file_size(CANONICAL_PATH, ErrorCode);
+    if (ErrorCode)
+    {
+        return nullptr;
+    }
+
+    if (pEntry->FileSize > m_MaxCachedFileSize)
+    {
+        // Too large to keep in memory; it is mapped when requested and tagged by size and modification time
+        pEntry->Tag = std::to_string(pEntry->FileSize) + "-" + std::to_string(pEntry->LastWriteTime.time_since_epoch().count());
+        return pEntry;
+    }
+
+    std::ifstream File(CANONICAL_PATH, std::ios::binary);
+    if (!File.is_open())
+    {
+        return nullptr;
+    }
+
+    pEntry->ContentStorage.assign(std::istreambuf_iterator<char>(File), std::istreambuf_iterator<char>());
+    pEntry->IsInMemory = true;
+    pEntry->Tag        = HashContent(pEntry->ContentStorage);
+
+    // Precompress at the highest levels; this only happens when the file is loaded. Keep the variants only when they are smaller
+    if (Compression::IsCompressible(pEntry->ContentType))
+    {
+        if (auto Gzipped = Compression::Gzip(pEntry->ContentStorage, 9); Gzipped && Gzipped->size() < pEntry->ContentStorage.size())
+        {
+            pEntry->GzipContentStorage = std::move(*Gzipped);
+        }
+
+        if (auto Brotlied = Compression::Brotli(pEntry->ContentStorage, 11); Brotlied && Brotlied->size() < pEntry->ContentStorage.size())
+        {
+            pEntry->BrotliContentStorage = std::move(*Brotlied);
+        }
+    }
+
+    // The storage is final, point the views at it
+    pEntry->Content       = pEntry->ContentStorage;
+    pEntry->GzipContent   = pEntry->GzipContentStorage;
+    pEntry->BrotliContent = pEntry->BrotliContentStorage;
+
+    return pEntry;
+}
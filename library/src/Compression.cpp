@@ -0,0 +1,317 @@
+#include "Compression.hpp"
+
+#include <zlib.h>
+
+#ifdef ORION_WITH_BROTLI
+#include <brotli/encode.h>
+#endif
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+
+using namespace ORION;
+
+namespace
+{
+    /// @brief  The window bits selecting the zlib wrapper (deflate) and the gzip wrapper
+    constexpr int ZLIB_WINDOW_BITS = 15;
+    constexpr int GZIP_WINDOW_BITS = 15 + 16;
+
+    /// @brief  The brotli window of streams (256 KiB). Streams live as long as their connection, so their memory is kept small
+    constexpr int BROTLI_STREAM_WINDOW_BITS = 18;
+
+    /// @brief  Compress data with zlib in one go
+    std::optional<std::string> DeflateWithWindowBits(const std::string_view& Data, const int LEVEL, const int WINDOW_BITS)
+    {
+        z_stream Stream {};
+        if (deflateInit2(&Stream, LEVEL, Z_DEFLATED, WINDOW_BITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        {
+            return std::nullopt;
+        }
+
+        std::string Compressed(deflateBound(&Stream, static_cast<uLong>(Data.size())), '\0');
+
+        Stream.next_in   = reinterpret_cast<Bytef*>(const_cast<char*>(Data.data()));
+        Stream.avail_in  = static_cast<uInt>(Data.size());
+        Stream.next_out  = reinterpret_cast<Bytef*>(Compressed.data());
+        Stream.avail_out = static_cast<uInt>(Compressed.size());
+
+        const int RESULT = deflate(&Stream, Z_FINISH);
+        Compressed.resize(Stream.total_out);
+        deflateEnd(&Stream);
+
+        if (RESULT != Z_STREAM_END)
+        {
+            return std::nullopt;
+        }
+
+        return Compressed;
+    }
+} // namespace
+
+std::string_view Compression::GetContentEncodingToken(const EContentCoding CODING)
+{
+    switch (CODING)
+    {
+        case EContentCoding::Deflate:
+            return "deflate";
+        case EContentCoding::Gzip:
+            return "gzip";
+        case EContentCoding::Brotli:
+            return "br";
+        default:
+            return "";
+    }
+}
+
+bool Compression::IsAccepted(const std::string& AcceptEncoding, const EContentCoding CODING)
+{
+    if (CODING == EContentCoding::Identity)
+    {
+        return true;
+    }
+
+    const auto TOKEN = GetContentEncodingToken(CODING);
+
+    // Accept-Encoding: gzip, deflate;q=0.5, br;q=0
+    size_t Start = 0;
+    while (Start < AcceptEncoding.size())
+    {
+        const auto END  = std::min(AcceptEncoding.find(',', Start), AcceptEncoding.size());
+        std::string Item = AcceptEncoding.substr(Start, END - Start);
+        Start            = END + 1;
+
+        // Split the coding from its parameters and trim it
+        const auto  PARAMETERS_POS = Item.find(';');
+        std::string Coding         = Item.substr(0, PARAMETERS_POS);
+        Coding.erase(0, Coding.find_first_not_of(" \t"));
+        Coding.erase(Coding.find_last_not_of(" \t") + 1);
+        std::transform(Coding.begin(), Coding.end(), Coding.begin(), [](const unsigned char C) { return std::tolower(C); });
+
+        if (Coding != TOKEN && Coding != "*")
+        {
+            continue;
+        }
+
+        // A q value of 0 means "not acceptable"
+        if (PARAMETERS_POS != std::string::npos)
+        {
+            if (const auto Q_POS = Item.find("q=", PARAMETERS_POS); Q_POS != std::string::npos && std::strtod(Item.c_str() + Q_POS + 2, nullptr) <= 0.0)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+Compression::EContentCoding Compression::Negotiate(const std::string& AcceptEncoding, const bool ALLOW_BROTLI)
+{
+    if (ALLOW_BROTLI && IsBrotliAvailable() && IsAccepted(AcceptEncoding, EContentCoding::Brotli))
+    {
+        return EContentCoding::Brotli;
+    }
+    if (IsAccepted(AcceptEncoding, EContentCoding::Gzip))
+    {
+        return EContentCoding::Gzip;
+    }
+    if (IsAccepted(AcceptEncoding, EContentCoding::Deflate))
+    {
+        return EContentCoding::Deflate;
+    }
+    return EContentCoding::Identity;
+}
+
+bool Compression::IsCompressible(const std::string& ContentType)
+{
+    return ContentType.find("text/") == 0 || ContentType.find("javascript") != std::string::npos || ContentType.find("json") != std::string::npos ||
+           ContentType.find("xml") != std::string::npos || ContentType.find("svg") != std::string::npos;
+}
+
+bool Compression::IsBrotliAvailable()
+{
+#ifdef ORION_WITH_BROTLI
+    return true;
+#else
+    return false;
+#endif
+}
+
+std::optional<std::string> Compression::Gzip(const std::string_view& Data, const int LEVEL)
+{
+    return DeflateWithWindowBits(Data, LEVEL, GZIP_WINDOW_BITS);
+}
+
+std::optional<std::string> Compression::Brotli(const std::string_view& Data, const int QUALITY)
+{
+#ifdef ORION_WITH_BROTLI
+    size_t      CompressedSize = BrotliEncoderMaxCompressedSize(Data.size());
+    std::string Compressed(CompressedSize, '\0');
+
+    if (!BrotliEncoderCompress(QUALITY,
+                               BROTLI_DEFAULT_WINDOW,
+                               BROTLI_MODE_GENERIC,
+                               Data.size(),
+                               reinterpret_cast<const uint8_t*>(Data.data()),
+                               &CompressedSize,
+                               reinterpret_cast<uint8_t*>(Compressed.data())))
+    {
+        return std::nullopt;
+    }
+
+    Compressed.resize(CompressedSize);
+    return Compressed;
+#else
+    (void)Data;
+    (void)QUALITY;
+    return std::nullopt;
+#endif
+}
+
+std::optional<std::string> Compression::Deflate(const std::string_view& Data, const int LEVEL)
+{
+    return DeflateWithWindowBits(Data, LEVEL, ZLIB_WINDOW_BITS);
+}
+
+std::optional<std::string> Compression::Compress(const std::string_view& Data, const EContentCoding CODING, const int LEVEL)
+{
+    switch (CODING)
+    {
+        case EContentCoding::Deflate:
+            return Deflate(Data, LEVEL);
+        case EContentCoding::Gzip:
+            return Gzip(Data, LEVEL);
+        case EContentCoding::Brotli:
+            return Brotli(Data, LEVEL);
+        default:
+            return std::string(Data);
+    }
+}
+
+struct Compression::StreamCompressor::Context
+{
+    ~Context()
+    {
+        if (IsZlibInitialized)
+        {
+            deflateEnd(&ZlibStream);
+        }
+#ifdef ORION_WITH_BROTLI
+        if (pBrotliEncoder)
+        {
+            BrotliEncoderDestroyInstance(pBrotliEncoder);
+        }
+#endif
+    }
+
+    /// @brief  The zlib stream (gzip and deflate)
+    z_stream ZlibStream {};
+
+    /// @brief  Whether the zlib stream was initialized
+    bool IsZlibInitialized = false;
+
+#ifdef ORION_WITH_BROTLI
+    /// @brief  The brotli encoder
+    BrotliEncoderState* pBrotliEncoder = nullptr;
+#endif
+};
+
+Compression::StreamCompressor::StreamCompressor(const EContentCoding CODING, const int LEVEL) : m_pContext(std::make_unique<Context>())
+{
+    if (CODING == EContentCoding::Gzip || CODING == EContentCoding::Deflate)
+    {
+        m_pContext->IsZlibInitialized = deflateInit2(&m_pContext->ZlibStream,
+                                                     LEVEL,
+                                                     Z_DEFLATED,
+                                                     CODING == EContentCoding::Gzip ? GZIP_WINDOW_BITS : ZLIB_WINDOW_BITS,
+                                                     8,
+                                                     Z_DEFAULT_STRATEGY) == Z_OK;
+        if (!m_pContext->IsZlibInitialized)
+        {
+            m_pContext.reset();
+        }
+        return;
+    }
+
+#ifdef ORION_WITH_BROTLI
+    if (CODING == EContentCoding::Brotli)
+    {
+        m_pContext->pBrotliEncoder = BrotliEncoderCreateInstance(nullptr, nullptr, nullptr);
+        if (!m_pContext->pBrotliEncoder)
+        {
+            m_pContext.reset();
+            return;
+        }
+
+        BrotliEncoderSetParameter(m_pContext->pBrotliEncoder, BROTLI_PARAM_QUALITY, static_cast<uint32_t>(LEVEL));
+        BrotliEncoderSetParameter(m_pContext->pBrotliEncoder, BROTLI_PARAM_LGWIN, BROTLI_STREAM_WINDOW_BITS);
+        return;
+    }
+#endif
+
+    // Identity, or brotli without brotli support
+    m_pContext.reset();
+}
+
+Compression::StreamCompressor::~StreamCompressor() = default;
+
+bool Compression::StreamCompressor::IsValid() const
+{
+    return m_pContext != nullptr;
+}
+
+std::optional<std::string> Compression::StreamCompressor::CompressAndFlush(const std::string_view& Data)
+{
+    if (!m_pContext)
+    {
+        return std::nullopt;
+    }
+
+    std::string Compressed;
+    char        Chunk[16 * 1024];
+
+    if (m_pContext->IsZlibInitialized)
+    {
+        auto& Stream    = m_pContext->ZlibStream;
+        Stream.next_in  = reinterpret_cast<Bytef*>(const_cast<char*>(Data.data()));
+        Stream.avail_in = static_cast<uInt>(Data.size());
+
+        // Z_SYNC_FLUSH ends the output on a byte boundary, so the client can inflate everything sent so far
+        do
+        {
+            Stream.next_out  = reinterpret_cast<Bytef*>(Chunk);
+            Stream.avail_out = sizeof(Chunk);
+            if (const int RESULT = deflate(&Stream, Z_SYNC_FLUSH); RESULT != Z_OK && RESULT != Z_BUF_ERROR)
+            {
+                m_pContext.reset();
+                return std::nullopt;
+            }
+            Compressed.append(Chunk, sizeof(Chunk) - Stream.avail_out);
+        } while (Stream.avail_out == 0);
+
+        return Compressed;
+    }
+
+#ifdef ORION_WITH_BROTLI
+    size_t         AvailableIn = Data.size();
+    const uint8_t* pNextIn     = reinterpret_cast<const uint8_t*>(Data.data());
+
+    do
+    {
+        size_t   AvailableOut = sizeof(Chunk);
+        uint8_t* pNextOut     = reinterpret_cast<uint8_t*>(Chunk);
+        if (!BrotliEncoderCompressStream(m_pContext->pBrotliEncoder, BROTLI_OPERATION_FLUSH, &AvailableIn, &pNextIn, &AvailableOut, &pNextOut, nullptr))
+        {
+            m_pContext.reset();
+            return std::nullopt;
+        }
+        Compressed.append(Chunk, sizeof(Chunk) - AvailableOut);
+    } while (AvailableIn > 0 || BrotliEncoderHasMoreOutput(m_pContext->pBrotliEncoder));
+#endif
+
+    return Compressed;
+}
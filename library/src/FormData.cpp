@@ -0,0 +1,441 @@
+#include "FormData.hpp"
+#include "GUID.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <utility>
+
+using namespace ORION;
+
+namespace
+{
+    /// @brief  The bytes read from the body at a time
+    constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+    /// @brief  The most bytes of the headers of a part
+    constexpr size_t MAX_HEADERS_SIZE = 16 * 1024;
+
+    /// @brief  A temporary file holding the content of a file part. Removed once its last payload is gone
+    struct TemporaryFile
+    {
+        explicit TemporaryFile(std::string InPath) : Path(std::move(InPath))
+        {
+        }
+
+        TemporaryFile(const TemporaryFile&)            = delete;
+        TemporaryFile& operator=(const TemporaryFile&) = delete;
+
+        ~TemporaryFile()
+        {
+            std::error_code Error;
+            std::filesystem::remove(Path, Error);
+        }
+
+        std::string Path;
+    };
+
+    /// @brief  Where the reader is in the body
+    enum class EState
+    {
+        /// @brief  Before the first boundary
+        Preamble,
+
+        /// @brief  After a boundary: either the closing -- or the end of its line follows
+        Boundary,
+
+        /// @brief  In the headers of a part
+        Headers,
+
+        /// @brief  In the content of a part
+        Content,
+
+        /// @brief  After the closing boundary
+        Epilogue,
+    };
+
+    /// @brief  A body being read
+    struct Reader
+    {
+        /// @brief  The body
+        concurrency::streams::streambuf<uint8_t> Body;
+
+        /// @brief  The delimiter of the parts: CRLF, then -- and the boundary
+        std::string Delimiter;
+
+        /// @brief  The limits
+        FormData::ReadOptions Options;
+
+        /// @brief  The chunk being read
+        std::vector<uint8_t> Chunk = std::vector<uint8_t>(CHUNK_SIZE);
+
+        /// @brief  The bytes read but not parsed yet: the start of a delimiter or of headers that the next chunk completes
+        std::string Pending;
+
+        /// @brief  The bytes read so far
+        size_t Size = 0;
+
+        /// @brief  Where the reader is in the body
+        EState State = EState::Preamble;
+
+        /// @brief  The parts read so far. The last one is being read while in its headers or content
+        std::vector<FormData::Part> Parts;
+
+        /// @brief  The content of the file being read, while in memory
+        std::vector<unsigned char> FileData;
+
+        /// @brief  The temporary file of the file being read, once past the memory limit, and the stream writing it (closed first)
+        std::shared_ptr<TemporaryFile> pFile;
+        std::ofstream                  FileStream;
+
+        /// @brief  Set with the parts once the body has been read, or with the error
+        pplx::task_completion_event<std::vector<FormData::Part>> Completed;
+    };
+
+    /// @brief  Get a string in lowercase
+    std::string ToLower(std::string Text)
+    {
+        std::transform(Text.begin(), Text.end(), Text.begin(), [](const unsigned char Character) { return static_cast<char>(std::tolower(Character)); });
+        return Text;
+    }
+
+    /// @brief  Get a string without its leading and trailing whitespace
+    std::string Trim(const std::string& Text)
+    {
+        const auto FIRST = Text.find_first_not_of(" \t");
+        if (FIRST == std::string::npos)
+        {
+            return "";
+        }
+        return Text.substr(FIRST, Text.find_last_not_of(" \t") - FIRST + 1);
+    }
+
+    /// @brief  Parse a header value with parameters: type; name=value; name="quoted \"value\""
+    /// @param  OutParameters The parameters, with lowercase names
+    /// @return The type in lowercase
+    std::string ParseParameters(const std::string& Value, std::vector<std::pair<std::string, std::string>>& OutParameters)
+    {
+        size_t     Position = Value.find(';');
+        const auto TYPE     = ToLower(Trim(Value.substr(0, Position)));
+
+        while (Position < Value.size())
+        {
+            // Skip the separator
+            ++Position;
+
+            const auto NAME_END = Value.find_first_of("=;", Position);
+            auto       Name     = ToLower(Trim(Value.substr(Position, NAME_END - Position)));
+            if (NAME_END == std::string::npos || Value[NAME_END] == ';')
+            {
+                Position = NAME_END;
+                continue;
+            }
+
+            Position = Value.find_first_not_of(" \t", NAME_END + 1);
+            std::string ParameterValue;
+            if (Position != std::string::npos && Value[Position] == '"')
+            {
+                // A quoted string, where a backslash escapes the next character
+                for (++Position; Position < Value.size() && Value[Position] != '"'; ++Position)
+                {
+                    if (Value[Position] == '\\' && Position + 1 < Value.size())
+                    {
+                        ++Position;
+                    }
+                    ParameterValue += Value[Position];
+                }
+                Position = Value.find(';', Position);
+            }
+            else if (Position != std::string::npos)
+            {
+                const auto VALUE_END = Value.find(';', Position);
+                ParameterValue       = Trim(Value.substr(Position, VALUE_END - Position));
+                Position             = VALUE_END;
+            }
+
+            OutParameters.emplace_back(std::move(Name), std::move(ParameterValue));
+        }
+        return TYPE;
+    }
+
+    /// @brief  Get a parameter by name. Empty if absent
+    std::string GetParameter(const std::vector<std::pair<std::string, std::string>>& Parameters, const std::string& Name)
+    {
+        const auto PARAMETER_ITER = std::find_if(Parameters.begin(), Parameters.end(), [&Name](const auto& Parameter) { return Parameter.first == Name; });
+        return PARAMETER_ITER != Parameters.end() ? PARAMETER_ITER->second : std::string();
+    }
+
+    /// @brief  Start a part from its headers
+    /// @throw  FormData::ParseError If the part has no Content-Disposition with a name
+    void BeginPart(Reader& InReader, const std::string& Headers)
+    {
+        FormData::Part NewPart;
+        for (size_t LineStart = 0; LineStart < Headers.size();)
+        {
+            auto LineEnd = Headers.find("\r\n", LineStart);
+            if (LineEnd == std::string::npos)
+            {
+                LineEnd = Headers.size();
+            }
+
+            const auto LINE      = Headers.substr(LineStart, LineEnd - LineStart);
+            const auto SEPARATOR = LINE.find(':');
+            LineStart            = LineEnd + 2;
+            if (SEPARATOR == std::string::npos)
+            {
+                continue;
+            }
+
+            const auto NAME  = ToLower(Trim(LINE.substr(0, SEPARATOR)));
+            const auto VALUE = Trim(LINE.substr(SEPARATOR + 1));
+            if (NAME == "content-disposition")
+            {
+                std::vector<std::pair<std::string, std::string>> Parameters;
+                if (ParseParameters(VALUE, Parameters) == "form-data")
+                {
+                    NewPart.Name     = GetParameter(Parameters, "name");
+                    NewPart.FileName = GetParameter(Parameters, "filename");
+                }
+            }
+            else if (NAME == "content-type")
+            {
+                NewPart.ContentType = VALUE;
+            }
+        }
+
+        if (NewPart.Name.empty())
+        {
+            throw FormData::ParseError(web::http::status_codes::BadRequest, "A part has no form-data Content-Disposition with a name");
+        }
+        InReader.Parts.push_back(std::move(NewPart));
+    }
+
+    /// @brief  Add content to the part being read
+    /// @throw  FormData::ParseError If a field is over its limit
+    void AppendToPart(Reader& InReader, const char* pData, const size_t SIZE)
+    {
+        auto& CurrentPart = InReader.Parts.back();
+        if (CurrentPart.FileName.empty())
+        {
+            if (CurrentPart.Value.size() + SIZE > InReader.Options.MaxFieldSize)
+            {
+                throw FormData::ParseError(web::http::status_codes::RequestEntityTooLarge, "The field " + CurrentPart.Name + " is too large");
+            }
+            CurrentPart.Value.append(pData, SIZE);
+            return;
+        }
+
+        // Past the memory limit the file is moved to a temporary file, and written there from then on
+        if (!InReader.pFile && InReader.FileData.size() + SIZE > InReader.Options.MemoryLimit)
+        {
+            InReader.pFile = std::make_shared<TemporaryFile>((std::filesystem::temp_directory_path() / ("orion-part-" + static_cast<std::string>(GUID::Generate()))).string());
+            InReader.FileStream.open(InReader.pFile->Path, std::ios::binary | std::ios::trunc);
+            InReader.FileStream.write(reinterpret_cast<const char*>(InReader.FileData.data()), static_cast<std::streamsize>(InReader.FileData.size()));
+            InReader.FileData = {};
+        }
+
+        if (InReader.pFile)
+        {
+            if (!InReader.FileStream.write(pData, static_cast<std::streamsize>(SIZE)))
+            {
+                throw std::runtime_error("Failed to write " + InReader.pFile->Path);
+            }
+        }
+        else
+        {
+            InReader.FileData.insert(InReader.FileData.end(), pData, pData + SIZE);
+        }
+    }
+
+    /// @brief  Finish the part being read: give a file its payload
+    void EndPart(Reader& InReader)
+    {
+        auto& CurrentPart = InReader.Parts.back();
+        if (CurrentPart.FileName.empty())
+        {
+            return;
+        }
+
+        if (InReader.pFile)
+        {
+            InReader.FileStream.close();
+            if (!InReader.FileStream)
+            {
+                throw std::runtime_error("Failed to write " + InReader.pFile->Path);
+            }
+            auto Path        = InReader.pFile->Path;
+            CurrentPart.File = OpenAI::FilePayload::FromFile(std::move(Path), std::move(InReader.pFile));
+            InReader.FileStream.clear();
+        }
+        else
+        {
+            CurrentPart.File = OpenAI::FilePayload::FromMemory(std::move(InReader.FileData));
+            InReader.FileData = {};
+        }
+    }
+
+    /// @brief  Parse as much of the pending bytes as possible. A delimiter (or headers) split between chunks stays pending
+    /// @throw  FormData::ParseError If the body is malformed or over a limit
+    void Parse(Reader& InReader)
+    {
+        auto& Pending = InReader.Pending;
+        while (true)
+        {
+            switch (InReader.State)
+            {
+                case EState::Preamble:
+                case EState::Content:
+                {
+                    const auto DELIMITER = Pending.find(InReader.Delimiter);
+                    const auto CONTENT_SIZE =
+                        DELIMITER != std::string::npos ? DELIMITER : Pending.size() - std::min(Pending.size(), InReader.Delimiter.size() - 1);
+
+                    if (InReader.State == EState::Content)
+                    {
+                        AppendToPart(InReader, Pending.data(), CONTENT_SIZE);
+                    }
+                    if (DELIMITER == std::string::npos)
+                    {
+                        Pending.erase(0, CONTENT_SIZE);
+                        return;
+                    }
+
+                    if (InReader.State == EState::Content)
+                    {
+                        EndPart(InReader);
+                    }
+                    Pending.erase(0, DELIMITER + InReader.Delimiter.size());
+                    InReader.State = EState::Boundary;
+                    break;
+                }
+
+                case EState::Boundary:
+                {
+                    // -- closes the body; otherwise only whitespace may follow the boundary on its line
+                    if (Pending.compare(0, 2, "--") == 0)
+                    {
+                        Pending.clear();
+                        InReader.State = EState::Epilogue;
+                        return;
+                    }
+
+                    const auto LINE_END = Pending.find("\r\n");
+                    if (LINE_END == std::string::npos)
+                    {
+                        if (Pending.size() > MAX_HEADERS_SIZE)
+                        {
+                            throw FormData::ParseError(web::http::status_codes::BadRequest, "A boundary is followed by other text");
+                        }
+                        return;
+                    }
+                    if (Pending.find_first_not_of(" \t") < LINE_END)
+                    {
+                        throw FormData::ParseError(web::http::status_codes::BadRequest, "A boundary is followed by other text");
+                    }
+
+                    Pending.erase(0, LINE_END + 2);
+                    InReader.State = EState::Headers;
+                    break;
+                }
+
+                case EState::Headers:
+                {
+                    // A part without headers starts with the empty line
+                    const auto HEADERS_END = Pending.compare(0, 2, "\r\n") == 0 ? 0 : Pending.find("\r\n\r\n");
+                    if (HEADERS_END == std::string::npos)
+                    {
+                        if (Pending.size() > MAX_HEADERS_SIZE)
+                        {
+                            throw FormData::ParseError(web::http::status_codes::RequestEntityTooLarge, "The headers of a part are too large");
+                        }
+                        return;
+                    }
+
+                    BeginPart(InReader, Pending.substr(0, HEADERS_END));
+                    Pending.erase(0, HEADERS_END == 0 ? 2 : HEADERS_END + 4);
+                    InReader.State = EState::Content;
+                    break;
+                }
+
+                case EState::Epilogue:
+                {
+                    Pending.clear();
+                    return;
+                }
+            }
+        }
+    }
+
+    /// @brief  Read the next chunk of the body and parse it, until the body ends
+    void ReadNextChunk(const std::shared_ptr<Reader>& pReader)
+    {
+        pReader->Body.getn(pReader->Chunk.data(), pReader->Chunk.size())
+            .then(
+                [pReader](const pplx::task<size_t>& ReadTask)
+                {
+                    try
+                    {
+                        const auto SIZE = ReadTask.get();
+                        if (SIZE == 0)
+                        {
+                            if (pReader->State != EState::Epilogue)
+                            {
+                                throw FormData::ParseError(web::http::status_codes::BadRequest, "The body ends before its closing boundary");
+                            }
+                            pReader->Completed.set(std::move(pReader->Parts));
+                            return;
+                        }
+
+                        pReader->Size += SIZE;
+                        if (pReader->Options.MaxSize > 0 && pReader->Size > pReader->Options.MaxSize)
+                        {
+                            throw FormData::ParseError(web::http::status_codes::RequestEntityTooLarge, "The body is too large");
+                        }
+
+                        pReader->Pending.append(reinterpret_cast<const char*>(pReader->Chunk.data()), SIZE);
+                        Parse(*pReader);
+                    }
+                    catch (...)
+                    {
+                        // The temporary files of the parts are removed with the reader
+                        pReader->Completed.set_exception(std::current_exception());
+                        return;
+                    }
+
+                    ReadNextChunk(pReader);
+                });
+    }
+} // namespace
+
+FormData::ParseError::ParseError(const web::http::status_code STATUS, const std::string& Message) : std::runtime_error(Message), m_Status(STATUS)
+{
+}
+
+std::string FormData::GetBoundary(const std::string& ContentType)
+{
+    std::vector<std::pair<std::string, std::string>> Parameters;
+    if (ParseParameters(ContentType, Parameters) != "multipart/form-data")
+    {
+        return "";
+    }
+
+    // A boundary is 1 to 70 characters (RFC 2046)
+    auto Boundary = GetParameter(Parameters, "boundary");
+    return Boundary.size() <= 70 ? Boundary : std::string();
+}
+
+pplx::task<std::vector<FormData::Part>> FormData::ReadAsync(const concurrency::streams::istream& Body, const std::string& Boundary, const ReadOptions& Options)
+{
+    auto pReader       = std::make_shared<Reader>();
+    pReader->Body      = Body.streambuf();
+    pReader->Delimiter = "\r\n--" + Boundary;
+    pReader->Options   = Options;
+
+    // The first boundary may start the body, without the CRLF that precedes the others
+    pReader->Pending = "\r\n";
+
+    ReadNextChunk(pReader);
+    return pplx::create_task(pReader->Completed);
+}
@@ -0,0 +1,94 @@
+#include "HttpRange.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <string_view>
+
+using namespace ORION;
+
+namespace
+{
+    /// @brief  Parse a decimal position of a byte range
+    /// @return Whether the whole text is a number
+    bool ParsePosition(const std::string_view& Text, uint64_t& OutPosition)
+    {
+        const auto [END, ERROR_CODE] = std::from_chars(Text.data(), Text.data() + Text.size(), OutPosition);
+        return !Text.empty() && ERROR_CODE == std::errc() && END == Text.data() + Text.size();
+    }
+} // namespace
+
+HttpRange::ByteRange HttpRange::Parse(const std::string& Range, const uint64_t SIZE)
+{
+    static constexpr std::string_view UNIT = "bytes=";
+
+    std::string_view Spec(Range);
+    Spec.remove_prefix(std::min(Spec.find_first_not_of(" \t"), Spec.size()));
+    Spec.remove_suffix(Spec.size() - std::min(Spec.find_last_not_of(" \t") + 1, Spec.size()));
+
+    // Only single byte ranges are supported; ignoring the header (and sending everything) is always allowed
+    if (Spec.substr(0, UNIT.size()) != UNIT || Spec.find(',') != std::string_view::npos)
+    {
+        return {};
+    }
+    Spec.remove_prefix(UNIT.size());
+
+    const auto DASH_POS = Spec.find('-');
+    if (DASH_POS == std::string_view::npos)
+    {
+        return {};
+    }
+
+    const auto FIRST = Spec.substr(0, DASH_POS);
+    const auto LAST  = Spec.substr(DASH_POS + 1);
+
+    ByteRange Result;
+    if (FIRST.empty())
+    {
+        // bytes=-N: the last N bytes
+        uint64_t SuffixLength = 0;
+        if (!ParsePosition(LAST, SuffixLength))
+        {
+            return {};
+        }
+        if (SuffixLength == 0 || SIZE == 0)
+        {
+            Result.Result = EResult::Unsatisfiable;
+            return Result;
+        }
+
+        Result.Length = std::min(SuffixLength, SIZE);
+        Result.Offset = SIZE - Result.Length;
+        Result.Result = EResult::Satisfiable;
+        return Result;
+    }
+
+    // bytes=N- or bytes=N-M
+    uint64_t FirstPosition = 0;
+    uint64_t LastPosition  = UINT64_MAX;
+    if (!ParsePosition(FIRST, FirstPosition) || (!LAST.empty() && !ParsePosition(LAST, LastPosition)) || LastPosition < FirstPosition)
+    {
+        return {};
+    }
+
+    if (FirstPosition >= SIZE)
+    {
+        Result.Result = EResult::Unsatisfiable;
+        return Result;
+    }
+
+    // The last position may be past the end; the range is clamped to the representation
+    Result.Offset = FirstPosition;
+    Result.Length = std::min(LastPosition, SIZE - 1) - FirstPosition + 1;
+    Result.Result = EResult::Satisfiable;
+    return Result;
+}
+
+std::string HttpRange::FormatContentRange(const ByteRange& InRange, const uint64_t SIZE)
+{
+    if (InRange.Result != EResult::Satisfiable)
+    {
+        return "bytes */" + std::to_string(SIZE);
+    }
+
+    return "bytes " + std::to_string(InRange.Offset) + "-" + std::to_string(InRange.Offset + InRange.Length - 1) + "/" + std::to_string(SIZE);
+}
@@ -0,0 +1,365 @@
+#include "Logger.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+
+using namespace ORION;
+using namespace ORION::Log;
+
+namespace
+{
+    /// @brief  The level names, in ELevel order
+    constexpr std::string_view LEVEL_NAMES[] = {"trace", "debug", "info", "warning", "error", "off"};
+
+    /// @brief  Append a string to a JSON line as a quoted, escaped JSON string
+    void AppendJsonString(std::string& Line, const std::string_view& Value)
+    {
+        static constexpr char HEX_DIGITS[] = "0123456789abcdef";
+
+        Line += '"';
+        for (const char Character : Value)
+        {
+            switch (Character)
+            {
+                case '"':
+                    Line += "\\\"";
+                    break;
+                case '\\':
+                    Line += "\\\\";
+                    break;
+                case '\n':
+                    Line += "\\n";
+                    break;
+                case '\r':
+                    Line += "\\r";
+                    break;
+                case '\t':
+                    Line += "\\t";
+                    break;
+                default:
+                    if (static_cast<unsigned char>(Character) < 0x20)
+                    {
+                        Line += "\\u00";
+                        Line += HEX_DIGITS[(Character >> 4) & 0xF];
+                        Line += HEX_DIGITS[Character & 0xF];
+                    }
+                    else
+                    {
+                        Line += Character;
+                    }
+                    break;
+            }
+        }
+        Line += '"';
+    }
+
+    /// @brief  Copy a field value, truncated to MAX_LENGTH (the number of bytes cut is noted, so truncation is visible in the log)
+    std::string TruncateValue(const std::string_view& Value, const size_t MAX_LENGTH)
+    {
+        if (MAX_LENGTH == 0 || Value.size() <= MAX_LENGTH)
+        {
+            return std::string(Value);
+        }
+
+        // Don't cut a UTF-8 sequence in half
+        size_t Length = MAX_LENGTH;
+        while (Length > 0 && (static_cast<unsigned char>(Value[Length]) & 0xC0) == 0x80)
+        {
+            --Length;
+        }
+
+        std::string Truncated(Value.substr(0, Length));
+        Truncated += "... (" + std::to_string(Value.size() - Length) + " more bytes)";
+        return Truncated;
+    }
+} // namespace
+
+std::optional<ELevel> Log::ParseLevel(const std::string_view& Name)
+{
+    for (size_t Index = 0; Index < std::size(LEVEL_NAMES); ++Index)
+    {
+        if (LEVEL_NAMES[Index] == Name)
+        {
+            return static_cast<ELevel>(Index);
+        }
+    }
+    if (Name == "warn")
+    {
+        return ELevel::Warning;
+    }
+    return std::nullopt;
+}
+
+std::string_view Log::GetLevelName(const ELevel LEVEL)
+{
+    return LEVEL_NAMES[static_cast<size_t>(LEVEL)];
+}
+
+Logger& Logger::Get()
+{
+    static Logger Instance;
+    return Instance;
+}
+
+Logger::Logger()
+    : m_pFilter(std::make_shared<const Filter>())
+{
+    m_WriterThread = std::thread(&Logger::WriterThreadHandler, this);
+}
+
+Logger::~Logger()
+{
+    {
+        std::lock_guard<std::mutex> WakeLock(m_WakeMutex);
+        m_IsRunning = false;
+    }
+    m_WakeConditionVariable.notify_one();
+
+    if (m_WriterThread.joinable())
+    {
+        m_WriterThread.join();
+    }
+
+    if (m_pOutput != stderr)
+    {
+        std::fclose(m_pOutput);
+    }
+}
+
+bool Logger::Configure(const LogOptions& Options, std::string& OutError)
+{
+    auto pFilter            = std::make_shared<Filter>();
+    pFilter->Level          = Options.Level;
+    pFilter->MinimumLevel   = Options.Level;
+    pFilter->MaxFieldLength = Options.MaxFieldLength;
+    pFilter->QueueCapacity  = std::max<size_t>(Options.QueueCapacity, 1);
+
+    bool IsValid = true;
+
+    // module=level,module=level
+    std::string_view ModuleLevels = Options.ModuleLevels;
+    while (!ModuleLevels.empty())
+    {
+        const auto       COMMA_POS = ModuleLevels.find(',');
+        std::string_view Entry     = ModuleLevels.substr(0, COMMA_POS);
+        ModuleLevels               = COMMA_POS == std::string_view::npos ? std::string_view() : ModuleLevels.substr(COMMA_POS + 1);
+        if (Entry.empty())
+        {
+            continue;
+        }
+
+        const auto EQUALS_POS = Entry.find('=');
+        const auto LEVEL      = EQUALS_POS != std::string_view::npos ? ParseLevel(Entry.substr(EQUALS_POS + 1)) : std::nullopt;
+        if (!LEVEL || EQUALS_POS == 0)
+        {
+            OutError = "Invalid module level '" + std::string(Entry) + "', expected module=level";
+            IsValid  = false;
+            continue;
+        }
+
+        pFilter->ModuleLevels[std::string(Entry.substr(0, EQUALS_POS))] = *LEVEL;
+        pFilter->MinimumLevel                                           = std::min(pFilter->MinimumLevel, *LEVEL);
+    }
+
+    FILE* pOutput = stderr;
+    if (!Options.FilePath.empty())
+    {
+        pOutput = std::fopen(Options.FilePath.c_str(), "a");
+        if (!pOutput)
+        {
+            OutError = "Failed to open the log file " + Options.FilePath + ": " + std::strerror(errno);
+            IsValid  = false;
+            pOutput  = stderr;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> OutputLock(m_OutputMutex);
+        std::fflush(m_pOutput);
+        if (m_pOutput != stderr)
+        {
+            std::fclose(m_pOutput);
+        }
+        m_pOutput = pOutput;
+    }
+
+    std::atomic_store(&m_pFilter, std::shared_ptr<const Filter>(std::move(pFilter)));
+    return IsValid;
+}
+
+bool Logger::IsEnabled(const ELevel LEVEL, const std::string_view& Module) const
+{
+    const auto pFilter = std::atomic_load(&m_pFilter);
+    if (LEVEL < pFilter->MinimumLevel || LEVEL == ELevel::Off)
+    {
+        return false;
+    }
+    if (pFilter->ModuleLevels.empty())
+    {
+        return LEVEL >= pFilter->Level;
+    }
+
+    // The most specific module wins: orion.events, then orion, then the default
+    std::string_view Prefix = Module;
+    while (true)
+    {
+        if (const auto LEVEL_ITER = pFilter->ModuleLevels.find(Prefix); LEVEL_ITER != pFilter->ModuleLevels.end())
+        {
+            return LEVEL >= LEVEL_ITER->second;
+        }
+
+        const auto DOT_POS = Prefix.rfind('.');
+        if (DOT_POS == std::string_view::npos)
+        {
+            return LEVEL >= pFilter->Level;
+        }
+        Prefix = Prefix.substr(0, DOT_POS);
+    }
+}
+
+void Logger::Write(const ELevel LEVEL, const std::string_view& Module, const std::string_view& Message, std::initializer_list<Field> Fields)
+{
+    if (!IsEnabled(LEVEL, Module))
+    {
+        return;
+    }
+
+    const auto pFilter = std::atomic_load(&m_pFilter);
+
+    // Drop rather than block when the writer can't keep up
+    if (m_QueuedCount.fetch_add(1, std::memory_order_relaxed) >= pFilter->QueueCapacity)
+    {
+        m_QueuedCount.fetch_sub(1, std::memory_order_relaxed);
+        m_DroppedCount.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    auto pRecord     = std::make_unique<Record>();
+    pRecord->Time    = std::chrono::system_clock::now();
+    pRecord->Level   = LEVEL;
+    pRecord->Module  = Module;
+    pRecord->Message = Message;
+    pRecord->Fields.reserve(Fields.size());
+    for (const auto& [Key, Value] : Fields)
+    {
+        pRecord->Fields.emplace_back(std::string(Key), TruncateValue(Value, pFilter->MaxFieldLength));
+    }
+
+    m_PushedCount.fetch_add(1, std::memory_order_relaxed);
+
+    // Only the producer that turns the queue from empty to non-empty can find the writer asleep
+    if (m_Queue.Push(std::move(pRecord)))
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_IsSleeping.load())
+        {
+            {
+                std::lock_guard<std::mutex> WakeLock(m_WakeMutex);
+            }
+            m_WakeConditionVariable.notify_one();
+        }
+    }
+}
+
+void Logger::Flush()
+{
+    const uint64_t TARGET = m_PushedCount.load();
+
+    std::unique_lock<std::mutex> WakeLock(m_WakeMutex);
+    m_WakeConditionVariable.notify_one();
+    m_FlushedConditionVariable.wait_for(WakeLock, std::chrono::seconds(5), [this, TARGET] { return m_WrittenCount.load() >= TARGET; });
+}
+
+void Logger::WriterThreadHandler()
+{
+    std::vector<std::unique_ptr<Record>> Batch;
+    std::string                          Lines;
+    uint64_t                             ReportedDroppedCount = 0;
+
+    while (true)
+    {
+        const size_t RECORD_COUNT = m_Queue.Drain([&Batch](std::unique_ptr<Record> pRecord) { Batch.push_back(std::move(pRecord)); });
+
+        if (RECORD_COUNT == 0)
+        {
+            if (!m_IsRunning)
+            {
+                // Queue is drained and the logger is being destroyed
+                break;
+            }
+
+            std::unique_lock<std::mutex> WakeLock(m_WakeMutex);
+            m_FlushedConditionVariable.notify_all();
+            m_IsSleeping = true;
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            // Wait for a record to be queued or for the logger to be destroyed
+            m_WakeConditionVariable.wait(WakeLock, [this] { return !m_Queue.IsEmpty() || !m_IsRunning; });
+
+            m_IsSleeping = false;
+            continue;
+        }
+        m_QueuedCount.fetch_sub(RECORD_COUNT, std::memory_order_relaxed);
+
+        // Format the whole batch, then write it with one call
+        Lines.clear();
+        for (const auto& pRecord : Batch)
+        {
+            FormatRecord(*pRecord, Lines);
+        }
+        Batch.clear();
+
+        if (const auto DROPPED_COUNT = m_DroppedCount.load(std::memory_order_relaxed); DROPPED_COUNT != ReportedDroppedCount)
+        {
+            Record DroppedRecord;
+            DroppedRecord.Time    = std::chrono::system_clock::now();
+            DroppedRecord.Level   = ELevel::Warning;
+            DroppedRecord.Module  = "log";
+            DroppedRecord.Message = "Log records were dropped because the writer fell behind";
+            DroppedRecord.Fields.emplace_back("dropped", std::to_string(DROPPED_COUNT - ReportedDroppedCount));
+            FormatRecord(DroppedRecord, Lines);
+            ReportedDroppedCount = DROPPED_COUNT;
+        }
+
+        {
+            std::lock_guard<std::mutex> OutputLock(m_OutputMutex);
+            std::fwrite(Lines.data(), 1, Lines.size(), m_pOutput);
+            std::fflush(m_pOutput);
+        }
+
+        m_WrittenCount.fetch_add(RECORD_COUNT);
+    }
+
+    m_FlushedConditionVariable.notify_all();
+}
+
+void Logger::FormatRecord(const Record& InRecord, std::string& OutLine)
+{
+    // RFC 3339 UTC time with milliseconds
+    const auto   TIME_T       = std::chrono::system_clock::to_time_t(InRecord.Time);
+    const auto   MILLISECONDS = std::chrono::duration_cast<std::chrono::milliseconds>(InRecord.Time.time_since_epoch()).count() % 1000;
+    std::tm      UTCTime {};
+    char         TimeBuffer[32];
+    gmtime_r(&TIME_T, &UTCTime);
+    const size_t TIME_LENGTH = std::strftime(TimeBuffer, sizeof(TimeBuffer), "%Y-%m-%dT%H:%M:%S", &UTCTime);
+    std::snprintf(TimeBuffer + TIME_LENGTH, sizeof(TimeBuffer) - TIME_LENGTH, ".%03dZ", static_cast<int>(MILLISECONDS));
+
+    OutLine += "{\"time\":\"";
+    OutLine += TimeBuffer;
+    OutLine += "\",\"level\":\"";
+    OutLine += GetLevelName(InRecord.Level);
+    OutLine += "\",\"module\":";
+    AppendJsonString(OutLine, InRecord.Module);
+    OutLine += ",\"message\":";
+    AppendJsonString(OutLine, InRecord.Message);
+    for (const auto& [Key, Value] : InRecord.Fields)
+    {
+        OutLine += ',';
+        AppendJsonString(OutLine, Key);
+        OutLine += ':';
+        AppendJsonString(OutLine, Value);
+    }
+    OutLine += "}\n";
+}
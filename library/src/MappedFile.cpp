@@ -0,0 +1,56 @@
+#include "MappedFile.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace ORION;
+
+std::shared_ptr<const MappedFile> MappedFile::Open(const std::filesystem::path& FilePath)
+{
+    const int FILE_DESCRIPTOR = ::open(FilePath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (FILE_DESCRIPTOR < 0)
+    {
+        return nullptr;
+    }
+
+    struct stat FileStatus {};
+    if (::fstat(FILE_DESCRIPTOR, &FileStatus) != 0 || !S_ISREG(FileStatus.st_mode))
+    {
+        ::close(FILE_DESCRIPTOR);
+        return nullptr;
+    }
+
+    const auto SIZE  = static_cast<uint64_t>(FileStatus.st_size);
+    void*      pData = nullptr;
+    if (SIZE > 0)
+    {
+        pData = ::mmap(nullptr, SIZE, PROT_READ, MAP_PRIVATE, FILE_DESCRIPTOR, 0);
+        if (pData == MAP_FAILED)
+        {
+            ::close(FILE_DESCRIPTOR);
+            return nullptr;
+        }
+
+        // Responses read the mapping front to back
+        ::madvise(pData, SIZE, MADV_SEQUENTIAL);
+    }
+
+    // The mapping keeps the file referenced
+    ::close(FILE_DESCRIPTOR);
+
+    return std::shared_ptr<const MappedFile>(new MappedFile(static_cast<const uint8_t*>(pData), SIZE));
+}
+
+MappedFile::MappedFile(const uint8_t* pData, const uint64_t SIZE) : m_pData(pData), m_Size(SIZE)
+{
+}
+
+MappedFile::~MappedFile()
+{
+    if (m_pData)
+    {
+        ::munmap(const_cast<uint8_t*>(m_pData), m_Size);
+    }
+}
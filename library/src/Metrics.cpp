@@ -0,0 +1,361 @@
+#include "Metrics.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <mutex>
+#include <sstream>
+#include <string_view>
+
+using namespace ORION;
+using namespace ORION::Metrics;
+
+namespace
+{
+    /// @brief  Render label pairs as name="value",... (without braces), escaping the values
+    std::string FormatLabels(const Labels& InLabels)
+    {
+        std::string Text;
+        for (const auto& [Name, Value] : InLabels)
+        {
+            if (!Text.empty())
+            {
+                Text += ',';
+            }
+
+            Text.append(Name).append("=\"");
+            for (const char C : Value)
+            {
+                switch (C)
+                {
+                    case '\\':
+                        Text += "\\\\";
+                        break;
+                    case '"':
+                        Text += "\\\"";
+                        break;
+                    case '\n':
+                        Text += "\\n";
+                        break;
+                    default:
+                        Text += C;
+                        break;
+                }
+            }
+            Text += '"';
+        }
+        return Text;
+    }
+
+    /// @brief  Render a sample value
+    std::string FormatValue(const double VALUE)
+    {
+        if (std::isinf(VALUE))
+        {
+            return VALUE > 0 ? "+Inf" : "-Inf";
+        }
+
+        char Buffer[32];
+        std::snprintf(Buffer, sizeof(Buffer), "%.15g", VALUE);
+        return Buffer;
+    }
+
+    /// @brief  Append a sample line: name{labels} value
+    void AppendSample(std::string& Output, const std::string& Name, const std::string& LabelText, const std::string& Value)
+    {
+        Output.append(Name);
+        if (!LabelText.empty())
+        {
+            Output.append("{").append(LabelText).append("}");
+        }
+        Output.append(" ").append(Value).append("\n");
+    }
+
+    /// @brief  Get the type token of a family
+    const char* GetTypeName(const Registry::EType TYPE)
+    {
+        switch (TYPE)
+        {
+            case Registry::EType::Gauge:
+                return "gauge";
+            case Registry::EType::Histogram:
+                return "histogram";
+            default:
+                return "counter";
+        }
+    }
+
+    /// @brief  Check whether a path segment is a version or a number (v1, 2.5, 3), which names an endpoint rather than a resource
+    bool IsVersionSegment(const std::string& Segment)
+    {
+        const size_t FIRST_DIGIT = !Segment.empty() && Segment[0] == 'v' ? 1 : 0;
+        if (Segment.size() <= FIRST_DIGIT || Segment.size() > 8 || !std::isdigit(static_cast<unsigned char>(Segment[FIRST_DIGIT])) || Segment.back() == '.')
+        {
+            return false;
+        }
+        return std::all_of(Segment.begin() + FIRST_DIGIT, Segment.end(), [](const unsigned char C) { return std::isdigit(C) || C == '.'; }) &&
+               Segment.find("..") == std::string::npos;
+    }
+
+    /// @brief  Check whether a path segment is a generated id: one with the prefix of an OpenAI id (thread_..., file-...), or a long
+    ///         token with digits (a GUID or a hash). Fixed segments are words or versions
+    bool IsIDSegment(const std::string& Segment)
+    {
+        static const std::vector<std::string_view> ID_PREFIXES = {"file-", "thread_", "run_", "asst_", "msg_", "step_", "call_", "vs_", "batch_"};
+        if (std::any_of(ID_PREFIXES.begin(), ID_PREFIXES.end(), [&Segment](const std::string_view& Prefix) { return Segment.rfind(Prefix, 0) == 0; }))
+        {
+            return true;
+        }
+        if (IsVersionSegment(Segment))
+        {
+            return false;
+        }
+
+        const bool HAS_DIGIT = std::any_of(Segment.begin(), Segment.end(), [](const unsigned char C) { return std::isdigit(C); });
+        return (HAS_DIGIT && Segment.size() >= 16) || (Segment.size() > 24 && Segment.find_first_of("_-") != std::string::npos);
+    }
+} // namespace
+
+Histogram::Histogram(std::vector<double> InUpperBounds)
+    : m_UpperBounds(std::move(InUpperBounds)),
+      m_BucketCounts(std::make_unique<std::atomic<uint64_t>[]>(m_UpperBounds.size() + 1))
+{
+    std::sort(m_UpperBounds.begin(), m_UpperBounds.end());
+}
+
+void Histogram::Observe(const double VALUE)
+{
+    // Buckets are inclusive of their upper bound (le)
+    const size_t BUCKET_INDEX = std::lower_bound(m_UpperBounds.begin(), m_UpperBounds.end(), VALUE) - m_UpperBounds.begin();
+    m_BucketCounts[BUCKET_INDEX].fetch_add(1, std::memory_order_relaxed);
+
+    double Sum = m_Sum.load(std::memory_order_relaxed);
+    while (!m_Sum.compare_exchange_weak(Sum, Sum + VALUE, std::memory_order_relaxed))
+    {
+    }
+}
+
+std::vector<uint64_t> Histogram::GetBucketCounts() const
+{
+    std::vector<uint64_t> Counts(m_UpperBounds.size() + 1);
+    for (size_t Index = 0; Index < Counts.size(); ++Index)
+    {
+        Counts[Index] = m_BucketCounts[Index].load(std::memory_order_relaxed);
+    }
+    return Counts;
+}
+
+const std::vector<double>& Metrics::GetLatencyBuckets()
+{
+    static const std::vector<double> LATENCY_BUCKETS = {0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0, 30.0, 60.0};
+    return LATENCY_BUCKETS;
+}
+
+Registry& Registry::Get()
+{
+    static Registry REGISTRY;
+    return REGISTRY;
+}
+
+Registry::Family& Registry::GetFamily(const std::string& Name, const std::string& Help, const EType TYPE)
+{
+    auto [FamilyIter, IS_NEW_FAMILY] = m_Families.try_emplace(Name);
+    if (IS_NEW_FAMILY)
+    {
+        FamilyIter->second.Type = TYPE;
+        FamilyIter->second.Help = Help;
+    }
+    else if (FamilyIter->second.Type != TYPE)
+    {
+        throw std::logic_error("The metric " + Name + " is already registered as a " + GetTypeName(FamilyIter->second.Type));
+    }
+    return FamilyIter->second;
+}
+
+Counter& Registry::GetCounter(const std::string& Name, const std::string& Help, const Labels& InLabels)
+{
+    const auto LABEL_TEXT = FormatLabels(InLabels);
+    {
+        std::shared_lock<std::shared_mutex> SharedLock(m_Mutex);
+        if (const auto FAMILY_ITER = m_Families.find(Name); FAMILY_ITER != m_Families.end())
+        {
+            if (const auto SERIES_ITER = FAMILY_ITER->second.Counters.find(LABEL_TEXT); SERIES_ITER != FAMILY_ITER->second.Counters.end())
+            {
+                return *SERIES_ITER->second;
+            }
+        }
+    }
+
+    std::unique_lock<std::shared_mutex> UniqueLock(m_Mutex);
+    auto&                               pSeries = GetFamily(Name, Help, EType::Counter).Counters[LABEL_TEXT];
+    if (!pSeries)
+    {
+        pSeries = std::make_unique<Counter>();
+    }
+    return *pSeries;
+}
+
+Gauge& Registry::GetGauge(const std::string& Name, const std::string& Help, const Labels& InLabels)
+{
+    const auto LABEL_TEXT = FormatLabels(InLabels);
+    {
+        std::shared_lock<std::shared_mutex> SharedLock(m_Mutex);
+        if (const auto FAMILY_ITER = m_Families.find(Name); FAMILY_ITER != m_Families.end())
+        {
+            if (const auto SERIES_ITER = FAMILY_ITER->second.Gauges.find(LABEL_TEXT); SERIES_ITER != FAMILY_ITER->second.Gauges.end())
+            {
+                return *SERIES_ITER->second;
+            }
+        }
+    }
+
+    std::unique_lock<std::shared_mutex> UniqueLock(m_Mutex);
+    auto&                               pSeries = GetFamily(Name, Help, EType::Gauge).Gauges[LABEL_TEXT];
+    if (!pSeries)
+    {
+        pSeries = std::make_unique<Gauge>();
+    }
+    return *pSeries;
+}
+
+Histogram& Registry::GetHistogram(const std::string& Name, const std::string& Help, const Labels& InLabels, const std::vector<double>& UpperBounds)
+{
+    const auto LABEL_TEXT = FormatLabels(InLabels);
+    {
+        std::shared_lock<std::shared_mutex> SharedLock(m_Mutex);
+        if (const auto FAMILY_ITER = m_Families.find(Name); FAMILY_ITER != m_Families.end())
+        {
+            if (const auto SERIES_ITER = FAMILY_ITER->second.Histograms.find(LABEL_TEXT); SERIES_ITER != FAMILY_ITER->second.Histograms.end())
+            {
+                return *SERIES_ITER->second;
+            }
+        }
+    }
+
+    std::unique_lock<std::shared_mutex> UniqueLock(m_Mutex);
+    auto&                               pSeries = GetFamily(Name, Help, EType::Histogram).Histograms[LABEL_TEXT];
+    if (!pSeries)
+    {
+        pSeries = std::make_unique<Histogram>(UpperBounds);
+    }
+    return *pSeries;
+}
+
+void Registry::AddCallback(const EType TYPE, const std::string& Name, const std::string& Help, const Labels& InLabels, std::function<double()> Read)
+{
+    std::unique_lock<std::shared_mutex> UniqueLock(m_Mutex);
+    GetFamily(Name, Help, TYPE == EType::Gauge ? EType::Gauge : EType::Counter).Callbacks[FormatLabels(InLabels)] = std::move(Read);
+}
+
+void Registry::RemoveCallback(const std::string& Name, const Labels& InLabels)
+{
+    std::unique_lock<std::shared_mutex> UniqueLock(m_Mutex);
+    if (const auto FAMILY_ITER = m_Families.find(Name); FAMILY_ITER != m_Families.end())
+    {
+        FAMILY_ITER->second.Callbacks.erase(FormatLabels(InLabels));
+    }
+}
+
+std::string Registry::Serialize() const
+{
+    std::string Output;
+
+    std::shared_lock<std::shared_mutex> SharedLock(m_Mutex);
+    for (const auto& [Name, InFamily] : m_Families)
+    {
+        Output.append("# HELP ").append(Name).append(" ").append(InFamily.Help).append("\n");
+        Output.append("# TYPE ").append(Name).append(" ").append(GetTypeName(InFamily.Type)).append("\n");
+
+        for (const auto& [LabelText, pCounter] : InFamily.Counters)
+        {
+            AppendSample(Output, Name, LabelText, std::to_string(pCounter->GetValue()));
+        }
+
+        for (const auto& [LabelText, pGauge] : InFamily.Gauges)
+        {
+            AppendSample(Output, Name, LabelText, std::to_string(pGauge->GetValue()));
+        }
+
+        for (const auto& [LabelText, Read] : InFamily.Callbacks)
+        {
+            AppendSample(Output, Name, LabelText, FormatValue(Read()));
+        }
+
+        for (const auto& [LabelText, pHistogram] : InFamily.Histograms)
+        {
+            // Buckets are cumulative in the exposition format
+            const auto  BUCKET_COUNTS = pHistogram->GetBucketCounts();
+            const auto& UPPER_BOUNDS  = pHistogram->GetUpperBounds();
+            const auto  SEPARATOR     = LabelText.empty() ? std::string() : std::string(",");
+
+            uint64_t CumulativeCount = 0;
+            for (size_t Index = 0; Index < BUCKET_COUNTS.size(); ++Index)
+            {
+                CumulativeCount += BUCKET_COUNTS[Index];
+                const auto UPPER_BOUND = Index < UPPER_BOUNDS.size() ? FormatValue(UPPER_BOUNDS[Index]) : std::string("+Inf");
+                AppendSample(Output, Name + "_bucket", LabelText + SEPARATOR + "le=\"" + UPPER_BOUND + "\"", std::to_string(CumulativeCount));
+            }
+            AppendSample(Output, Name + "_sum", LabelText, FormatValue(pHistogram->GetSum()));
+            AppendSample(Output, Name + "_count", LabelText, std::to_string(CumulativeCount));
+        }
+    }
+
+    return Output;
+}
+
+std::string Metrics::GetEndpointLabel(const std::string& Path)
+{
+    std::string       Endpoint;
+    std::stringstream PathStream(Path);
+    std::string       Segment;
+    while (std::getline(PathStream, Segment, '/'))
+    {
+        if (Segment.empty() || (Endpoint.empty() && Segment == "v1"))
+        {
+            continue;
+        }
+
+        Endpoint.append(Endpoint.empty() ? "" : "/").append(IsIDSegment(Segment) ? ":id" : Segment);
+    }
+    return Endpoint.empty() ? std::string("/") : Endpoint;
+}
+
+void Metrics::InstrumentClient(web::http::client::http_client& Client, const std::string& Service)
+{
+    Client.add_handler(
+        [Service](web::http::http_request Request, std::shared_ptr<web::http::http_pipeline_stage> pNextStage)
+        {
+            const auto ENDPOINT = GetEndpointLabel(Request.request_uri().path());
+            const auto METHOD   = Request.method();
+            const auto START    = std::chrono::steady_clock::now();
+
+            // The response completes when its headers arrive, so streamed responses are timed to their first byte
+            return pNextStage->propagate(Request).then(
+                [Service, ENDPOINT, METHOD, START](pplx::task<web::http::http_response> ResponseTask)
+                {
+                    auto&       Metrics = Registry::Get();
+                    std::string Status  = "error";
+                    try
+                    {
+                        auto Response = ResponseTask.get();
+                        Status        = std::to_string(Response.status_code());
+
+                        Metrics.GetHistogram("orion_upstream_request_duration_seconds", "Time until the response headers of upstream API requests arrive",
+                                             {{"service", Service}, {"endpoint", ENDPOINT}})
+                            .Observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - START).count());
+                        Metrics.GetCounter("orion_upstream_requests_total", "Upstream API requests by status ('error' if no response arrived)",
+                                           {{"service", Service}, {"endpoint", ENDPOINT}, {"method", METHOD}, {"status", Status}})
+                            .Increment();
+                        return Response;
+                    }
+                    catch (...)
+                    {
+                        Metrics.GetCounter("orion_upstream_requests_total", "Upstream API requests by status ('error' if no response arrived)",
+                                           {{"service", Service}, {"endpoint", ENDPOINT}, {"method", METHOD}, {"status", Status}})
+                            .Increment();
+                        throw;
+                    }
+                });
+        });
+}
@@ -0,0 +1,1017 @@
+#include "OpenAIClient.hpp"
+#include "GUID.hpp"
+#include "Logger.hpp"
+#include "Metrics.hpp"
+#include "TimerQueue.hpp"
+#include "Tracing.hpp"
+#include "Upstream.hpp"
+
+#include <cpprest/filestream.h>
+#include <cpprest/rawptrstream.h>
+
+#include <algorithm>
+#include <array>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <random>
+
+using namespace ORION;
+using namespace ORION::OpenAI;
+
+namespace
+{
+    std::mutex   g_OptionsMutex;
+    RetryOptions g_Options;
+
+    /// @brief  Get a copy of the retry settings
+    RetryOptions GetOptions()
+    {
+        std::lock_guard<std::mutex> Lock(g_OptionsMutex);
+        return g_Options;
+    }
+
+    /// @brief  The timers of the backoffs and the rate limiters
+    TimerQueue& GetTimers()
+    {
+        static TimerQueue Timers;
+        return Timers;
+    }
+
+    /// @brief  Complete after a delay, without holding a thread
+    pplx::task<void> Delay(const std::chrono::milliseconds DELAY)
+    {
+        pplx::task_completion_event<void> Elapsed;
+        GetTimers().Schedule(DELAY, [Elapsed] { Elapsed.set(); });
+        return pplx::create_task(Elapsed);
+    }
+
+    /**
+     * @brief Stops calls for a while once the API keeps failing.
+     *
+     * Closed: calls go through, and failed attempts in a row are counted. Open (after BreakerThreshold of them): calls are refused until the
+     * cooldown has passed. Half open: one trial call goes through; it closes the circuit if it succeeds and opens it again if it fails.
+     */
+    class CircuitBreaker final
+    {
+    public:
+        static CircuitBreaker& Get()
+        {
+            static CircuitBreaker Breaker;
+            return Breaker;
+        }
+
+        /// @brief  Whether a call may be attempted
+        bool Allow()
+        {
+            std::lock_guard<std::mutex> Lock(m_Mutex);
+            if (m_State == EState::Open && std::chrono::steady_clock::now() >= m_OpenUntil)
+            {
+                SetState(EState::HalfOpen);
+                m_IsTrialInFlight = false;
+            }
+
+            if (m_State == EState::HalfOpen && !m_IsTrialInFlight)
+            {
+                m_IsTrialInFlight = true;
+                return true;
+            }
+            return m_State == EState::Closed;
+        }
+
+        /// @brief  Note an attempt the API answered (a 2xx, or a 4xx that isn't the API's fault)
+        void RecordSuccess()
+        {
+            std::lock_guard<std::mutex> Lock(m_Mutex);
+            m_FailureCount = 0;
+            if (m_State != EState::Closed)
+            {
+                SetState(EState::Closed);
+                Log::Info("openai", "The circuit breaker closed, the OpenAI API is answering again");
+            }
+        }
+
+        /// @brief  Note an attempt that failed (a 5xx, or no response)
+        void RecordFailure(const RetryOptions& Options)
+        {
+            std::lock_guard<std::mutex> Lock(m_Mutex);
+            ++m_FailureCount;
+
+            // A failure that arrives while the circuit is open was sent before it opened, and doesn't extend the cooldown
+            const bool IS_THRESHOLD_REACHED = m_State == EState::Closed && Options.BreakerThreshold > 0 && m_FailureCount >= Options.BreakerThreshold;
+            if (IS_THRESHOLD_REACHED || m_State == EState::HalfOpen)
+            {
+                SetState(EState::Open);
+                m_OpenUntil = std::chrono::steady_clock::now() + Options.BreakerCooldown;
+                Log::Warning("openai", "The circuit breaker opened, OpenAI calls fail fast until the cooldown has passed",
+                             {{"failures", std::to_string(m_FailureCount)}, {"cooldown_ms", std::to_string(Options.BreakerCooldown.count())}});
+            }
+        }
+
+    private:
+        /// @brief  The state of the circuit (the values of the orion_openai_circuit_state gauge)
+        enum class EState
+        {
+            Closed   = 0,
+            Open     = 1,
+            HalfOpen = 2,
+        };
+
+        CircuitBreaker()
+            : m_StateGauge(Metrics::Registry::Get().GetGauge("orion_openai_circuit_state", "State of the OpenAI circuit breaker (0 closed, 1 open, 2 half open)"))
+        {
+        }
+
+        void SetState(const EState STATE)
+        {
+            m_State = STATE;
+            m_StateGauge.Set(static_cast<int64_t>(STATE));
+        }
+
+        Metrics::Gauge&                       m_StateGauge;
+        EState                                m_State           = EState::Closed;
+        size_t                                m_FailureCount    = 0;
+        bool                                  m_IsTrialInFlight = false;
+        std::chrono::steady_clock::time_point m_OpenUntil;
+        std::mutex                            m_Mutex;
+    };
+
+    /// @brief  Get the name of an endpoint class in metrics
+    std::string GetClassName(const EEndpointClass CLASS)
+    {
+        switch (CLASS)
+        {
+            case EEndpointClass::Assistants:
+                return "assistants";
+            case EEndpointClass::Chat:
+                return "chat";
+            case EEndpointClass::Embeddings:
+                return "embeddings";
+            case EEndpointClass::Audio:
+                return "audio";
+        }
+        return "unknown";
+    }
+
+    /**
+     * @brief The request and token budgets of an endpoint class, shared by the calls of all clients.
+     *
+     * Each budget is a bucket that refills at its rate and holds a tenth of a minute's worth, so a burst of calls is spread out instead of
+     * sent at once and refused. A call waits, without holding a thread, until both buckets can pay for it; a call larger than a bucket goes
+     * once the bucket is full and leaves it in debt. Waiting interactive calls are served before background ones, each lane in order.
+     */
+    class RateLimiter final
+    {
+    public:
+        explicit RateLimiter(const std::string& Class)
+            : m_Class(Class),
+              m_LastRefill(std::chrono::steady_clock::now())
+        {
+            for (const auto PRIORITY : {EPriority::Interactive, EPriority::Background})
+            {
+                const std::string     PRIORITY_NAME = PRIORITY == EPriority::Interactive ? "interactive" : "background";
+                const Metrics::Labels LABELS        = {{"class", Class}, {"priority", PRIORITY_NAME}};
+                auto&                 WaitLane      = m_Lanes[static_cast<size_t>(PRIORITY)];
+
+                WaitLane.pWaitingGauge =
+                    &Metrics::Registry::Get().GetGauge("orion_openai_rate_limit_waiting", "OpenAI API calls waiting for the budget of their endpoint class", LABELS);
+                WaitLane.pWaitHistogram =
+                    &Metrics::Registry::Get().GetHistogram("orion_openai_rate_limit_wait_seconds", "Time OpenAI API calls waited for the budget of their endpoint class", LABELS);
+            }
+        }
+
+        /// @brief  Set the budget. The buckets start full, and keep their level (up to the new size) when the budget changes
+        void SetBudget(const RateBudget& Budget)
+        {
+            {
+                std::lock_guard<std::mutex> Lock(m_Mutex);
+                Refill(std::chrono::steady_clock::now());
+                m_Requests.SetRate(Budget.RequestsPerMinute);
+                m_Tokens.SetRate(Budget.TokensPerMinute);
+            }
+            Drain();
+        }
+
+        /// @brief  Pay for an attempt. The task completes once the budget allows it
+        /// @param  TOKENS The estimated tokens of the attempt
+        pplx::task<void> Acquire(const EPriority PRIORITY, const double TOKENS)
+        {
+            std::lock_guard<std::mutex> Lock(m_Mutex);
+            const auto                  NOW = std::chrono::steady_clock::now();
+            Refill(NOW);
+
+            // Calls already waiting in this lane or a higher one go first
+            bool IsAnyoneAhead = false;
+            for (size_t LaneIndex = 0; LaneIndex <= static_cast<size_t>(PRIORITY); ++LaneIndex)
+            {
+                IsAnyoneAhead = IsAnyoneAhead || !m_Lanes[LaneIndex].Waiters.empty();
+            }
+
+            auto& WaitLane = m_Lanes[static_cast<size_t>(PRIORITY)];
+            if (!IsAnyoneAhead && CanPay(TOKENS, NOW))
+            {
+                Pay(TOKENS);
+                WaitLane.pWaitHistogram->Observe(0.0);
+                return pplx::task_from_result();
+            }
+
+            WaitLane.Waiters.push_back({pplx::task_completion_event<void>(), TOKENS, NOW});
+            WaitLane.pWaitingGauge->Add(1);
+            ScheduleDrain(NOW);
+            return pplx::create_task(WaitLane.Waiters.back().Granted);
+        }
+
+        /// @brief  Stop paying for calls for a while (the API refused one for exceeding the quota)
+        void Pause(const std::chrono::milliseconds DURATION)
+        {
+            std::lock_guard<std::mutex> Lock(m_Mutex);
+            const auto                  NOW = std::chrono::steady_clock::now();
+            m_PausedUntil                   = std::max(m_PausedUntil, NOW + DURATION);
+            Log::Warning("openai", "Pausing calls after the API rate limited one", {{"class", m_Class}, {"pause_ms", std::to_string(DURATION.count())}});
+        }
+
+    private:
+        /// @brief  A budget: a bucket that refills at a rate and holds a tenth of a minute's worth
+        struct Bucket
+        {
+            double Level         = 0.0;
+            double RatePerSecond = 0.0;
+            double Capacity      = 0.0;
+            bool   IsLevelUnset  = true;
+
+            void SetRate(const double PER_MINUTE)
+            {
+                RatePerSecond = PER_MINUTE / 60.0;
+                Capacity      = std::max(PER_MINUTE / 10.0, 1.0);
+                Level         = IsLevelUnset ? Capacity : std::min(Level, Capacity);
+                IsLevelUnset  = false;
+            }
+
+            bool IsUnlimited() const
+            {
+                return RatePerSecond <= 0.0;
+            }
+
+            /// @brief  The level the bucket must have for a cost to be paid (a cost larger than the bucket is paid from a full one)
+            double GetRequiredLevel(const double COST) const
+            {
+                return std::min(COST, Capacity);
+            }
+        };
+
+        /// @brief  A call waiting for the budget
+        struct Waiter
+        {
+            pplx::task_completion_event<void>     Granted;
+            double                                Tokens = 0.0;
+            std::chrono::steady_clock::time_point Since;
+        };
+
+        /// @brief  The waiting calls of a priority, in order
+        struct Lane
+        {
+            std::deque<Waiter>  Waiters;
+            Metrics::Gauge*     pWaitingGauge  = nullptr;
+            Metrics::Histogram* pWaitHistogram = nullptr;
+        };
+
+        /// @brief  Add what the buckets earned since the last refill. Called with the mutex held
+        void Refill(const std::chrono::steady_clock::time_point NOW)
+        {
+            const double SECONDS = std::chrono::duration<double>(NOW - m_LastRefill).count();
+            m_LastRefill         = NOW;
+            for (auto* pBucket : {&m_Requests, &m_Tokens})
+            {
+                pBucket->Level = std::min(pBucket->Capacity, pBucket->Level + SECONDS * pBucket->RatePerSecond);
+            }
+        }
+
+        /// @brief  Whether the buckets can pay for a call now. Called with the mutex held
+        bool CanPay(const double TOKENS, const std::chrono::steady_clock::time_point NOW) const
+        {
+            return NOW >= m_PausedUntil && (m_Requests.IsUnlimited() || m_Requests.Level >= m_Requests.GetRequiredLevel(1.0)) &&
+                   (m_Tokens.IsUnlimited() || m_Tokens.Level >= m_Tokens.GetRequiredLevel(TOKENS));
+        }
+
+        /// @brief  Pay for a call. Called with the mutex held
+        void Pay(const double TOKENS)
+        {
+            m_Requests.Level -= m_Requests.IsUnlimited() ? 0.0 : 1.0;
+            m_Tokens.Level   -= m_Tokens.IsUnlimited() ? 0.0 : TOKENS;
+        }
+
+        /// @brief  Get when the buckets can pay for a call. Called with the mutex held, after a refill
+        std::chrono::steady_clock::time_point GetPayableTime(const double TOKENS, const std::chrono::steady_clock::time_point NOW) const
+        {
+            double WaitSeconds = 0.0;
+            for (const auto& [pBucket, COST] : {std::pair {&m_Requests, 1.0}, std::pair {&m_Tokens, TOKENS}})
+            {
+                if (!pBucket->IsUnlimited())
+                {
+                    WaitSeconds = std::max(WaitSeconds, (pBucket->GetRequiredLevel(COST) - pBucket->Level) / pBucket->RatePerSecond);
+                }
+            }
+            const auto PAYABLE = NOW + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(WaitSeconds));
+            return std::max(PAYABLE, m_PausedUntil);
+        }
+
+        /// @brief  Get the first waiting call: the longest waiting interactive one, else background one. Called with the mutex held
+        Lane* GetFirstLane()
+        {
+            for (auto& WaitLane : m_Lanes)
+            {
+                if (!WaitLane.Waiters.empty())
+                {
+                    return &WaitLane;
+                }
+            }
+            return nullptr;
+        }
+
+        /// @brief  Have Drain run when the first waiting call can be paid for. Called with the mutex held
+        void ScheduleDrain(const std::chrono::steady_clock::time_point NOW)
+        {
+            const auto* pLane = GetFirstLane();
+            if (pLane == nullptr)
+            {
+                return;
+            }
+
+            // An earlier drain that is already scheduled covers this one
+            const auto DUE = GetPayableTime(pLane->Waiters.front().Tokens, NOW);
+            if (m_DrainDue && *m_DrainDue <= DUE)
+            {
+                return;
+            }
+            m_DrainDue = DUE;
+            GetTimers().ScheduleAt(DUE, [this] { Drain(); });
+        }
+
+        /// @brief  Let the waiting calls the buckets can pay for go, in order
+        void Drain()
+        {
+            std::vector<pplx::task_completion_event<void>> Granted;
+            {
+                std::lock_guard<std::mutex> Lock(m_Mutex);
+                const auto                  NOW = std::chrono::steady_clock::now();
+                Refill(NOW);
+                m_DrainDue.reset();
+
+                for (auto* pLane = GetFirstLane(); pLane != nullptr && CanPay(pLane->Waiters.front().Tokens, NOW); pLane = GetFirstLane())
+                {
+                    auto& FirstWaiter = pLane->Waiters.front();
+                    Pay(FirstWaiter.Tokens);
+                    pLane->pWaitHistogram->Observe(std::chrono::duration<double>(NOW - FirstWaiter.Since).count());
+                    pLane->pWaitingGauge->Add(-1);
+                    Granted.push_back(FirstWaiter.Granted);
+                    pLane->Waiters.pop_front();
+                }
+                ScheduleDrain(NOW);
+            }
+
+            for (const auto& Event : Granted)
+            {
+                Event.set();
+            }
+        }
+
+        std::string                                          m_Class;
+        Bucket                                               m_Requests;
+        Bucket                                               m_Tokens;
+        std::chrono::steady_clock::time_point                m_LastRefill;
+        std::chrono::steady_clock::time_point                m_PausedUntil;
+        std::optional<std::chrono::steady_clock::time_point> m_DrainDue;
+        std::array<Lane, 2>                                  m_Lanes;
+        std::mutex                                           m_Mutex;
+    };
+
+    /// @brief  Get the rate limiter of an endpoint class
+    RateLimiter& GetRateLimiter(const EEndpointClass CLASS)
+    {
+        // Never destroyed: the timers may still drain them while the process exits
+        static auto* pLimiters = []
+        {
+            auto* pNewLimiters = new std::array<RateLimiter, 4> {RateLimiter(GetClassName(EEndpointClass::Assistants)), RateLimiter(GetClassName(EEndpointClass::Chat)),
+                                                                 RateLimiter(GetClassName(EEndpointClass::Embeddings)), RateLimiter(GetClassName(EEndpointClass::Audio))};
+            const RateLimitOptions DEFAULT_OPTIONS;
+            (*pNewLimiters)[static_cast<size_t>(EEndpointClass::Assistants)].SetBudget(DEFAULT_OPTIONS.Assistants);
+            (*pNewLimiters)[static_cast<size_t>(EEndpointClass::Chat)].SetBudget(DEFAULT_OPTIONS.Chat);
+            (*pNewLimiters)[static_cast<size_t>(EEndpointClass::Embeddings)].SetBudget(DEFAULT_OPTIONS.Embeddings);
+            (*pNewLimiters)[static_cast<size_t>(EEndpointClass::Audio)].SetBudget(DEFAULT_OPTIONS.Audio);
+            return pNewLimiters;
+        }();
+        return (*pLimiters)[static_cast<size_t>(CLASS)];
+    }
+
+    /// @brief  Estimate the tokens of a request body (about four characters each)
+    double EstimateTokens(const web::json::value& Body)
+    {
+        return static_cast<double>(Body.serialize().size()) / 4.0;
+    }
+
+    /// @brief  A call in progress, across its attempts
+    struct Call
+    {
+        std::string                                     Operation;
+        bool                                            IsIdempotent = false;
+        EEndpointClass                                  Class        = EEndpointClass::Assistants;
+        EPriority                                       Priority     = EPriority::Interactive;
+        double                                          Tokens       = 0.0;
+        std::function<pplx::task<web::http::http_request>()> CreateRequest;
+        std::shared_ptr<web::http::client::http_client> pHttpClient;
+        std::shared_ptr<Tracing::Trace>                 pTrace;
+        Tracing::SpanID                                 ParentSpanID = 0;
+        RetryOptions                                    Options;
+        size_t                                          RetryCount = 0;
+    };
+
+    /// @brief  Whether a status may pass if the call is sent again
+    bool IsTransientStatus(const web::http::status_code STATUS)
+    {
+        return STATUS == web::http::status_codes::RequestTimeout || STATUS == web::http::status_codes::TooManyRequests ||
+               (STATUS >= 500 && STATUS != web::http::status_codes::NotImplemented);
+    }
+
+    /// @brief  Get the delay the API asked for (retry-after-ms, or Retry-After in seconds), if any
+    std::optional<std::chrono::milliseconds> GetRetryAfter(const web::http::http_headers& Headers)
+    {
+        try
+        {
+            if (const auto HEADER = Headers.find(U("retry-after-ms")); HEADER != Headers.end())
+            {
+                return std::chrono::milliseconds(static_cast<int64_t>(std::stod(HEADER->second)));
+            }
+            if (const auto HEADER = Headers.find(U("Retry-After")); HEADER != Headers.end())
+            {
+                return std::chrono::milliseconds(static_cast<int64_t>(std::stod(HEADER->second) * 1000.0));
+            }
+        }
+        catch (const std::exception&)
+        {
+            // An HTTP date or garbage: fall back to the backoff
+        }
+        return std::nullopt;
+    }
+
+    /// @brief  Get the backoff before a retry: random up to the doubled initial backoff, capped (full jitter)
+    std::chrono::milliseconds GetBackoff(const RetryOptions& Options, const size_t RETRY_COUNT)
+    {
+        thread_local std::mt19937_64 RandomGenerator(std::random_device {}());
+
+        const auto CEILING = std::min<int64_t>(Options.MaxBackoff.count(), Options.InitialBackoff.count() << std::min<size_t>(RETRY_COUNT, 20));
+        return std::chrono::milliseconds(std::uniform_int_distribution<int64_t>(0, std::max<int64_t>(CEILING, 0))(RandomGenerator));
+    }
+
+    /// @brief  Get the message and code of an error response of the API ({"error": {"message", "code"}}), or the body itself
+    std::pair<std::string, std::string> ParseError(const std::string& Body)
+    {
+        try
+        {
+            const auto JBODY = web::json::value::parse(Body);
+            if (JBODY.has_object_field("error"))
+            {
+                const auto& JERROR = JBODY.at("error");
+                return {JERROR.has_string_field("message") ? JERROR.at("message").as_string() : Body, JERROR.has_string_field("code") ? JERROR.at("code").as_string() : ""};
+            }
+        }
+        catch (const std::exception&)
+        {
+            // Not JSON
+        }
+        return {Body, ""};
+    }
+
+    /// @brief  A multipart/form-data body, built once for all the attempts of an upload
+    struct MultipartBody
+    {
+        /// @brief  The boundary of the parts, and the content type that announces it
+        static constexpr std::string_view BOUNDARY     = "----CppRestSdkFormBoundary";
+        static constexpr std::string_view CONTENT_TYPE = "multipart/form-data; boundary=----CppRestSdkFormBoundary";
+
+        /// @brief  Bodies up to this size are kept in memory; larger ones are written to a temporary file
+        static constexpr size_t MEMORY_LIMIT = 8 * 1024 * 1024;
+
+        /// @brief  The body, if in memory
+        std::vector<unsigned char> Data;
+
+        /// @brief  The temporary file of the body, if on disk. Removed with the body
+        std::string FilePath;
+
+        /// @brief  The size of the body in bytes
+        size_t Size = 0;
+
+        MultipartBody() = default;
+
+        MultipartBody(const MultipartBody&)            = delete;
+        MultipartBody& operator=(const MultipartBody&) = delete;
+
+        ~MultipartBody()
+        {
+            if (!FilePath.empty())
+            {
+                std::error_code Error;
+                std::filesystem::remove(FilePath, Error);
+            }
+        }
+    };
+
+    /// @brief  Build a multipart/form-data body of fields and a file
+    /// @throw  APIError If the file can't be read or the temporary file can't be written
+    std::shared_ptr<MultipartBody> BuildMultipartBody(const std::string& Operation, const std::vector<std::pair<std::string, std::string>>& Fields,
+                                                      const std::string& FileName, const std::string& MimeType, const FilePayload& Payload)
+    {
+        std::string Head;
+        for (const auto& [Name, Value] : Fields)
+        {
+            Head += "--" + std::string(MultipartBody::BOUNDARY) + "\r\n";
+            Head += "Content-Disposition: form-data; name=\"" + Name + "\"\r\n\r\n";
+            Head += Value + "\r\n";
+        }
+        Head += "--" + std::string(MultipartBody::BOUNDARY) + "\r\n";
+        Head += "Content-Disposition: form-data; name=\"file\"; filename=\"" + FileName + "\"\r\n";
+        Head += "Content-Type: " + MimeType + "\r\n\r\n";
+        const std::string TAIL = "\r\n--" + std::string(MultipartBody::BOUNDARY) + "--";
+
+        auto       pBody         = std::make_shared<MultipartBody>();
+        const auto ESTIMATE_SIZE = Head.size() + Payload.GetSize() + TAIL.size();
+        try
+        {
+            // The parts are written as they are read, so the file is never held whole in memory besides the body
+            std::function<void(const unsigned char*, const size_t)> Write;
+            std::ofstream                                          BodyFile;
+            if (ESTIMATE_SIZE <= MultipartBody::MEMORY_LIMIT)
+            {
+                pBody->Data.reserve(ESTIMATE_SIZE);
+                Write = [&pBody](const unsigned char* pData, const size_t SIZE) { pBody->Data.insert(pBody->Data.end(), pData, pData + SIZE); };
+            }
+            else
+            {
+                pBody->FilePath = (std::filesystem::temp_directory_path() / ("orion-upload-" + static_cast<std::string>(GUID::Generate()))).string();
+                BodyFile.open(pBody->FilePath, std::ios::binary | std::ios::trunc);
+                Write = [&BodyFile](const unsigned char* pData, const size_t SIZE) { BodyFile.write(reinterpret_cast<const char*>(pData), static_cast<std::streamsize>(SIZE)); };
+            }
+
+            const auto WriteCounted = [&Write, &pBody](const unsigned char* pData, const size_t SIZE)
+            {
+                Write(pData, SIZE);
+                pBody->Size += SIZE;
+            };
+            WriteCounted(reinterpret_cast<const unsigned char*>(Head.data()), Head.size());
+            Payload.Read(WriteCounted);
+            WriteCounted(reinterpret_cast<const unsigned char*>(TAIL.data()), TAIL.size());
+
+            if (!pBody->FilePath.empty() && !BodyFile.flush())
+            {
+                throw std::runtime_error("Failed to write the temporary file " + pBody->FilePath);
+            }
+        }
+        catch (const std::exception& Exception)
+        {
+            throw APIError(Operation, 0, Exception.what());
+        }
+        return pBody;
+    }
+
+    /// @brief  Create a request with the headers every operation needs
+    web::http::http_request BuildRequest(const std::string& APIKey, const web::http::method& Method, const std::string& Path)
+    {
+        web::http::http_request Request(Method);
+        Request.set_request_uri(Path);
+        Request.headers().add("Authorization", "Bearer " + APIKey);
+        Request.headers().add("OpenAI-Beta", "assistants=v2");
+        return Request;
+    }
+
+    pplx::task<web::http::http_response> Attempt(const std::shared_ptr<Call>& pCall);
+    pplx::task<web::http::http_response> SendAttempt(const std::shared_ptr<Call>& pCall);
+
+    /// @brief  Send a failed call again after a delay, or fail it with its error
+    pplx::task<web::http::http_response> RetryOrFail(const std::shared_ptr<Call>& pCall, const bool IS_RETRYABLE, const std::optional<std::chrono::milliseconds> RETRY_AFTER,
+                                                     const APIError& Error)
+    {
+        if (!IS_RETRYABLE || pCall->RetryCount >= pCall->Options.MaxRetries || (RETRY_AFTER && *RETRY_AFTER > pCall->Options.MaxRetryAfter))
+        {
+            return pplx::task_from_exception<web::http::http_response>(Error);
+        }
+
+        const auto DELAY = RETRY_AFTER ? *RETRY_AFTER : GetBackoff(pCall->Options, pCall->RetryCount);
+        ++pCall->RetryCount;
+
+        Metrics::Registry::Get().GetCounter("orion_openai_retries_total", "Retried attempts of OpenAI API calls", {{"operation", pCall->Operation}}).Increment();
+        Log::Warning("openai", "Retrying a failed call",
+                     {{"operation", pCall->Operation},
+                      {"retry", std::to_string(pCall->RetryCount)},
+                      {"status", std::to_string(Error.GetStatus())},
+                      {"delay_ms", std::to_string(DELAY.count())},
+                      {"error", Error.what()}});
+
+        return Delay(DELAY).then([pCall]() { return Attempt(pCall); });
+    }
+
+    /// @brief  Pay for one attempt of a call from the budget of its class, then send it
+    pplx::task<web::http::http_response> Attempt(const std::shared_ptr<Call>& pCall)
+    {
+        auto PaidTask = GetRateLimiter(pCall->Class).Acquire(pCall->Priority, pCall->Tokens);
+        if (PaidTask.is_done())
+        {
+            // Within the budget: send it right away instead of from a continuation
+            return SendAttempt(pCall);
+        }
+        return PaidTask.then([pCall]() { return SendAttempt(pCall); });
+    }
+
+    /// @brief  Send one attempt of a call, and retry or fail it if it doesn't succeed
+    pplx::task<web::http::http_response> SendAttempt(const std::shared_ptr<Call>& pCall)
+    {
+        if (!CircuitBreaker::Get().Allow())
+        {
+            Metrics::Registry::Get()
+                .GetCounter("orion_openai_circuit_rejections_total", "OpenAI API calls refused because the circuit breaker is open", {{"operation", pCall->Operation}})
+                .Increment();
+            return pplx::task_from_exception<web::http::http_response>(APIError(pCall->Operation, 0, "The OpenAI API is failing, calls are paused (circuit breaker open)"));
+        }
+
+        // Retries run on the timer and pool threads, so the message's trace is made active again for the request to be traced
+        const auto SendRequest = [pCall](const web::http::http_request& Request)
+        {
+            Tracing::TraceScope Scope(pCall->pTrace, pCall->ParentSpanID);
+            return pCall->pHttpClient->request(Request);
+        };
+
+        // Most requests are ready right away; one with a body streamed from a file is sent once the file is open
+        pplx::task<web::http::http_response> ResponseTask;
+        try
+        {
+            auto RequestTask = pCall->CreateRequest();
+            ResponseTask     = RequestTask.is_done() ? SendRequest(RequestTask.get()) : RequestTask.then(SendRequest);
+        }
+        catch (const std::exception&)
+        {
+            // A request that can't be built (its body file can't be opened) fails the attempt below, so the breaker records it
+            ResponseTask = pplx::task_from_exception<web::http::http_response>(std::current_exception());
+        }
+
+        return ResponseTask
+            .then(
+                [pCall](pplx::task<web::http::http_response> ResponseTask)
+                {
+                    web::http::http_response Response;
+                    try
+                    {
+                        Response = ResponseTask.get();
+                    }
+                    catch (const std::exception& Exception)
+                    {
+                        // Without a response it is unknown whether the API processed the request
+                        CircuitBreaker::Get().RecordFailure(pCall->Options);
+                        return RetryOrFail(pCall, pCall->IsIdempotent, std::nullopt, APIError(pCall->Operation, 0, Exception.what()));
+                    }
+
+                    const auto STATUS = Response.status_code();
+                    if (STATUS >= 500)
+                    {
+                        CircuitBreaker::Get().RecordFailure(pCall->Options);
+                    }
+                    else
+                    {
+                        CircuitBreaker::Get().RecordSuccess();
+                    }
+
+                    if (STATUS >= 200 && STATUS < 300)
+                    {
+                        return pplx::task_from_result(Response);
+                    }
+
+                    // The error body is read to report it, and to tell a 429 that passes (rate limit) from one that doesn't (exhausted quota)
+                    return Response.extract_string(true).then(
+                        [pCall, Response, STATUS](pplx::task<std::string> BodyTask)
+                        {
+                            std::string Body;
+                            try
+                            {
+                                Body = BodyTask.get();
+                            }
+                            catch (const std::exception&)
+                            {
+                                // Report the status alone
+                            }
+
+                            const auto [MESSAGE, CODE] = ParseError(Body);
+                            const auto RETRY_AFTER     = GetRetryAfter(Response.headers());
+
+                            // The budget was overspent (by other processes sharing the quota, or a wrong estimate): hold back the whole class
+                            if (STATUS == web::http::status_codes::TooManyRequests && CODE != "insufficient_quota")
+                            {
+                                GetRateLimiter(pCall->Class).Pause(std::min(RETRY_AFTER.value_or(std::chrono::seconds(1)), pCall->Options.MaxRetryAfter));
+                            }
+
+                            // A 429 means the API refused the request without processing it, so it is safe to send again even if not idempotent
+                            const bool IS_RETRYABLE = IsTransientStatus(STATUS) && CODE != "insufficient_quota" &&
+                                                      (pCall->IsIdempotent || STATUS == web::http::status_codes::TooManyRequests);
+                            return RetryOrFail(pCall, IS_RETRYABLE, RETRY_AFTER, APIError(pCall->Operation, STATUS, MESSAGE));
+                        });
+                });
+    }
+} // namespace
+
+void OpenAI::Configure(const RetryOptions& Options)
+{
+    std::lock_guard<std::mutex> Lock(g_OptionsMutex);
+    g_Options = Options;
+}
+
+void OpenAI::Configure(const RateLimitOptions& Options)
+{
+    GetRateLimiter(EEndpointClass::Assistants).SetBudget(Options.Assistants);
+    GetRateLimiter(EEndpointClass::Chat).SetBudget(Options.Chat);
+    GetRateLimiter(EEndpointClass::Embeddings).SetBudget(Options.Embeddings);
+    GetRateLimiter(EEndpointClass::Audio).SetBudget(Options.Audio);
+}
+
+APIError::APIError(std::string Operation, const web::http::status_code STATUS, const std::string& Message)
+    : std::runtime_error(Operation + " failed" + (STATUS != 0 ? " (" + std::to_string(STATUS) + ")" : std::string()) + ": " + Message),
+      m_Operation(std::move(Operation)),
+      m_Status(STATUS)
+{
+}
+
+FilePayload FilePayload::FromMemory(std::vector<unsigned char> Data)
+{
+    FilePayload Payload;
+    Payload.m_pData = std::make_shared<const std::vector<unsigned char>>(std::move(Data));
+    return Payload;
+}
+
+FilePayload FilePayload::FromBase64(const std::string_view Base64, std::shared_ptr<const void> pOwner)
+{
+    FilePayload Payload;
+    Payload.m_Base64 = Base64;
+    Payload.m_pOwner = std::move(pOwner);
+    return Payload;
+}
+
+FilePayload FilePayload::FromFile(std::string Path, std::shared_ptr<const void> pOwner)
+{
+    FilePayload Payload;
+    Payload.m_Path   = std::move(Path);
+    Payload.m_pOwner = std::move(pOwner);
+    return Payload;
+}
+
+size_t FilePayload::GetSize() const
+{
+    if (m_pData)
+    {
+        return m_pData->size();
+    }
+    if (!m_Path.empty())
+    {
+        std::error_code Error;
+        const auto      SIZE = std::filesystem::file_size(m_Path, Error);
+        return Error ? 0 : static_cast<size_t>(SIZE);
+    }
+
+    // Three bytes per four characters, less the padding
+    const size_t PADDING = m_Base64.size() >= 2 ? std::count(m_Base64.end() - 2, m_Base64.end(), '=') : 0;
+    return m_Base64.size() / 4 * 3 - PADDING;
+}
+
+void FilePayload::Read(const std::function<void(const unsigned char* pData, const size_t SIZE)>& Sink) const
+{
+    if (m_pData)
+    {
+        Sink(m_pData->data(), m_pData->size());
+        return;
+    }
+
+    if (!m_Path.empty())
+    {
+        std::ifstream File(m_Path, std::ios::binary);
+        if (!File)
+        {
+            throw std::runtime_error("Failed to open " + m_Path);
+        }
+
+        std::vector<char> Chunk(64 * 1024);
+        while (File.read(Chunk.data(), static_cast<std::streamsize>(Chunk.size())) || File.gcount() > 0)
+        {
+            Sink(reinterpret_cast<const unsigned char*>(Chunk.data()), static_cast<size_t>(File.gcount()));
+        }
+        if (File.bad())
+        {
+            throw std::runtime_error("Failed to read " + m_Path);
+        }
+        return;
+    }
+
+    // Decoded a chunk at a time. Chunks are a multiple of four characters, so each decodes on its own (from_base64 throws if invalid)
+    constexpr size_t CHUNK_CHARS = 64 * 1024;
+    for (size_t Offset = 0; Offset < m_Base64.size(); Offset += CHUNK_CHARS)
+    {
+        const auto CHUNK = utility::conversions::from_base64(utility::string_t(m_Base64.substr(Offset, CHUNK_CHARS)));
+        Sink(CHUNK.data(), CHUNK.size());
+    }
+}
+
+Client::Client(std::string APIKey)
+    : m_APIKey(std::move(APIKey)),
+      m_pHttpClient(Upstream::GetOpenAIClient())
+{
+}
+
+pplx::task<web::json::value> Client::ListAssistants() const
+{
+    return SendForJson({"list_assistants", true, EEndpointClass::Assistants, EPriority::Interactive}, CreateRequest(web::http::methods::GET, "assistants"));
+}
+
+pplx::task<web::json::value> Client::CreateAssistant(const web::json::value& Body) const
+{
+    return SendForJson({"create_assistant", false, EEndpointClass::Assistants, EPriority::Interactive}, CreateJsonRequest(web::http::methods::POST, "assistants", Body));
+}
+
+pplx::task<web::json::value> Client::UpdateAssistant(const std::string& AssistantID, const web::json::value& Body) const
+{
+    return SendForJson({"update_assistant", true, EEndpointClass::Assistants, EPriority::Interactive},
+                       CreateJsonRequest(web::http::methods::POST, "assistants/" + AssistantID, Body));
+}
+
+pplx::task<web::json::value> Client::CreateThread() const
+{
+    // A thread created twice leaves an empty thread behind, which is harmless; an instance without a thread is not
+    return SendForJson({"create_thread", true, EEndpointClass::Assistants, EPriority::Interactive},
+                       CreateJsonRequest(web::http::methods::POST, "threads", web::json::value::object()));
+}
+
+pplx::task<web::json::value> Client::CreateMessage(const std::string& ThreadID, const web::json::value& Body) const
+{
+    return SendForJson({"create_message", false, EEndpointClass::Assistants, EPriority::Interactive},
+                       CreateJsonRequest(web::http::methods::POST, "threads/" + ThreadID + "/messages", Body));
+}
+
+pplx::task<web::json::value> Client::ListMessages(const std::string& ThreadID, const size_t LIMIT, const std::string& Order) const
+{
+    web::uri_builder ListMessagesURIBuilder;
+    ListMessagesURIBuilder.append_path("threads/" + ThreadID + "/messages");
+    ListMessagesURIBuilder.append_query("limit", LIMIT);
+    ListMessagesURIBuilder.append_query("order", Order);
+
+    return SendForJson({"list_messages", true, EEndpointClass::Assistants, EPriority::Interactive}, CreateRequest(web::http::methods::GET, ListMessagesURIBuilder.to_string()));
+}
+
+pplx::task<web::http::http_response> Client::CreateRunStream(const std::string& ThreadID, web::json::value Body) const
+{
+    Body["stream"] = web::json::value::boolean(true);
+    return Send({"create_run", false, EEndpointClass::Assistants, EPriority::Interactive}, CreateJsonRequest(web::http::methods::POST, "threads/" + ThreadID + "/runs", Body));
+}
+
+pplx::task<web::http::http_response> Client::SubmitToolOutputsStream(const std::string& ThreadID, const std::string& RunID, const web::json::value& ToolOutputs) const
+{
+    auto Body            = web::json::value::object();
+    Body["tool_outputs"] = ToolOutputs;
+    Body["stream"]       = web::json::value::boolean(true);
+    return Send({"submit_tool_outputs", false, EEndpointClass::Assistants, EPriority::Interactive},
+                CreateJsonRequest(web::http::methods::POST, "threads/" + ThreadID + "/runs/" + RunID + "/submit_tool_outputs", Body));
+}
+
+pplx::task<web::json::value> Client::CancelRun(const std::string& ThreadID, const std::string& RunID) const
+{
+    return SendForJson({"cancel_run", true, EEndpointClass::Assistants, EPriority::Interactive},
+                       CreateRequest(web::http::methods::POST, "threads/" + ThreadID + "/runs/" + RunID + "/cancel"));
+}
+
+pplx::task<web::json::value> Client::UploadFile(const std::string& FileName, const std::string& MimeType, FilePayload Payload, const std::string& Purpose) const
+{
+    return SendMultipart({"upload_file", false, EEndpointClass::Assistants, EPriority::Interactive}, "files", {{"purpose", Purpose}}, FileName, MimeType, std::move(Payload));
+}
+
+pplx::task<web::json::value> Client::GetFile(const std::string& FileID) const
+{
+    return SendForJson({"get_file", true, EEndpointClass::Assistants, EPriority::Interactive}, CreateRequest(web::http::methods::GET, "files/" + FileID));
+}
+
+pplx::task<web::http::http_response> Client::GetFileContent(const std::string& FileID) const
+{
+    return Send({"get_file_content", true, EEndpointClass::Assistants, EPriority::Interactive}, CreateRequest(web::http::methods::GET, "files/" + FileID + "/content"));
+}
+
+pplx::task<web::json::value> Client::CreateEmbeddings(const web::json::value& Body) const
+{
+    return SendForJson({"create_embeddings", true, EEndpointClass::Embeddings, EPriority::Background}, CreateJsonRequest(web::http::methods::POST, "embeddings", Body),
+                       EstimateTokens(Body));
+}
+
+pplx::task<web::json::value> Client::CreateChatCompletion(const web::json::value& Body) const
+{
+    return SendForJson({"create_chat_completion", true, EEndpointClass::Chat, EPriority::Interactive}, CreateJsonRequest(web::http::methods::POST, "chat/completions", Body),
+                       EstimateTokens(Body) + (Body.has_number_field("max_tokens") ? Body.at("max_tokens").as_double() : 0.0));
+}
+
+pplx::task<web::http::http_response> Client::CreateSpeech(const web::json::value& Body) const
+{
+    return Send({"create_speech", true, EEndpointClass::Audio, EPriority::Background}, CreateJsonRequest(web::http::methods::POST, "audio/speech", Body));
+}
+
+pplx::task<web::json::value> Client::CreateTranscription(const std::string& FileName, const std::string& MimeType, FilePayload Payload, const std::string& Model) const
+{
+    return SendMultipart({"create_transcription", true, EEndpointClass::Audio, EPriority::Interactive}, "audio/transcriptions", {{"model", Model}}, FileName, MimeType,
+                         std::move(Payload));
+}
+
+Client::RequestFactory Client::CreateRequest(const web::http::method& Method, const std::string& Path) const
+{
+    return [APIKey = m_APIKey, Method, Path] { return pplx::task_from_result(BuildRequest(APIKey, Method, Path)); };
+}
+
+Client::RequestFactory Client::CreateJsonRequest(const web::http::method& Method, const std::string& Path, const web::json::value& Body) const
+{
+    return [APIKey = m_APIKey, Method, Path, Body]
+    {
+        auto Request = BuildRequest(APIKey, Method, Path);
+        Request.set_body(Body);
+        return pplx::task_from_result(Request);
+    };
+}
+
+pplx::task<web::json::value> Client::SendMultipart(const Operation& OPERATION, const std::string& Path, const std::vector<std::pair<std::string, std::string>>& Fields,
+                                                   const std::string& FileName, const std::string& MimeType, FilePayload Payload) const
+{
+    // Building a large body writes it to disk, so it is built on the pool rather than on the calling thread
+    return pplx::create_task([OPERATION_NAME = std::string(OPERATION.Name), Fields, FileName, MimeType, Payload = std::move(Payload)]
+                             { return BuildMultipartBody(OPERATION_NAME, Fields, FileName, MimeType, Payload); })
+        .then(
+            [Self = *this, OPERATION, Path, pTrace = Tracing::TraceScope::GetCurrentTrace(), PARENT_SPAN_ID = Tracing::TraceScope::GetCurrentSpanID()](
+                const std::shared_ptr<MultipartBody>& pBody)
+            {
+                Tracing::TraceScope Scope(pTrace, PARENT_SPAN_ID);
+                return Self.SendForJson(OPERATION,
+                                        [APIKey = Self.m_APIKey, Path, pBody]
+                                        {
+                                            auto Request = BuildRequest(APIKey, web::http::methods::POST, Path);
+                                            if (pBody->FilePath.empty())
+                                            {
+                                                // Read in place: the body outlives the call, which holds the factory
+                                                Request.set_body(concurrency::streams::rawptr_buffer<uint8_t>(pBody->Data.data(), pBody->Data.size()).create_istream(),
+                                                                 pBody->Data.size(), std::string(MultipartBody::CONTENT_TYPE));
+                                                return pplx::task_from_result(Request);
+                                            }
+
+                                            return concurrency::streams::fstream::open_istream(pBody->FilePath, std::ios::in | std::ios::binary)
+                                                .then(
+                                                    [Request, pBody](const concurrency::streams::istream& BodyStream) mutable
+                                                    {
+                                                        Request.set_body(BodyStream, pBody->Size, std::string(MultipartBody::CONTENT_TYPE));
+                                                        return Request;
+                                                    });
+                                        });
+            });
+}
+
+pplx::task<web::http::http_response> Client::Send(const Operation& OPERATION, RequestFactory CreateAttemptRequest, const double TOKENS) const
+{
+    auto pCall           = std::make_shared<Call>();
+    pCall->Operation     = OPERATION.Name;
+    pCall->IsIdempotent  = OPERATION.IsIdempotent;
+    pCall->Class         = OPERATION.Class;
+    pCall->Priority      = OPERATION.Priority;
+    pCall->Tokens        = TOKENS;
+    pCall->CreateRequest = std::move(CreateAttemptRequest);
+    pCall->pHttpClient   = m_pHttpClient;
+    pCall->pTrace        = Tracing::TraceScope::GetCurrentTrace();
+    pCall->ParentSpanID  = Tracing::TraceScope::GetCurrentSpanID();
+    pCall->Options       = GetOptions();
+
+    return Attempt(pCall).then(
+        [pCall, START = std::chrono::steady_clock::now()](pplx::task<web::http::http_response> CallTask)
+        {
+            const auto RecordCall = [&pCall, START](const std::string& Outcome)
+            {
+                auto& Registry = Metrics::Registry::Get();
+                Registry
+                    .GetHistogram("orion_openai_call_duration_seconds", "Time of OpenAI API calls including their retries (streamed ones until their headers)",
+                                  {{"operation", pCall->Operation}})
+                    .Observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - START).count());
+                Registry.GetCounter("orion_openai_calls_total", "OpenAI API calls by outcome (ok, or error once the retries are used up)",
+                                    {{"operation", pCall->Operation}, {"outcome", Outcome}})
+                    .Increment();
+            };
+
+            try
+            {
+                auto Response = CallTask.get();
+                RecordCall("ok");
+                return Response;
+            }
+            catch (...)
+            {
+                RecordCall("error");
+                throw;
+            }
+        });
+}
+
+pplx::task<web::json::value> Client::SendForJson(const Operation& OPERATION, RequestFactory CreateAttemptRequest, const double TOKENS) const
+{
+    return Send(OPERATION, std::move(CreateAttemptRequest), TOKENS).then([](const web::http::http_response& Response) { return Response.extract_json(true); });
+}
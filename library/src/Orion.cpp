@@ -1,6 +1,10 @@
 #include "Orion.hpp"
+#include "Metrics.hpp"
 #include "MimeTypes.hpp"
 #include "OrionWebServer.hpp"
+#include "Tracing.hpp"
+#include "UploadCache.hpp"
+#include "Upstream.hpp"
 #include "tools/FunctionTool.hpp"
 
 // Include cpprestsdk headers
@@ -18,17 +22,43 @@
 // Include cmark headers
 #include <cmark.h>
 
+#include <openssl/evp.h>
+
 #include "GUID.hpp"
+#include "Logger.hpp"
 #include "Process.hpp"
 
 // Include standard headers
+#include <algorithm>
+#include <atomic>
 #include <dlfcn.h>
 #include <filesystem>
 #include <future>
+#include <iomanip>
+#include <optional>
+#include <sstream>
 #include <thread>
 
 using namespace ORION;
 
+namespace
+{
+    /// @brief  Hash a user id for the traces (the first 64 bits of its SHA-256). The id itself logs a user in, so it is never recorded
+    std::string HashUserID(const std::string& UserID)
+    {
+        unsigned char Digest[EVP_MAX_MD_SIZE];
+        unsigned int  DigestSize = 0;
+        EVP_Digest(UserID.data(), UserID.size(), Digest, &DigestSize, EVP_sha256(), nullptr);
+
+        std::ostringstream HashStream;
+        for (unsigned int Index = 0; Index < std::min(DigestSize, 8u); ++Index)
+        {
+            HashStream << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(Digest[Index]);
+        }
+        return HashStream.str();
+    }
+} // namespace
+
 Orion::Orion(const std::string&                         ID,
              std::vector<std::unique_ptr<IOrionTool>>&& Tools,
              const EOrionIntelligence                   INTELLIGENCE,
@@ -78,13 +108,6 @@ std::string Orion::GetUserID() const
 
 double Orion::GetSemanticSimilarity(const std::string& Content, const std::string& Query) const
 {
-    // Create a new http_request to create an embedding for the content
-    web::http::http_request VectorSearchRequest(web::http::methods::POST);
-    VectorSearchRequest.set_request_uri(U("embeddings"));
-    VectorSearchRequest.headers().add("Authorization", "Bearer " + m_OpenAIAPIKey);
-    VectorSearchRequest.headers().add("OpenAI-Beta", "assistants=v2");
-    VectorSearchRequest.headers().add("Content-Type", "application/json");
-
     // Create json array for the input
     web::json::value JInputArray    = web::json::value::array();
     JInputArray[JInputArray.size()] = web::json::value::string(Content);
@@ -94,21 +117,22 @@ double Orion::GetSemanticSimilarity(const std::string& Content, const std::strin
     VectorSearchRequestBody["input"]         = JInputArray;
     VectorSearchRequestBody["model"]         = web::json::value::string("text-embedding-3-small");
 
-    VectorSearchRequest.set_body(VectorSearchRequestBody);
-
-    // Send the request and get the response
-    const auto VECTOR_SEARCH_RESPONSE = m_OpenAIClient->request(VectorSearchRequest).get();
-
-    if (VECTOR_SEARCH_RESPONSE.status_code() != web::http::status_codes::OK)
+    // Create the embeddings
+    static auto&     EMBEDDING_DURATION = Metrics::Registry::Get().GetHistogram("orion_embedding_duration_seconds", "Time to create the embeddings of a similarity check");
+    web::json::value VectorSearchResponseJson;
+    try
+    {
+        Metrics::ScopedTimer EmbeddingTimer(EMBEDDING_DURATION);
+        VectorSearchResponseJson = m_OpenAIClient->CreateEmbeddings(VectorSearchRequestBody).get();
+    }
+    catch (const std::exception& Exception)
     {
-        std::cerr << "Failed to create an embedding for the content" << std::endl;
-        std::cout << VECTOR_SEARCH_RESPONSE.to_string() << std::endl;
+        Log::Error("orion", "Failed to create an embedding for the content", {{"error", Exception.what()}});
         return 0.0;
     }
 
     // Get the embedding
-    auto VectorSearchResponseJson = VECTOR_SEARCH_RESPONSE.extract_json().get();
-    auto JEmbeddingArray          = VectorSearchResponseJson.at("data").as_array();
+    auto JEmbeddingArray = VectorSearchResponseJson.at("data").as_array();
 
     // Calculate the similarity between the content and the query
     const auto EMBEDDING_CONTENT = JEmbeddingArray[0].at("embedding").as_array();
@@ -144,7 +168,7 @@ void Orion::LoadAPIKeys()
         }
         if (m_OpenAIAPIKey.empty())
         {
-            std::cerr << "OpenAI API key not found" << std::endl;
+            Log::Error("orion", "OpenAI API key not found");
             return;
         }
     }
@@ -163,7 +187,7 @@ void Orion::LoadAPIKeys()
         }
         if (m_OpenWeatherAPIKey.empty())
         {
-            std::cerr << "OpenWeather API key not found" << std::endl;
+            Log::Error("orion", "OpenWeather API key not found");
             return;
         }
     }
@@ -182,7 +206,7 @@ void Orion::LoadAPIKeys()
         }
         if (m_HASSAPIKey.empty())
         {
-            std::cerr << "Home Assistant API key not found" << std::endl;
+            Log::Error("orion", "Home Assistant API key not found");
             return;
         }
     }
@@ -201,7 +225,7 @@ void Orion::LoadAPIKeys()
         }
         if (m_GoogleAPIKey.empty())
         {
-            std::cerr << "Google API key not found" << std::endl;
+            Log::Error("orion", "Google API key not found");
             return;
         }
     }
@@ -220,7 +244,7 @@ void Orion::LoadAPIKeys()
         }
         if (m_GoogleCSEID.empty())
         {
-            std::cerr << "Google Custom Search Engine ID not found" << std::endl;
+            Log::Error("orion", "Google Custom Search Engine ID not found");
             return;
         }
     }
@@ -289,13 +313,13 @@ std::vector<std::unique_ptr<PluginModule>> Orion::InspectPlugins() const
 {
     std::vector<std::unique_ptr<PluginModule>> Plugins;
 
-    std::cout << "Searching for plugins in: " << OrionWebServer::AssetDirectories::ResolveBasePluginDirectory() << std::endl;
+    Log::Info("plugins", "Searching for plugins", {{"directory", OrionWebServer::AssetDirectories::ResolveBasePluginDirectory()}});
 
     // Iterate through the plugins and load the one with the matching name
     constexpr auto PLUGINS_DIR = OrionWebServer::AssetDirectories::ResolveBasePluginDirectory();
     for (const auto& Entry : std::filesystem::directory_iterator(PLUGINS_DIR))
     {
-        std::cout << "Plugin Module: " << Entry.path().filename() << std::endl;
+        Log::Debug("plugins", "Found a plugin module", {{"file", Entry.path().filename().string()}});
 
         auto PluginModule = std::make_unique<struct PluginModule>();
 
@@ -313,12 +337,6 @@ std::vector<std::unique_ptr<PluginModule>> Orion::InspectPlugins() const
 void Orion::RecalculateOrionTools()
 {
     // Update the assistant
-    web::http::http_request UpdateAssistantRequest(web::http::methods::POST);
-    UpdateAssistantRequest.set_request_uri(U("assistants/" + m_CurrentAssistantID));
-    UpdateAssistantRequest.headers().add("Authorization", "Bearer " + m_OpenAIAPIKey);
-    UpdateAssistantRequest.headers().add("OpenAI-Beta", "assistants=v2");
-    UpdateAssistantRequest.headers().add("Content-Type", "application/json");
-
     web::json::value UpdateAssistantRequestBody = web::json::value::object();
     UpdateAssistantRequestBody["description"]   = web::json::value::string(m_Description);
     UpdateAssistantRequestBody["model"]         = web::json::value::string(m_CurrentIntelligence == EOrionIntelligence::Base ? "gpt-3.5-turbo" : "gpt-4-turbo-preview");
@@ -328,7 +346,7 @@ void Orion::RecalculateOrionTools()
     {
         for (const auto& Tool : m_Tools)
         {
-            printf("Adding tool: %s\n", Tool->GetName().c_str());
+            Log::Debug("orion.tools", "Adding a tool", {{"tool", Tool->GetName()}});
             Tools[Tools.size()] = web::json::value::parse(Tool->ToJson());
         }
     }
@@ -341,7 +359,7 @@ void Orion::RecalculateOrionTools()
             const auto TOOLS = Plugin->GetPlugin()->GetTools();
             for (const auto& Tool : TOOLS)
             {
-                printf("Adding tool: %s\n", Tool->GetName().c_str());
+                Log::Debug("orion.tools", "Adding a tool", {{"tool", Tool->GetName()}});
                 Tools[Tools.size()] = web::json::value::parse(Tool->ToJson());
             }
             ToolInstructions.push_back(Plugin->GetPlugin()->GetToolInstructions().data());
@@ -354,14 +372,9 @@ void Orion::RecalculateOrionTools()
                                                     std::string(Defaults::INSTRUCTIONS),
                                                     [](const std::string& Prev, const std::string& Next) { return Prev + "\n\n" + Next; });
 
-    std::cout << "CRUDE_INSTRUCTIONS: " << std::endl << CRUDE_INSTRUCTIONS << std::endl;
+    Log::Debug("orion.assistant", "Generating the instructions", {{"crude_instructions", CRUDE_INSTRUCTIONS}});
 
     // Request gpt-3.5-turbo to generate a cohesive instruction set
-    web::http::http_request GenerateInstructionsRequest(web::http::methods::POST);
-    GenerateInstructionsRequest.set_request_uri(U("chat/completions"));
-    GenerateInstructionsRequest.headers().add("Authorization", "Bearer " + m_OpenAIAPIKey);
-    GenerateInstructionsRequest.headers().add("OpenAI-Beta", "assistants=v2");
-    GenerateInstructionsRequest.headers().add("Content-Type", "application/json");
 
     // Set the prompt
     const std::string SYSTEM_PROMPT = "You are an expert at creating optimized instruction prompts for gpt-3.5-turbo. "
@@ -387,202 +400,302 @@ void Orion::RecalculateOrionTools()
     GenerateInstructionsRequestBody["model"]         = web::json::value::string("gpt-3.5-turbo");
     GenerateInstructionsRequestBody["messages"]      = web::json::value::array({ SystemMessage, UserMessage });
 
-    // Set the body
-    GenerateInstructionsRequest.set_body(GenerateInstructionsRequestBody);
-
     // Send the request and get the response
-    const auto GENERATE_INSTRUCTIONS_RESPONSE = m_OpenAIClient->request(GenerateInstructionsRequest).get();
-    if (GENERATE_INSTRUCTIONS_RESPONSE.status_code() != web::http::status_codes::OK)
+    try
+    {
+        const auto GENERATE_INSTRUCTIONS_RESPONSE = m_OpenAIClient->CreateChatCompletion(GenerateInstructionsRequestBody).get();
+        m_Instructions                            = GENERATE_INSTRUCTIONS_RESPONSE.at("choices").as_array().at(0).at("message").at("content").as_string();
+    }
+    catch (const std::exception& Exception)
     {
-        std::cerr << "Failed to generate instructions:" << std::endl << GENERATE_INSTRUCTIONS_RESPONSE.to_string() << std::endl;
+        Log::Error("orion.assistant", "Failed to generate the instructions", {{"error", Exception.what()}});
         return;
     }
 
-    m_Instructions = GENERATE_INSTRUCTIONS_RESPONSE.extract_json().get().at("choices").as_array().at(0).at("message").at("content").as_string();
-
     UpdateAssistantRequestBody["instructions"] = web::json::value::string(m_Instructions);
     UpdateAssistantRequestBody["tools"]        = Tools;
 
-    UpdateAssistantRequest.set_body(UpdateAssistantRequestBody);
-
-    if (const web::http::http_response UPDATE_ASSISTANT_RESPONSE = m_OpenAIClient->request(UpdateAssistantRequest).get();
-        UPDATE_ASSISTANT_RESPONSE.status_code() != web::http::status_codes::OK)
+    try
+    {
+        m_OpenAIClient->UpdateAssistant(m_CurrentAssistantID, UpdateAssistantRequestBody).wait();
+    }
+    catch (const std::exception& Exception)
     {
-        std::cerr << "Failed to update the assistant:" << std::endl << UPDATE_ASSISTANT_RESPONSE.to_string() << std::endl;
+        Log::Error("orion.assistant", "Failed to update the assistant", {{"error", Exception.what()}});
     }
 }
 
-pplx::task<void> Orion::SendMessageAsync(const std::string& Message, const web::json::array& Files)
+pplx::task<void> Orion::CancelCurrentRun()
 {
-    // Cancel current assistant run
-    if (!m_CurrentAssistantRunID.empty())
+    std::string RunID;
     {
-        web::http::http_request CancelRunRequest(web::http::methods::POST);
-        CancelRunRequest.set_request_uri(U("threads/" + m_CurrentThreadID + "/runs/" + m_CurrentAssistantRunID + "/cancel"));
-        CancelRunRequest.headers().add("Authorization", "Bearer " + m_OpenAIAPIKey);
-        CancelRunRequest.headers().add("OpenAI-Beta", "assistants=v2");
-
-        if (const auto CANCEL_RUN_RESPONSE = m_OpenAIClient->request(CancelRunRequest).get(); CANCEL_RUN_RESPONSE.status_code() != web::http::status_codes::OK)
-        {
-            std::cout << __func__ << ": Failed to cancel the current assistant run.: " << CANCEL_RUN_RESPONSE.to_string() << std::endl;
-        }
-
-        m_CurrentAssistantRunID.clear();
+        std::lock_guard<std::mutex> RunLockGuard(m_CurrentAssistantRunMutex);
+        RunID.swap(m_CurrentAssistantRunID);
     }
 
-    // Upload the files
-    auto JAttachments = web::json::value::array();
-    for (const auto& File : Files)
+    if (RunID.empty())
     {
-        // Get the file name and data
-        const auto FILE_NAME = File.at("name").as_string();
-        const auto FILE_DATA = utility::conversions::from_base64(File.at("data").as_string());
-        const auto MIME_TYPE = MimeTypes::GetMimeType(FILE_NAME);
+        return pplx::task_from_result();
+    }
 
-        // Create a boundary for the multipart/form-data body
-        const std::string BOUNDARY = "----CppRestSdkFormBoundary";
+    return m_OpenAIClient->CancelRun(m_CurrentThreadID, RunID)
+        .then(
+            [RunID](pplx::task<web::json::value> CancelRunTask)
+            {
+                try
+                {
+                    CancelRunTask.wait();
+                }
+                catch (const std::exception& Exception)
+                {
+                    Log::Warning("orion", "Failed to cancel the current assistant run", {{"run_id", RunID}, {"error", Exception.what()}});
+                }
+            });
+}
 
-        // Create the multipart/form-data body
-        std::vector<unsigned char> MultiPartFormData;
+/// @brief  The uploads of the files of a message
+struct Orion::FileUploads
+{
+    /// @brief  The files. Their content is uploaded from here, without copies
+    std::shared_ptr<const std::vector<MessageFile>> pFiles;
 
-        // Helper function to append text to the vector
-        auto AppendText = [&](const std::string& Text) { MultiPartFormData.insert(MultiPartFormData.end(), Text.begin(), Text.end()); };
+    /// @brief  The attachment of each file, in the order of the files. Empty for a file that failed to upload
+    std::vector<std::optional<web::json::value>> Attachments;
 
-        // Helper function to append binary data to the vector
-        auto AppendBinary = [&](const std::vector<unsigned char>& Data) { MultiPartFormData.insert(MultiPartFormData.end(), Data.begin(), Data.end()); };
+    /// @brief  The next file to upload, and the files not uploaded yet
+    std::atomic<size_t> NextFile  = 0;
+    std::atomic<size_t> Remaining = 0;
 
-        // Create the multipart/form-data body
+    /// @brief  The trace of the message, and the span the uploads are parented to
+    std::shared_ptr<Tracing::Trace> pTrace;
+    Tracing::SpanID                 ParentSpanID = 0;
 
-        // Add the model part
-        AppendText("--" + BOUNDARY + "\r\n");
-        AppendText("Content-Disposition: form-data; name=\"purpose\"\r\n\r\n");
-        AppendText(std::string("assistants") + "\r\n");
+    /// @brief  Set once every file has been uploaded (or failed to)
+    pplx::task_completion_event<void> Completed;
+};
 
-        // Add the file part
-        AppendText("--" + BOUNDARY + "\r\n");
-        AppendText("Content-Disposition: form-data; name=\"file\"; filename=\"" + FILE_NAME + "\"\r\n");
-        AppendText("Content-Type: " + MIME_TYPE + "\r\n\r\n");
-        AppendBinary(FILE_DATA);
-        AppendText("\r\n");
+pplx::task<web::json::value> Orion::UploadFilesAsync(std::shared_ptr<const std::vector<MessageFile>> pFiles)
+{
+    if (pFiles->size() == 0)
+    {
+        return pplx::task_from_result(web::json::value::array());
+    }
 
-        // End of the multipart/form-data body
-        AppendText("--" + BOUNDARY + "--");
+    auto pUploads          = std::make_shared<FileUploads>();
+    pUploads->pFiles       = std::move(pFiles);
+    pUploads->Remaining    = pUploads->pFiles->size();
+    pUploads->pTrace       = Tracing::TraceScope::GetCurrentTrace();
+    pUploads->ParentSpanID = Tracing::TraceScope::GetCurrentSpanID();
+    pUploads->Attachments.resize(pUploads->pFiles->size());
 
-        // Create a new http_request to upload the file
-        web::http::http_request UploadFileRequest(web::http::methods::POST);
-        UploadFileRequest.set_request_uri(U("files"));
-        UploadFileRequest.headers().add("Authorization", "Bearer " + m_OpenAIAPIKey);
-        UploadFileRequest.headers().add("OpenAI-Beta", "assistants=v2");
-        UploadFileRequest.headers().add("Content-Type", "multipart/form-data; boundary=" + BOUNDARY);
+    // Each of a few upload chains takes the next file once its upload completes
+    for (size_t Chain = 0; Chain < std::min(pUploads->pFiles->size(), MAX_PARALLEL_UPLOADS); ++Chain)
+    {
+        UploadNextFile(pUploads);
+    }
 
-        // Set the body
-        UploadFileRequest.set_body(MultiPartFormData);
+    return pplx::create_task(pUploads->Completed)
+        .then(
+            [pUploads]
+            {
+                // Add the files that were uploaded to the list of files
+                auto JAttachments = web::json::value::array();
+                for (const auto& JAttachment : pUploads->Attachments)
+                {
+                    if (JAttachment)
+                    {
+                        JAttachments[JAttachments.size()] = *JAttachment;
+                    }
+                }
+                return JAttachments;
+            });
+}
 
-        // Send the request and get the response
-        auto UploadFileResponse = m_OpenAIClient->request(UploadFileRequest).get();
+void Orion::UploadNextFile(const std::shared_ptr<FileUploads>& pUploads)
+{
+    const size_t INDEX = pUploads->NextFile++;
+    if (INDEX >= pUploads->pFiles->size())
+    {
+        return;
+    }
 
-        if (UploadFileResponse.status_code() != web::http::status_codes::OK)
-        {
-            std::cerr << "Failed to upload the file" << std::endl;
-            std::cout << UploadFileResponse.to_string() << std::endl;
+    const auto&         pTrace         = pUploads->pTrace;
+    const auto          UPLOAD_SPAN_ID = pTrace ? pTrace->StartSpan("upload_file", pUploads->ParentSpanID) : 0;
+    Tracing::TraceScope Scope(pTrace, UPLOAD_SPAN_ID);
 
-            // Continue to the next file
-            continue;
+    // Upload the file. Its content is read (or decoded) as the body of the upload is built
+    const auto&             FileName = pUploads->pFiles->at(INDEX).Name;
+    pplx::task<std::string> UploadFileTask;
+    try
+    {
+        const auto& Payload   = pUploads->pFiles->at(INDEX).Payload;
+        const auto  MIME_TYPE = MimeTypes::GetMimeType(FileName);
+
+        if (pTrace)
+        {
+            pTrace->SetAttribute(UPLOAD_SPAN_ID, "orion.file_name", FileName);
+            pTrace->SetAttribute(UPLOAD_SPAN_ID, "orion.file_bytes", std::to_string(Payload.GetSize()));
         }
+        // A file with the same content uploaded before (by any user) is reused
+        UploadFileTask = UploadCache::Get().UploadFile(m_OpenAIAPIKey, FileName, MIME_TYPE, Payload);
+    }
+    catch (const std::exception&)
+    {
+        UploadFileTask = pplx::task_from_exception<std::string>(std::current_exception());
+    }
+
+    UploadFileTask
+        .then(
+            [this, pUploads, INDEX, FileName, UPLOAD_SPAN_ID](pplx::task<std::string> CompletedUploadTask)
+            {
+                std::string FileID;
+                try
+                {
+                    FileID = CompletedUploadTask.get();
+                }
+                catch (const std::exception& Exception)
+                {
+                    // Continue with the other files
+                    Log::Error("orion", "Failed to upload the file", {{"file_name", FileName}, {"error", Exception.what()}});
+                }
 
-        // Get the file id
-        auto       UploadFileResponseJson = UploadFileResponse.extract_json().get();
-        const auto FILE_ID                = UploadFileResponseJson.at("id").as_string();
+                if (pUploads->pTrace)
+                {
+                    pUploads->pTrace->EndSpan(UPLOAD_SPAN_ID, {}, FileID.empty());
+                }
+
+                if (!FileID.empty())
+                {
+                    auto JAttachment      = web::json::value::object();
+                    auto JAttachmentTools = web::json::value::array();
+                    auto JAttachmentTool  = web::json::value::object();
 
-        auto JAttachment      = web::json::value::object();
-        auto JAttachmentTools = web::json::value::array();
-        auto JAttachmentTool  = web::json::value::object();
+                    JAttachmentTool["type"] = web::json::value::string("code_interpreter");
 
-        JAttachmentTool["type"] = web::json::value::string("code_interpreter");
+                    JAttachmentTools[JAttachmentTools.size()] = JAttachmentTool;
 
-        JAttachmentTools[JAttachmentTools.size()] = JAttachmentTool;
+                    JAttachment["file_id"] = web::json::value::string(FileID);
+                    JAttachment["tools"]   = JAttachmentTools;
 
-        JAttachment["file_id"] = web::json::value::string(FILE_ID);
-        JAttachment["tools"]   = JAttachmentTools;
+                    pUploads->Attachments[INDEX] = JAttachment;
+                }
 
-        // Add the file to the list of files
-        JAttachments[JAttachments.size()] = JAttachment;
+                if (--pUploads->Remaining == 0)
+                {
+                    pUploads->Completed.set();
+                }
+                else
+                {
+                    UploadNextFile(pUploads);
+                }
+            });
+}
+
+pplx::task<void> Orion::SendMessageAsync(const std::string& Message, web::json::array Files)
+{
+    // The data of the files is decoded from the array as it is uploaded, so the array is kept rather than copied
+    auto pFiles = std::make_shared<const web::json::array>(std::move(Files));
+
+    std::vector<MessageFile> MessageFiles;
+    MessageFiles.reserve(pFiles->size());
+    for (const auto& File : *pFiles)
+    {
+        try
+        {
+            MessageFiles.push_back({File.at("name").as_string(), OpenAI::FilePayload::FromBase64(File.at("data").as_string(), pFiles)});
+        }
+        catch (const std::exception& Exception)
+        {
+            Log::Error("orion", "Ignoring a malformed file", {{"error", Exception.what()}});
+        }
     }
+    return SendMessageAsync(Message, std::move(MessageFiles));
+}
 
-    // Create a message in the openai thread
-    web::http::http_request CreateMessageRequest(web::http::methods::POST);
-    CreateMessageRequest.set_request_uri("threads/" + m_CurrentThreadID + "/messages");
-    CreateMessageRequest.headers().add("Authorization", "Bearer " + m_OpenAIAPIKey);
-    CreateMessageRequest.headers().add("OpenAI-Beta", "assistants=v2");
-    CreateMessageRequest.headers().add("Content-Type", "application/json");
+pplx::task<void> Orion::SendMessageAsync(const std::string& Message, std::vector<MessageFile> Files)
+{
+    // Trace the message until the run completes. The scope is set again in each continuation, which run on pool threads
+    auto pTrace = Tracing::TraceStore::Get().StartTrace("send_message", {{"orion.user_hash", HashUserID(GetUserID())}, {"orion.files", std::to_string(Files.size())}});
+    Tracing::TraceScope Scope(pTrace);
 
-    web::json::value CreateMessageBody = web::json::value::object();
-    CreateMessageBody["content"]       = web::json::value::string(Message);
-    CreateMessageBody["role"]          = web::json::value::string("user");
-    CreateMessageBody["attachments"]   = JAttachments;
-    CreateMessageRequest.set_body(CreateMessageBody);
+    // The files are shared by the steps (and their content by the uploads) rather than copied
+    auto pFiles = std::make_shared<const std::vector<MessageFile>>(std::move(Files));
 
-    return m_OpenAIClient->request(CreateMessageRequest)
+    // Nothing below waits on the network: each step continues once its response has arrived. First cancel the current assistant run
+    const auto CANCEL_SPAN_ID = pTrace ? pTrace->StartSpan("cancel_current_run") : 0;
+    return CancelCurrentRun()
         .then(
-            [this](const web::http::http_response& CreateMessageResponse)
+            [this, pTrace, CANCEL_SPAN_ID, pFiles]
             {
-                if (CreateMessageResponse.status_code() != web::http::status_codes::OK)
+                Tracing::TraceScope Scope(pTrace);
+                if (pTrace)
                 {
-                    std::cerr << "Failed to create a new message" << std::endl;
-                    std::cout << CreateMessageResponse.to_string() << std::endl;
-                    return pplx::task_from_result();
+                    pTrace->EndSpan(CANCEL_SPAN_ID);
                 }
 
-                // run the assistant
-                auto CreateRunRequest = web::http::http_request(web::http::methods::POST);
-                CreateRunRequest.set_request_uri(U("threads/" + m_CurrentThreadID + "/runs"));
-                CreateRunRequest.headers().add("Authorization", "Bearer " + m_OpenAIAPIKey);
-                CreateRunRequest.headers().add("OpenAI-Beta", "assistants=v2");
-                CreateRunRequest.headers().add("Content-Type", "application/json");
+                // Upload the files
+                return UploadFilesAsync(pFiles);
+            })
+        .then(
+            [this, pTrace, Message](const web::json::value& JAttachments)
+            {
+                Tracing::TraceScope Scope(pTrace);
+
+                // Create a message in the openai thread
+                web::json::value CreateMessageBody = web::json::value::object();
+                CreateMessageBody["content"]       = web::json::value::string(Message);
+                CreateMessageBody["role"]          = web::json::value::string("user");
+                CreateMessageBody["attachments"]   = JAttachments;
+
+                return m_OpenAIClient->CreateMessage(m_CurrentThreadID, CreateMessageBody);
+            })
+        .then(
+            [this, pTrace](const web::json::value&)
+            {
+                Tracing::TraceScope Scope(pTrace);
 
+                // run the assistant
                 auto CreateRunBody            = web::json::value::object();
                 CreateRunBody["assistant_id"] = web::json::value::string(m_CurrentAssistantID);
 
                 // Set the model to the current model
-                CreateRunBody["model"]  = web::json::value::string(m_CurrentIntelligence == EOrionIntelligence::Base ? "gpt-3.5-turbo" : "gpt-4-turbo-preview");
-                CreateRunBody["stream"] = web::json::value::boolean(true);
-                CreateRunRequest.set_body(CreateRunBody);
-
-                return m_OpenAIClient->request(CreateRunRequest)
-                    .then(
-                        [this](const web::http::http_response& CreateRunResponse)
-                        {
-                            if (CreateRunResponse.status_code() != web::http::status_codes::OK)
-                            {
-                                std::cerr << "Failed to create a new run" << std::endl;
-                                std::cout << CreateRunResponse.to_string() << std::endl;
-                                return pplx::task_from_result();
-                            }
+                CreateRunBody["model"] = web::json::value::string(m_CurrentIntelligence == EOrionIntelligence::Base ? "gpt-3.5-turbo" : "gpt-4-turbo-preview");
 
-                            // The response is a server-sent event stream that we need to parse and terminates with the "done" event
-                            // Keep reading the response stream for new events
-                            ProcessOpenAIEventStream(CreateRunResponse.body());
+                return m_OpenAIClient->CreateRunStream(m_CurrentThreadID, CreateRunBody);
+            })
+        .then(
+            [this, pTrace](const web::http::http_response& CreateRunResponse)
+            {
+                Tracing::TraceScope Scope(pTrace);
 
-                            return pplx::task_from_result();
-                        });
+                // The response is a server-sent event stream that we need to parse and terminates with the "done" event
+                return ProcessOpenAIEventStreamAsync(CreateRunResponse.body());
+            })
+        .then(
+            [pTrace](pplx::task<void> SendMessageTask)
+            {
+                // Finish the trace whether the message succeeded or not, then surface any exception (a failed message or run) to the caller
+                try
+                {
+                    SendMessageTask.get();
+                }
+                catch (...)
+                {
+                    Tracing::TraceStore::Get().FinishTrace(pTrace, true);
+                    throw;
+                }
+                Tracing::TraceStore::Get().FinishTrace(pTrace);
             });
 }
 
 void Orion::CreateAssistant()
 {
     // Check if an assistant already exists on the server
-    web::http::http_request ListAssistantsRequest(web::http::methods::GET);
-    ListAssistantsRequest.set_request_uri(U("assistants"));
-    ListAssistantsRequest.headers().add("Authorization", "Bearer " + m_OpenAIAPIKey);
-    ListAssistantsRequest.headers().add("OpenAI-Beta", "assistants=v2");
-
-    const web::http::http_response LIST_ASSISTANTS_RESPONSE = m_OpenAIClient->request(ListAssistantsRequest).get();
-
     bool DoesAssistantExist = false;
-    if (LIST_ASSISTANTS_RESPONSE.status_code() == web::http::status_codes::OK)
+    try
     {
-        web::json::value Json = LIST_ASSISTANTS_RESPONSE.extract_json().get();
-        for (const auto& Assistant : Json.at("data").as_array())
+        const web::json::value JASSISTANTS = m_OpenAIClient->ListAssistants().get();
+        for (const auto& Assistant : JASSISTANTS.at("data").as_array())
         {
             if (Assistant.at("id").as_string() == m_CurrentAssistantID)
             {
@@ -591,9 +704,9 @@ void Orion::CreateAssistant()
             }
         }
     }
-    else
+    catch (const std::exception& Exception)
     {
-        std::cerr << "Failed to get the list of assistants" << std::endl;
+        Log::Error("orion.assistant", "Failed to get the list of assistants", {{"error", Exception.what()}});
         return;
     }
 
@@ -604,28 +717,21 @@ void Orion::CreateAssistant()
     else
     {
         // Create a new assistant
-        web::http::http_request CreateAssistantRequest(web::http::methods::POST);
-        CreateAssistantRequest.set_request_uri(U("assistants"));
-        CreateAssistantRequest.headers().add("Authorization", "Bearer " + m_OpenAIAPIKey);
-        CreateAssistantRequest.headers().add("OpenAI-Beta", "assistants=v2");
-        CreateAssistantRequest.headers().add("Content-Type", "application/json");
-
         web::json::value CreateAssistantRequestBody = web::json::value::object();
         CreateAssistantRequestBody["name"]          = web::json::value::string(m_Name);
         CreateAssistantRequestBody["instructions"]  = web::json::value::string(m_Instructions);
         CreateAssistantRequestBody["description"]   = web::json::value::string(m_Description);
         CreateAssistantRequestBody["model"]         = web::json::value::string(m_CurrentIntelligence == EOrionIntelligence::Base ? "gpt-3.5-turbo" : "gpt-4-turbo-preview");
 
-        CreateAssistantRequest.set_body(CreateAssistantRequestBody);
-
-        const web::http::http_response CREATE_ASSISTANT_RESPONSE = m_OpenAIClient->request(CreateAssistantRequest).get();
-        if (CREATE_ASSISTANT_RESPONSE.status_code() != web::http::status_codes::OK)
+        try
         {
-            std::cerr << "Failed to create a new assistant:" << std::endl << CREATE_ASSISTANT_RESPONSE.to_string() << std::endl;
+            m_CurrentAssistantID = m_OpenAIClient->CreateAssistant(CreateAssistantRequestBody).get().at("id").as_string();
+        }
+        catch (const std::exception& Exception)
+        {
+            Log::Error("orion.assistant", "Failed to create a new assistant", {{"error", Exception.what()}});
+            return;
         }
-
-        web::json::value Json = CREATE_ASSISTANT_RESPONSE.extract_json().get();
-        m_CurrentAssistantID  = Json.at("id").as_string();
 
         // Recalculate the Orion tools
         RecalculateOrionTools();
@@ -634,30 +740,27 @@ void Orion::CreateAssistant()
 
 void Orion::CreateThread()
 {
-    // Create a new thread
-    web::http::http_request CreateThreadRequest(web::http::methods::POST);
-    CreateThreadRequest.set_request_uri(U("threads"));
-    CreateThreadRequest.headers().add("Authorization", "Bearer " + m_OpenAIAPIKey);
-    CreateThreadRequest.headers().add("OpenAI-Beta", "assistants=v2");
-    CreateThreadRequest.headers().add("Content-Type", "application/json");
-    CreateThreadRequest.set_body(web::json::value::object());
-
-    if (const web::http::http_response CREATE_THREAD_RESPONSE = m_OpenAIClient->request(CreateThreadRequest).get();
-        CREATE_THREAD_RESPONSE.status_code() == web::http::status_codes::OK)
+    // Create a new thread (retried on transient failures, so the instance doesn't end up without one)
+    try
     {
-        web::json::value ResponseDataJson = CREATE_THREAD_RESPONSE.extract_json().get();
-        m_CurrentThreadID                 = ResponseDataJson.at("id").as_string();
+        m_CurrentThreadID = m_OpenAIClient->CreateThread().get().at("id").as_string();
     }
-    else
+    catch (const std::exception& Exception)
     {
-        std::cerr << "Failed to create a new thread" << std::endl;
+        Log::Error("orion", "Failed to create a new thread", {{"error", Exception.what()}});
     }
 }
 
 void Orion::CreateClient()
 {
-    // Create a client to communicate with the OpenAI API
-    m_OpenAIClient = std::make_unique<web::http::client::http_client>(U("https://api.openai.com/v1/"));
+    // Create the typed client of the OpenAI API. It shares the process-wide connection (with the configured base URL and transport,
+    // measured and traced), so requests reuse its warm connections
+    m_OpenAIClient = std::make_unique<OpenAI::Client>(m_OpenAIAPIKey);
+}
+
+std::shared_ptr<web::http::client::http_client> Orion::GetHttpClient(const std::string& BaseURL, const std::string& Service)
+{
+    return Upstream::GetClient(BaseURL, Service);
 }
 
 void Orion::SetNewVoice(const EOrionVoice VOICE)
@@ -771,8 +874,8 @@ web::json::value Orion::ListSmartDevices(const std::string& Domain) const
 {
     try
     {
-        // Create a new http_client to communicate with the home-assistant api
-        web::http::client::http_client HomeAssistantClient(U("http://homeassistant.local:8123/api/"));
+        // Get the shared client of the home-assistant api
+        const auto pHomeAssistantClient = GetHttpClient(U("http://homeassistant.local:8123/api/"), "home_assistant");
 
         // Create a new http_request to get the smart devices
         web::http::http_request ListStatesRequest(web::http::methods::GET);
@@ -783,7 +886,7 @@ web::json::value Orion::ListSmartDevices(const std::string& Domain) const
         const auto DOMAIN_WITH_DOT = Domain + ".";
 
         // Send the request and get the response
-        return HomeAssistantClient.request(ListStatesRequest)
+        return pHomeAssistantClient->request(ListStatesRequest)
             .then(
                 [DOMAIN_WITH_DOT](const web::http::http_response& ListStatesResponse)
                 {
@@ -811,8 +914,7 @@ web::json::value Orion::ListSmartDevices(const std::string& Domain) const
                     }
                     else
                     {
-                        std::cerr << "Failed to get the smart devices: " << ListStatesResponse.to_string() << std::endl;
-                        std::cout << "Failed to get the smart devices: " << ListStatesResponse.to_string() << std::endl;
+                        Log::Error("orion.home_assistant", "Failed to get the smart devices", {{"response", ListStatesResponse.to_string()}});
                         return pplx::task_from_result(web::json::value::array());
                     }
                 })
@@ -820,7 +922,7 @@ web::json::value Orion::ListSmartDevices(const std::string& Domain) const
     }
     catch (const std::exception& Exception)
     {
-        std::cerr << "Failed to list the smart devices: " << Exception.what() << std::endl;
+        Log::Error("orion.home_assistant", "Failed to list the smart devices", {{"error", Exception.what()}});
         return web::json::value::array();
     }
 }
@@ -836,8 +938,8 @@ web::json::value Orion::ExecSmartDeviceService(const web::json::value& Devices,
             const auto DOMAIN      = DEVICE_NAME.substr(0, DEVICE_NAME.find('.'));
             const auto ENTITY_ID   = DEVICE_NAME.substr(DEVICE_NAME.find('.') + 1);
 
-            // Create a new http_client to communicate with the home-assistant api
-            web::http::client::http_client HomeAssistantClient(U("http://homeassistant.local:8123/api/"));
+            // Get the shared client of the home-assistant api
+            const auto pHomeAssistantClient = GetHttpClient(U("http://homeassistant.local:8123/api/"), "home_assistant");
 
             // Create a new http_request to execute the smart device service
             web::http::http_request ExecuteServiceRequest(web::http::methods::POST);
@@ -851,16 +953,15 @@ web::json::value Orion::ExecSmartDeviceService(const web::json::value& Devices,
             ExecuteServiceRequest.set_body(ExecuteServiceRequestBody);
 
             // Send the request and get the response
-            auto ExecuteServiceResponse = HomeAssistantClient.request(ExecuteServiceRequest).get();
+            auto ExecuteServiceResponse = pHomeAssistantClient->request(ExecuteServiceRequest).get();
 
             if (ExecuteServiceResponse.status_code() != web::http::status_codes::OK)
             {
-                std::cerr << "Failed to execute the smart device service" << std::endl;
-                std::cout << ExecuteServiceResponse.to_string() << std::endl;
+                Log::Error("orion.home_assistant", "Failed to execute the smart device service", {{"response", ExecuteServiceResponse.to_string()}});
             }
             else
             {
-                std::cout << "Executed the smart device service: " << Service << " on the device: " << DEVICE_NAME << std::endl;
+                Log::Info("orion.home_assistant", "Executed the smart device service", {{"service", Service}, {"device", DEVICE_NAME}});
             }
         }
 
@@ -868,96 +969,59 @@ web::json::value Orion::ExecSmartDeviceService(const web::json::value& Devices,
     }
     catch (const std::exception& Exception)
     {
-        std::cerr << "Failed to execute the smart device service: " << Exception.what() << std::endl;
+        Log::Error("orion.home_assistant", "Failed to execute the smart device service", {{"error", Exception.what()}});
         return web::json::value::string("Failed to execute the smart device service: " + std::string(Exception.what()));
     }
 }
 
 pplx::task<web::json::value> Orion::GetChatHistoryAsync() const
 {
-    // Create a new http_request to get the chat history
-    web::http::http_request ListMessagesRequest(web::http::methods::GET);
-
-    // Request uri builder
-    web::uri_builder ListMessagesRequestURIBuilder;
-    ListMessagesRequestURIBuilder.append_path("threads/" + m_CurrentThreadID + "/messages");
-    ListMessagesRequestURIBuilder.append_query("limit", 100);
-    ListMessagesRequestURIBuilder.append_query("order", "asc");
-    ListMessagesRequest.set_request_uri(ListMessagesRequestURIBuilder.to_string());
-
-    ListMessagesRequest.headers().add("Authorization", "Bearer " + m_OpenAIAPIKey);
-    ListMessagesRequest.headers().add("OpenAI-Beta", "assistants=v2");
-
-    // Check if the query parameter is present
-    const bool IS_MARKDOWN_REQUESTED = ListMessagesRequest.request_uri().query().find(U("markdown=true")) != std::string::npos;
-
-    // Send the request and get the response
-    return m_OpenAIClient->request(ListMessagesRequest)
+    // Get the messages of the thread (the web server renders them as markdown when asked to)
+    return m_OpenAIClient->ListMessages(m_CurrentThreadID, 100, "asc")
         .then(
-            [=](const web::http::http_response& ListMessagesResponse)
+            [](pplx::task<web::json::value> ListMessagesTask)
             {
-                if (ListMessagesResponse.status_code() == web::http::status_codes::OK)
+                web::json::value ListMessagesResponseDataJson;
+                try
                 {
-                    return ListMessagesResponse.extract_json()
-                        .then([=](const pplx::task<web::json::value>& ExtractJsonTask) { return ExtractJsonTask.get(); })
-                        .then(
-                            [=](web::json::value ListMessagesResponseDataJson)
-                            {
-                                auto JData = ListMessagesResponseDataJson.at("data").as_array();
-
-                                auto JChatHistory = web::json::value::array();
-                                for (const auto& Message : JData)
-                                {
-                                    // Our assistant is always the orion role in the chat history
-                                    auto Role = Message.at("role").as_string();
-                                    Role      = Role == "assistant" ? "orion" : Role;
+                    ListMessagesResponseDataJson = ListMessagesTask.get();
+                }
+                catch (const std::exception& Exception)
+                {
+                    Log::Error("orion", "Failed to get the chat history", {{"error", Exception.what()}});
+                    return web::json::value::object();
+                }
 
-                                    for (const auto& Content : Message.at("content").as_array())
-                                    {
-                                        if (Content.at("type").as_string() == "text")
-                                        {
-                                            // Add the message to the chat history
-                                            auto Msg = Content.at("text").at("value").as_string();
+                auto JData = ListMessagesResponseDataJson.at("data").as_array();
 
-                                            if (IS_MARKDOWN_REQUESTED)
-                                            {
-                                                char* pMarkdown = cmark_markdown_to_html(Msg.c_str(), Msg.length(), CMARK_OPT_UNSAFE);
-                                                Msg             = pMarkdown;
-                                                free(pMarkdown);
-                                            }
-
-                                            auto JMessage       = web::json::value::object();
-                                            JMessage["message"] = web::json::value::string(Msg);
-                                            JMessage["role"]    = web::json::value::string(Role);
+                auto JChatHistory = web::json::value::array();
+                for (const auto& Message : JData)
+                {
+                    // Our assistant is always the orion role in the chat history
+                    auto Role = Message.at("role").as_string();
+                    Role      = Role == "assistant" ? "orion" : Role;
 
-                                            // Add the message to the chat history
-                                            JChatHistory[JChatHistory.size()] = JMessage;
-                                        }
-                                    }
-                                }
+                    for (const auto& Content : Message.at("content").as_array())
+                    {
+                        if (Content.at("type").as_string() == "text")
+                        {
+                            auto JMessage       = web::json::value::object();
+                            JMessage["message"] = Content.at("text").at("value");
+                            JMessage["role"]    = web::json::value::string(Role);
 
-                                return JChatHistory;
-                            });
+                            // Add the message to the chat history
+                            JChatHistory[JChatHistory.size()] = JMessage;
+                        }
+                    }
                 }
-                else
-                {
-                    std::cerr << "Failed to get the chat history" << std::endl;
-                    std::cout << ListMessagesResponse.to_string() << std::endl;
 
-                    return pplx::task_from_result(web::json::value::object());
-                }
+                return JChatHistory;
             });
 }
 
 pplx::task<concurrency::streams::istream> Orion::SpeakSingleAsync(const std::string& Message, const uint8_t INDEX, const ETTSAudioFormat AUDIO_FORMAT) const
 {
-    // Create a new http_request to get the speech
-    web::http::http_request TextToSpeechRequest(web::http::methods::POST);
-    TextToSpeechRequest.set_request_uri(U("audio/speech"));
-    TextToSpeechRequest.headers().add("Authorization", "Bearer " + m_OpenAIAPIKey);
-    TextToSpeechRequest.headers().add("Content-Type", "application/json");
-
-    // Add the body to the request
+    // Create the body of the speech request
     web::json::value TextToSpeechRequestBody = web::json::value::object();
     TextToSpeechRequestBody["model"]         = web::json::value::string("tts-1");
     TextToSpeechRequestBody["input"]         = web::json::value::string(Message);
@@ -1020,21 +1084,25 @@ pplx::task<concurrency::streams::istream> Orion::SpeakSingleAsync(const std::str
 
     const auto EXTENSION = "." + TextToSpeechRequestBody["response_format"].as_string();
 
-    TextToSpeechRequest.set_body(TextToSpeechRequestBody);
+    static auto& TTS_DURATION   = Metrics::Registry::Get().GetHistogram("orion_tts_duration_seconds", "Time until the synthesized speech starts streaming");
+    static auto& TTS_CHARACTERS = Metrics::Registry::Get().GetCounter("orion_tts_characters_total", "Characters of text sent to speech synthesis");
+    TTS_CHARACTERS.Increment(Message.size());
 
     // Send the request and get the response
-    return m_OpenAIClient->request(TextToSpeechRequest)
+    return m_OpenAIClient->CreateSpeech(TextToSpeechRequestBody)
         .then(
-            [](const web::http::http_response& TextToSpeechResponse)
+            [START = std::chrono::steady_clock::now()](pplx::task<web::http::http_response> TextToSpeechTask)
             {
-                if (TextToSpeechResponse.status_code() == web::http::status_codes::OK)
+                TTS_DURATION.Observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - START).count());
+                try
                 {
-                    return TextToSpeechResponse.body();
+                    return TextToSpeechTask.get().body();
+                }
+                catch (const std::exception& Exception)
+                {
+                    Log::Error("orion.speech", "Failed to get the speech", {{"error", Exception.what()}});
+                    return concurrency::streams::istream {};
                 }
-
-                std::cout << __func__ << ": Failed to get the speech: " << TextToSpeechResponse.to_string() << std::endl;
-
-                return concurrency::streams::istream {};
             });
 }
 
@@ -1098,354 +1166,493 @@ pplx::task<std::vector<std::string>> Orion::SplitMessageAsync(const std::string&
         });
 }
 
-void Orion::ProcessOpenAIEventStream(const concurrency::streams::istream& EventStream)
+/// @brief  An OpenAI event stream being read, and the event being assembled from its lines
+struct Orion::OpenAIEventStream
 {
-    std::string Line;
+    /// @brief  The stream
+    concurrency::streams::istream EventStream;
+
+    /// @brief  The user whose clients receive the events of the stream
+    std::string UserID;
+
+    /// @brief  The trace, the span of the stream, and the phases of the stream in it: the wait for the first token, then the streaming of each message
+    std::shared_ptr<Tracing::Trace> pTrace;
+    Tracing::SpanID                 SpanID             = 0;
+    Tracing::SpanID                 WaitForTokenSpanID = 0;
+    Tracing::SpanID                 MessageSpanID      = 0;
+
+    /// @brief  The event being assembled
     std::string EventName;
     std::string EventData;
+
+    /// @brief  Set once the stream has ended
+    pplx::task_completion_event<void> Completed;
+};
+
+pplx::task<void> Orion::ProcessOpenAIEventStreamAsync(const concurrency::streams::istream& EventStream)
+{
+    auto pStream         = std::make_shared<OpenAIEventStream>();
+    pStream->EventStream = EventStream;
+    pStream->UserID      = GetUserID();
+    pStream->pTrace      = Tracing::TraceScope::GetCurrentTrace();
+    if (pStream->pTrace)
+    {
+        pStream->SpanID             = pStream->pTrace->StartSpan("event_stream", Tracing::TraceScope::GetCurrentSpanID());
+        pStream->WaitForTokenSpanID = pStream->pTrace->StartSpan("model.wait_first_token", pStream->SpanID);
+    }
+
+    ReadOpenAIEventStream(pStream);
+
+    return pplx::create_task(pStream->Completed)
+        .then(
+            [pStream](pplx::task<void> StreamTask)
+            {
+                // A stream that ended without a token (a tool call, a failed run) or mid-message still ends its phases
+                bool IsError = false;
+                try
+                {
+                    StreamTask.wait();
+                }
+                catch (...)
+                {
+                    IsError = true;
+                }
+
+                if (pStream->pTrace)
+                {
+                    pStream->pTrace->EndSpan(pStream->WaitForTokenSpanID);
+                    pStream->pTrace->EndSpan(pStream->MessageSpanID);
+                    pStream->pTrace->EndSpan(pStream->SpanID, {}, IsError);
+                }
+                return StreamTask;
+            });
+}
+
+void Orion::ReadOpenAIEventStream(const std::shared_ptr<OpenAIEventStream>& pStream)
+{
+    // Lines that are already buffered are read in this loop; the read of a line that hasn't arrived yet continues the loop once it has
     while (true)
     {
         concurrency::streams::container_buffer<std::string> LineBuff {};
-        const auto                                          NUM_CHARS_READ = EventStream.read_line(LineBuff).get();
-        Line                                                               = LineBuff.collection();
+        auto                                                ReadLineTask = pStream->EventStream.read_line(LineBuff);
+        if (!ReadLineTask.is_done())
+        {
+            ReadLineTask.then(
+                [this, pStream, LineBuff](pplx::task<size_t> PendingReadLineTask)
+                {
+                    if (ProcessOpenAIEventStreamLine(pStream, PendingReadLineTask, LineBuff.collection()))
+                    {
+                        ReadOpenAIEventStream(pStream);
+                    }
+                });
+            return;
+        }
 
-        if (NUM_CHARS_READ <= 0)
+        if (!ProcessOpenAIEventStreamLine(pStream, ReadLineTask, LineBuff.collection()))
         {
-            // Log the event
-            std::cout << "SSE Event name: " << EventName << std::endl;
-            std::cout << "SSEEvent data: " << EventData << std::endl;
+            return;
+        }
+    }
+}
 
-            // Process the event
+bool Orion::ProcessOpenAIEventStreamLine(const std::shared_ptr<OpenAIEventStream>& pStream, const pplx::task<size_t>& ReadLineTask, const std::string& Line)
+{
+    auto&               Stream = *pStream;
+    Tracing::TraceScope Scope(Stream.pTrace, Stream.SpanID);
 
-            // Check if the event is the "done" event
-            if (EventName.empty() || EventName == OrionWebServer::SSEOpenAIEventNames::DONE)
+    try
+    {
+        if (ReadLineTask.get() > 0)
+        {
+            if (constexpr std::string_view EVENT_PREFIX = "event: "; Line.find(EVENT_PREFIX) == 0)
             {
-                // Break out of the loop
-                break;
+                Stream.EventName = Line.substr(EVENT_PREFIX.length());
             }
-            else if (EventName == OrionWebServer::SSEOpenAIEventNames::THREAD_RUN_CREATED)
+            else if (constexpr std::string_view DATA_PREFIX = "data: "; Line.find(DATA_PREFIX) == 0)
             {
-                web::json::value JMessage = web::json::value::parse(EventData);
-                m_CurrentAssistantRunID   = JMessage.at("id").as_string();
+                Stream.EventData += Line.substr(DATA_PREFIX.length());
             }
-            else if (EventName == OrionWebServer::SSEOpenAIEventNames::THREAD_RUN_COMPLETED)
-            {
-                web::json::value JMessage = web::json::value::parse(EventData);
-                m_CurrentAssistantRunID.clear();
+            return true;
+        }
 
-                // Format an SSE event for the SSEOrionEventNames::RUN_COMPLETED event.
-                // No data is needed for this event.
-                m_pOrionWebServer->SendServerEvent(OrionWebServer::SSEOrionEventNames::MESSAGE_COMPLETED, web::json::value::object());
-            }
-            else if (EventName == OrionWebServer::SSEOpenAIEventNames::THREAD_MESSAGE_COMPLETED)
+        // An empty line (or the end of the stream) ends the event. The "done" event ends the stream
+        auto ToolOutputsTask = ProcessOpenAIEvent(Stream);
+        if (Stream.EventName.empty() || Stream.EventName == OrionWebServer::SSEOpenAIEventNames::DONE)
+        {
+            Stream.Completed.set();
+            return false;
+        }
+
+        Stream.EventName.clear();
+        Stream.EventData.clear();
+        if (!ToolOutputsTask)
+        {
+            return true;
+        }
+
+        // Read on once the stream of the submitted tool outputs has ended
+        ToolOutputsTask->then(
+            [this, pStream](pplx::task<void> ToolOutputsStreamTask)
             {
-                // Format an SSE event for the SSEOrionEventNames::MESSAGE_COMPLETED event.
+                try
+                {
+                    ToolOutputsStreamTask.get();
+                }
+                catch (...)
+                {
+                    pStream->Completed.set_exception(std::current_exception());
+                    return;
+                }
+                ReadOpenAIEventStream(pStream);
+            });
+        return false;
+    }
+    catch (...)
+    {
+        Stream.Completed.set_exception(std::current_exception());
+        return false;
+    }
+}
 
-                m_pOrionWebServer->SendServerEvent(OrionWebServer::SSEOrionEventNames::MESSAGE_COMPLETED, web::json::value::object());
-            }
-            else if (EventName == OrionWebServer::SSEOpenAIEventNames::THREAD_MESSAGE_DELTA)
+std::optional<pplx::task<void>> Orion::ProcessOpenAIEvent(OpenAIEventStream& Stream)
+{
+    // Log the event. Deltas arrive every few milliseconds and carry the whole run, so they are only logged at trace level
+    Log::Write(Stream.EventName == OrionWebServer::SSEOpenAIEventNames::THREAD_MESSAGE_DELTA ? Log::ELevel::Trace : Log::ELevel::Debug, "orion.events", "Received an event",
+               {{"event", Stream.EventName}, {"data", Stream.EventData}});
+
+    // Deltas are too frequent to be events of the trace; the first one ends the wait for the first token instead
+    if (Stream.pTrace && !Stream.EventName.empty() && Stream.EventName != OrionWebServer::SSEOpenAIEventNames::THREAD_MESSAGE_DELTA &&
+        Stream.EventName != OrionWebServer::SSEOpenAIEventNames::THREAD_RUN_STEP_DELTA)
+    {
+        Stream.pTrace->AddEvent(Stream.SpanID, Stream.EventName);
+    }
+
+    if (Stream.EventName == OrionWebServer::SSEOpenAIEventNames::THREAD_RUN_CREATED)
+    {
+        web::json::value            JMessage = web::json::value::parse(Stream.EventData);
+        std::lock_guard<std::mutex> RunLockGuard(m_CurrentAssistantRunMutex);
+        m_CurrentAssistantRunID = JMessage.at("id").as_string();
+    }
+    else if (Stream.EventName == OrionWebServer::SSEOpenAIEventNames::THREAD_RUN_COMPLETED)
+    {
+        {
+            std::lock_guard<std::mutex> RunLockGuard(m_CurrentAssistantRunMutex);
+            m_CurrentAssistantRunID.clear();
+        }
+
+        // Format an SSE event for the SSEOrionEventNames::RUN_COMPLETED event.
+        // No data is needed for this event.
+        m_pOrionWebServer->SendServerEvent(Stream.UserID, OrionWebServer::SSEOrionEventNames::MESSAGE_COMPLETED, web::json::value::object());
+    }
+    else if (Stream.EventName == OrionWebServer::SSEOpenAIEventNames::THREAD_MESSAGE_COMPLETED)
+    {
+        if (Stream.pTrace)
+        {
+            Stream.pTrace->EndSpan(Stream.MessageSpanID);
+            Stream.MessageSpanID = 0;
+        }
+
+        // Format an SSE event for the SSEOrionEventNames::MESSAGE_COMPLETED event.
+
+        m_pOrionWebServer->SendServerEvent(Stream.UserID, OrionWebServer::SSEOrionEventNames::MESSAGE_COMPLETED, web::json::value::object());
+    }
+    else if (Stream.EventName == OrionWebServer::SSEOpenAIEventNames::THREAD_MESSAGE_DELTA)
+    {
+        // Format an SSE event for the SSEOrionEventNames::MESSAGE_DELTA event.
+        // The data is the message from the assistant.
+
+        if (Stream.pTrace && Stream.WaitForTokenSpanID != 0)
+        {
+            Stream.pTrace->EndSpan(Stream.WaitForTokenSpanID);
+            Stream.pTrace->MarkFirstToken();
+            Stream.WaitForTokenSpanID = 0;
+        }
+        if (Stream.pTrace && Stream.MessageSpanID == 0)
+        {
+            Stream.MessageSpanID = Stream.pTrace->StartSpan("model.stream_message", Stream.SpanID);
+        }
+
+        // First Validate the JSON
+        web::json::value JMessage = web::json::value::parse(Stream.EventData);
+
+        // Perform checks to ensure the message is valid
+        if (!JMessage.has_field(U("delta")) || !JMessage.at(U("delta")).has_field(U("content")))
+        {
+            Log::Error("orion.events", "Unexpected message format", {{"data", Stream.EventData}});
+            throw std::runtime_error("Unexpected message format.");
+        }
+
+        auto JMessageContentArray = JMessage.at(U("delta")).at(U("content")).as_array();
+        for (const auto& JContentItem : JMessageContentArray)
+        {
+            // Check if the content item is a text item
+            if (JContentItem.has_field(U("text")))
             {
-                // Format an SSE event for the SSEOrionEventNames::MESSAGE_DELTA event.
-                // The data is the message from the assistant.
+                auto JTextContent      = JContentItem.at(U("text"));
+                auto TextContentString = JTextContent.has_field(U("value")) ? JTextContent.at(U("value")).as_string() : "";
 
-                // First Validate the JSON
-                web::json::value JMessage = web::json::value::parse(EventData);
+                auto JAnnotations = JTextContent.has_field(U("annotations")) ? JTextContent.at(U("annotations")).as_array() : web::json::value::array().as_array();
 
-                // Perform checks to ensure the message is valid
-                if (!JMessage.has_field(U("delta")) || !JMessage.at(U("delta")).has_field(U("content")))
+                if (!TextContentString.empty())
                 {
-                    std::cout << U(__func__) << ":" << __LINE__ << U(": Unexpected message format.") << std::endl;
-                    throw std::runtime_error("Unexpected message format.");
+                    // Get the message from the assistant
+                    web::json::value JClientSSEData = web::json::value::object();
+                    JClientSSEData[U("message")]    = web::json::value::string(TextContentString);
+
+                    // Send the message to the client
+                    m_pOrionWebServer->SendServerEvent(Stream.UserID, OrionWebServer::SSEOrionEventNames::MESSAGE_DELTA, std::move(JClientSSEData));
                 }
 
-                auto JMessageContentArray = JMessage.at(U("delta")).at(U("content")).as_array();
-                for (const auto& JContentItem : JMessageContentArray)
+                // Gather the annotations
+                for (const auto& JAnnotation : JAnnotations)
                 {
-                    // Check if the content item is a text item
-                    if (JContentItem.has_field(U("text")))
+                    auto TextToReplace = JAnnotation.at(U("text")).as_string();
+                    auto JFilePath     = JAnnotation.at(U("file_path"));
+                    if (auto FileID = JFilePath.at(U("file_id")).as_string(); !FileID.empty())
                     {
-                        auto JTextContent      = JContentItem.at(U("text"));
-                        auto TextContentString = JTextContent.has_field(U("value")) ? JTextContent.at(U("value")).as_string() : "";
-
-                        auto JAnnotations = JTextContent.has_field(U("annotations")) ? JTextContent.at(U("annotations")).as_array() : web::json::value::array().as_array();
-
-                        if (!TextContentString.empty())
-                        {
-                            // Get the message from the assistant
-                            web::json::value JClientSSEData = web::json::value::object();
-                            JClientSSEData[U("message")]    = web::json::value::string(TextContentString);
-
-                            // Send the message to the client
-                            m_pOrionWebServer->SendServerEvent(OrionWebServer::SSEOrionEventNames::MESSAGE_DELTA, JClientSSEData);
-                        }
-
-                        // Gather the annotations
-                        for (const auto& JAnnotation : JAnnotations)
-                        {
-                            auto TextToReplace = JAnnotation.at(U("text")).as_string();
-                            auto JFilePath     = JAnnotation.at(U("file_path"));
-                            if (auto FileID = JFilePath.at(U("file_id")).as_string(); !FileID.empty())
-                            {
-                                const auto FILE_EXT     = TextToReplace.substr(TextToReplace.find_last_of('.'));
-                                const auto DOWNLOAD_URL = +"/orion/files/" + FileID + FILE_EXT;
+                        const auto FILE_EXT     = TextToReplace.substr(TextToReplace.find_last_of('.'));
+                        const auto DOWNLOAD_URL = +"/orion/files/" + FileID + FILE_EXT;
 
-                                // SSE event for the annotation
-                                web::json::value JClientSSEData      = web::json::value::object();
-                                JClientSSEData[U("url")]             = web::json::value::string(DOWNLOAD_URL);
-                                JClientSSEData[U("text_to_replace")] = web::json::value::string(TextToReplace);
+                        // SSE event for the annotation
+                        web::json::value JClientSSEData      = web::json::value::object();
+                        JClientSSEData[U("url")]             = web::json::value::string(DOWNLOAD_URL);
+                        JClientSSEData[U("text_to_replace")] = web::json::value::string(TextToReplace);
 
-                                // Send the message to the client
+                        // Send the message to the client
 
-                                m_pOrionWebServer->SendServerEvent(OrionWebServer::SSEOrionEventNames::MESSAGE_ANNOTATION_CREATED, JClientSSEData);
-                            }
-                        }
+                        m_pOrionWebServer->SendServerEvent(Stream.UserID, OrionWebServer::SSEOrionEventNames::MESSAGE_ANNOTATION_CREATED, std::move(JClientSSEData));
                     }
                 }
             }
-            else if (EventName == OrionWebServer::SSEOpenAIEventNames::THREAD_MESSAGE_CREATED)
-            {
-                // Format an SSE event for the SSEOrionEventNames::MESSAGE_CREATED event.
-                // No data is needed for this event.
+        }
+    }
+    else if (Stream.EventName == OrionWebServer::SSEOpenAIEventNames::THREAD_MESSAGE_CREATED)
+    {
+        // Format an SSE event for the SSEOrionEventNames::MESSAGE_CREATED event.
+        // No data is needed for this event.
 
-                // Send the message to the client
-                m_pOrionWebServer->SendServerEvent(OrionWebServer::SSEOrionEventNames::MESSAGE_STARTED, {});
-            }
-            else if (EventName == OrionWebServer::SSEOpenAIEventNames::THREAD_MESSAGE_IN_PROGRESS)
-            {
-                // Format an SSE event for the SSEOrionEventNames::RUN_COMPLETED event.
-                // No data is needed for this event.
+        // Send the message to the client
+        m_pOrionWebServer->SendServerEvent(Stream.UserID, OrionWebServer::SSEOrionEventNames::MESSAGE_STARTED, {});
+    }
+    else if (Stream.EventName == OrionWebServer::SSEOpenAIEventNames::THREAD_MESSAGE_IN_PROGRESS)
+    {
+        // Format an SSE event for the SSEOrionEventNames::RUN_COMPLETED event.
+        // No data is needed for this event.
 
-                // Send the message to the client
-                m_pOrionWebServer->SendServerEvent(OrionWebServer::SSEOrionEventNames::MESSAGE_IN_PROGRESS, {});
-            }
-            else if (EventName == OrionWebServer::SSEOpenAIEventNames::THREAD_RUN_REQUIRES_ACTION)
-            {
-                // Parse the data
-                web::json::value JRun = web::json::value::parse(EventData);
+        // Send the message to the client
+        m_pOrionWebServer->SendServerEvent(Stream.UserID, OrionWebServer::SSEOrionEventNames::MESSAGE_IN_PROGRESS, {});
+    }
+    else if (Stream.EventName == OrionWebServer::SSEOpenAIEventNames::THREAD_RUN_REQUIRES_ACTION)
+    {
+        // Parse the data
+        web::json::value JRun = web::json::value::parse(Stream.EventData);
 
-                if (auto JRequiredAction = JRun.at("required_action"); JRequiredAction.at("type").as_string() == "submit_tool_outputs")
-                {
-                    auto JSumbitToolOutputs = JRequiredAction.at("submit_tool_outputs");
-                    auto JToolCalls         = JSumbitToolOutputs.at("tool_calls").as_array();
+        if (auto JRequiredAction = JRun.at("required_action"); JRequiredAction.at("type").as_string() == "submit_tool_outputs")
+        {
+            auto JSumbitToolOutputs = JRequiredAction.at("submit_tool_outputs");
+            auto JToolCalls         = JSumbitToolOutputs.at("tool_calls").as_array();
+
+            // Create responses for each tool call
+            auto ToolCallOutputs = web::json::value::array();
 
-                    // Create responses for each tool call
-                    auto ToolCallOutputs = web::json::value::array();
+            for (auto& JToolCall : JToolCalls)
+            {
+                if (JToolCall.at("type").as_string() == "function")
+                {
+                    // Get the tool call
+                    auto       JFunctionToolCall = JToolCall.at("function");
+                    const auto TOOL_NAME         = JFunctionToolCall.at("name").as_string();
+                    const auto TOOL_ARGS         = web::json::value::parse(JFunctionToolCall.at("arguments").as_string());
+
+                    IOrionTool* pTool = nullptr;
+                    if (const auto TOOL_IT = std::find_if(m_Tools.begin(), m_Tools.end(), [TOOL_NAME](const auto& Tool) { return Tool->GetName() == TOOL_NAME; });
+                        TOOL_IT != std::end(m_Tools))
+                    {
+                        pTool = TOOL_IT->get();
+                    }
 
-                    for (auto& JToolCall : JToolCalls)
+                    // If the tool is not found, it might be a plugin
+                    if (!pTool)
                     {
-                        if (JToolCall.at("type").as_string() == "function")
+                        // Get the tool from the plugin. First, Iterate through the plugins and for each plugin, iterate through the tools to find the tool.  use std::find
+                        // to find the tool
+                        for (const auto& Plugin : m_Plugins)
                         {
-                            // Get the tool call
-                            auto       JFunctionToolCall = JToolCall.at("function");
-                            const auto TOOL_NAME         = JFunctionToolCall.at("name").as_string();
-                            const auto TOOL_ARGS         = web::json::value::parse(JFunctionToolCall.at("arguments").as_string());
-
-                            IOrionTool* pTool = nullptr;
-                            if (const auto TOOL_IT = std::find_if(m_Tools.begin(), m_Tools.end(), [TOOL_NAME](const auto& Tool) { return Tool->GetName() == TOOL_NAME; });
-                                TOOL_IT != std::end(m_Tools))
-                            {
-                                pTool = TOOL_IT->get();
-                            }
+                            const auto PLUGIN_TOOLS = Plugin->GetPlugin()->GetTools();
 
-                            // If the tool is not found, it might be a plugin
-                            if (!pTool)
+                            if (const auto PLUGIN_TOOL_ITER =
+                                    std::find_if(PLUGIN_TOOLS.begin(), PLUGIN_TOOLS.end(), [TOOL_NAME](const auto& Tool) { return Tool->GetName() == TOOL_NAME; });
+                                PLUGIN_TOOL_ITER != std::end(PLUGIN_TOOLS))
                             {
-                                // Get the tool from the plugin. First, Iterate through the plugins and for each plugin, iterate through the tools to find the tool.  use std::find
-                                // to find the tool
-                                for (const auto& Plugin : m_Plugins)
-                                {
-                                    const auto PLUGIN_TOOLS = Plugin->GetPlugin()->GetTools();
-
-                                    if (const auto PLUGIN_TOOL_ITER =
-                                            std::find_if(PLUGIN_TOOLS.begin(), PLUGIN_TOOLS.end(), [TOOL_NAME](const auto& Tool) { return Tool->GetName() == TOOL_NAME; });
-                                        PLUGIN_TOOL_ITER != std::end(PLUGIN_TOOLS))
-                                    {
-                                        pTool = (*PLUGIN_TOOL_ITER);
-                                        break;
-                                    }
-                                }
+                                pTool = (*PLUGIN_TOOL_ITER);
+                                break;
                             }
+                        }
+                    }
 
-                            if (pTool)
-                            {
-                                // Get the tool
-                                if (auto pFunctionTool = dynamic_cast<FunctionTool*>(pTool); !pFunctionTool)
-                                {
-                                    std::cout << __func__ << ": Tool is not a function tool: " << TOOL_NAME << std::endl;
-
-                                    // A built-in tool
-                                    auto JOutput            = web::json::value::object();
-                                    JOutput["tool_call_id"] = JToolCall.at("id");
-                                    JOutput["output"]       = web::json::value::string("");
-
-                                    // Add the tool call outputs to the responses
-                                    ToolCallOutputs[ToolCallOutputs.size()] = JOutput;
-                                }
-                                else
-                                {
-                                    // Get the tool call outputs
-                                    auto JFunctionOutputs = pFunctionTool->Execute(*this, TOOL_ARGS);
-
-                                    // Create the tool call outputs
-                                    auto JOutput            = web::json::value::object();
-                                    JOutput["tool_call_id"] = JToolCall.at("id");
-                                    JOutput["output"]       = web::json::value::string(JFunctionOutputs);
-
-                                    // Add the tool call outputs to the responses
-                                    ToolCallOutputs[ToolCallOutputs.size()] = JOutput;
-                                }
-                            }
-                            else
-                            {
-                                // Possibly a hallucination
-                                auto JOutput            = web::json::value::object();
-                                JOutput["tool_call_id"] = JToolCall.at("id");
-                                JOutput["output"]       = JToolCall.at("output");
+                    if (pTool)
+                    {
+                        // Get the tool
+                        if (auto pFunctionTool = dynamic_cast<FunctionTool*>(pTool); !pFunctionTool)
+                        {
+                            Log::Warning("orion.tools", "Tool is not a function tool", {{"tool", TOOL_NAME}});
 
-                                // Add the tool call outputs to the responses
-                                ToolCallOutputs[ToolCallOutputs.size()] = JOutput;
-                            }
+                            // A built-in tool
+                            auto JOutput            = web::json::value::object();
+                            JOutput["tool_call_id"] = JToolCall.at("id");
+                            JOutput["output"]       = web::json::value::string("");
+
+                            // Add the tool call outputs to the responses
+                            ToolCallOutputs[ToolCallOutputs.size()] = JOutput;
                         }
                         else
                         {
-                            // Default to an empty output
+                            // Get the tool call outputs
+                            std::string JFunctionOutputs;
+                            {
+                                Tracing::ScopedSpan  ToolSpan("tool " + TOOL_NAME, {{"orion.tool", TOOL_NAME}});
+                                Metrics::ScopedTimer ToolTimer(Metrics::Registry::Get().GetHistogram("orion_tool_duration_seconds", "Time to execute a function tool",
+                                                                                                     {{"tool", TOOL_NAME}}));
+                                JFunctionOutputs = pFunctionTool->Execute(*this, TOOL_ARGS);
+                            }
+
+                            // Create the tool call outputs
                             auto JOutput            = web::json::value::object();
                             JOutput["tool_call_id"] = JToolCall.at("id");
-                            JOutput["output"]       = web::json::value::string("");
+                            JOutput["output"]       = web::json::value::string(JFunctionOutputs);
 
                             // Add the tool call outputs to the responses
                             ToolCallOutputs[ToolCallOutputs.size()] = JOutput;
                         }
                     }
-
-                    // Submit the tool call results
-                    web::http::http_request SubmitToolOutputsRequest(web::http::methods::POST);
-
-                    // Set the request uri
-                    SubmitToolOutputsRequest.set_request_uri(U("threads/" + m_CurrentThreadID + "/runs/" + JRun.at("id").as_string() + "/submit_tool_outputs"));
-
-                    // Set the headers
-                    SubmitToolOutputsRequest.headers().add("Authorization", "Bearer " + m_OpenAIAPIKey);
-                    SubmitToolOutputsRequest.headers().add("OpenAI-Beta", "assistants=v2");
-                    SubmitToolOutputsRequest.headers().add("Content-Type", "application/json");
-
-                    // Create the body
-                    web::json::value SubmitToolOutputsRequestBody = web::json::value::object();
-                    SubmitToolOutputsRequestBody["tool_outputs"]  = ToolCallOutputs;
-                    SubmitToolOutputsRequestBody["stream"]        = web::json::value::boolean(true);
-
-                    // Set the body
-                    SubmitToolOutputsRequest.set_body(SubmitToolOutputsRequestBody);
-
-                    // Send the request and get the response (blocking)
-                    auto SubmitToolOutputsResponse = m_OpenAIClient->request(SubmitToolOutputsRequest).get();
-
-                    if (SubmitToolOutputsResponse.status_code() != web::http::status_codes::OK)
+                    else
                     {
-                        std::cerr << "Failed to submit the tool outputs" << std::endl;
-                        std::cout << SubmitToolOutputsResponse.to_string() << std::endl;
-                    }
+                        // Possibly a hallucination
+                        auto JOutput            = web::json::value::object();
+                        JOutput["tool_call_id"] = JToolCall.at("id");
+                        JOutput["output"]       = JToolCall.at("output");
 
-                    ProcessOpenAIEventStream(SubmitToolOutputsResponse.body());
+                        // Add the tool call outputs to the responses
+                        ToolCallOutputs[ToolCallOutputs.size()] = JOutput;
+                    }
                 }
-            }
-            else if (EventName == OrionWebServer::SSEOpenAIEventNames::THREAD_RUN_STEP_CREATED)
-            {
-                const auto JRUN_STEP     = web::json::value::parse(EventData);
-                const auto JSTEP_DETAILS = JRUN_STEP.at("step_details");
-
-                if (const auto STEP_TYPE = JSTEP_DETAILS.at("type").as_string(); STEP_TYPE == "tool_calls")
+                else
                 {
-                    auto JEventData = web::json::value::object();
+                    // Default to an empty output
+                    auto JOutput            = web::json::value::object();
+                    JOutput["tool_call_id"] = JToolCall.at("id");
+                    JOutput["output"]       = web::json::value::string("");
 
-                    // Send the message to the client
-                    m_pOrionWebServer->SendServerEvent(OrionWebServer::SSEOrionEventNames::TOOL_STARTED, JEventData);
+                    // Add the tool call outputs to the responses
+                    ToolCallOutputs[ToolCallOutputs.size()] = JOutput;
                 }
             }
-            else if (EventName == OrionWebServer::SSEOpenAIEventNames::THREAD_RUN_STEP_DELTA)
-            {
-                const auto JRUN_STEP     = web::json::value::parse(EventData);
-                const auto JSTEP_DETAILS = JRUN_STEP.at("delta").at("step_details");
-
-                if (const auto STEP_TYPE = JSTEP_DETAILS.at("type").as_string(); STEP_TYPE == "tool_calls")
-                {
-                    auto JEventData = web::json::value::object();
 
-                    if (const auto JTOOL_CALL = JSTEP_DETAILS.at("tool_calls").as_array().at(0); JTOOL_CALL.at("type").as_string() == "function")
-                    {
-                        const auto JFUNCTION       = JTOOL_CALL.at("function");
-                        const auto FUNCTION_NAME   = JFUNCTION.has_field("name") ? JFUNCTION.at("name") : web::json::value::string("");
-                        const auto FUNCTION_ARGS   = JFUNCTION.has_field("arguments") ? JFUNCTION.at("arguments") : web::json::value::string("");
-                        const auto FUNCTION_OUTPUT = JFUNCTION.has_field("output") ? JFUNCTION.at("output") : web::json::value::object();
-
-                        JEventData["name"]   = FUNCTION_NAME;
-                        JEventData["args"]   = FUNCTION_ARGS;
-                        JEventData["output"] = FUNCTION_OUTPUT;
-                    }
-                    else if (JTOOL_CALL.at("type").as_string() == "code_interpreter")
+            // Submit the tool call results. The run goes on in the response's event stream, which is read before this one
+            return m_OpenAIClient->SubmitToolOutputsStream(m_CurrentThreadID, JRun.at("id").as_string(), ToolCallOutputs)
+                .then(
+                    [this, pTrace = Stream.pTrace, SPAN_ID = Stream.SpanID](pplx::task<web::http::http_response> SubmitToolOutputsTask)
                     {
-                        const auto JCODE_INTERPRETER = JTOOL_CALL.at("code_interpreter");
-                        const auto INPUT             = JCODE_INTERPRETER.has_field("input") ? JCODE_INTERPRETER.at("input") : web::json::value::string("");
-                        const auto OUTPUTS           = JCODE_INTERPRETER.has_field("outputs") ? JCODE_INTERPRETER.at("outputs") : web::json::value::array();
+                        Tracing::TraceScope Scope(pTrace, SPAN_ID);
 
-                        JEventData["name"]   = web::json::value::string("code_interpreter");
-                        JEventData["args"]   = INPUT;
-                        JEventData["output"] = OUTPUTS;
-                    }
+                        web::http::http_response SubmitToolOutputsResponse;
+                        try
+                        {
+                            SubmitToolOutputsResponse = SubmitToolOutputsTask.get();
+                        }
+                        catch (const std::exception& Exception)
+                        {
+                            Log::Error("orion.tools", "Failed to submit the tool outputs", {{"error", Exception.what()}});
+                            return pplx::task_from_result();
+                        }
+                        return ProcessOpenAIEventStreamAsync(SubmitToolOutputsResponse.body());
+                    });
+        }
+    }
+    else if (Stream.EventName == OrionWebServer::SSEOpenAIEventNames::THREAD_RUN_STEP_CREATED)
+    {
+        const auto JRUN_STEP     = web::json::value::parse(Stream.EventData);
+        const auto JSTEP_DETAILS = JRUN_STEP.at("step_details");
 
-                    // Send the message to the client
-                    m_pOrionWebServer->SendServerEvent(OrionWebServer::SSEOrionEventNames::TOOL_DELTA, JEventData);
-                }
-            }
-            else if (EventName == OrionWebServer::SSEOpenAIEventNames::THREAD_RUN_STEP_COMPLETED)
-            {
-                const auto JRUN_STEP     = web::json::value::parse(EventData);
-                const auto JSTEP_DETAILS = JRUN_STEP.at("step_details");
+        if (const auto STEP_TYPE = JSTEP_DETAILS.at("type").as_string(); STEP_TYPE == "tool_calls")
+        {
+            auto JEventData = web::json::value::object();
 
-                if (const auto STEP_TYPE = JSTEP_DETAILS.at("type").as_string(); STEP_TYPE == "tool_calls")
-                {
-                    auto JEventData = web::json::value::object();
+            // Send the message to the client
+            m_pOrionWebServer->SendServerEvent(Stream.UserID, OrionWebServer::SSEOrionEventNames::TOOL_STARTED, std::move(JEventData));
+        }
+    }
+    else if (Stream.EventName == OrionWebServer::SSEOpenAIEventNames::THREAD_RUN_STEP_DELTA)
+    {
+        const auto JRUN_STEP     = web::json::value::parse(Stream.EventData);
+        const auto JSTEP_DETAILS = JRUN_STEP.at("delta").at("step_details");
 
-                    if (const auto JTOOL_CALL = JSTEP_DETAILS.at("tool_calls").as_array().at(0); JTOOL_CALL.at("type").as_string() == "function")
-                    {
-                        const auto JFUNCTION       = JTOOL_CALL.at("function");
-                        const auto FUNCTION_NAME   = JFUNCTION.has_field("name") ? JFUNCTION.at("name") : web::json::value::string("");
-                        const auto FUNCTION_ARGS   = JFUNCTION.has_field("arguments") ? JFUNCTION.at("arguments") : web::json::value::string("");
-                        const auto FUNCTION_OUTPUT = JFUNCTION.has_field("output") ? JFUNCTION.at("output") : web::json::value::object();
-
-                        JEventData["name"]   = FUNCTION_NAME;
-                        JEventData["args"]   = FUNCTION_ARGS;
-                        JEventData["output"] = FUNCTION_OUTPUT;
-                    }
-                    else if (JTOOL_CALL.at("type").as_string() == "code_interpreter")
-                    {
-                        const auto JCODE_INTERPRETER = JTOOL_CALL.at("code_interpreter");
-                        const auto INPUT             = JCODE_INTERPRETER.has_field("input") ? JCODE_INTERPRETER.at("input") : web::json::value::string("");
-                        const auto OUTPUTS           = JCODE_INTERPRETER.has_field("outputs") ? JCODE_INTERPRETER.at("outputs") : web::json::value::array();
+        if (const auto STEP_TYPE = JSTEP_DETAILS.at("type").as_string(); STEP_TYPE == "tool_calls")
+        {
+            auto JEventData = web::json::value::object();
 
-                        JEventData["name"]   = web::json::value::string("code_interpreter");
-                        JEventData["args"]   = INPUT;
-                        JEventData["output"] = OUTPUTS;
-                    }
+            if (const auto JTOOL_CALL = JSTEP_DETAILS.at("tool_calls").as_array().at(0); JTOOL_CALL.at("type").as_string() == "function")
+            {
+                const auto JFUNCTION       = JTOOL_CALL.at("function");
+                const auto FUNCTION_NAME   = JFUNCTION.has_field("name") ? JFUNCTION.at("name") : web::json::value::string("");
+                const auto FUNCTION_ARGS   = JFUNCTION.has_field("arguments") ? JFUNCTION.at("arguments") : web::json::value::string("");
+                const auto FUNCTION_OUTPUT = JFUNCTION.has_field("output") ? JFUNCTION.at("output") : web::json::value::object();
+
+                JEventData["name"]   = FUNCTION_NAME;
+                JEventData["args"]   = FUNCTION_ARGS;
+                JEventData["output"] = FUNCTION_OUTPUT;
+            }
+            else if (JTOOL_CALL.at("type").as_string() == "code_interpreter")
+            {
+                const auto JCODE_INTERPRETER = JTOOL_CALL.at("code_interpreter");
+                const auto INPUT             = JCODE_INTERPRETER.has_field("input") ? JCODE_INTERPRETER.at("input") : web::json::value::string("");
+                const auto OUTPUTS           = JCODE_INTERPRETER.has_field("outputs") ? JCODE_INTERPRETER.at("outputs") : web::json::value::array();
 
-                    // Send the message to the client
-                    m_pOrionWebServer->SendServerEvent(OrionWebServer::SSEOrionEventNames::TOOL_COMPLETED, JEventData);
-                }
+                JEventData["name"]   = web::json::value::string("code_interpreter");
+                JEventData["args"]   = INPUT;
+                JEventData["output"] = OUTPUTS;
             }
 
-            EventName.clear();
-            EventData.clear();
+            // Send the message to the client
+            m_pOrionWebServer->SendServerEvent(Stream.UserID, OrionWebServer::SSEOrionEventNames::TOOL_DELTA, std::move(JEventData));
         }
-        else
+    }
+    else if (Stream.EventName == OrionWebServer::SSEOpenAIEventNames::THREAD_RUN_STEP_COMPLETED)
+    {
+        const auto JRUN_STEP     = web::json::value::parse(Stream.EventData);
+        const auto JSTEP_DETAILS = JRUN_STEP.at("step_details");
+
+        if (const auto STEP_TYPE = JSTEP_DETAILS.at("type").as_string(); STEP_TYPE == "tool_calls")
         {
-            if (constexpr std::string_view EVENT_PREFIX = "event: "; Line.find(EVENT_PREFIX) == 0)
+            auto JEventData = web::json::value::object();
+
+            if (const auto JTOOL_CALL = JSTEP_DETAILS.at("tool_calls").as_array().at(0); JTOOL_CALL.at("type").as_string() == "function")
             {
-                EventName = Line.substr(EVENT_PREFIX.length());
+                const auto JFUNCTION       = JTOOL_CALL.at("function");
+                const auto FUNCTION_NAME   = JFUNCTION.has_field("name") ? JFUNCTION.at("name") : web::json::value::string("");
+                const auto FUNCTION_ARGS   = JFUNCTION.has_field("arguments") ? JFUNCTION.at("arguments") : web::json::value::string("");
+                const auto FUNCTION_OUTPUT = JFUNCTION.has_field("output") ? JFUNCTION.at("output") : web::json::value::object();
+
+                JEventData["name"]   = FUNCTION_NAME;
+                JEventData["args"]   = FUNCTION_ARGS;
+                JEventData["output"] = FUNCTION_OUTPUT;
             }
-            else if (constexpr std::string_view DATA_PREFIX = "data: "; Line.find(DATA_PREFIX) == 0)
+            else if (JTOOL_CALL.at("type").as_string() == "code_interpreter")
             {
-                EventData += Line.substr(DATA_PREFIX.length());
+                const auto JCODE_INTERPRETER = JTOOL_CALL.at("code_interpreter");
+                const auto INPUT             = JCODE_INTERPRETER.has_field("input") ? JCODE_INTERPRETER.at("input") : web::json::value::string("");
+                const auto OUTPUTS           = JCODE_INTERPRETER.has_field("outputs") ? JCODE_INTERPRETER.at("outputs") : web::json::value::array();
+
+                JEventData["name"]   = web::json::value::string("code_interpreter");
+                JEventData["args"]   = INPUT;
+                JEventData["output"] = OUTPUTS;
             }
+
+            // Send the message to the client
+            m_pOrionWebServer->SendServerEvent(Stream.UserID, OrionWebServer::SSEOrionEventNames::TOOL_COMPLETED, std::move(JEventData));
         }
     }
+
+
+    return std::nullopt;
 }
\ No newline at end of file
@@ -0,0 +1,344 @@
+#include "OrionEventDispatcher.hpp"
+#include "Logger.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <functional>
+#include <sstream>
+
+using namespace ORION;
+
+namespace
+{
+    /// @brief  How often the shard threads look for idle channels to evict
+    constexpr auto SWEEP_INTERVAL = std::chrono::seconds(30);
+} // namespace
+
+OrionEventDispatcher::OrionEventDispatcher(const size_t SHARD_COUNT, const size_t REPLAY_BUFFER_SIZE)
+    : m_ReplayBufferSize(REPLAY_BUFFER_SIZE),
+      m_Epoch(std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count())
+{
+    // Default to one shard per hardware thread
+    const size_t RESOLVED_SHARD_COUNT = SHARD_COUNT > 0 ? SHARD_COUNT : std::max<size_t>(1, std::thread::hardware_concurrency());
+
+    m_Shards.reserve(RESOLVED_SHARD_COUNT);
+    for (size_t Index = 0; Index < RESOLVED_SHARD_COUNT; ++Index)
+    {
+        m_Shards.push_back(std::make_unique<Shard>());
+    }
+}
+
+OrionEventDispatcher::~OrionEventDispatcher()
+{
+    Stop();
+}
+
+void OrionEventDispatcher::Start()
+{
+    if (m_IsRunning.exchange(true))
+    {
+        return;
+    }
+
+    for (const auto& pShard : m_Shards)
+    {
+        pShard->Thread = std::thread(std::bind(&OrionEventDispatcher::ShardThreadHandler, this, std::ref(*pShard)));
+    }
+}
+
+void OrionEventDispatcher::Stop()
+{
+    if (!m_IsRunning.exchange(false))
+    {
+        return;
+    }
+
+    for (const auto& pShard : m_Shards)
+    {
+        {
+            std::lock_guard<std::mutex> WakeLock(pShard->WakeMutex);
+        }
+        pShard->WakeConditionVariable.notify_one();
+    }
+
+    for (const auto& pShard : m_Shards)
+    {
+        if (pShard->Thread.joinable())
+        {
+            pShard->Thread.join();
+        }
+    }
+}
+
+void OrionEventDispatcher::Dispatch(const std::string& UserID, const std::string_view& Name, web::json::value&& Data)
+{
+    auto& TargetShard = GetShard(UserID);
+    m_QueuedEventCount.fetch_add(1, std::memory_order_relaxed);
+
+    // Only the producer that turns the queue from empty to non-empty can find the shard thread asleep. Everyone else's event
+    // will be picked up by the drain that takes the earlier ones.
+    if (TargetShard.Queue.Push(std::make_unique<Event>(UserID, Name, std::move(Data))))
+    {
+        WakeShard(TargetShard);
+    }
+}
+
+uint64_t OrionEventDispatcher::Subscribe(const std::string& UserID, EventSink Sink, const std::string& LastEventID)
+{
+    auto& TargetShard = GetShard(UserID);
+
+    const uint64_t SUBSCRIPTION_ID = ++m_LastSubscriptionID;
+
+    std::lock_guard<std::mutex> ChannelsLockGuard(TargetShard.ChannelsMutex);
+    auto&                       Channel = GetChannel(TargetShard, UserID);
+
+    // Replay the events the client missed. This happens under the same lock the shard thread delivers under, so the client sees
+    // every event exactly once and in order
+    if (!LastEventID.empty())
+    {
+        const auto LAST_SEQUENCE = ParseEventID(LastEventID);
+
+        // The oldest event still in the ring buffer
+        const uint64_t OLDEST_SEQUENCE =
+            std::max(Channel.FirstSequence, Channel.LastSequence >= Channel.RecentEvents.size() ? Channel.LastSequence - Channel.RecentEvents.size() + 1 : 1);
+
+        if (LAST_SEQUENCE && *LAST_SEQUENCE <= Channel.LastSequence && *LAST_SEQUENCE + 1 >= OLDEST_SEQUENCE)
+        {
+            std::vector<const RecordedEvent*> MissedEvents;
+            for (uint64_t Sequence = *LAST_SEQUENCE + 1; Sequence <= Channel.LastSequence; ++Sequence)
+            {
+                MissedEvents.push_back(&Channel.RecentEvents[Sequence % Channel.RecentEvents.size()]);
+            }
+
+            if (!MissedEvents.empty())
+            {
+                Sink(MissedEvents);
+            }
+        }
+        else
+        {
+            // The missed events are gone (or the id is from before a restart), the client has to reload its state. The event carries the
+            // current id so the client can resume from here on its next reconnect
+            const RecordedEvent RESYNC_EVENT {Channel.LastSequence, std::string(RESYNC_EVENT_NAME), "{}"};
+            Sink({&RESYNC_EVENT});
+        }
+    }
+
+    Channel.Subscribers.push_back(Subscriber {SUBSCRIPTION_ID, std::move(Sink)});
+    ++m_SubscriberCount;
+
+    return SUBSCRIPTION_ID;
+}
+
+void OrionEventDispatcher::Unsubscribe(const std::string& UserID, const uint64_t SubscriptionID)
+{
+    auto& TargetShard = GetShard(UserID);
+
+    std::lock_guard<std::mutex> ChannelsLockGuard(TargetShard.ChannelsMutex);
+    if (const auto CHANNEL_ITER = TargetShard.Channels.find(UserID); CHANNEL_ITER != TargetShard.Channels.end())
+    {
+        auto&      Subscribers  = CHANNEL_ITER->second.Subscribers;
+        const auto REMOVED_ITER = std::remove_if(Subscribers.begin(), Subscribers.end(), [SubscriptionID](const Subscriber& Sub) { return Sub.SubscriptionID == SubscriptionID; });
+        m_SubscriberCount -= std::distance(REMOVED_ITER, Subscribers.end());
+        Subscribers.erase(REMOVED_ITER, Subscribers.end());
+
+        // The channel is kept for a while for the client to reconnect, then evicted by the shard thread
+        CHANNEL_ITER->second.LastActivity = std::chrono::steady_clock::now();
+    }
+}
+
+OrionEventDispatcher::Stats OrionEventDispatcher::GetStats() const
+{
+    Stats Result;
+    Result.Subscribers     = m_SubscriberCount;
+    Result.QueuedEvents    = m_QueuedEventCount.load(std::memory_order_relaxed);
+    Result.DeliveredEvents = m_DeliveredEventCount.load(std::memory_order_relaxed);
+    return Result;
+}
+
+OrionEventDispatcher::Shard& OrionEventDispatcher::GetShard(const std::string& UserID) const
+{
+    return *m_Shards[std::hash<std::string> {}(UserID) % m_Shards.size()];
+}
+
+OrionEventDispatcher::UserChannel& OrionEventDispatcher::GetChannel(Shard& InShard, const std::string& UserID)
+{
+    const auto [CHANNEL_ITER, IS_NEW] = InShard.Channels.try_emplace(UserID);
+    if (IS_NEW)
+    {
+        // Start after every sequence of an evicted channel, so a client's id from before the eviction is resynced rather than replayed
+        CHANNEL_ITER->second.LastSequence  = InShard.EvictedSequence;
+        CHANNEL_ITER->second.FirstSequence = InShard.EvictedSequence + 1;
+    }
+    return CHANNEL_ITER->second;
+}
+
+void OrionEventDispatcher::SweepChannels(Shard& InShard)
+{
+    const auto NOW = std::chrono::steady_clock::now();
+    if (NOW < InShard.NextSweep)
+    {
+        return;
+    }
+    InShard.NextSweep = NOW + SWEEP_INTERVAL;
+
+    std::lock_guard<std::mutex> ChannelsLockGuard(InShard.ChannelsMutex);
+    for (auto ChannelIter = InShard.Channels.begin(); ChannelIter != InShard.Channels.end();)
+    {
+        const auto& Channel = ChannelIter->second;
+        if (Channel.Subscribers.empty() && NOW - Channel.LastActivity >= CHANNEL_RETENTION)
+        {
+            InShard.EvictedSequence = std::max(InShard.EvictedSequence, Channel.LastSequence);
+            ChannelIter             = InShard.Channels.erase(ChannelIter);
+        }
+        else
+        {
+            ++ChannelIter;
+        }
+    }
+}
+
+void OrionEventDispatcher::WakeShard(Shard& InShard)
+{
+    // Producers only take the mutex when the worker is (about to be) asleep. Taking it before notifying guarantees the worker is either
+    // still going to re-check the queue or is already waiting, so the wake up can't be lost.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (InShard.IsSleeping.load())
+    {
+        {
+            std::lock_guard<std::mutex> WakeLock(InShard.WakeMutex);
+        }
+        InShard.WakeConditionVariable.notify_one();
+    }
+}
+
+std::string OrionEventDispatcher::FormatEventID(const uint64_t SEQUENCE) const
+{
+    return std::to_string(m_Epoch) + "-" + std::to_string(SEQUENCE);
+}
+
+std::optional<uint64_t> OrionEventDispatcher::ParseEventID(const std::string& EventID) const
+{
+    // Event ids are "<epoch>-<sequence>"
+    const auto SEPARATOR_POS = EventID.find('-');
+    if (SEPARATOR_POS == std::string::npos)
+    {
+        return std::nullopt;
+    }
+
+    uint64_t   Epoch        = 0;
+    uint64_t   Sequence     = 0;
+    const auto EPOCH_RESULT = std::from_chars(EventID.data(), EventID.data() + SEPARATOR_POS, Epoch);
+    const auto SEQ_RESULT   = std::from_chars(EventID.data() + SEPARATOR_POS + 1, EventID.data() + EventID.size(), Sequence);
+    if (EPOCH_RESULT.ec != std::errc() || SEQ_RESULT.ec != std::errc() || SEQ_RESULT.ptr != EventID.data() + EventID.size() || Epoch != m_Epoch)
+    {
+        return std::nullopt;
+    }
+
+    return Sequence;
+}
+
+void OrionEventDispatcher::DeliverToSubscribers(const UserChannel& Channel, const std::vector<const RecordedEvent*>& Events)
+{
+    for (const auto& Sub : Channel.Subscribers)
+    {
+        try
+        {
+            Sub.Sink(Events);
+        }
+        catch (const std::exception& Exception)
+        {
+            // The connection is going away; it is removed when its transport notices
+            Log::Warning("events", "Failed to deliver events", {{"error", Exception.what()}});
+        }
+    }
+}
+
+void OrionEventDispatcher::ShardThreadHandler(Shard& InShard)
+{
+    // The events of each user in the current batch. Emptied after each batch, so it only holds the users of the batch
+    std::unordered_map<std::string, std::vector<std::unique_ptr<Event>>> PendingEvents;
+    std::vector<const RecordedEvent*>                                    Batch;
+
+    // Holds the event being delivered when replay is disabled (no ring buffer)
+    RecordedEvent UnbufferedEvent;
+
+    while (true)
+    {
+        // Take every queued event at once and group them per user (in order)
+        const size_t EVENT_COUNT = InShard.Queue.Drain([&PendingEvents](std::unique_ptr<Event> pEvent) { PendingEvents[pEvent->UserID].push_back(std::move(pEvent)); });
+
+        if (EVENT_COUNT == 0)
+        {
+            if (!m_IsRunning)
+            {
+                // Queue is drained and we are stopping
+                break;
+            }
+
+            std::unique_lock<std::mutex> WakeLock(InShard.WakeMutex);
+            InShard.IsSleeping = true;
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            // Wait for an event to be queued or for the dispatcher to stop, waking up now and then to evict idle channels
+            InShard.WakeConditionVariable.wait_for(WakeLock, SWEEP_INTERVAL, [this, &InShard] { return !InShard.Queue.IsEmpty() || !m_IsRunning; });
+
+            InShard.IsSleeping = false;
+            WakeLock.unlock();
+
+            SweepChannels(InShard);
+            continue;
+        }
+
+        {
+            // Lock the channels of this shard once for the whole batch. Ids are assigned under the lock so that a subscribing client
+            // either gets an event replayed or delivered, never both
+            std::lock_guard<std::mutex> ChannelsLockGuard(InShard.ChannelsMutex);
+
+            for (auto& [UserID, Events] : PendingEvents)
+            {
+                auto& Channel        = GetChannel(InShard, UserID);
+                Channel.LastActivity = std::chrono::steady_clock::now();
+                if (Channel.RecentEvents.size() != m_ReplayBufferSize)
+                {
+                    Channel.RecentEvents.resize(m_ReplayBufferSize);
+                }
+
+                // The batch must be delivered before the ring buffer wraps around onto its first event
+                const size_t MAX_BATCH_SIZE = std::max<size_t>(1, Channel.RecentEvents.size());
+
+                for (const auto& pEvent : Events)
+                {
+                    const uint64_t SEQUENCE = ++Channel.LastSequence;
+
+                    // Record the event in its ring buffer slot (reusing the slot's allocations)
+                    auto& Recorded    = Channel.RecentEvents.empty() ? UnbufferedEvent : Channel.RecentEvents[SEQUENCE % Channel.RecentEvents.size()];
+                    Recorded.Sequence = SEQUENCE;
+                    Recorded.Name     = pEvent->Name;
+                    Recorded.Data     = pEvent->Data.serialize();
+                    Batch.push_back(&Recorded);
+
+                    if (Batch.size() >= MAX_BATCH_SIZE)
+                    {
+                        DeliverToSubscribers(Channel, Batch);
+                        Batch.clear();
+                    }
+                }
+
+                // Send all of the user's remaining events in the batch to each of the user's clients at once
+                if (!Batch.empty())
+                {
+                    DeliverToSubscribers(Channel, Batch);
+                    Batch.clear();
+                }
+            }
+        }
+
+        PendingEvents.clear();
+        SweepChannels(InShard);
+
+        m_QueuedEventCount.fetch_sub(EVENT_COUNT, std::memory_order_relaxed);
+        m_DeliveredEventCount.fetch_add(EVENT_COUNT, std::memory_order_relaxed);
+    }
+}
@@ -1,22 +1,101 @@
 #include "OrionWebServer.hpp"
+#include "Compression.hpp"
+#include "FormData.hpp"
 #include "GUID.hpp"
+#include "HttpRange.hpp"
+#include "Logger.hpp"
+#include "MappedFile.hpp"
+#include "Metrics.hpp"
 #include "MimeTypes.hpp"
+#include "OpenAIClient.hpp"
 #include "Orion.hpp"
+#include "TLSServerContext.hpp"
+#include "Tracing.hpp"
+#include "UploadCache.hpp"
+#include "Upstream.hpp"
 #include "User.hpp"
 #include "tools/CodeInterpreterTool.hpp"
 #include "tools/RetrievalTool.hpp"
 
 #include <cmark.h>
 
+#include <cpprest/containerstream.h>
 #include <cpprest/filestream.h>
 #include <cpprest/producerconsumerstream.h>
+#include <cpprest/rawptrstream.h>
+#include <pplx/threadpool.h>
 
 #include <filesystem>
 
-#include <sqlite_modern_cpp.h>
-
 using namespace ORION;
 
+namespace
+{
+    /// @brief  Get the route of a request path for the request metrics (paths with ids or file names are grouped so the series stay bounded)
+    std::string GetRouteLabel(const std::string& Path)
+    {
+        static const std::vector<std::string> ROUTES = {"/",
+                                                        "/login",
+                                                        "/register",
+                                                        "/markdown",
+                                                        "/metrics",
+                                                        "/debug/traces",
+                                                        "/orion/send_message",
+                                                        "/orion/chat_history",
+                                                        "/orion/speak",
+                                                        "/orion/transcribe",
+                                                        "/orion/events"};
+        if (std::find(ROUTES.begin(), ROUTES.end(), Path) != ROUTES.end())
+        {
+            return Path;
+        }
+        if (Path.find("/orion/files/") != std::string::npos)
+        {
+            return "/orion/files";
+        }
+        if (Path.find("/debug/traces/") == 0)
+        {
+            return "/debug/traces/:id";
+        }
+        if (Path.find("/assets/") != std::string::npos)
+        {
+            return "/assets";
+        }
+        if (Path.find("orion/plugins") != std::string::npos)
+        {
+            return "/orion/plugins";
+        }
+        return "other";
+    }
+
+    /// @brief  Check whether a request comes from the loopback interface, directly rather than through a proxy on the same host
+    bool IsLoopbackRequest(const web::http::http_request& Request)
+    {
+        const auto& HEADERS = Request.headers();
+        if (HEADERS.has(U("X-Forwarded-For")) || HEADERS.has(U("Forwarded")) || HEADERS.has(U("X-Real-IP")))
+        {
+            return false;
+        }
+
+        const auto ADDRESS = Request.remote_address();
+        return ADDRESS == U("::1") || ADDRESS.rfind(U("127."), 0) == 0 || ADDRESS.rfind(U("::ffff:127."), 0) == 0;
+    }
+
+    /// @brief  Get the message shown to a user whose message was not admitted
+    std::string GetAdmissionRejectionMessage(const AdmissionController::EDecision DECISION)
+    {
+        switch (DECISION)
+        {
+            case AdmissionController::EDecision::RateLimited:
+                return U("Too many messages. Please slow down.");
+            case AdmissionController::EDecision::Draining:
+                return U("The server is restarting. Please try again in a moment.");
+            default:
+                return U("The server is busy. Please try again later.");
+        }
+    }
+} // namespace
+
 std::string OrionWebServer::AssetDirectories::ResolveBaseAssetDirectory(const std::string& Extension)
 {
     // Get the mime type
@@ -57,21 +136,97 @@ std::string OrionWebServer::AssetDirectories::ResolveBaseAssetDirectory(const st
     }
 }
 
-void OrionWebServer::Start(const int PORT)
+OrionWebServer::OrionWebServer(const OrionWebServerOptions& OPTIONS)
+    : m_Options(OPTIONS),
+      m_EventDispatcher(OPTIONS.EventDispatchShardCount, OPTIONS.EventReplayBufferSize),
+      m_AdmissionController(OPTIONS.Admission),
+      // The users database lives under the assets directory and must never be served
+      m_AssetCache(std::filesystem::current_path() / AssetDirectories::STATIC_ASSETS_DIR, {AssetDirectories::STATIC_DATABASE_DIR}),
+      m_UserStore(std::filesystem::path(AssetDirectories::DATABASE_FILE), OPTIONS.UserStoreConnectionCount)
 {
+}
+
+OrionWebServer::~OrionWebServer()
+{
+    // The callbacks read this server's state
+    for (const auto& [Name, InLabels] : m_MetricCallbacks)
+    {
+        Metrics::Registry::Get().RemoveCallback(Name, InLabels);
+    }
+}
+
+void OrionWebServer::Start(const int PORT, const int WEBSOCKET_PORT)
+{
+    m_Options.Port          = PORT;
+    m_Options.WebSocketPort = WEBSOCKET_PORT;
+    Start();
+}
+
+void OrionWebServer::Start()
+{
+    // Configure the log first, so everything the server logs while starting follows it
+    if (std::string LogError; !Log::Logger::Get().Configure(m_Options.Logging, LogError))
+    {
+        Log::Error("server", "Invalid log settings", {{"error", LogError}});
+    }
+    Log::Info("server", "Starting the Orion web server", {{"options", m_Options.Describe()}});
+
+    // Size the worker pool before anything uses it. cpprestsdk runs the listener's io and every pplx continuation on this one pool, and the
+    // handlers block on it (.get()/.wait()), so the default of 40 threads runs dry under load on large machines
+    try
+    {
+        crossplat::threadpool::initialize_with_threads(m_Options.GetWorkerThreadCount());
+    }
+    catch (const std::exception& Exception)
+    {
+        Log::Warning("server", "The worker pool was already created, its size is unchanged", {{"error", Exception.what()}});
+    }
+
+    RegisterMetrics();
+    Tracing::TraceStore::Get().Configure(m_Options.TraceBufferSize, m_Options.TraceDirectory);
+    if (std::string UpstreamError; !Upstream::Configure(m_Options.OpenAI, UpstreamError))
+    {
+        Log::Error("server", "Invalid OpenAI transport settings, requests go to the API", {{"error", UpstreamError}});
+    }
+    OpenAI::Configure(m_Options.OpenAIRetries);
+    OpenAI::Configure(m_Options.OpenAIRateLimits);
+
+    // Open the users database (login and registration fail until it is usable)
+    if (!m_UserStore.Open())
+    {
+        Log::Error("server", "Failed to open the users database", {{"path", AssetDirectories::DATABASE_FILE}});
+    }
+
+    // Open the cache of uploaded attachments (every attachment is uploaded until it is usable)
+    if (!UploadCache::Get().Open(AssetDirectories::UPLOADS_DATABASE_FILE, m_Options.UploadCache))
+    {
+        Log::Error("server", "Failed to open the upload cache, attachments are always uploaded", {{"path", AssetDirectories::UPLOADS_DATABASE_FILE}});
+    }
+
+    // Load the certificate and key once; every connection's ssl context is configured from them and shares the session ticket keys
     web::http::experimental::listener::http_listener_config ListenerConfig;
-    ListenerConfig.set_ssl_context_callback(
-        [this](boost::asio::ssl::context& Ctx)
+    if (m_Options.IsTLSEnabled)
+    {
+        std::string TLSError;
+        m_pTLSContext = TLSServerContext::Create(m_Options.TLS, TLSError);
+        if (!m_pTLSContext)
         {
-            Ctx.set_options(boost::asio::ssl::context::default_workarounds | boost::asio::ssl::context::no_sslv2 | boost::asio::ssl::context::no_sslv3 |
-                            boost::asio::ssl::context::single_dh_use);
-            Ctx.set_password_callback([](std::size_t MaxLength, boost::asio::ssl::context::password_purpose Purpose) { return "test"; });
-            Ctx.use_certificate_chain_file("cert.pem");
-            Ctx.use_private_key_file("key.pem", boost::asio::ssl::context::pem);
-        });
+            Log::Error("server", "Failed to set up TLS", {{"error", TLSError}});
+            return;
+        }
+
+        ListenerConfig.set_ssl_context_callback(
+            [pTLSContext = m_pTLSContext](boost::asio::ssl::context& Ctx)
+            {
+                Ctx.set_options(boost::asio::ssl::context::default_workarounds);
+                pTLSContext->Apply(Ctx.native_handle());
+            });
+    }
 
     // Create a listener
-    m_Listener = web::http::experimental::listener::http_listener(U("https://0.0.0.0:") + std::to_string(PORT), ListenerConfig);
+    m_Listener = web::http::experimental::listener::http_listener((m_Options.IsTLSEnabled ? U("https://") : U("http://")) + m_Options.BindAddress + U(":") +
+                                                                      std::to_string(m_Options.Port),
+                                                                  ListenerConfig);
 
     // Handle requests
     m_Listener.support(web::http::methods::POST, std::bind(&OrionWebServer::HandleRequest, this, std::placeholders::_1));
@@ -80,17 +235,131 @@ void OrionWebServer::Start(const int PORT)
     // Start the listener
     m_IsRunning = m_Listener.open().wait() == pplx::task_status::completed ? true : false;
 
-    // Create orion event thread
-    m_OrionEventThread = std::thread(std::bind(&OrionWebServer::OrionEventThreadHandler, this));
+    // Load the static assets into memory (generated audio is cached on first request)
+    m_AssetCache.Preload({"audio"});
+
+    // Start the orion event dispatcher threads
+    m_EventDispatcher.Start();
+
+    // Start the WebSocket endpoint (TLS only)
+    if (m_Options.WebSocketPort > 0 && !m_Options.IsTLSEnabled)
+    {
+        Log::Warning("server", "The WebSocket endpoint requires TLS and is disabled");
+    }
+    else if (m_Options.WebSocketPort > 0)
+    {
+        OrionWebSocketServer::Callbacks WebSocketCallbacks;
+        WebSocketCallbacks.OnValidate = std::bind(&OrionWebServer::HandleWebSocketValidate, this, std::placeholders::_1);
+        WebSocketCallbacks.OnOpen     = std::bind(&OrionWebServer::HandleWebSocketOpen, this, std::placeholders::_1, std::placeholders::_2);
+        WebSocketCallbacks.OnMessage  = std::bind(&OrionWebServer::HandleWebSocketMessage, this, std::placeholders::_1, std::placeholders::_2);
+        WebSocketCallbacks.OnClose    = std::bind(&OrionWebServer::HandleWebSocketClose, this, std::placeholders::_1);
+
+        m_pWebSocketServer = std::make_unique<OrionWebSocketServer>(std::move(WebSocketCallbacks));
+        if (!m_pWebSocketServer->Start(m_Options.BindAddress, m_Options.WebSocketPort, m_pTLSContext))
+        {
+            Log::Error("server", "Failed to start the WebSocket endpoint", {{"port", std::to_string(m_Options.WebSocketPort)}});
+            m_pWebSocketServer.reset();
+        }
+    }
+}
+
+void OrionWebServer::RegisterMetrics()
+{
+    if (!m_MetricCallbacks.empty())
+    {
+        return;
+    }
+
+    const auto ADD_CALLBACK = [this](const Metrics::Registry::EType TYPE, const std::string& Name, const std::string& Help, const Metrics::Labels& InLabels,
+                                     std::function<double()> Read)
+    {
+        Metrics::Registry::Get().AddCallback(TYPE, Name, Help, InLabels, std::move(Read));
+        m_MetricCallbacks.emplace_back(Name, InLabels);
+    };
+
+    using EType = Metrics::Registry::EType;
+
+    ADD_CALLBACK(EType::Gauge, "orion_worker_threads", "Threads of the listener and task pool", {}, [this] { return m_Options.GetWorkerThreadCount(); });
+
+    // Runs and admission
+    ADD_CALLBACK(EType::Gauge, "orion_runs_in_flight", "Orion runs in progress", {}, [this] { return m_AdmissionController.GetStats().InFlight; });
+    ADD_CALLBACK(EType::Counter, "orion_run_admissions_total", "Messages sent to Orion by admission decision", {{"decision", "admitted"}},
+                 [this] { return m_AdmissionController.GetStats().Admitted; });
+    ADD_CALLBACK(EType::Counter, "orion_run_admissions_total", "Messages sent to Orion by admission decision", {{"decision", "rate_limited"}},
+                 [this] { return m_AdmissionController.GetStats().RateLimited; });
+    ADD_CALLBACK(EType::Counter, "orion_run_admissions_total", "Messages sent to Orion by admission decision", {{"decision", "overloaded"}},
+                 [this] { return m_AdmissionController.GetStats().Overloaded; });
+    ADD_CALLBACK(EType::Counter, "orion_run_admissions_total", "Messages sent to Orion by admission decision", {{"decision", "draining"}},
+                 [this] { return m_AdmissionController.GetStats().Draining; });
+
+    // Event delivery
+    ADD_CALLBACK(EType::Gauge, "orion_event_subscribers", "Clients subscribed to Orion events (event streams and WebSocket connections)", {},
+                 [this] { return m_EventDispatcher.GetStats().Subscribers; });
+    ADD_CALLBACK(EType::Gauge, "orion_event_queue_depth", "Orion events waiting to be delivered", {}, [this] { return m_EventDispatcher.GetStats().QueuedEvents; });
+    ADD_CALLBACK(EType::Counter, "orion_events_delivered_total", "Orion events delivered to the subscribers", {},
+                 [this] { return m_EventDispatcher.GetStats().DeliveredEvents; });
+    ADD_CALLBACK(EType::Gauge, "orion_event_streams", "Open /orion/events responses", {},
+                 [this]
+                 {
+                     std::lock_guard<std::mutex> EventStreamsLockGuard(m_EventStreamsMutex);
+                     return m_EventStreams.size();
+                 });
+    ADD_CALLBACK(EType::Gauge, "orion_websocket_connections", "Open /orion/ws connections", {},
+                 [this]
+                 {
+                     std::lock_guard<std::mutex> SessionsLockGuard(m_WebSocketSessionsMutex);
+                     return m_WebSocketSessions.size();
+                 });
 }
 
 void OrionWebServer::Stop()
 {
-    // Close the listener
+    if (m_IsStopping.exchange(true))
+    {
+        return;
+    }
+
+    // Refuse new messages (clients are told to retry shortly, by then they reach the replacement server) and let the runs in flight finish
+    m_AdmissionController.BeginDrain();
+    const auto IN_FLIGHT_RUNS = m_AdmissionController.GetStats().InFlight;
+    Log::Info("server", "Draining the Orion web server",
+              {{"timeout_seconds", std::to_string(m_Options.DrainTimeoutSeconds)}, {"runs_in_flight", std::to_string(IN_FLIGHT_RUNS)}});
+
+    if (!m_AdmissionController.WaitForInFlightRuns(std::chrono::seconds(m_Options.DrainTimeoutSeconds)))
+    {
+        // Cancel the runs that outlasted the deadline. Their event streams end (and their clients are told) once OpenAI stops them
+        Log::Warning("server", "Runs are still in flight, cancelling them", {{"runs_in_flight", std::to_string(m_AdmissionController.GetStats().InFlight)}});
+        std::vector<pplx::task<void>> CancelTasks;
+        for (const auto& pOrion : m_OrionInstances)
+        {
+            CancelTasks.push_back(pOrion->CancelCurrentRun());
+        }
+        pplx::when_all(CancelTasks.begin(), CancelTasks.end()).wait();
+
+        if (!m_AdmissionController.WaitForInFlightRuns(std::chrono::seconds(5)))
+        {
+            Log::Error("server", "Abandoning the runs in flight", {{"runs_in_flight", std::to_string(m_AdmissionController.GetStats().InFlight)}});
+        }
+    }
+
+    // Deliver the events that are still queued, then end the event streams and close the WebSocket connections
+    m_EventDispatcher.Stop();
+    {
+        std::lock_guard<std::mutex> EventStreamsLockGuard(m_EventStreamsMutex);
+        for (auto& [SubscriptionID, Buffer] : m_EventStreams)
+        {
+            Buffer.close(std::ios_base::out).wait();
+        }
+        m_EventStreams.clear();
+    }
+    if (m_pWebSocketServer)
+    {
+        m_pWebSocketServer->Stop();
+    }
+
+    // Let Wait() close the listener
     m_IsRunning = false;
     m_ConditionVariable.notify_one();
-    m_OrionEventQueueConditionVariable.notify_one();
-    m_OrionEventThread.join();
 }
 
 void OrionWebServer::Wait()
@@ -104,7 +373,7 @@ void OrionWebServer::Wait()
     // Close the listener
     if (m_Listener.close().wait() != pplx::task_status::completed)
     {
-        std::cout << __FUNCTION__ << ":" << __LINE__ << ": Failed to close http listener!";
+        Log::Error("server", "Failed to close the http listener");
     }
 }
 
@@ -117,8 +386,43 @@ void OrionWebServer::HandleRequest(const web::http::http_request& Request)
     // Store the current endpoint request
     m_CurrentRequest = Request;
 
+    // Record how long the request takes until it is replied to (for streams, until the headers are sent) and its status. Handlers that
+    // reply asynchronously are measured correctly since the response, not the handler, completes the task
+    Request.get_response().then(
+        [ROUTE = GetRouteLabel(PATH), METHOD = Request.method(), START = std::chrono::steady_clock::now()](const pplx::task<web::http::http_response>& ResponseTask)
+        {
+            try
+            {
+                const auto STATUS   = std::to_string(ResponseTask.get().status_code());
+                auto&      Registry = Metrics::Registry::Get();
+                Registry.GetHistogram("orion_http_request_duration_seconds", "Time from receiving a request to replying to it", {{"route", ROUTE}})
+                    .Observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - START).count());
+                Registry.GetCounter("orion_http_requests_total", "Requests served by route, method and status", {{"route", ROUTE}, {"method", METHOD}, {"status", STATUS}})
+                    .Increment();
+            }
+            catch (const std::exception&)
+            {
+                // The request was never replied to
+            }
+        });
+
+    // The metrics and traces describe every user, so they are only served locally unless configured otherwise
+    if ((PATH == U("/metrics") || PATH.find(U("/debug/")) == 0) && !m_Options.IsDebugEndpointPublic && !IsLoopbackRequest(Request))
+    {
+        ReplyWithText(Request, web::http::status_codes::Forbidden, "Forbidden", U("text/plain; charset=utf-8"));
+        return;
+    }
+
     // Dispatch the request to the appropriate handler
-    if (PATH == U("/orion/send_message"))
+    if (PATH == U("/metrics"))
+    {
+        HandleMetricsEndpoint(Request);
+    }
+    else if (PATH == U("/debug/traces") || PATH.find(U("/debug/traces/")) == 0)
+    {
+        HandleTracesEndpoint(Request);
+    }
+    else if (PATH == U("/orion/send_message"))
     {
         HandleSendMessageEndpoint(Request);
     }
@@ -207,54 +511,130 @@ void OrionWebServer::HandleSendMessageEndpoint(web::http::http_request Request)
         return;
     }
 
-    // Check if markdown is requested
-    const bool IS_MARKDOWN_REQUESTED = Request.request_uri().query().find(U("markdown=true")) != std::string::npos;
+    // Check that the user may start another run
+    const auto ADMISSION = m_AdmissionController.TryAdmit(USER_ID);
+    if (ADMISSION.Decision != AdmissionController::EDecision::Admitted)
+    {
+        const bool IS_RATE_LIMITED = ADMISSION.Decision == AdmissionController::EDecision::RateLimited;
 
-    // Extract the message and the files from the form data
-    Request.extract_json()
-        .then([this, OrionIt, Request, IS_MARKDOWN_REQUESTED](const pplx::task<web::json::value>& ExtractJsonTask) { return ExtractJsonTask; })
-        .then(
-            [this, OrionIt, Request, IS_MARKDOWN_REQUESTED](web::json::value JsonRequestBody)
-            {
-                // Get the message from the request body
-                const auto MESSAGE = JsonRequestBody.at(U("message")).as_string();
+        web::http::http_response Response(IS_RATE_LIMITED ? web::http::status_codes::TooManyRequests : web::http::status_codes::ServiceUnavailable);
+        Response.headers().add(U("Retry-After"), std::to_string(ADMISSION.RetryAfter.count()));
 
-                // Get the files from the request body
-                const auto FILES = JsonRequestBody.has_field(U("files")) ? JsonRequestBody.at(U("files")).as_array() : web::json::value::array().as_array();
+        auto JResponse          = web::json::value::object();
+        JResponse[U("message")] = web::json::value::string(GetAdmissionRejectionMessage(ADMISSION.Decision));
+        Response.set_body(JResponse);
 
-                // Send the message to the Orion instance
-                (*OrionIt)->SendMessageAsync(MESSAGE, FILES);
+        Request.reply(Response);
+        return;
+    }
 
-                // Send the response
-                Request.reply(web::http::status_codes::OK);
-            });
-}
+    // Send the message to the Orion instance. The run holds its admission ticket until it completes
+    const auto SendMessage = [Request, pOrion = OrionIt->get(), pTicket = ADMISSION.pTicket](const std::string& Message, auto Files)
+    {
+        pOrion->SendMessageAsync(Message, std::move(Files))
+            .then(
+                [pTicket](const pplx::task<void>& RunTask)
+                {
+                    try
+                    {
+                        RunTask.get();
+                    }
+                    catch (const std::exception& Exception)
+                    {
+                        Log::Error("orion", "Run failed", {{"error", Exception.what()}});
+                    }
+                });
 
-// ReSharper disable once CppMemberFunctionMayBeStatic
-void OrionWebServer::HandleRootEndpoint(web::http::http_request Request)
-{
-    constexpr auto INDEX_HTML { U("index.html") };
-    const auto     INDEX_HTML_PATH = std::filesystem::path(AssetDirectories::ResolveBaseAssetDirectory(INDEX_HTML)) / INDEX_HTML;
+        // Send the response
+        Request.reply(web::http::status_codes::OK);
+    };
 
-    // Find the index.html file
-    std::ifstream IndexFile { INDEX_HTML_PATH };
-    if (!IndexFile.is_open())
+    // A multipart/form-data body carries the files as raw bytes (a message field and file parts), read as it arrives
+    const auto BOUNDARY = FormData::GetBoundary(Request.headers().content_type());
+    if (!BOUNDARY.empty())
     {
-        Request.reply(web::http::status_codes::NotFound, U("The index.html file was not found."));
+        if (m_Options.MessageUploads.MaxSize > 0 && Request.headers().content_length() > m_Options.MessageUploads.MaxSize)
+        {
+            Request.reply(web::http::status_codes::RequestEntityTooLarge, U("The message is too large."));
+            return;
+        }
+
+        FormData::ReadAsync(Request.body(), BOUNDARY, m_Options.MessageUploads)
+            .then(
+                [Request, SendMessage](const pplx::task<std::vector<FormData::Part>>& ReadTask)
+                {
+                    std::optional<std::string> Message;
+                    std::vector<MessageFile>   Files;
+                    try
+                    {
+                        for (auto& Part : ReadTask.get())
+                        {
+                            if (Part.File)
+                            {
+                                Files.push_back({std::move(Part.FileName), std::move(*Part.File)});
+                            }
+                            else if (Part.Name == U("message"))
+                            {
+                                Message = std::move(Part.Value);
+                            }
+                        }
+                    }
+                    catch (const FormData::ParseError& Error)
+                    {
+                        Request.reply(Error.GetStatus(), Error.what());
+                        return;
+                    }
+                    catch (const std::exception& Exception)
+                    {
+                        Log::Error("server", "Failed to read a message", {{"error", Exception.what()}});
+                        Request.reply(web::http::status_codes::BadRequest, U("The message could not be read."));
+                        return;
+                    }
+
+                    // A message field is required, as in the JSON form
+                    if (!Message)
+                    {
+                        Request.reply(web::http::status_codes::BadRequest, U("The message could not be read."));
+                        return;
+                    }
+
+                    SendMessage(*Message, std::move(Files));
+                });
         return;
     }
 
-    // Read the contents of the index.html file
-    std::string IndexContents { std::istreambuf_iterator<char>(IndexFile), std::istreambuf_iterator<char>() };
+    // Otherwise the body is JSON, with the files in base64
+    Request.extract_json().then(
+        [Request, SendMessage](const pplx::task<web::json::value>& ExtractJsonTask)
+        {
+            std::string      Message;
+            web::json::array Files = web::json::value::array().as_array();
+            try
+            {
+                auto JsonRequestBody = ExtractJsonTask.get();
+                Message              = JsonRequestBody.at(U("message")).as_string();
+                if (JsonRequestBody.has_field(U("files")))
+                {
+                    // Moved out of the body rather than copied, the files are most of it
+                    Files = std::move(JsonRequestBody.at(U("files")).as_array());
+                }
+            }
+            catch (const std::exception&)
+            {
+                Request.reply(web::http::status_codes::BadRequest, U("The message could not be read."));
+                return;
+            }
 
-    // Send the contents of the index.html file
-    const auto MIME_TYPE = MimeTypes::GetMimeType(INDEX_HTML);
+            SendMessage(Message, std::move(Files));
+        });
+}
 
-    // ReSharper disable once CppExpressionWithoutSideEffects
-    Request.reply(web::http::status_codes::OK, IndexContents, MIME_TYPE);
+void OrionWebServer::HandleRootEndpoint(web::http::http_request Request)
+{
+    // index.html lives in the html assets directory
+    ReplyWithAsset(Request, U("html/index.html"));
 }
 
-// ReSharper disable once CppMemberFunctionMayBeStatic
 void OrionWebServer::HandleAssetFileEndpoint(web::http::http_request Request)
 {
     // Get the file name from the request path and make it relative (remove the leading slash)
@@ -276,60 +656,203 @@ void OrionWebServer::HandleAssetFileEndpoint(web::http::http_request Request)
     constexpr std::string_view ASSETS_DIR { U("assets/") };
     FileNameCorrected = { FileNameCorrected.find(ASSETS_DIR) == 0 ? FileNameCorrected.substr(ASSETS_DIR.size()) : FileNameCorrected };
 
-    // FIXME: This Web Server is not secure. It is vulnerable to directory traversal attacks. Fix this by checking if the file path is within the assets directory (We are doing
-    // this above but it is not enough eg. /assets/../file.txt)
-    // Calculate file path.
-    const std::string FILE_PATH { std::filesystem::current_path() / AssetDirectories::STATIC_ASSETS_DIR / FileNameCorrected };
-
-    // Ensure that the file path is within the assets directory. We can do this by getting the absolute path of the file
-    // and checking if it starts with the absolute path of the assets directory.
-    const std::filesystem::path ABSOLUTE_FILE_PATH { std::filesystem::canonical(FILE_PATH) };
+    // The asset cache rejects paths leaving the assets directory (eg. /assets/../file.txt)
+    ReplyWithAsset(Request, web::uri::decode(FileNameCorrected));
+}
 
-    // Check if the file path is within the assets directory
-    if (const std::filesystem::path ABSOLUTE_ASSETS_DIR { std::filesystem::canonical(std::filesystem::current_path() / AssetDirectories::STATIC_ASSETS_DIR) };
-        ABSOLUTE_FILE_PATH.string().find(ABSOLUTE_ASSETS_DIR.string()) != 0)
+void OrionWebServer::ReplyWithAsset(web::http::http_request Request, const std::string& RelativePath)
+{
+    const auto pAsset = m_AssetCache.Find(RelativePath);
+    if (!pAsset)
     {
         auto Response       = web::json::value::object();
-        Response["message"] = web::json::value::string(U("The file path is invalid."));
-        Request.reply(web::http::status_codes::BadRequest, Response);
+        Response["message"] = web::json::value::string(U("The file was not found."));
+        Request.reply(web::http::status_codes::NotFound, Response);
         return;
     }
 
-    // Check if the file exists
-    if (!std::filesystem::exists(FILE_PATH))
+    // A range request (e.g. an audio element seeking) is answered from the identity representation, unless If-Range names an older version
+    const auto IDENTITY_ETAG = AssetCache::GetETag(*pAsset, "");
+    const bool IS_RANGE_REQUEST =
+        Request.headers().has(U("Range")) && (!Request.headers().has(U("If-Range")) || Request.headers().find(U("If-Range"))->second == IDENTITY_ETAG);
+
+    // Pick the smallest representation the client accepts
+    const auto ACCEPT_ENCODING = Request.headers().has(U("Accept-Encoding")) ? Request.headers().find(U("Accept-Encoding"))->second : std::string();
+
+    auto             Coding = Compression::EContentCoding::Identity;
+    std::string_view Body   = pAsset->Content;
+    if (!IS_RANGE_REQUEST && !pAsset->BrotliContent.empty() && Compression::IsAccepted(ACCEPT_ENCODING, Compression::EContentCoding::Brotli))
     {
-        auto Response       = web::json::value::object();
-        Response["message"] = web::json::value::string(U("The file was not found."));
-        Request.reply(web::http::status_codes::NotFound, Response);
+        Coding = Compression::EContentCoding::Brotli;
+        Body   = pAsset->BrotliContent;
+    }
+    else if (!IS_RANGE_REQUEST && !pAsset->GzipContent.empty() && Compression::IsAccepted(ACCEPT_ENCODING, Compression::EContentCoding::Gzip))
+    {
+        Coding = Compression::EContentCoding::Gzip;
+        Body   = pAsset->GzipContent;
+    }
+
+    const auto CONTENT_ENCODING = Compression::GetContentEncodingToken(Coding);
+
+    web::http::http_response Response(web::http::status_codes::OK);
+    Response.headers().add(U("ETag"), Coding == Compression::EContentCoding::Identity ? IDENTITY_ETAG : AssetCache::GetETag(*pAsset, CONTENT_ENCODING));
+    Response.headers().add(U("Accept-Ranges"), U("bytes"));
+
+    // Pages are revalidated on every load so new versions show up immediately; everything else may be reused for a while
+    Response.headers().add(U("Cache-Control"), pAsset->ContentType.find("html") != std::string::npos ? U("no-cache") : U("public, max-age=3600"));
+    if (!pAsset->GzipContent.empty() || !pAsset->BrotliContent.empty())
+    {
+        Response.headers().add(U("Vary"), U("Accept-Encoding"));
+    }
+
+    // The client already has this version
+    if (Request.headers().has(U("If-None-Match")) && AssetCache::IsNotModified(*pAsset, Request.headers().find(U("If-None-Match"))->second))
+    {
+        Response.set_status_code(web::http::status_codes::NotModified);
+        Request.reply(Response);
         return;
     }
 
-    // Get mime type from file extension
-    const std::string CONTENT_TYPE { MimeTypes::GetMimeType(FILE_PATH) };
+    // The response body points into memory that outlives the response: the cache entry, or a mapping of files too large for the cache
+    const uint8_t*              pData = reinterpret_cast<const uint8_t*>(Body.data());
+    uint64_t                    Size  = Body.size();
+    std::shared_ptr<const void> pKeepAlive(pAsset);
+    if (!pAsset->IsInMemory)
+    {
+        const auto pMappedFile = MappedFile::Open(pAsset->FilePath);
+        if (!pMappedFile)
+        {
+            Log::Error("server", "The asset could not be read", {{"path", pAsset->FilePath.string()}});
+
+            Request.reply(web::http::status_codes::NotFound, U("The file could not be read."));
+            return;
+        }
 
-    // Stream the file to the response
-    concurrency::streams::fstream::open_istream(FILE_PATH)
-        .then(
-            [Request, CONTENT_TYPE](const concurrency::streams::istream& StaticFileInputStream)
+        pData      = pMappedFile->GetData();
+        Size       = pMappedFile->GetSize();
+        pKeepAlive = pMappedFile;
+    }
+
+    if (IS_RANGE_REQUEST)
+    {
+        const auto RANGE = HttpRange::Parse(Request.headers().find(U("Range"))->second, Size);
+        if (RANGE.Result == HttpRange::EResult::Unsatisfiable)
+        {
+            Response.set_status_code(web::http::status_codes::RangeNotSatisfiable);
+            Response.headers().add(U("Content-Range"), HttpRange::FormatContentRange(RANGE, Size));
+            Request.reply(Response);
+            return;
+        }
+
+        if (RANGE.Result == HttpRange::EResult::Satisfiable)
+        {
+            Response.set_status_code(web::http::status_codes::PartialContent);
+            Response.headers().add(U("Content-Range"), HttpRange::FormatContentRange(RANGE, Size));
+            pData += RANGE.Offset;
+            Size = RANGE.Length;
+        }
+    }
+
+    if (!CONTENT_ENCODING.empty())
+    {
+        Response.headers().add(U("Content-Encoding"), std::string(CONTENT_ENCODING));
+    }
+
+    // Send the bytes in place instead of copying them into a body buffer
+    static constexpr uint8_t EMPTY_BODY = 0;
+    const auto BODY_BUFFER = concurrency::streams::rawptr_buffer<uint8_t>(pData ? pData : &EMPTY_BODY, static_cast<size_t>(Size), std::ios::in);
+    Response.set_body(BODY_BUFFER.create_istream(), Size, pAsset->ContentType);
+
+    // The reply task completes once the response is sent, release the memory then
+    Request.reply(Response).then(
+        [pKeepAlive](const pplx::task<void>& ReplyTask)
+        {
+            try
             {
-                // Send the response
-                // ReSharper disable once CppExpressionWithoutSideEffects
-                Request.reply(web::http::status_codes::OK, StaticFileInputStream, CONTENT_TYPE);
-            })
-        .then(
-            [FILE_PATH, Request](const pplx::task<void>& OpenStreamTask)
+                ReplyTask.get();
+            }
+            catch (const std::exception&)
             {
-                try
-                {
-                    OpenStreamTask.get();
-                }
-                catch (std::exception& Exception)
-                {
-                    std::cout << U("The file ") << FILE_PATH << U(" was not found: ") << std::endl;
+                // The client went away, nothing to clean up besides the memory
+            }
+        });
+}
 
-                    Request.reply(web::http::status_codes::NotFound, U("The file ") + FILE_PATH + U(" was not found: ") + std::string(Exception.what()));
-                }
-            });
+void OrionWebServer::ReplyWithJson(web::http::http_request Request, const web::http::status_code STATUS, const web::json::value& Body) const
+{
+    ReplyWithText(std::move(Request), STATUS, Body.serialize(), U("application/json"));
+}
+
+void OrionWebServer::ReplyWithText(web::http::http_request Request, const web::http::status_code STATUS, std::string Body, const std::string& ContentType) const
+{
+    web::http::http_response Response(STATUS);
+
+    // Small bodies aren't worth the CPU (and the client can't tell)
+    if (!m_Options.Compression.IsEnabled || Body.size() < m_Options.Compression.MinimumSize)
+    {
+        Response.set_body(std::move(Body), ContentType);
+        Request.reply(Response);
+        return;
+    }
+
+    Response.headers().add(U("Vary"), U("Accept-Encoding"));
+
+    const auto ACCEPT_ENCODING = Request.headers().has(U("Accept-Encoding")) ? Request.headers().find(U("Accept-Encoding"))->second : std::string();
+    const auto CODING          = Compression::Negotiate(ACCEPT_ENCODING);
+    const auto LEVEL           = CODING == Compression::EContentCoding::Brotli ? m_Options.Compression.BrotliQuality : m_Options.Compression.Level;
+
+    if (CODING != Compression::EContentCoding::Identity)
+    {
+        if (auto Compressed = Compression::Compress(Body, CODING, LEVEL))
+        {
+            const auto SIZE = Compressed->size();
+            Response.headers().add(U("Content-Encoding"), std::string(Compression::GetContentEncodingToken(CODING)));
+            Response.set_body(concurrency::streams::bytestream::open_istream(std::move(*Compressed)), SIZE, ContentType);
+            Request.reply(Response);
+            return;
+        }
+    }
+
+    Response.set_body(std::move(Body), ContentType);
+    Request.reply(Response);
+}
+
+void OrionWebServer::HandleMetricsEndpoint(web::http::http_request Request) const
+{
+    ReplyWithText(std::move(Request), web::http::status_codes::OK, Metrics::Registry::Get().Serialize(), U("text/plain; version=0.0.4; charset=utf-8"));
+}
+
+void OrionWebServer::HandleTracesEndpoint(web::http::http_request Request) const
+{
+    const auto        PATH   = Request.request_uri().path();
+    const std::string PREFIX = "/debug/traces/";
+    auto&             Traces = Tracing::TraceStore::Get();
+
+    if (PATH.find(PREFIX) != 0)
+    {
+        auto JTraces = web::json::value::array();
+        for (const auto& pTrace : Traces.GetRecentTraces())
+        {
+            JTraces[JTraces.size()] = pTrace->ToSummaryJson();
+        }
+
+        auto JResponse      = web::json::value::object();
+        JResponse["traces"] = JTraces;
+        ReplyWithJson(std::move(Request), web::http::status_codes::OK, JResponse);
+        return;
+    }
+
+    const auto pTrace = Traces.FindTrace(PATH.substr(PREFIX.length()));
+    if (!pTrace)
+    {
+        ReplyWithText(std::move(Request), web::http::status_codes::NotFound, "Trace not found", U("text/plain; charset=utf-8"));
+        return;
+    }
+
+    const auto QUERY     = web::uri::split_query(Request.request_uri().query());
+    const auto FORMAT_IT = QUERY.find(U("format"));
+    const bool IS_OTLP   = FORMAT_IT != QUERY.end() && FORMAT_IT->second == U("otlp");
+    ReplyWithJson(std::move(Request), web::http::status_codes::OK, IS_OTLP ? pTrace->ToOTLPJson() : pTrace->ToJson());
 }
 
 void OrionWebServer::HandleMarkdownEndpoint(web::http::http_request Request) const
@@ -354,7 +877,7 @@ void OrionWebServer::HandleMarkdownEndpoint(web::http::http_request Request) con
                 Response[U("message")]    = web::json::value::string(RequestMessage);
 
                 // Send the response
-                Request.reply(web::http::status_codes::OK, Response);
+                ReplyWithJson(Request, web::http::status_codes::OK, Response);
             });
 }
 
@@ -420,10 +943,8 @@ void OrionWebServer::HandleChatHistoryEndpoint(web::http::http_request Request)
                 }
             }
 
-            // Send the response
-
-            // ReSharper disable once CppExpressionWithoutSideEffects
-            Request.reply(web::http::status_codes::OK, ChatHistory);
+            // Send the response (rendered history is large, it is compressed when the client allows)
+            ReplyWithJson(Request, web::http::status_codes::OK, ChatHistory);
         });
 }
 
@@ -554,29 +1075,15 @@ void OrionWebServer::HandleLoginEndpoint(web::http::http_request Request)
                 const auto PASSWORD = JsonRequestBody.has_field(U("password")) ? JsonRequestBody.at(U("password")).as_string() : U("");
                 const auto USER_ID  = JsonRequestBody.has_field(U("user_id")) ? JsonRequestBody.at(U("user_id")).as_string() : U("");
 
-                // Get the database path
-                const auto DB_PATH = std::filesystem::path(AssetDirectories::DATABASE_FILE);
-
-                // Create directory if it does not exist
-                std::filesystem::create_directories(DB_PATH.parent_path());
-
-                // Open the database
-                sqlite::database DB { DB_PATH.string() };
-
-                User Usr {};
-
-                // Create the users table if it does not exist with the user_id, orion_id, username, and password columns.
-                DB << "CREATE TABLE IF NOT EXISTS users (user_id TEXT PRIMARY KEY, orion_id TEXT, username TEXT, password TEXT);";
-
                 // Convert the username to lowercase
                 auto UserNameLower = USERNAME;
                 std::transform(UserNameLower.begin(), UserNameLower.end(), UserNameLower.begin(), ::tolower);
 
-                // Check if the username already exists
-                int UserCount = 0;
-                DB << "SELECT COUNT(*) FROM users WHERE username = ? OR user_id = ?;" << UserNameLower << USER_ID >> UserCount;
+                // Look the user up by id, or by username and password
+                User       Usr {};
+                const auto LOGIN_RESULT = m_UserStore.Login(UserNameLower, PASSWORD, USER_ID, Usr);
 
-                if (UserCount <= 0)
+                if (LOGIN_RESULT == UserStore::ELoginResult::UnknownUser)
                 {
                     web::json::value Response = web::json::value::object();
                     Response[U("message")]    = web::json::value::string(U("The user does not exist."));
@@ -586,11 +1093,15 @@ void OrionWebServer::HandleLoginEndpoint(web::http::http_request Request)
                     return;
                 }
 
-                // Get the user_id and orion_id from the database if the username and password are valid OR if the user_id is valid
-                DB << "SELECT user_id,orion_id FROM users WHERE (username = ? AND password = ?) OR user_id = ?;" << UserNameLower << PASSWORD << USER_ID >>
-                    [&Usr](const std::string& IDArg, const std::string& OrionIDArg) {
-                        Usr = { IDArg, OrionIDArg };
-                    };
+                if (LOGIN_RESULT == UserStore::ELoginResult::Error)
+                {
+                    web::json::value Response = web::json::value::object();
+                    Response[U("message")]    = web::json::value::string(U("An internal error occurred."));
+
+                    // ReSharper disable once CppExpressionWithoutSideEffects
+                    Request.reply(web::http::status_codes::InternalError, Response);
+                    return;
+                }
 
                 // Send the response
                 if (Usr)
@@ -653,27 +1164,12 @@ void OrionWebServer::HandleRegisterEndpoint(web::http::http_request Request)
                     return;
                 }
 
-                // Get the database path
-                const auto DB_PATH = std::filesystem::path(AssetDirectories::DATABASE_FILE);
-
-                // Create directory if it does not exist
-                std::filesystem::create_directories(DB_PATH.parent_path());
-
-                // Open the database
-                sqlite::database DB { DB_PATH.string() };
-
-                // Create the users table if it does not exist with the user_id, orion_id, username, and password columns.
-                DB << "CREATE TABLE IF NOT EXISTS users (user_id TEXT PRIMARY KEY, orion_id TEXT, username TEXT, password TEXT);";
-
                 // Convert the username to lowercase
                 auto UserNameLower = USERNAME;
                 std::transform(UserNameLower.begin(), UserNameLower.end(), UserNameLower.begin(), ::tolower);
 
-                // Check if the username already exists
-                int UserCount = 0;
-                DB << "SELECT COUNT(*) FROM users WHERE username = ?;" << UserNameLower >> UserCount;
-
-                if (UserCount > 0)
+                // Check if the username already exists (before an assistant is created for the user)
+                if (m_UserStore.IsUsernameTaken(UserNameLower))
                 {
                     web::json::value Response = web::json::value::object();
                     Response[U("message")]    = web::json::value::string(U("The username already exists."));
@@ -703,7 +1199,16 @@ void OrionWebServer::HandleRegisterEndpoint(web::http::http_request Request)
                 }
 
                 // Insert the user into the database
-                DB << "INSERT INTO users (user_id, orion_id, username, password) VALUES (?, ?, ?, ?);" << USER_ID << ORION_ID << UserNameLower << PASSWORD;
+                if (const auto ADD_RESULT = m_UserStore.AddUser({ USER_ID, ORION_ID }, UserNameLower, PASSWORD); ADD_RESULT != UserStore::EAddResult::Added)
+                {
+                    web::json::value Response = web::json::value::object();
+                    Response[U("message")] =
+                        web::json::value::string(ADD_RESULT == UserStore::EAddResult::UsernameTaken ? U("The username already exists.") : U("An internal error occurred."));
+
+                    // ReSharper disable once CppExpressionWithoutSideEffects
+                    Request.reply(ADD_RESULT == UserStore::EAddResult::UsernameTaken ? web::http::status_codes::Conflict : web::http::status_codes::InternalError, Response);
+                    return;
+                }
 
                 m_LoggedInUsers.push_back({ USER_ID, ORION_ID });
 
@@ -750,7 +1255,12 @@ void OrionWebServer::HandleTranscribeEndpoint(web::http::http_request Request) c
                 AudioFile.close();
 
                 // Convert the audio to wav format (overwrites the audio.wav file if it exists. Don't ask for confirmation)
-                std::system("ffmpeg -i audio.mp4 -acodec pcm_s16le -ac 1 -ar 16000 audio.wav -y");
+                {
+                    static auto& CONVERSION_DURATION =
+                        Metrics::Registry::Get().GetHistogram("orion_transcription_conversion_duration_seconds", "Time to convert recorded audio for transcription");
+                    Metrics::ScopedTimer ConversionTimer(CONVERSION_DURATION);
+                    std::system("ffmpeg -i audio.mp4 -acodec pcm_s16le -ac 1 -ar 16000 audio.wav -y");
+                }
 
                 // Read the wav file
                 std::ifstream              WavFile { "audio.wav", std::ios::binary };
@@ -760,92 +1270,37 @@ void OrionWebServer::HandleTranscribeEndpoint(web::http::http_request Request) c
                 const auto        MIME_TYPE = MimeTypes::GetMimeType("audio.wav");
                 const std::string MODEL     = "whisper-1";
 
-                // Create a boundary for the multipart/form-data body
-                const std::string BOUNDARY = "----CppRestSdkFormBoundary";
-
-                // Create the multipart/form-data body
-                std::vector<unsigned char> MultiPartFormData;
-
-                // Helper function to append text to the vector
-                auto AppendText = [&](const std::string& Text) { MultiPartFormData.insert(MultiPartFormData.end(), Text.begin(), Text.end()); };
-
-                // Helper function to append binary data to the vector
-                auto AppendBinary = [&](const std::vector<unsigned char>& Data) { MultiPartFormData.insert(MultiPartFormData.end(), Data.begin(), Data.end()); };
-
-                // Create the multipart/form-data body
-
-                // Add the model part
-                AppendText("--" + BOUNDARY + "\r\n");
-                AppendText("Content-Disposition: form-data; name=\"model\"\r\n\r\n");
-                AppendText(MODEL + "\r\n");
-
-                // Add the file part
-                AppendText("--" + BOUNDARY + "\r\n");
-                AppendText("Content-Disposition: form-data; name=\"file\"; filename=\"audio.wav\"\r\n");
-                AppendText("Content-Type: " + MIME_TYPE + "\r\n\r\n");
-                AppendBinary(WavData);
-                AppendText("\r\n");
-
-                // End of the multipart/form-data body
-                AppendText("--" + BOUNDARY + "--");
-
-                // Create the request
-                web::http::client::http_client Client(U("https://api.openai.com/v1"));
-                web::http::http_request        SpeechToTextRequest(web::http::methods::POST);
-                SpeechToTextRequest.set_request_uri(U("/audio/transcriptions"));
-                SpeechToTextRequest.headers().add(U("Authorization"), U("Bearer " + OpenAIAPIKey));
-                SpeechToTextRequest.headers().add(U("Content-Type"), U("multipart/form-data; boundary=") + std::string(BOUNDARY));
-                SpeechToTextRequest.set_body(MultiPartFormData);
-
                 // Send the request
-                Client.request(SpeechToTextRequest)
+                OpenAI::Client(OpenAIAPIKey)
+                    .CreateTranscription("audio.wav", MIME_TYPE, OpenAI::FilePayload::FromMemory(std::move(WavData)), MODEL)
                     .then(
-                        [this, Request](web::http::http_response Response)
+                        [Request](pplx::task<web::json::value> TranscriptionTask)
                         {
-                            if (Response.status_code() == web::http::status_codes::OK)
+                            auto JSpeechToTextRequestResponse = web::json::value::object();
+                            try
                             {
-                                // Get the response body
-                                Response.extract_json()
-                                    .then([this, Request](const pplx::task<web::json::value>& ExtractJsonTask) { return ExtractJsonTask.get(); })
-                                    .then(
-                                        [this, Request](web::json::value ResponseJson)
-                                        {
-                                            if (ResponseJson.has_field(U("text")))
-                                            {
-                                                auto JSpeechToTextRequestResponse          = web::json::value::object();
-                                                JSpeechToTextRequestResponse[U("message")] = ResponseJson.at(U("text"));
-
-                                                auto Dump = ResponseJson.serialize();
-
-                                                // Send the response
-                                                // ReSharper disable once CppExpressionWithoutSideEffects
-                                                Request.reply(web::http::status_codes::OK, JSpeechToTextRequestResponse);
-                                            }
-                                            else
-                                            {
-                                                auto JSpeechToTextRequestResponse          = web::json::value::object();
-                                                JSpeechToTextRequestResponse[U("message")] = web::json::value::string(ResponseJson.serialize());
-
-                                                // Send the response
-                                                // ReSharper disable once CppExpressionWithoutSideEffects
-                                                Request.reply(web::http::status_codes::BadRequest, JSpeechToTextRequestResponse);
-                                            }
-                                        });
+                                const auto RESPONSE_JSON = TranscriptionTask.get();
+                                if (RESPONSE_JSON.has_field(U("text")))
+                                {
+                                    JSpeechToTextRequestResponse[U("message")] = RESPONSE_JSON.at(U("text"));
+
+                                    // ReSharper disable once CppExpressionWithoutSideEffects
+                                    Request.reply(web::http::status_codes::OK, JSpeechToTextRequestResponse);
+                                }
+                                else
+                                {
+                                    JSpeechToTextRequestResponse[U("message")] = web::json::value::string(RESPONSE_JSON.serialize());
+
+                                    // ReSharper disable once CppExpressionWithoutSideEffects
+                                    Request.reply(web::http::status_codes::BadRequest, JSpeechToTextRequestResponse);
+                                }
                             }
-                            else
+                            catch (const OpenAI::APIError& Error)
                             {
-                                Response.extract_json()
-                                    .then([this, Request, Response](const pplx::task<web::json::value>& ExtractJsonTask) { return ExtractJsonTask.get(); })
-                                    .then(
-                                        [this, Request, Response](const web::json::value& ResponseJson)
-                                        {
-                                            auto JSpeechToTextRequestResponse          = web::json::value::object();
-                                            JSpeechToTextRequestResponse[U("message")] = web::json::value::string(ResponseJson.serialize());
-
-                                            // Send the response
-                                            // ReSharper disable once CppExpressionWithoutSideEffects
-                                            Request.reply(Response.status_code(), JSpeechToTextRequestResponse);
-                                        });
+                                JSpeechToTextRequestResponse[U("message")] = web::json::value::string(Error.what());
+
+                                // ReSharper disable once CppExpressionWithoutSideEffects
+                                Request.reply(Error.GetStatus() != 0 ? Error.GetStatus() : web::http::status_codes::BadGateway, JSpeechToTextRequestResponse);
                             }
                         });
             });
@@ -853,26 +1308,131 @@ void OrionWebServer::HandleTranscribeEndpoint(web::http::http_request Request) c
 
 void OrionWebServer::HandleOrionEventsEndpoint(web::http::http_request Request)
 {
-    // Register the client for Orion events
+    const auto QUERY = web::uri::split_query(Request.request_uri().query());
+
+    // Get the user id from the header or the query (EventSource can't set custom headers)
+    std::string UserID;
+    if (Request.headers().has(U("X-User-Id")))
+    {
+        UserID = Request.headers().find(U("X-User-Id"))->second;
+    }
+    else if (const auto USER_ID_ITER = QUERY.find(U("user_id")); USER_ID_ITER != QUERY.end())
     {
-        std::lock_guard<std::mutex> OrionEventClientsLockGuard(m_OrionEventClientsMutex);
+        UserID = web::uri::decode(USER_ID_ITER->second);
+    }
 
-        // Create the response
-        web::http::http_response Response(web::http::status_codes::OK);
-        Response.headers().add(U("Content-Type"), U("text/event-stream"));
-        Response.headers().add(U("Cache-Control"), U("no-cache"));
-        Response.headers().add(U("Connection"), U("keep-alive"));
+    if (UserID.empty())
+    {
+        Request.reply(web::http::status_codes::BadRequest, U("The X-User-Id header or user_id query parameter is required."));
+        return;
+    }
 
-        concurrency::streams::producer_consumer_buffer<uint8_t> Buffer;
+    // Only logged in users with an Orion instance may subscribe (like the WebSocket endpoint), so no one else can replay their events
+    if (FindOrionInstance(UserID) == nullptr)
+    {
+        Request.reply(web::http::status_codes::Unauthorized, U("User is not logged in."));
+        return;
+    }
 
-        // Add the client to the list of clients
-        m_OrionEventClients.push_back(Buffer);
+    // Create the response
+    web::http::http_response Response(web::http::status_codes::OK);
+    Response.headers().add(U("Content-Type"), U("text/event-stream"));
+    Response.headers().add(U("Cache-Control"), U("no-cache"));
+    Response.headers().add(U("Connection"), U("keep-alive"));
 
-        Response.set_body(m_OrionEventClients.back().create_istream(), U("text/event-stream"));
+    // A reconnecting EventSource sends the id of the last event it received. Clients that manage the connection themselves may pass it in the query
+    std::string LastEventID;
+    if (Request.headers().has(U("Last-Event-ID")))
+    {
+        LastEventID = Request.headers().find(U("Last-Event-ID"))->second;
+    }
+    else if (const auto LAST_EVENT_ID_ITER = QUERY.find(U("last_event_id")); LAST_EVENT_ID_ITER != QUERY.end())
+    {
+        LastEventID = web::uri::decode(LAST_EVENT_ID_ITER->second);
+    }
 
-        // Send the response
-        Request.reply(Response);
+    // Compress the stream when the client allows. The context carries over between deliveries, so the repetitive event framing and JSON
+    // compress well, and every delivery is flushed so events aren't held back
+    std::shared_ptr<Compression::StreamCompressor> pCompressor;
+    if (m_Options.Compression.IsEnabled && m_Options.Compression.IsEventStreamCompressed)
+    {
+        const auto ACCEPT_ENCODING = Request.headers().has(U("Accept-Encoding")) ? Request.headers().find(U("Accept-Encoding"))->second : std::string();
+        const auto CODING          = Compression::Negotiate(ACCEPT_ENCODING);
+        const auto LEVEL           = CODING == Compression::EContentCoding::Brotli ? m_Options.Compression.BrotliQuality : m_Options.Compression.Level;
+
+        if (CODING != Compression::EContentCoding::Identity)
+        {
+            pCompressor = std::make_shared<Compression::StreamCompressor>(CODING, LEVEL);
+            if (pCompressor->IsValid())
+            {
+                Response.headers().add(U("Content-Encoding"), std::string(Compression::GetContentEncodingToken(CODING)));
+            }
+            else
+            {
+                pCompressor.reset();
+            }
+        }
+        Response.headers().add(U("Vary"), U("Accept-Encoding"));
+    }
+
+    concurrency::streams::producer_consumer_buffer<uint8_t> Buffer;
+
+    // Register the client for the Orion events of the user (replaying the events it missed, if any). Each batch of events is written
+    // to the response in the Server-Sent Event format with a single write. The dispatcher never runs a sink concurrently with itself,
+    // so the compressor needs no lock
+    const auto SUBSCRIPTION_ID = m_EventDispatcher.Subscribe(
+        UserID,
+        [this, Buffer, pCompressor](const std::vector<const OrionEventDispatcher::RecordedEvent*>& Events)
+        {
+            std::string Payload;
+            for (const auto* pEvent : Events)
+            {
+                Payload.append("id: ").append(m_EventDispatcher.FormatEventID(pEvent->Sequence)).append("\n");
+                Payload.append("event: ").append(pEvent->Name).append("\n");
+                Payload.append("data: ").append(pEvent->Data).append("\n\n");
+            }
+
+            if (pCompressor)
+            {
+                auto Compressed = pCompressor->CompressAndFlush(Payload);
+                if (!Compressed)
+                {
+                    // The stream is broken, end it; the client reconnects and resumes from its last event id
+                    Buffer.close(std::ios_base::out).wait();
+                    return;
+                }
+                Payload = std::move(*Compressed);
+            }
+
+            Buffer.putn_nocopy(reinterpret_cast<const uint8_t*>(Payload.data()), Payload.size()).wait();
+            Buffer.sync().wait();
+        },
+        LastEventID);
+
+    Response.set_body(Buffer.create_istream(), U("text/event-stream"));
+
+    {
+        std::lock_guard<std::mutex> EventStreamsLockGuard(m_EventStreamsMutex);
+        m_EventStreams.emplace(SUBSCRIPTION_ID, Buffer);
     }
+
+    // Send the response. The reply only completes when the connection is closed, at which point the client is removed
+    Request.reply(Response).then(
+        [this, UserID, SUBSCRIPTION_ID](pplx::task<void> ReplyTask)
+        {
+            try
+            {
+                ReplyTask.get();
+            }
+            catch (const std::exception&)
+            {
+                // The client went away
+            }
+            m_EventDispatcher.Unsubscribe(UserID, SUBSCRIPTION_ID);
+
+            std::lock_guard<std::mutex> EventStreamsLockGuard(m_EventStreamsMutex);
+            m_EventStreams.erase(SUBSCRIPTION_ID);
+        });
 }
 
 void OrionWebServer::HandleOrionFilesEndpoint(web::http::http_request Request) const
@@ -904,21 +1464,25 @@ void OrionWebServer::HandleOrionFilesEndpoint(web::http::http_request Request) c
 
     const auto MIME_TYPE = MimeTypes::GetMimeType(FILE_ID_RAW);
 
-    // Create the request to get the file
-    web::http::client::http_client Client(U("https://api.openai.com/v1"));
-    web::http::http_request        FileRequest(web::http::methods::GET);
-    FileRequest.set_request_uri(U("/files/") + FILE_ID + "/content");
-
-    // Add the authorization header
-    FileRequest.headers().add(U("Authorization"), U("Bearer " + OpenAIAPIKey));
-
-    // Send the request
-    Client.request(FileRequest)
+    // Get the file and forward it to the client
+    OpenAI::Client(OpenAIAPIKey)
+        .GetFileContent(FILE_ID)
         .then(
-            [this, Request, MIME_TYPE](web::http::http_response FileRequestResponse)
+            [Request, MIME_TYPE](pplx::task<web::http::http_response> FileContentTask)
             {
-                // Forward the response to the client
-                Request.reply(FileRequestResponse.status_code(), FileRequestResponse.body(), MIME_TYPE);
+                try
+                {
+                    const auto FILE_CONTENT_RESPONSE = FileContentTask.get();
+                    Request.reply(FILE_CONTENT_RESPONSE.status_code(), FILE_CONTENT_RESPONSE.body(), MIME_TYPE);
+                }
+                catch (const OpenAI::APIError& Error)
+                {
+                    auto JFileRequestResponse          = web::json::value::object();
+                    JFileRequestResponse[U("message")] = web::json::value::string(Error.what());
+
+                    // ReSharper disable once CppExpressionWithoutSideEffects
+                    Request.reply(Error.GetStatus() != 0 ? Error.GetStatus() : web::http::status_codes::BadGateway, JFileRequestResponse);
+                }
             });
 }
 
@@ -981,7 +1545,7 @@ void OrionWebServer::HandleOrionPluginsEndpoint(web::http::http_request Request)
             PluginInfo[U("author")]      = web::json::value::string(PLUGIN->GetPlugin()->GetAuthor().data());
             PluginInfo[U("enabled")]     = web::json::value::boolean((*OrionIt)->IsPluginLoaded(PLUGIN_NAME));
 
-            Request.reply(web::http::status_codes::OK, PluginInfo);
+            ReplyWithJson(Request, web::http::status_codes::OK, PluginInfo);
         }
         else
         {
@@ -1002,7 +1566,7 @@ void OrionWebServer::HandleOrionPluginsEndpoint(web::http::http_request Request)
             }
 
             // Send the response
-            Request.reply(web::http::status_codes::OK, PluginList);
+            ReplyWithJson(Request, web::http::status_codes::OK, PluginList);
         }
     }
     else if (Request.method() == web::http::methods::POST)
@@ -1065,52 +1629,185 @@ void OrionWebServer::HandleOrionPluginsEndpoint(web::http::http_request Request)
     }
 }
 
-void OrionWebServer::SendServerEvent(const OrionEventName& Event, const web::json::value& Data)
+bool OrionWebServer::HandleWebSocketValidate(const std::string& Resource)
 {
-    // We push the message to a queue. The queue is processed in a separate thread.
+    const web::uri REQUEST_URI { Resource };
+    if (REQUEST_URI.path() != U("/orion/ws"))
     {
-        std::lock_guard<std::mutex> LockGuard(m_OrionEventQueueMutex);
-        m_OrionEventQueue.push({ Event, Data });
+        return false;
     }
 
-    // Notify the thread to process the queue
-    m_OrionEventQueueConditionVariable.notify_one();
+    // Only logged in users with an Orion instance may connect
+    const auto QUERY        = web::uri::split_query(REQUEST_URI.query());
+    const auto USER_ID_ITER = QUERY.find(U("user_id"));
+    return USER_ID_ITER != QUERY.end() && FindOrionInstance(web::uri::decode(USER_ID_ITER->second)) != nullptr;
 }
 
-void OrionWebServer::OrionEventThreadHandler()
+void OrionWebServer::HandleWebSocketOpen(const OrionWebSocketServer::ConnectionID CONNECTION_ID, const std::string& Resource)
 {
-    while (m_IsRunning)
+    // The resource was checked by HandleWebSocketValidate
+    const auto QUERY   = web::uri::split_query(web::uri(Resource).query());
+    const auto USER_ID = web::uri::decode(QUERY.at(U("user_id")));
+
+    std::string LastEventID;
+    if (const auto LAST_EVENT_ID_ITER = QUERY.find(U("last_event_id")); LAST_EVENT_ID_ITER != QUERY.end())
     {
-        std::unique_lock<std::mutex> Lock(m_OrionEventQueueMutex);
+        LastEventID = web::uri::decode(LAST_EVENT_ID_ITER->second);
+    }
 
-        // Wait for the condition variable to be notified
-        m_OrionEventQueueConditionVariable.wait(Lock, [this] { return !m_OrionEventQueue.empty() || !m_IsRunning; });
+    // Hold the sessions lock while subscribing so that a close racing with the open finds the subscription
+    std::lock_guard<std::mutex> SessionsLockGuard(m_WebSocketSessionsMutex);
 
-        // Get the event from the queue
-        if (!m_OrionEventQueue.empty())
+    // Each event is sent as its own message. The event data is already serialized, so the message is assembled as text
+    const auto SUBSCRIPTION_ID = m_EventDispatcher.Subscribe(
+        USER_ID,
+        [this, CONNECTION_ID](const std::vector<const OrionEventDispatcher::RecordedEvent*>& Events)
         {
-            const auto [Event, Data] = m_OrionEventQueue.front();
-            m_OrionEventQueue.pop();
+            for (const auto* pEvent : Events)
+            {
+                std::string Message;
+                Message.append(R"({"type":"event","id":")").append(m_EventDispatcher.FormatEventID(pEvent->Sequence));
+                Message.append(R"(","event":")").append(pEvent->Name);
+                Message.append(R"(","data":)").append(pEvent->Data).append("}");
+                m_pWebSocketServer->Send(CONNECTION_ID, Message);
+            }
+        },
+        LastEventID);
 
-            // Unlock the mutex
-            Lock.unlock();
+    m_WebSocketSessions[CONNECTION_ID] = WebSocketSession { USER_ID, SUBSCRIPTION_ID };
+}
 
-            // Lock the OrionEventClients mutex
-            std::lock_guard<std::mutex> OrionEventClientsLockGuard(m_OrionEventClientsMutex);
+void OrionWebServer::HandleWebSocketMessage(const OrionWebSocketServer::ConnectionID CONNECTION_ID, const std::string& Message)
+{
+    std::string UserID;
+    {
+        std::lock_guard<std::mutex> SessionsLockGuard(m_WebSocketSessionsMutex);
+        const auto                  SESSION_ITER = m_WebSocketSessions.find(CONNECTION_ID);
+        if (SESSION_ITER == m_WebSocketSessions.end())
+        {
+            return;
+        }
+        UserID = SESSION_ITER->second.UserID;
+    }
 
-            // Loop through all the connected clients and send the event
-            for (const auto& Client : m_OrionEventClients)
-            {
-                // Format the Server-Sent Event
-                std::ostringstream SSEEvent;
-                SSEEvent << "event: " << Event << "\n";
-                SSEEvent << "data: " << Data.serialize() << "\n\n";
-                SSEEvent << std::flush;
-
-                auto ResponseStream = Client.create_ostream();
-                ResponseStream.print(SSEEvent.str()).get();
-                ResponseStream.flush().wait();
-            }
+    // Replies echo the request id of the message (if any) so the client can match them
+    web::json::value JReply = web::json::value::object();
+    const auto       SendReply = [this, CONNECTION_ID, &JReply](const std::string& Type)
+    {
+        JReply[U("type")] = web::json::value::string(Type);
+        m_pWebSocketServer->Send(CONNECTION_ID, JReply.serialize());
+    };
+
+    web::json::value JMessage;
+    try
+    {
+        JMessage = web::json::value::parse(Message);
+    }
+    catch (const web::json::json_exception&)
+    {
+        JReply[U("message")] = web::json::value::string(U("The message is not valid JSON."));
+        SendReply(U("error"));
+        return;
+    }
+
+    if (JMessage.has_field(U("request_id")))
+    {
+        JReply[U("request_id")] = JMessage.at(U("request_id"));
+    }
+
+    const auto TYPE = JMessage.has_string_field(U("type")) ? JMessage.at(U("type")).as_string() : std::string();
+    if (TYPE == U("ping"))
+    {
+        SendReply(U("pong"));
+    }
+    else if (TYPE == U("send_message"))
+    {
+        Orion* pOrion = FindOrionInstance(UserID);
+        if (!pOrion)
+        {
+            JReply[U("message")] = web::json::value::string(U("User is not logged in."));
+            SendReply(U("error"));
+            return;
         }
+
+        if (!JMessage.has_string_field(U("message")))
+        {
+            JReply[U("message")] = web::json::value::string(U("The message field is required."));
+            SendReply(U("error"));
+            return;
+        }
+
+        // Check that the user may start another run
+        const auto ADMISSION = m_AdmissionController.TryAdmit(UserID);
+        if (ADMISSION.Decision != AdmissionController::EDecision::Admitted)
+        {
+            const bool IS_RATE_LIMITED = ADMISSION.Decision == AdmissionController::EDecision::RateLimited;
+            JReply[U("message")]       = web::json::value::string(GetAdmissionRejectionMessage(ADMISSION.Decision));
+            JReply[U("status")]        = web::json::value::number(IS_RATE_LIMITED ? 429 : 503);
+            JReply[U("retry_after")]   = web::json::value::number(static_cast<int64_t>(ADMISSION.RetryAfter.count()));
+            SendReply(U("error"));
+            return;
+        }
+
+        const auto MESSAGE = JMessage.at(U("message")).as_string();
+        auto       Files   = JMessage.has_array_field(U("files")) ? JMessage.at(U("files")).as_array() : web::json::value::array().as_array();
+
+        // Sending doesn't block, so it starts on the WebSocket thread. The run holds its admission ticket until it completes
+        pOrion->SendMessageAsync(MESSAGE, std::move(Files))
+            .then(
+                [pTicket = ADMISSION.pTicket](const pplx::task<void>& RunTask)
+                {
+                    try
+                    {
+                        RunTask.get();
+                    }
+                    catch (const std::exception& Exception)
+                    {
+                        Log::Error("orion", "Run failed", {{"error", Exception.what()}});
+                    }
+                });
+
+        SendReply(U("ack"));
+    }
+    else
+    {
+        JReply[U("message")] = web::json::value::string(U("Unknown message type: ") + TYPE);
+        SendReply(U("error"));
     }
-}
\ No newline at end of file
+}
+
+void OrionWebServer::HandleWebSocketClose(const OrionWebSocketServer::ConnectionID CONNECTION_ID)
+{
+    std::lock_guard<std::mutex> SessionsLockGuard(m_WebSocketSessionsMutex);
+    if (const auto SESSION_ITER = m_WebSocketSessions.find(CONNECTION_ID); SESSION_ITER != m_WebSocketSessions.end())
+    {
+        m_EventDispatcher.Unsubscribe(SESSION_ITER->second.UserID, SESSION_ITER->second.SubscriptionID);
+        m_WebSocketSessions.erase(SESSION_ITER);
+    }
+}
+
+Orion* OrionWebServer::FindOrionInstance(const std::string& UserID) const
+{
+    const auto USER_ITER = std::find_if(m_LoggedInUsers.begin(), m_LoggedInUsers.end(), [&UserID](const User& User) { return User.UserID == UserID; });
+    if (USER_ITER == m_LoggedInUsers.end())
+    {
+        return nullptr;
+    }
+
+    const auto ORION_ITER = std::find_if(m_OrionInstances.begin(),
+                                         m_OrionInstances.end(),
+                                         [USER_ITER](const std::unique_ptr<Orion>& Orion) { return Orion->GetCurrentAssistantID() == USER_ITER->OrionID; });
+
+    return ORION_ITER != m_OrionInstances.end() ? ORION_ITER->get() : nullptr;
+}
+
+void OrionWebServer::SendServerEvent(const std::string& UserID, const OrionEventName& Event, const web::json::value& Data)
+{
+    SendServerEvent(UserID, Event, web::json::value(Data));
+}
+
+void OrionWebServer::SendServerEvent(const std::string& UserID, const OrionEventName& Event, web::json::value&& Data)
+{
+    // The event is queued on the shard of the user and delivered by that shard's thread
+    m_EventDispatcher.Dispatch(UserID, Event, std::move(Data));
+}
@@ -0,0 +1,440 @@
+#include "OrionWebServerOptions.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <thread>
+
+using namespace ORION;
+
+namespace
+{
+    /// @brief  A setting that can be given on the command line or in the config file
+    struct Setting
+    {
+        /// @brief  The name of the setting (--name on the command line, name = value in the config file)
+        std::string_view Name;
+
+        /// @brief  The description shown in the usage
+        std::string_view Description;
+
+        /// @brief  Apply a value to the options. Returns false if the value is invalid
+        std::function<bool(OrionWebServerOptions& Options, const std::string& Value)> Apply;
+    };
+
+    /// @brief  Parse an integer
+    template <typename T>
+    bool ParseNumber(const std::string& Value, T& OutNumber)
+    {
+        const auto [END, ERROR_CODE] = std::from_chars(Value.data(), Value.data() + Value.size(), OutNumber);
+        return !Value.empty() && ERROR_CODE == std::errc() && END == Value.data() + Value.size();
+    }
+
+    /// @brief  Parse a port (0-65535)
+    bool ParsePort(const std::string& Value, int& OutPort)
+    {
+        return ParseNumber(Value, OutPort) && OutPort >= 0 && OutPort <= 65535;
+    }
+
+    /// @brief  Parse a non-negative decimal number
+    bool ParseDecimal(const std::string& Value, double& OutNumber)
+    {
+        char* pEnd = nullptr;
+        OutNumber  = std::strtod(Value.c_str(), &pEnd);
+        return !Value.empty() && pEnd == Value.c_str() + Value.size() && OutNumber >= 0.0;
+    }
+
+    /// @brief  Parse a duration, as a count of the duration's unit (milliseconds, seconds, hours)
+    template <typename TDuration>
+    bool ParseDuration(const std::string& Value, TDuration& OutDuration)
+    {
+        size_t Count = 0;
+        if (!ParseNumber(Value, Count))
+        {
+            return false;
+        }
+        OutDuration = TDuration(Count);
+        return true;
+    }
+
+    /// @brief  Parse an OpenAI budget: requests per minute, optionally followed by /tokens per minute (500/200000)
+    bool ParseRateBudget(const std::string& Value, OpenAI::RateBudget& OutBudget)
+    {
+        const auto SEPARATOR = Value.find('/');
+        if (SEPARATOR == std::string::npos)
+        {
+            OutBudget.TokensPerMinute = 0.0;
+            return ParseDecimal(Value, OutBudget.RequestsPerMinute);
+        }
+        return ParseDecimal(Value.substr(0, SEPARATOR), OutBudget.RequestsPerMinute) && ParseDecimal(Value.substr(SEPARATOR + 1), OutBudget.TokensPerMinute);
+    }
+
+    /// @brief  Parse a switch (on/off, true/false, yes/no, 1/0)
+    bool ParseSwitch(const std::string& Value, bool& OutSwitch)
+    {
+        std::string Lower = Value;
+        std::transform(Lower.begin(), Lower.end(), Lower.begin(), [](const unsigned char C) { return std::tolower(C); });
+
+        if (Lower == "on" || Lower == "true" || Lower == "yes" || Lower == "1")
+        {
+            OutSwitch = true;
+            return true;
+        }
+        if (Lower == "off" || Lower == "false" || Lower == "no" || Lower == "0")
+        {
+            OutSwitch = false;
+            return true;
+        }
+        return false;
+    }
+
+    /// @brief  The settings, in the order they are listed in the usage
+    const std::vector<Setting>& GetSettings()
+    {
+        static const std::vector<Setting> SETTINGS = {
+            {"port", "Port of the web interface and API (default 5000)", [](auto& Options, const auto& Value) { return ParsePort(Value, Options.Port); }},
+            {"bind-address", "Address to listen on (default 0.0.0.0)",
+             [](auto& Options, const auto& Value)
+             {
+                 Options.BindAddress = Value;
+                 return !Value.empty();
+             }},
+            {"tls", "Serve HTTPS: on or off, e.g. behind a reverse proxy (default on). The WebSocket endpoint requires it",
+             [](auto& Options, const auto& Value) { return ParseSwitch(Value, Options.IsTLSEnabled); }},
+            {"tls-cert", "PEM certificate chain file (default cert.pem)",
+             [](auto& Options, const auto& Value)
+             {
+                 Options.TLS.CertificateFile = Value;
+                 return !Value.empty();
+             }},
+            {"tls-key", "PEM private key file (default key.pem)",
+             [](auto& Options, const auto& Value)
+             {
+                 Options.TLS.PrivateKeyFile = Value;
+                 return !Value.empty();
+             }},
+            {"tls-ciphers", "OpenSSL cipher list for TLS 1.2 (default: ECDHE with AES-GCM or ChaCha20-Poly1305)",
+             [](auto& Options, const auto& Value)
+             {
+                 Options.TLS.Ciphers = Value;
+                 return !Value.empty();
+             }},
+            {"tls-session-resumption", "Let clients resume TLS sessions with session tickets: on or off (default on)",
+             [](auto& Options, const auto& Value) { return ParseSwitch(Value, Options.TLS.IsSessionResumptionEnabled); }},
+            {"websocket-port", "Port of the /orion/ws endpoint, 0 to disable (default 5001)",
+             [](auto& Options, const auto& Value) { return ParsePort(Value, Options.WebSocketPort); }},
+            {"worker-threads", "Threads of the listener and task pool, 0 for 4 per core and at least 40 (default 0)",
+             [](auto& Options, const auto& Value) { return ParseNumber(Value, Options.WorkerThreadCount); }},
+            {"event-shards", "Event dispatch threads, 0 for one per core (default 0)",
+             [](auto& Options, const auto& Value) { return ParseNumber(Value, Options.EventDispatchShardCount); }},
+            {"event-replay-buffer", "Events kept per user for reconnecting clients (default 256)",
+             [](auto& Options, const auto& Value) { return ParseNumber(Value, Options.EventReplayBufferSize); }},
+            {"db-connections", "Pooled connections to the users database (default 4)",
+             [](auto& Options, const auto& Value) { return ParseNumber(Value, Options.UserStoreConnectionCount) && Options.UserStoreConnectionCount > 0; }},
+            {"rate-limit", "Messages per second each user may send on average (default 0.5)",
+             [](auto& Options, const auto& Value) { return ParseDecimal(Value, Options.Admission.TokensPerSecond); }},
+            {"rate-burst", "Messages each user may send back to back (default 5)",
+             [](auto& Options, const auto& Value) { return ParseDecimal(Value, Options.Admission.BurstSize); }},
+            {"max-in-flight-runs", "Runs in flight across all users, 0 for unlimited (default 64)",
+             [](auto& Options, const auto& Value) { return ParseNumber(Value, Options.Admission.MaxInFlightRuns); }},
+            {"drain-timeout", "Seconds to let runs in flight finish on shutdown before cancelling them (default 30)",
+             [](auto& Options, const auto& Value) { return ParseNumber(Value, Options.DrainTimeoutSeconds); }},
+            {"compression", "Compress JSON responses and the event stream: on or off (default on)",
+             [](auto& Options, const auto& Value) { return ParseSwitch(Value, Options.Compression.IsEnabled); }},
+            {"compression-min-size", "Smallest JSON response that is compressed, in bytes (default 1024)",
+             [](auto& Options, const auto& Value) { return ParseNumber(Value, Options.Compression.MinimumSize); }},
+            {"compression-level", "zlib level of gzip and deflate, 1-9 (default 5)",
+             [](auto& Options, const auto& Value) { return ParseNumber(Value, Options.Compression.Level) && Options.Compression.Level >= 1 && Options.Compression.Level <= 9; }},
+            {"brotli-quality", "Brotli quality, 0-11 (default 4)",
+             [](auto& Options, const auto& Value)
+             { return ParseNumber(Value, Options.Compression.BrotliQuality) && Options.Compression.BrotliQuality >= 0 && Options.Compression.BrotliQuality <= 11; }},
+            {"compress-events", "Compress the /orion/events stream: on or off (default on)",
+             [](auto& Options, const auto& Value) { return ParseSwitch(Value, Options.Compression.IsEventStreamCompressed); }},
+            {"log-level", "Level of the log: trace, debug, info, warning, error or off (default info)",
+             [](auto& Options, const auto& Value)
+             {
+                 const auto LEVEL = Log::ParseLevel(Value);
+                 if (LEVEL)
+                 {
+                     Options.Logging.Level = *LEVEL;
+                 }
+                 return LEVEL.has_value();
+             }},
+            {"log-modules", "Levels of modules, e.g. orion.events=debug,plugins=warning (default none)",
+             [](auto& Options, const auto& Value)
+             {
+                 Options.Logging.ModuleLevels = Value;
+                 return true;
+             }},
+            {"log-file", "File the log is appended to as JSON lines (default stderr)",
+             [](auto& Options, const auto& Value)
+             {
+                 Options.Logging.FilePath = Value;
+                 return true;
+             }},
+            {"log-max-field", "Length logged payloads (web pages, memories, events) are truncated to, 0 for no limit (default 1024)",
+             [](auto& Options, const auto& Value) { return ParseNumber(Value, Options.Logging.MaxFieldLength); }},
+            {"trace-buffer", "Number of message traces kept for /debug/traces, 0 disables tracing (default 100)",
+             [](auto& Options, const auto& Value) { return ParseNumber(Value, Options.TraceBufferSize); }},
+            {"trace-dir", "Directory finished message traces are written to as OTLP/JSON files (default none)",
+             [](auto& Options, const auto& Value)
+             {
+                 Options.TraceDirectory = Value;
+                 return true;
+             }},
+            {"debug-public", "Serve /metrics and /debug/traces to every client rather than loopback only: on or off (default off)",
+             [](auto& Options, const auto& Value) { return ParseSwitch(Value, Options.IsDebugEndpointPublic); }},
+            {"openai-base-url", "Base URL of the OpenAI API (default OPENAI_BASE_URL, or https://api.openai.com/v1/)",
+             [](auto& Options, const auto& Value)
+             {
+                 Options.OpenAI.BaseURL = Value;
+                 return true;
+             }},
+            {"openai-record", "Cassette file the OpenAI responses are recorded to, with their timing (appended)",
+             [](auto& Options, const auto& Value)
+             {
+                 Options.OpenAI.Mode         = Upstream::ETransportMode::Record;
+                 Options.OpenAI.CassetteFile = Value;
+                 return true;
+             }},
+            {"openai-replay", "Cassette file the OpenAI responses are replayed from, without the network",
+             [](auto& Options, const auto& Value)
+             {
+                 Options.OpenAI.Mode         = Upstream::ETransportMode::Replay;
+                 Options.OpenAI.CassetteFile = Value;
+                 return true;
+             }},
+            {"openai-replay-speed", "Speed of a replay relative to the recording, 0 for no delays (default 1)",
+             [](auto& Options, const auto& Value) { return ParseDecimal(Value, Options.OpenAI.ReplaySpeed); }},
+            {"upstream-max-connections", "Most requests in flight to any one upstream API host, not counting event streams, 0 for no limit (default 64)",
+             [](auto& Options, const auto& Value) { return ParseNumber(Value, Options.OpenAI.MaxConnectionsPerHost); }},
+            {"openai-max-retries", "Retries of a transiently failed OpenAI call (default 3)",
+             [](auto& Options, const auto& Value) { return ParseNumber(Value, Options.OpenAIRetries.MaxRetries); }},
+            {"openai-breaker-threshold", "Failed OpenAI calls in a row that stop calls for a while, 0 to never stop them (default 5)",
+             [](auto& Options, const auto& Value) { return ParseNumber(Value, Options.OpenAIRetries.BreakerThreshold); }},
+            {"openai-breaker-cooldown-ms", "Milliseconds OpenAI calls stay stopped before a trial call (default 30000)",
+             [](auto& Options, const auto& Value) { return ParseDuration(Value, Options.OpenAIRetries.BreakerCooldown); }},
+            {"openai-rate-assistants", "OpenAI budget of assistants, threads, runs and files: requests[/tokens] per minute, 0 for no limit (default 1000)",
+             [](auto& Options, const auto& Value) { return ParseRateBudget(Value, Options.OpenAIRateLimits.Assistants); }},
+            {"openai-rate-chat", "OpenAI budget of chat completions: requests[/tokens] per minute (default 500/200000)",
+             [](auto& Options, const auto& Value) { return ParseRateBudget(Value, Options.OpenAIRateLimits.Chat); }},
+            {"openai-rate-embeddings", "OpenAI budget of embeddings: requests[/tokens] per minute (default 3000/1000000)",
+             [](auto& Options, const auto& Value) { return ParseRateBudget(Value, Options.OpenAIRateLimits.Embeddings); }},
+            {"openai-rate-audio", "OpenAI budget of speech and transcriptions: requests[/tokens] per minute (default 50)",
+             [](auto& Options, const auto& Value) { return ParseRateBudget(Value, Options.OpenAIRateLimits.Audio); }},
+            {"upload-cache-ttl-hours", "Hours an uploaded attachment is reused for when attached again, 0 to always upload (default 168)",
+             [](auto& Options, const auto& Value) { return ParseDuration(Value, Options.UploadCache.TTL); }},
+            {"upload-cache-verify-seconds", "Seconds a reused attachment is trusted before checking it still exists, 0 to always check (default 3600)",
+             [](auto& Options, const auto& Value) { return ParseDuration(Value, Options.UploadCache.VerifyInterval); }},
+            {"upload-max-mb", "Megabytes of a multipart message with its files, 0 for no limit (default 512)",
+             [](auto& Options, const auto& Value)
+             {
+                 size_t Megabytes = 0;
+                 if (!ParseNumber(Value, Megabytes))
+                 {
+                     return false;
+                 }
+                 Options.MessageUploads.MaxSize = Megabytes * 1024 * 1024;
+                 return true;
+             }},
+            {"upload-memory-kb", "Kilobytes of an uploaded file kept in memory, larger files are written to a temporary file (default 1024)",
+             [](auto& Options, const auto& Value)
+             {
+                 size_t Kilobytes = 0;
+                 if (!ParseNumber(Value, Kilobytes))
+                 {
+                     return false;
+                 }
+                 Options.MessageUploads.MemoryLimit = Kilobytes * 1024;
+                 return true;
+             }},
+        };
+        return SETTINGS;
+    }
+
+    /// @brief  Apply a setting by name
+    bool ApplySetting(OrionWebServerOptions& Options, const std::string& Name, const std::string& Value, std::string& OutError)
+    {
+        const auto& SETTINGS = GetSettings();
+        const auto  SETTING_ITER = std::find_if(SETTINGS.begin(), SETTINGS.end(), [&Name](const Setting& InSetting) { return InSetting.Name == Name; });
+        if (SETTING_ITER == SETTINGS.end())
+        {
+            OutError = "Unknown option: " + Name;
+            return false;
+        }
+
+        if (!SETTING_ITER->Apply(Options, Value))
+        {
+            OutError = "Invalid value for " + Name + ": " + Value;
+            return false;
+        }
+        return true;
+    }
+
+    /// @brief  Trim spaces and tabs
+    std::string Trim(const std::string& Text)
+    {
+        const auto FIRST = Text.find_first_not_of(" \t\r");
+        return FIRST == std::string::npos ? std::string() : Text.substr(FIRST, Text.find_last_not_of(" \t\r") - FIRST + 1);
+    }
+
+    /// @brief  Apply the settings of a config file
+    bool ApplyConfigFile(OrionWebServerOptions& Options, const std::string& FilePath, std::string& OutError)
+    {
+        std::ifstream ConfigFile(FilePath);
+        if (!ConfigFile.is_open())
+        {
+            OutError = "Could not open the config file " + FilePath;
+            return false;
+        }
+
+        std::string Line;
+        size_t      LineNumber = 0;
+        while (std::getline(ConfigFile, Line))
+        {
+            ++LineNumber;
+
+            Line = Trim(Line.substr(0, Line.find('#')));
+            if (Line.empty())
+            {
+                continue;
+            }
+
+            const auto EQUALS_POS = Line.find('=');
+            if (EQUALS_POS == std::string::npos)
+            {
+                OutError = FilePath + ":" + std::to_string(LineNumber) + ": expected name = value";
+                return false;
+            }
+
+            if (!ApplySetting(Options, Trim(Line.substr(0, EQUALS_POS)), Trim(Line.substr(EQUALS_POS + 1)), OutError))
+            {
+                OutError = FilePath + ":" + std::to_string(LineNumber) + ": " + OutError;
+                return false;
+            }
+        }
+        return true;
+    }
+} // namespace
+
+size_t OrionWebServerOptions::GetDefaultWorkerThreadCount()
+{
+    return std::max<size_t>(40, 4 * std::max(1u, std::thread::hardware_concurrency()));
+}
+
+size_t OrionWebServerOptions::GetWorkerThreadCount() const
+{
+    return WorkerThreadCount > 0 ? WorkerThreadCount : GetDefaultWorkerThreadCount();
+}
+
+std::optional<OrionWebServerOptions> OrionWebServerOptions::Parse(const std::vector<std::string>& Arguments, std::string& OutError)
+{
+    OutError.clear();
+
+    // Split the arguments into name/value pairs: --name value or --name=value
+    std::vector<std::pair<std::string, std::string>> Settings;
+    std::string                                      ConfigFilePath;
+    for (size_t Index = 0; Index < Arguments.size(); ++Index)
+    {
+        const auto& ARGUMENT = Arguments[Index];
+        if (ARGUMENT == "--help" || ARGUMENT == "-h")
+        {
+            return std::nullopt;
+        }
+
+        if (ARGUMENT.rfind("--", 0) != 0)
+        {
+            OutError = "Unexpected argument: " + ARGUMENT;
+            return std::nullopt;
+        }
+
+        std::string Name = ARGUMENT.substr(2);
+        std::string Value;
+        if (const auto EQUALS_POS = Name.find('='); EQUALS_POS != std::string::npos)
+        {
+            Value = Name.substr(EQUALS_POS + 1);
+            Name  = Name.substr(0, EQUALS_POS);
+        }
+        else if (Index + 1 < Arguments.size())
+        {
+            Value = Arguments[++Index];
+        }
+        else
+        {
+            OutError = "Missing value for --" + Name;
+            return std::nullopt;
+        }
+
+        if (Name == "config")
+        {
+            ConfigFilePath = Value;
+            continue;
+        }
+        Settings.emplace_back(std::move(Name), std::move(Value));
+    }
+
+    // The config file first, so the command line overrides it
+    OrionWebServerOptions Options;
+    if (!ConfigFilePath.empty() && !ApplyConfigFile(Options, ConfigFilePath, OutError))
+    {
+        return std::nullopt;
+    }
+
+    for (const auto& [Name, Value] : Settings)
+    {
+        if (!ApplySetting(Options, Name, Value, OutError))
+        {
+            return std::nullopt;
+        }
+    }
+
+    return Options;
+}
+
+std::string OrionWebServerOptions::GetUsage(const std::string& ProgramName)
+{
+    std::ostringstream Usage;
+    Usage << "Usage: " << ProgramName << " [--config <file>] [--<option> <value>]...\n\n";
+    Usage << "  --config <file>                 Read options from a file (one 'option = value' per line); the command line overrides it\n";
+    for (const auto& InSetting : GetSettings())
+    {
+        std::string Flag = "--" + std::string(InSetting.Name) + " <value>";
+        Flag.resize(std::max<size_t>(Flag.size() + 1, 32), ' ');
+        Usage << "  " << Flag << InSetting.Description << "\n";
+    }
+    return Usage.str();
+}
+
+std::string OrionWebServerOptions::Describe() const
+{
+    std::ostringstream Description;
+    Description << (IsTLSEnabled ? "https://" : "http://") << BindAddress << ":" << Port;
+    if (IsTLSEnabled)
+    {
+        Description << " (" << TLS.CertificateFile << ", session resumption " << (TLS.IsSessionResumptionEnabled ? "on" : "off") << ")";
+    }
+    Description << ", websocket " << (WebSocketPort > 0 && IsTLSEnabled ? std::to_string(WebSocketPort) : std::string("off"));
+    Description << ", " << GetWorkerThreadCount() << " worker threads" << (WorkerThreadCount == 0 ? " (auto)" : "");
+    Description << ", " << (EventDispatchShardCount > 0 ? std::to_string(EventDispatchShardCount) : std::string("auto")) << " event shards";
+    Description << ", " << UserStoreConnectionCount << " database connections";
+    Description << ", compression " << (Compression.IsEnabled ? "on" : "off");
+    Description << ", tracing " << (TraceBufferSize > 0 ? std::to_string(TraceBufferSize) + " traces" : std::string("off"));
+    Description << ", debug endpoints " << (IsDebugEndpointPublic ? "public" : "loopback only");
+    Description << ", openai " << Upstream::GetModeName(OpenAI.Mode);
+    if (OpenAI.Mode != Upstream::ETransportMode::Live)
+    {
+        Description << " (" << OpenAI.CassetteFile;
+        if (OpenAI.Mode == Upstream::ETransportMode::Replay)
+        {
+            Description << ", speed " << OpenAI.ReplaySpeed;
+        }
+        Description << ")";
+    }
+    Description << ", " << OpenAIRetries.MaxRetries << " openai retries";
+    Description << ", upload cache " << (UploadCache.TTL.count() > 0 ? std::to_string(UploadCache.TTL.count()) + "h" : std::string("off"));
+    return Description.str();
+}
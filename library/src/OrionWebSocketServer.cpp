@@ -0,0 +1,221 @@
+#include "OrionWebSocketServer.hpp"
+#include "Logger.hpp"
+
+#include <websocketpp/config/asio.hpp>
+#include <websocketpp/server.hpp>
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using namespace ORION;
+
+using WebSocketEndpoint = websocketpp::server<websocketpp::config::asio_tls>;
+
+struct OrionWebSocketServer::Impl
+{
+    explicit Impl(Callbacks&& InCallbacks)
+        : ServerCallbacks(std::move(InCallbacks))
+    {
+    }
+
+    /// @brief  The callbacks of the server
+    Callbacks ServerCallbacks;
+
+    /// @brief  The websocketpp endpoint
+    WebSocketEndpoint Endpoint;
+
+    /// @brief  The thread running the endpoint's io loop
+    std::thread Thread;
+
+    /// @brief  The open connections
+    std::unordered_map<ConnectionID, websocketpp::connection_hdl> Connections;
+
+    /// @brief  The connection id of each open connection handle
+    std::map<websocketpp::connection_hdl, ConnectionID, std::owner_less<websocketpp::connection_hdl>> ConnectionIDs;
+
+    /// @brief  The mutex for the connections
+    std::mutex ConnectionsMutex;
+
+    /// @brief  The id of the last connection
+    std::atomic<ConnectionID> LastConnectionID = 0;
+
+    /// @brief  Get the resource (path and query) a connection requested
+    std::string GetResource(const websocketpp::connection_hdl& Handle)
+    {
+        return Endpoint.get_con_from_hdl(Handle)->get_resource();
+    }
+
+    /// @brief  Forget a connection and notify the owner
+    void RemoveConnection(const websocketpp::connection_hdl& Handle)
+    {
+        ConnectionID ClosedConnectionID = 0;
+        {
+            std::lock_guard<std::mutex> ConnectionsLockGuard(ConnectionsMutex);
+            const auto                  ID_ITER = ConnectionIDs.find(Handle);
+            if (ID_ITER == ConnectionIDs.end())
+            {
+                return;
+            }
+
+            ClosedConnectionID = ID_ITER->second;
+            Connections.erase(ClosedConnectionID);
+            ConnectionIDs.erase(ID_ITER);
+        }
+
+        if (ServerCallbacks.OnClose)
+        {
+            ServerCallbacks.OnClose(ClosedConnectionID);
+        }
+    }
+};
+
+OrionWebSocketServer::OrionWebSocketServer(Callbacks InCallbacks)
+    : m_pImpl(std::make_unique<Impl>(std::move(InCallbacks)))
+{
+}
+
+OrionWebSocketServer::~OrionWebSocketServer()
+{
+    Stop();
+}
+
+bool OrionWebSocketServer::Start(const std::string& BindAddress, const int PORT, std::shared_ptr<const TLSServerContext> pTLSContext)
+{
+    auto& Endpoint = m_pImpl->Endpoint;
+
+    // Only log errors
+    Endpoint.clear_access_channels(websocketpp::log::alevel::all);
+    Endpoint.set_error_channels(websocketpp::log::elevel::warn | websocketpp::log::elevel::rerror | websocketpp::log::elevel::fatal);
+
+    Endpoint.init_asio();
+    Endpoint.set_reuse_addr(true);
+
+    Endpoint.set_tls_init_handler(
+        [pTLSContext](websocketpp::connection_hdl)
+        {
+            auto pContext = std::make_shared<boost::asio::ssl::context>(boost::asio::ssl::context::tls_server);
+            pContext->set_options(boost::asio::ssl::context::default_workarounds);
+            pTLSContext->Apply(pContext->native_handle());
+            return pContext;
+        });
+
+    Endpoint.set_validate_handler(
+        [this](websocketpp::connection_hdl Handle)
+        {
+            if (m_pImpl->ServerCallbacks.OnValidate && !m_pImpl->ServerCallbacks.OnValidate(m_pImpl->GetResource(Handle)))
+            {
+                m_pImpl->Endpoint.get_con_from_hdl(Handle)->set_status(websocketpp::http::status_code::forbidden);
+                return false;
+            }
+            return true;
+        });
+
+    Endpoint.set_open_handler(
+        [this](websocketpp::connection_hdl Handle)
+        {
+            const ConnectionID CONNECTION_ID = ++m_pImpl->LastConnectionID;
+            {
+                std::lock_guard<std::mutex> ConnectionsLockGuard(m_pImpl->ConnectionsMutex);
+                m_pImpl->Connections[CONNECTION_ID] = Handle;
+                m_pImpl->ConnectionIDs[Handle]      = CONNECTION_ID;
+            }
+
+            if (m_pImpl->ServerCallbacks.OnOpen)
+            {
+                m_pImpl->ServerCallbacks.OnOpen(CONNECTION_ID, m_pImpl->GetResource(Handle));
+            }
+        });
+
+    Endpoint.set_message_handler(
+        [this](websocketpp::connection_hdl Handle, WebSocketEndpoint::message_ptr pMessage)
+        {
+            if (pMessage->get_opcode() != websocketpp::frame::opcode::text || !m_pImpl->ServerCallbacks.OnMessage)
+            {
+                return;
+            }
+
+            ConnectionID SenderConnectionID = 0;
+            {
+                std::lock_guard<std::mutex> ConnectionsLockGuard(m_pImpl->ConnectionsMutex);
+                const auto                  ID_ITER = m_pImpl->ConnectionIDs.find(Handle);
+                if (ID_ITER == m_pImpl->ConnectionIDs.end())
+                {
+                    return;
+                }
+                SenderConnectionID = ID_ITER->second;
+            }
+
+            m_pImpl->ServerCallbacks.OnMessage(SenderConnectionID, pMessage->get_payload());
+        });
+
+    Endpoint.set_close_handler([this](websocketpp::connection_hdl Handle) { m_pImpl->RemoveConnection(Handle); });
+    Endpoint.set_fail_handler([this](websocketpp::connection_hdl Handle) { m_pImpl->RemoveConnection(Handle); });
+
+    websocketpp::lib::error_code ErrorCode;
+    Endpoint.listen(BindAddress, std::to_string(PORT), ErrorCode);
+    if (ErrorCode)
+    {
+        Log::Error("websocket", "Failed to listen", {{"address", BindAddress + ":" + std::to_string(PORT)}, {"error", ErrorCode.message()}});
+        return false;
+    }
+
+    Endpoint.start_accept(ErrorCode);
+    if (ErrorCode)
+    {
+        Log::Error("websocket", "Failed to accept connections", {{"error", ErrorCode.message()}});
+        return false;
+    }
+
+    m_pImpl->Thread = std::thread([this] { m_pImpl->Endpoint.run(); });
+    return true;
+}
+
+void OrionWebSocketServer::Stop()
+{
+    if (!m_pImpl->Thread.joinable())
+    {
+        return;
+    }
+
+    websocketpp::lib::error_code ErrorCode;
+    m_pImpl->Endpoint.stop_listening(ErrorCode);
+
+    // Close every connection. The io loop exits once they are all gone
+    std::vector<websocketpp::connection_hdl> OpenConnections;
+    {
+        std::lock_guard<std::mutex> ConnectionsLockGuard(m_pImpl->ConnectionsMutex);
+        for (const auto& [ID, Handle] : m_pImpl->Connections)
+        {
+            OpenConnections.push_back(Handle);
+        }
+    }
+
+    for (const auto& Handle : OpenConnections)
+    {
+        m_pImpl->Endpoint.close(Handle, websocketpp::close::status::going_away, "Server shutting down", ErrorCode);
+    }
+
+    m_pImpl->Thread.join();
+}
+
+bool OrionWebSocketServer::Send(const ConnectionID CONNECTION_ID, const std::string& Message)
+{
+    websocketpp::connection_hdl Handle;
+    {
+        std::lock_guard<std::mutex> ConnectionsLockGuard(m_pImpl->ConnectionsMutex);
+        const auto                  CONNECTION_ITER = m_pImpl->Connections.find(CONNECTION_ID);
+        if (CONNECTION_ITER == m_pImpl->Connections.end())
+        {
+            return false;
+        }
+        Handle = CONNECTION_ITER->second;
+    }
+
+    websocketpp::lib::error_code ErrorCode;
+    m_pImpl->Endpoint.send(Handle, Message, websocketpp::frame::opcode::text, ErrorCode);
+    return !ErrorCode;
+}
@@ -1,4 +1,5 @@
 #include "Plugin.hpp"
+#include "Logger.hpp"
 
 #include <dlfcn.h>
 #include <filesystem>
@@ -21,20 +22,20 @@ bool PluginModule::Load(const std::string& InPath, const Orion& InOrion, const b
 {
     if (m_Handle)
     {
-        std::cout << "Plugin already loaded." << std::endl;
+        Log::Warning("plugins", "Plugin already loaded", {{"path", InPath}});
         return true;
     }
 
     if (!std::filesystem::exists(InPath))
     {
-        std::cout << "Plugin not found: " << InPath << std::endl;
+        Log::Error("plugins", "Plugin not found", {{"path", InPath}});
         return false;
     }
 
     m_Handle = std::unique_ptr<void, void (*)(void*)>(dlopen(InPath.c_str(), RTLD_LAZY), reinterpret_cast<void (*)(void*)>(dlclose));
     if (!m_Handle)
     {
-        std::cout << "Failed to load plugin: " << dlerror() << std::endl;
+        Log::Error("plugins", "Failed to load plugin", {{"path", InPath}, {"error", dlerror()}});
         return false;
     }
 
@@ -42,14 +43,14 @@ bool PluginModule::Load(const std::string& InPath, const Orion& InOrion, const b
     const auto                        CREATE_PLUGIN = reinterpret_cast<CreatePluginFunc>(dlsym(m_Handle.get(), "CreatePlugin"));
     if (!CREATE_PLUGIN)
     {
-        std::cout << "Failed to load plugin: " << dlerror() << std::endl;
+        Log::Error("plugins", "Failed to load plugin", {{"path", InPath}, {"error", dlerror()}});
         return false;
     }
 
     m_Plugin = std::unique_ptr<IPlugin>(CREATE_PLUGIN());
     if (!m_Plugin)
     {
-        std::cout << "Failed to load plugin: " << dlerror() << std::endl;
+        Log::Error("plugins", "Failed to load plugin", {{"path", InPath}, {"error", dlerror()}});
         return false;
     }
 
@@ -64,13 +65,13 @@ void PluginModule::Unload(const bool INNER_UNLOAD)
 {
     if (!m_Handle)
     {
-        std::cout << "Plugin not loaded." << std::endl;
+        Log::Warning("plugins", "Plugin not loaded");
         return;
     }
 
     if (!m_Plugin)
     {
-        std::cout << "Plugin not loaded." << std::endl;
+        Log::Warning("plugins", "Plugin not loaded");
         return;
     }
 
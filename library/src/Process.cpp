@@ -1,8 +1,8 @@
 #include "Process.hpp"
+#include "Logger.hpp"
 
 #include <cstdio>
 #include <cstdlib>
-#include <iostream>
 
 using namespace ORION;
 
@@ -37,20 +37,20 @@ int Process::Execute(const char* pPath, const char* pArgs)
             if (const int EXIT_CODE = WEXITSTATUS(Status); EXIT_CODE != 0)
             {
                 // Child process exited with an error
-                std::cerr << "Child process exited with code " << EXIT_CODE << std::endl;
+                Log::Error("process", "Child process exited with an error", {{"exit_code", std::to_string(EXIT_CODE)}});
 
                 return EXIT_CODE;
             }
             else
             {
-                std::cout << "Child process exited normally" << std::endl;
+                Log::Debug("process", "Child process exited normally");
 
                 return EXIT_CODE;
             }
         }
 
         // Child process did not exit normally
-        std::cerr << "Child process did not exit normally" << std::endl;
+        Log::Error("process", "Child process did not exit normally");
 
         return EXIT_FAILURE;
     }
@@ -0,0 +1,166 @@
+#include "TLSServerContext.hpp"
+
+#include <openssl/err.h>
+#include <openssl/pem.h>
+#include <openssl/rand.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+
+using namespace ORION;
+
+namespace
+{
+    /// @brief  The key exchange groups, fastest first
+    constexpr const char* KEY_EXCHANGE_GROUPS = "X25519:P-256:P-384";
+
+    /// @brief  The session id context. OpenSSL only resumes sessions issued under the same one, and every connection has its own ssl context
+    constexpr unsigned char SESSION_ID_CONTEXT[] = "orion";
+
+    /// @brief  Get the last OpenSSL error as text (and clear the error queue)
+    std::string GetOpenSSLError()
+    {
+        const unsigned long ERROR_CODE = ERR_get_error();
+        ERR_clear_error();
+        if (ERROR_CODE == 0)
+        {
+            return "unknown error";
+        }
+
+        char Buffer[256];
+        ERR_error_string_n(ERROR_CODE, Buffer, sizeof(Buffer));
+        return Buffer;
+    }
+} // namespace
+
+struct TLSServerContext::Credentials
+{
+    ~Credentials()
+    {
+        X509_free(pCertificate);
+        sk_X509_pop_free(pChain, X509_free);
+        EVP_PKEY_free(pPrivateKey);
+        OPENSSL_cleanse(TicketKeys, sizeof(TicketKeys));
+    }
+
+    /// @brief  The leaf certificate
+    X509* pCertificate = nullptr;
+
+    /// @brief  The intermediate certificates
+    STACK_OF(X509) * pChain = nullptr;
+
+    /// @brief  The private key
+    EVP_PKEY* pPrivateKey = nullptr;
+
+    /// @brief  The session ticket keys: 16 bytes of key name, 32 of HMAC key and 32 of AES key
+    unsigned char TicketKeys[80] = {};
+};
+
+TLSServerContext::TLSServerContext(const TLSOptions& OPTIONS)
+    : m_Options(OPTIONS),
+      m_pCredentials(std::make_unique<Credentials>())
+{
+}
+
+TLSServerContext::~TLSServerContext() = default;
+
+std::shared_ptr<const TLSServerContext> TLSServerContext::Create(const TLSOptions& OPTIONS, std::string& OutError)
+{
+    std::shared_ptr<TLSServerContext> pServerContext(new TLSServerContext(OPTIONS));
+    auto&                             Credentials = *pServerContext->m_pCredentials;
+
+    // The certificate chain, leaf first
+    BIO* pCertificateBio = BIO_new_file(OPTIONS.CertificateFile.c_str(), "r");
+    if (pCertificateBio == nullptr)
+    {
+        OutError = "Could not open the certificate file " + OPTIONS.CertificateFile + ": " + GetOpenSSLError();
+        return nullptr;
+    }
+
+    Credentials.pCertificate = PEM_read_bio_X509_AUX(pCertificateBio, nullptr, nullptr, nullptr);
+    Credentials.pChain       = sk_X509_new_null();
+    while (X509* pIntermediate = PEM_read_bio_X509(pCertificateBio, nullptr, nullptr, nullptr))
+    {
+        sk_X509_push(Credentials.pChain, pIntermediate);
+    }
+    BIO_free(pCertificateBio);
+    ERR_clear_error(); // The end of the file is reported as an error
+
+    if (Credentials.pCertificate == nullptr)
+    {
+        OutError = "No certificate in " + OPTIONS.CertificateFile;
+        return nullptr;
+    }
+
+    // The private key
+    BIO* pKeyBio = BIO_new_file(OPTIONS.PrivateKeyFile.c_str(), "r");
+    if (pKeyBio == nullptr)
+    {
+        OutError = "Could not open the private key file " + OPTIONS.PrivateKeyFile + ": " + GetOpenSSLError();
+        return nullptr;
+    }
+
+    Credentials.pPrivateKey = PEM_read_bio_PrivateKey(pKeyBio, nullptr, nullptr, nullptr);
+    BIO_free(pKeyBio);
+    if (Credentials.pPrivateKey == nullptr)
+    {
+        OutError = "Could not read the private key in " + OPTIONS.PrivateKeyFile + ": " + GetOpenSSLError();
+        return nullptr;
+    }
+
+    if (X509_check_private_key(Credentials.pCertificate, Credentials.pPrivateKey) != 1)
+    {
+        OutError = "The private key in " + OPTIONS.PrivateKeyFile + " does not match the certificate in " + OPTIONS.CertificateFile;
+        ERR_clear_error();
+        return nullptr;
+    }
+
+    if (RAND_bytes(Credentials.TicketKeys, sizeof(Credentials.TicketKeys)) != 1)
+    {
+        OutError = "Could not generate the session ticket keys: " + GetOpenSSLError();
+        return nullptr;
+    }
+
+    // Configure a scratch context so invalid settings (e.g. the cipher list) are reported now rather than on every handshake
+    SSL_CTX* pScratchContext = SSL_CTX_new(TLS_server_method());
+    if (pScratchContext == nullptr || !pServerContext->Apply(pScratchContext))
+    {
+        OutError = "Invalid TLS settings: " + GetOpenSSLError();
+        SSL_CTX_free(pScratchContext);
+        return nullptr;
+    }
+    SSL_CTX_free(pScratchContext);
+
+    return pServerContext;
+}
+
+bool TLSServerContext::Apply(ssl_ctx_st* pContext) const
+{
+    // TLS 1.2 and newer with forward secret AEAD ciphers. Renegotiation and compression are never needed and only add attack surface
+    SSL_CTX_set_min_proto_version(pContext, TLS1_2_VERSION);
+    SSL_CTX_set_options(pContext, SSL_OP_NO_COMPRESSION | SSL_OP_NO_RENEGOTIATION);
+    if (SSL_CTX_set_cipher_list(pContext, m_Options.Ciphers.c_str()) != 1 || SSL_CTX_set1_groups_list(pContext, KEY_EXCHANGE_GROUPS) != 1)
+    {
+        return false;
+    }
+
+    // The credentials parsed at startup (the context takes its own references)
+    if (SSL_CTX_use_certificate(pContext, m_pCredentials->pCertificate) != 1 || SSL_CTX_use_PrivateKey(pContext, m_pCredentials->pPrivateKey) != 1 ||
+        SSL_CTX_set1_chain(pContext, m_pCredentials->pChain) != 1)
+    {
+        return false;
+    }
+
+    // Stateless session tickets encrypted with the shared keys, so any connection can resume a session issued by another. The per-context
+    // session cache is useless when every connection has its own context
+    SSL_CTX_set_session_cache_mode(pContext, SSL_SESS_CACHE_OFF);
+    if (!m_Options.IsSessionResumptionEnabled)
+    {
+        SSL_CTX_set_options(pContext, SSL_OP_NO_TICKET);
+        SSL_CTX_set_num_tickets(pContext, 0);
+        return true;
+    }
+
+    SSL_CTX_clear_options(pContext, SSL_OP_NO_TICKET);
+    return SSL_CTX_set_session_id_context(pContext, SESSION_ID_CONTEXT, sizeof(SESSION_ID_CONTEXT) - 1) == 1 &&
+           SSL_CTX_set_tlsext_ticket_keys(pContext, const_cast<unsigned char*>(m_pCredentials->TicketKeys), sizeof(m_pCredentials->TicketKeys)) == 1;
+}
@@ -0,0 +1,75 @@
+#include "TimerQueue.hpp"
+#include "Logger.hpp"
+
+#include <exception>
+
+using namespace ORION;
+
+TimerQueue::TimerQueue()
+    : m_TimerThread(&TimerQueue::TimerThreadHandler, this)
+{
+}
+
+TimerQueue::~TimerQueue()
+{
+    {
+        std::lock_guard<std::mutex> Lock(m_Mutex);
+        m_IsRunning = false;
+    }
+    m_ConditionVariable.notify_one();
+
+    if (m_TimerThread.joinable())
+    {
+        m_TimerThread.join();
+    }
+}
+
+void TimerQueue::ScheduleAt(const std::chrono::steady_clock::time_point DUE, std::function<void()> Callback)
+{
+    bool IsEarliest = false;
+    {
+        std::lock_guard<std::mutex> Lock(m_Mutex);
+        IsEarliest = m_Timers.empty() || DUE < m_Timers.top().Due;
+        m_Timers.push({DUE, m_NextSequence++, std::move(Callback)});
+    }
+
+    // The thread only needs to wake up if it is waiting for a later timer (or for any)
+    if (IsEarliest)
+    {
+        m_ConditionVariable.notify_one();
+    }
+}
+
+void TimerQueue::TimerThreadHandler()
+{
+    std::unique_lock<std::mutex> Lock(m_Mutex);
+    while (m_IsRunning)
+    {
+        if (m_Timers.empty())
+        {
+            m_ConditionVariable.wait(Lock);
+            continue;
+        }
+
+        if (const auto DUE = m_Timers.top().Due; DUE > std::chrono::steady_clock::now())
+        {
+            m_ConditionVariable.wait_until(Lock, DUE);
+            continue;
+        }
+
+        // The callback is moved out before the pop; priority_queue only hands out const references
+        auto Callback = std::move(const_cast<Timer&>(m_Timers.top()).Callback);
+        m_Timers.pop();
+
+        Lock.unlock();
+        try
+        {
+            Callback();
+        }
+        catch (const std::exception& Exception)
+        {
+            Log::Error("timers", "A timer callback failed", {{"error", Exception.what()}});
+        }
+        Lock.lock();
+    }
+}
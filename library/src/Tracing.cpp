@@ -0,0 +1,506 @@
+#include "Tracing.hpp"
+#include "Logger.hpp"
+#include "Metrics.hpp"
+
+#include <algorithm>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <sstream>
+
+using namespace ORION;
+using namespace ORION::Tracing;
+
+namespace
+{
+    /// @brief  The active trace of the current thread, and the span new spans are parented to
+    thread_local std::shared_ptr<Trace> t_pCurrentTrace;
+    thread_local SpanID                 t_CurrentSpanID = 0;
+
+    /// @brief  Generate a random, non-zero 64 bit id
+    uint64_t GenerateID()
+    {
+        thread_local std::mt19937_64 RandomGenerator(std::random_device {}());
+
+        uint64_t ID = 0;
+        while (ID == 0)
+        {
+            ID = RandomGenerator();
+        }
+        return ID;
+    }
+
+    /// @brief  Format a 64 bit id as 16 hex characters
+    std::string ToHex(const uint64_t ID)
+    {
+        std::stringstream HexStream;
+        HexStream << std::hex << std::setfill('0') << std::setw(16) << ID;
+        return HexStream.str();
+    }
+
+    /// @brief  Convert attributes to a json object (for the timeline)
+    web::json::value ToJsonObject(const Attributes& InAttributes)
+    {
+        auto JAttributes = web::json::value::object();
+        for (const auto& [Key, Value] : InAttributes)
+        {
+            JAttributes[Key] = web::json::value::string(Value);
+        }
+        return JAttributes;
+    }
+
+    /// @brief  Convert attributes to an array of OTLP KeyValues
+    web::json::value ToOTLPAttributes(const Attributes& InAttributes)
+    {
+        auto JAttributes = web::json::value::array();
+        for (const auto& [Key, Value] : InAttributes)
+        {
+            auto JValue           = web::json::value::object();
+            JValue["stringValue"] = web::json::value::string(Value);
+
+            auto JAttribute     = web::json::value::object();
+            JAttribute["key"]   = web::json::value::string(Key);
+            JAttribute["value"] = JValue;
+
+            JAttributes[JAttributes.size()] = JAttribute;
+        }
+        return JAttributes;
+    }
+} // namespace
+
+Trace::Trace(const std::string& Name, Attributes InAttributes)
+    : m_TraceID(ToHex(GenerateID()) + ToHex(GenerateID())),
+      m_Start(std::chrono::steady_clock::now()),
+      m_SystemStart(std::chrono::system_clock::now())
+{
+    Span Root;
+    Root.ID             = GenerateID();
+    Root.Name           = Name;
+    Root.Start          = m_Start;
+    Root.SpanAttributes = std::move(InAttributes);
+
+    m_RootSpanID = Root.ID;
+    m_Spans.push_back(std::move(Root));
+}
+
+SpanID Trace::StartSpan(const std::string& Name, const SpanID PARENT_ID)
+{
+    Span NewSpan;
+    NewSpan.ID       = GenerateID();
+    NewSpan.ParentID = PARENT_ID != 0 ? PARENT_ID : m_RootSpanID;
+    NewSpan.Name     = Name;
+    NewSpan.Start    = std::chrono::steady_clock::now();
+
+    std::lock_guard<std::mutex> LockGuard(m_Mutex);
+    m_Spans.push_back(std::move(NewSpan));
+    return m_Spans.back().ID;
+}
+
+void Trace::EndSpan(const SpanID SPAN_ID, const Attributes& InAttributes, const bool IS_ERROR)
+{
+    const auto NOW = std::chrono::steady_clock::now();
+
+    std::lock_guard<std::mutex> LockGuard(m_Mutex);
+    if (auto pSpan = FindSpan(SPAN_ID); pSpan && !pSpan->IsEnded)
+    {
+        pSpan->End     = NOW;
+        pSpan->IsEnded = true;
+        pSpan->IsError = pSpan->IsError || IS_ERROR;
+        pSpan->SpanAttributes.insert(pSpan->SpanAttributes.end(), InAttributes.begin(), InAttributes.end());
+    }
+}
+
+void Trace::SetAttribute(const SpanID SPAN_ID, const std::string& Key, const std::string& Value)
+{
+    std::lock_guard<std::mutex> LockGuard(m_Mutex);
+    if (auto pSpan = FindSpan(SPAN_ID))
+    {
+        pSpan->SpanAttributes.emplace_back(Key, Value);
+    }
+}
+
+void Trace::AddEvent(const SpanID SPAN_ID, const std::string& Name)
+{
+    const auto NOW = std::chrono::steady_clock::now();
+
+    std::lock_guard<std::mutex> LockGuard(m_Mutex);
+    if (auto pSpan = FindSpan(SPAN_ID))
+    {
+        pSpan->Events.push_back({Name, NOW});
+    }
+}
+
+bool Trace::MarkFirstToken()
+{
+    const auto NOW = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> LockGuard(m_Mutex);
+        if (m_FirstToken)
+        {
+            return false;
+        }
+        m_FirstToken = NOW;
+    }
+
+    static auto& TimeToFirstToken = Metrics::Registry::Get().GetHistogram("orion_time_to_first_token_seconds",
+                                                                          "Time from receiving a message to the first token of the reply");
+    TimeToFirstToken.Observe(std::chrono::duration<double>(NOW - m_Start).count());
+    return true;
+}
+
+std::optional<std::chrono::steady_clock::duration> Trace::GetTimeToFirstToken() const
+{
+    std::lock_guard<std::mutex> LockGuard(m_Mutex);
+    if (!m_FirstToken)
+    {
+        return std::nullopt;
+    }
+    return *m_FirstToken - m_Start;
+}
+
+void Trace::Finish(const bool IS_ERROR)
+{
+    const auto NOW = std::chrono::steady_clock::now();
+
+    std::lock_guard<std::mutex> LockGuard(m_Mutex);
+    if (m_IsFinished)
+    {
+        return;
+    }
+    m_IsFinished = true;
+
+    // Spans left open (a stream that ended early, an exception) end with the trace
+    for (auto& OpenSpan : m_Spans)
+    {
+        if (!OpenSpan.IsEnded)
+        {
+            OpenSpan.End     = NOW;
+            OpenSpan.IsEnded = true;
+        }
+    }
+    m_Spans.front().IsError = m_Spans.front().IsError || IS_ERROR;
+}
+
+bool Trace::IsFinished() const
+{
+    std::lock_guard<std::mutex> LockGuard(m_Mutex);
+    return m_IsFinished;
+}
+
+web::json::value Trace::ToSummaryJson() const
+{
+    std::lock_guard<std::mutex> LockGuard(m_Mutex);
+    const auto&                 ROOT = m_Spans.front();
+
+    const auto START_TIME_MILLISECONDS = std::chrono::duration_cast<std::chrono::milliseconds>(m_SystemStart.time_since_epoch()).count();
+
+    auto JSummary                      = web::json::value::object();
+    JSummary["trace_id"]               = web::json::value::string(m_TraceID);
+    JSummary["name"]                   = web::json::value::string(ROOT.Name);
+    JSummary["start_time_unix_ms"]     = web::json::value::number(static_cast<int64_t>(START_TIME_MILLISECONDS));
+    JSummary["duration_ms"]            = ROOT.IsEnded ? web::json::value::number(ToMilliseconds(ROOT.End)) : web::json::value::null();
+    JSummary["time_to_first_token_ms"] = m_FirstToken ? web::json::value::number(ToMilliseconds(*m_FirstToken)) : web::json::value::null();
+    JSummary["in_progress"]            = web::json::value::boolean(!m_IsFinished);
+    JSummary["error"]                  = web::json::value::boolean(ROOT.IsError);
+    JSummary["attributes"]             = ToJsonObject(ROOT.SpanAttributes);
+    return JSummary;
+}
+
+web::json::value Trace::ToJson() const
+{
+    auto JTrace = ToSummaryJson();
+
+    std::lock_guard<std::mutex> LockGuard(m_Mutex);
+
+    auto JSpans = web::json::value::array();
+    for (const auto& TraceSpan : m_Spans)
+    {
+        auto JSpan              = web::json::value::object();
+        JSpan["span_id"]        = web::json::value::string(ToHex(TraceSpan.ID));
+        JSpan["parent_span_id"] = TraceSpan.ParentID != 0 ? web::json::value::string(ToHex(TraceSpan.ParentID)) : web::json::value::null();
+        JSpan["name"]           = web::json::value::string(TraceSpan.Name);
+        JSpan["start_ms"]       = web::json::value::number(ToMilliseconds(TraceSpan.Start));
+        JSpan["duration_ms"]    = TraceSpan.IsEnded ? web::json::value::number(ToMilliseconds(TraceSpan.End) - ToMilliseconds(TraceSpan.Start))
+                                                    : web::json::value::null();
+        JSpan["error"]          = web::json::value::boolean(TraceSpan.IsError);
+        JSpan["attributes"]     = ToJsonObject(TraceSpan.SpanAttributes);
+
+        auto JEvents = web::json::value::array();
+        for (const auto& SpanEvent : TraceSpan.Events)
+        {
+            auto JEvent             = web::json::value::object();
+            JEvent["name"]          = web::json::value::string(SpanEvent.Name);
+            JEvent["time_ms"]       = web::json::value::number(ToMilliseconds(SpanEvent.Time));
+            JEvents[JEvents.size()] = JEvent;
+        }
+        JSpan["events"] = JEvents;
+
+        JSpans[JSpans.size()] = JSpan;
+    }
+    JTrace["spans"] = JSpans;
+
+    return JTrace;
+}
+
+web::json::value Trace::ToOTLPJson() const
+{
+    std::lock_guard<std::mutex> LockGuard(m_Mutex);
+
+    auto JSpans = web::json::value::array();
+    for (const auto& TraceSpan : m_Spans)
+    {
+        auto SpanAttributes = TraceSpan.SpanAttributes;
+        if (TraceSpan.ID == m_RootSpanID && m_FirstToken)
+        {
+            SpanAttributes.emplace_back("orion.time_to_first_token_ms", std::to_string(ToMilliseconds(*m_FirstToken)));
+        }
+
+        // SPAN_KIND_SERVER for the message, SPAN_KIND_INTERNAL for the rest
+        auto JSpan                 = web::json::value::object();
+        JSpan["traceId"]           = web::json::value::string(m_TraceID);
+        JSpan["spanId"]            = web::json::value::string(ToHex(TraceSpan.ID));
+        JSpan["name"]              = web::json::value::string(TraceSpan.Name);
+        JSpan["kind"]              = web::json::value::number(TraceSpan.ID == m_RootSpanID ? 2 : 1);
+        JSpan["startTimeUnixNano"] = web::json::value::string(ToUnixNanoseconds(TraceSpan.Start));
+        JSpan["endTimeUnixNano"]   = web::json::value::string(ToUnixNanoseconds(TraceSpan.IsEnded ? TraceSpan.End : TraceSpan.Start));
+        JSpan["attributes"]        = ToOTLPAttributes(SpanAttributes);
+        if (TraceSpan.ParentID != 0)
+        {
+            JSpan["parentSpanId"] = web::json::value::string(ToHex(TraceSpan.ParentID));
+        }
+
+        auto JEvents = web::json::value::array();
+        for (const auto& SpanEvent : TraceSpan.Events)
+        {
+            auto JEvent             = web::json::value::object();
+            JEvent["name"]          = web::json::value::string(SpanEvent.Name);
+            JEvent["timeUnixNano"]  = web::json::value::string(ToUnixNanoseconds(SpanEvent.Time));
+            JEvents[JEvents.size()] = JEvent;
+        }
+        JSpan["events"] = JEvents;
+
+        auto JStatus    = web::json::value::object();
+        JStatus["code"] = web::json::value::number(TraceSpan.IsError ? 2 : 1); // STATUS_CODE_ERROR / STATUS_CODE_OK
+        JSpan["status"] = JStatus;
+
+        JSpans[JSpans.size()] = JSpan;
+    }
+
+    auto JScope    = web::json::value::object();
+    JScope["name"] = web::json::value::string("orion");
+
+    auto JScopeSpans     = web::json::value::object();
+    JScopeSpans["scope"] = JScope;
+    JScopeSpans["spans"] = JSpans;
+
+    auto JResource          = web::json::value::object();
+    JResource["attributes"] = ToOTLPAttributes({{"service.name", "orion"}});
+
+    auto JResourceSpans          = web::json::value::object();
+    JResourceSpans["resource"]   = JResource;
+    JResourceSpans["scopeSpans"] = web::json::value::array({JScopeSpans});
+
+    auto JRequest             = web::json::value::object();
+    JRequest["resourceSpans"] = web::json::value::array({JResourceSpans});
+    return JRequest;
+}
+
+Trace::Span* Trace::FindSpan(const SpanID SPAN_ID)
+{
+    // Traces have tens of spans, and recent spans are the ones being ended
+    const auto SPAN_ITER = std::find_if(m_Spans.rbegin(), m_Spans.rend(), [SPAN_ID](const Span& TraceSpan) { return TraceSpan.ID == SPAN_ID; });
+    return SPAN_ITER != m_Spans.rend() ? &*SPAN_ITER : nullptr;
+}
+
+double Trace::ToMilliseconds(const std::chrono::steady_clock::time_point& Time) const
+{
+    return std::chrono::duration<double, std::milli>(Time - m_Start).count();
+}
+
+std::string Trace::ToUnixNanoseconds(const std::chrono::steady_clock::time_point& Time) const
+{
+    const auto SYSTEM_TIME = m_SystemStart + std::chrono::duration_cast<std::chrono::system_clock::duration>(Time - m_Start);
+    return std::to_string(std::chrono::duration_cast<std::chrono::nanoseconds>(SYSTEM_TIME.time_since_epoch()).count());
+}
+
+TraceScope::TraceScope(std::shared_ptr<Trace> pTrace, const SpanID PARENT_ID)
+    : m_pPreviousTrace(std::move(t_pCurrentTrace)),
+      m_PreviousSpanID(t_CurrentSpanID)
+{
+    t_CurrentSpanID = pTrace ? (PARENT_ID != 0 ? PARENT_ID : pTrace->GetRootSpanID()) : 0;
+    t_pCurrentTrace = std::move(pTrace);
+}
+
+TraceScope::~TraceScope()
+{
+    t_pCurrentTrace = std::move(m_pPreviousTrace);
+    t_CurrentSpanID = m_PreviousSpanID;
+}
+
+std::shared_ptr<Trace> TraceScope::GetCurrentTrace()
+{
+    return t_pCurrentTrace;
+}
+
+SpanID TraceScope::GetCurrentSpanID()
+{
+    return t_CurrentSpanID;
+}
+
+ScopedSpan::ScopedSpan(const std::string& Name, const Attributes& InAttributes)
+    : m_pTrace(t_pCurrentTrace),
+      m_PreviousSpanID(t_CurrentSpanID)
+{
+    if (!m_pTrace)
+    {
+        return;
+    }
+
+    m_SpanID = m_pTrace->StartSpan(Name, m_PreviousSpanID);
+    for (const auto& [Key, Value] : InAttributes)
+    {
+        m_pTrace->SetAttribute(m_SpanID, Key, Value);
+    }
+    t_CurrentSpanID = m_SpanID;
+}
+
+ScopedSpan::~ScopedSpan()
+{
+    if (!m_pTrace)
+    {
+        return;
+    }
+
+    m_pTrace->EndSpan(m_SpanID, {}, m_IsError || std::uncaught_exceptions() > 0);
+    t_CurrentSpanID = m_PreviousSpanID;
+}
+
+void ScopedSpan::SetAttribute(const std::string& Key, const std::string& Value)
+{
+    if (m_pTrace)
+    {
+        m_pTrace->SetAttribute(m_SpanID, Key, Value);
+    }
+}
+
+TraceStore& TraceStore::Get()
+{
+    static TraceStore Store;
+    return Store;
+}
+
+void TraceStore::Configure(const size_t CAPACITY, const std::string& OTLPDirectory)
+{
+    if (!OTLPDirectory.empty())
+    {
+        std::error_code ErrorCode;
+        std::filesystem::create_directories(OTLPDirectory, ErrorCode);
+        if (ErrorCode)
+        {
+            Log::Error("tracing", "Failed to create the trace directory", {{"path", OTLPDirectory}, {"error", ErrorCode.message()}});
+        }
+    }
+
+    std::lock_guard<std::mutex> LockGuard(m_Mutex);
+    m_Capacity      = CAPACITY;
+    m_OTLPDirectory = OTLPDirectory;
+    while (m_Traces.size() > m_Capacity)
+    {
+        m_Traces.pop_front();
+    }
+}
+
+std::shared_ptr<Trace> TraceStore::StartTrace(const std::string& Name, Attributes InAttributes)
+{
+    std::lock_guard<std::mutex> LockGuard(m_Mutex);
+    if (m_Capacity == 0)
+    {
+        return nullptr;
+    }
+
+    auto pTrace = std::make_shared<Trace>(Name, std::move(InAttributes));
+    if (m_Traces.size() >= m_Capacity)
+    {
+        m_Traces.pop_front();
+    }
+    m_Traces.push_back(pTrace);
+    return pTrace;
+}
+
+void TraceStore::FinishTrace(const std::shared_ptr<Trace>& pTrace, const bool IS_ERROR)
+{
+    if (!pTrace)
+    {
+        return;
+    }
+    pTrace->Finish(IS_ERROR);
+
+    std::string OTLPDirectory;
+    {
+        std::lock_guard<std::mutex> LockGuard(m_Mutex);
+        OTLPDirectory = m_OTLPDirectory;
+    }
+    if (OTLPDirectory.empty())
+    {
+        return;
+    }
+
+    // One file per trace, so a collector can pick them up as they appear
+    const auto    FILE_PATH = std::filesystem::path(OTLPDirectory) / (pTrace->GetTraceID() + ".json");
+    std::ofstream TraceFile(FILE_PATH, std::ios::binary | std::ios::trunc);
+    if (!TraceFile)
+    {
+        Log::Error("tracing", "Failed to write the trace", {{"path", FILE_PATH.string()}});
+        return;
+    }
+    TraceFile << pTrace->ToOTLPJson().serialize();
+}
+
+std::vector<std::shared_ptr<Trace>> TraceStore::GetRecentTraces() const
+{
+    std::lock_guard<std::mutex> LockGuard(m_Mutex);
+    return {m_Traces.rbegin(), m_Traces.rend()};
+}
+
+std::shared_ptr<Trace> TraceStore::FindTrace(const std::string& TraceID) const
+{
+    std::lock_guard<std::mutex> LockGuard(m_Mutex);
+    const auto TRACE_ITER = std::find_if(m_Traces.begin(), m_Traces.end(), [&TraceID](const auto& pTrace) { return pTrace->GetTraceID() == TraceID; });
+    return TRACE_ITER != m_Traces.end() ? *TRACE_ITER : nullptr;
+}
+
+void Tracing::InstrumentClient(web::http::client::http_client& Client, const std::string& Service)
+{
+    Client.add_handler(
+        [Service](web::http::http_request Request, std::shared_ptr<web::http::http_pipeline_stage> pNextStage)
+        {
+            // Requests are sent from the thread that handles the message, so the active trace is the message's
+            auto pTrace = TraceScope::GetCurrentTrace();
+            if (!pTrace)
+            {
+                return pNextStage->propagate(Request);
+            }
+
+            const auto SPAN_ID = pTrace->StartSpan(Service + " " + Request.method() + " " + Metrics::GetEndpointLabel(Request.request_uri().path()),
+                                                   TraceScope::GetCurrentSpanID());
+
+            // The response completes when its headers arrive, so the span of a streamed response ends at its first byte
+            return pNextStage->propagate(Request).then(
+                [pTrace, SPAN_ID](pplx::task<web::http::http_response> ResponseTask)
+                {
+                    try
+                    {
+                        auto Response = ResponseTask.get();
+                        pTrace->EndSpan(SPAN_ID, {{"http.status_code", std::to_string(Response.status_code())}}, Response.status_code() >= 400);
+                        return Response;
+                    }
+                    catch (...)
+                    {
+                        pTrace->EndSpan(SPAN_ID, {}, true);
+                        throw;
+                    }
+                });
+        });
+}
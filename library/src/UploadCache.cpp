@@ -0,0 +1,347 @@
+#include "UploadCache.hpp"
+#include "Logger.hpp"
+#include "Metrics.hpp"
+#include "Tracing.hpp"
+
+#include <openssl/evp.h>
+#include <sqlite_modern_cpp.h>
+
+#include <stdexcept>
+
+using namespace ORION;
+
+namespace
+{
+    /// @brief  How long a writer waits for another writer before the query fails with SQLITE_BUSY
+    constexpr int BUSY_TIMEOUT_MS = 5000;
+
+    /// @brief  The current schema version (PRAGMA user_version)
+    constexpr int SCHEMA_VERSION = 1;
+
+    /// @brief  Get the current time in seconds since the epoch, the unit the database keeps times in
+    int64_t GetNow()
+    {
+        return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    /// @brief  Hash the chunks a reader passes to its sink with SHA-256
+    /// @return The hash in lowercase hex
+    std::string HashSHA256(const std::function<void(const std::function<void(const unsigned char* pData, const size_t SIZE)>& Sink)>& Reader)
+    {
+        std::unique_ptr<EVP_MD_CTX, decltype(&EVP_MD_CTX_free)> pContext(EVP_MD_CTX_new(), &EVP_MD_CTX_free);
+        if (!pContext || EVP_DigestInit_ex(pContext.get(), EVP_sha256(), nullptr) != 1)
+        {
+            throw std::runtime_error("SHA-256 is not available");
+        }
+
+        Reader([&pContext](const unsigned char* pData, const size_t SIZE) { EVP_DigestUpdate(pContext.get(), pData, SIZE); });
+
+        unsigned char Digest[EVP_MAX_MD_SIZE];
+        unsigned int  DigestSize = 0;
+        if (EVP_DigestFinal_ex(pContext.get(), Digest, &DigestSize) != 1)
+        {
+            throw std::runtime_error("SHA-256 failed");
+        }
+
+        static constexpr char HEX_DIGITS[] = "0123456789abcdef";
+
+        std::string Hash;
+        Hash.reserve(DigestSize * 2);
+        for (unsigned int Index = 0; Index < DigestSize; ++Index)
+        {
+            Hash += HEX_DIGITS[Digest[Index] >> 4];
+            Hash += HEX_DIGITS[Digest[Index] & 0x0F];
+        }
+        return Hash;
+    }
+
+    /// @brief  Count a lookup by its result (hit, verified, stale, miss)
+    void CountLookup(const std::string& Result)
+    {
+        Metrics::Registry::Get()
+            .GetCounter("orion_upload_cache_lookups_total", "Lookups of attachments in the upload cache by result (hit, verified, stale, miss)", {{"result", Result}})
+            .Increment();
+    }
+
+    /// @brief  Record the result of a lookup on the span of the upload
+    void TraceLookup(const std::shared_ptr<Tracing::Trace>& pTrace, const Tracing::SpanID SPAN_ID, const std::string& Result)
+    {
+        CountLookup(Result);
+        if (pTrace)
+        {
+            pTrace->SetAttribute(SPAN_ID, "orion.upload_cache", Result);
+        }
+    }
+
+    /// @brief  Open a connection to the database. It is only used under the cache's mutex, so SQLite's own locking is off
+    sqlite::database OpenDatabase(const std::filesystem::path& DatabasePath)
+    {
+        sqlite::sqlite_config Config;
+        Config.flags = sqlite::OpenFlags::READWRITE | sqlite::OpenFlags::CREATE | sqlite::OpenFlags::NOMUTEX;
+
+        sqlite::database Database {DatabasePath.string(), Config};
+
+        int BusyTimeout = 0;
+        Database << "PRAGMA busy_timeout = " + std::to_string(BUSY_TIMEOUT_MS) + ";" >> BusyTimeout;
+
+        std::string JournalMode;
+        Database << "PRAGMA journal_mode = WAL;" >> JournalMode;
+        Database << "PRAGMA synchronous = NORMAL;";
+        return Database;
+    }
+
+    /// @brief  Migrate the schema to the current version
+    void Migrate(sqlite::database& Database)
+    {
+        int Version = 0;
+        Database << "PRAGMA user_version;" >> Version;
+        if (Version >= SCHEMA_VERSION)
+        {
+            return;
+        }
+
+        Database << "BEGIN IMMEDIATE;";
+        try
+        {
+            if (Version < 1)
+            {
+                Database << "CREATE TABLE IF NOT EXISTS uploads (content_hash TEXT NOT NULL, key_hash TEXT NOT NULL, purpose TEXT NOT NULL, file_id TEXT NOT NULL, "
+                            "bytes INTEGER NOT NULL, uploaded_at INTEGER NOT NULL, verified_at INTEGER NOT NULL, PRIMARY KEY (content_hash, key_hash, purpose));";
+            }
+
+            Database << "PRAGMA user_version = " + std::to_string(SCHEMA_VERSION) + ";";
+            Database << "COMMIT;";
+        }
+        catch (...)
+        {
+            Database << "ROLLBACK;";
+            throw;
+        }
+    }
+} // namespace
+
+struct UploadCache::Connection
+{
+    explicit Connection(const std::filesystem::path& DatabasePath)
+        : Database(OpenDatabase(DatabasePath)),
+          FindEntry(Database << "SELECT file_id, bytes, verified_at FROM uploads WHERE content_hash = ? AND key_hash = ? AND purpose = ? AND uploaded_at >= ?;"),
+          StoreEntry(Database << "INSERT OR REPLACE INTO uploads (content_hash, key_hash, purpose, file_id, bytes, uploaded_at, verified_at) VALUES (?, ?, ?, ?, ?, ?, ?);"),
+          TouchEntry(Database << "UPDATE uploads SET verified_at = ? WHERE content_hash = ? AND key_hash = ? AND purpose = ?;"),
+          RemoveEntry(Database << "DELETE FROM uploads WHERE content_hash = ? AND key_hash = ? AND purpose = ?;")
+    {
+        // Unused binders execute when destroyed; these are only executed explicitly
+        FindEntry.used(true);
+        StoreEntry.used(true);
+        TouchEntry.used(true);
+        RemoveEntry.used(true);
+    }
+
+    /// @brief  The connection
+    sqlite::database Database;
+
+    /// @brief  The prepared statements
+    sqlite::database_binder FindEntry;
+    sqlite::database_binder StoreEntry;
+    sqlite::database_binder TouchEntry;
+    sqlite::database_binder RemoveEntry;
+};
+
+UploadCache& UploadCache::Get()
+{
+    static UploadCache Cache;
+    return Cache;
+}
+
+UploadCache::UploadCache() = default;
+
+UploadCache::~UploadCache() = default;
+
+bool UploadCache::Open(const std::filesystem::path& DatabasePath, const UploadCacheOptions& Options)
+{
+    std::lock_guard<std::mutex> LockGuard(m_Mutex);
+    m_Options = Options;
+    if (m_pConnection || m_Options.TTL.count() == 0)
+    {
+        return true;
+    }
+
+    try
+    {
+        std::filesystem::create_directories(DatabasePath.parent_path());
+
+        // Migrate before the statements are prepared, they need the schema
+        {
+            auto Database = OpenDatabase(DatabasePath);
+            Migrate(Database);
+
+            // Expired entries are never used again
+            Database << "DELETE FROM uploads WHERE uploaded_at < ?;" << GetNow() - std::chrono::duration_cast<std::chrono::seconds>(m_Options.TTL).count();
+        }
+
+        m_pConnection = std::make_unique<Connection>(DatabasePath);
+        return true;
+    }
+    catch (const std::exception& Exception)
+    {
+        Log::Error("uploads", "Failed to open the upload cache", {{"path", DatabasePath.string()}, {"error", Exception.what()}});
+        return false;
+    }
+}
+
+UploadCache::Key UploadCache::GetKey(const std::string& APIKey, const OpenAI::FilePayload& Payload, const std::string& Purpose)
+{
+    return {HashSHA256([&Payload](const auto& Sink) { Payload.Read(Sink); }),
+            HashSHA256([&APIKey](const auto& Sink) { Sink(reinterpret_cast<const unsigned char*>(APIKey.data()), APIKey.size()); }), Purpose};
+}
+
+pplx::task<std::string> UploadCache::UploadFile(const std::string& APIKey, const std::string& FileName, const std::string& MimeType, OpenAI::FilePayload Payload,
+                                                const std::string& Purpose)
+{
+    if (!IsEnabled())
+    {
+        return OpenAI::Client(APIKey).UploadFile(FileName, MimeType, std::move(Payload), Purpose).then([](const web::json::value& JFile) { return JFile.at("id").as_string(); });
+    }
+
+    auto       pTrace  = Tracing::TraceScope::GetCurrentTrace();
+    const auto SPAN_ID = Tracing::TraceScope::GetCurrentSpanID();
+
+    // Hash the content off the calling thread, reading a large file takes a while. The content is read again by the upload on a miss
+    return pplx::create_task(
+        [this, pTrace, SPAN_ID, APIKey, FileName, MimeType, Payload, Purpose]() -> pplx::task<std::string>
+        {
+            Tracing::TraceScope Scope(pTrace, SPAN_ID);
+
+            const auto FILE_KEY = GetKey(APIKey, Payload, Purpose);
+
+            const auto ENTRY = Find(FILE_KEY);
+            if (!ENTRY)
+            {
+                TraceLookup(pTrace, SPAN_ID, "miss");
+                return UploadAndStore(APIKey, FileName, MimeType, Payload, FILE_KEY);
+            }
+
+            if (GetNow() - ENTRY->VerifiedAt < m_Options.VerifyInterval.count())
+            {
+                TraceLookup(pTrace, SPAN_ID, "hit");
+                return pplx::task_from_result(ENTRY->FileID);
+            }
+
+            // The file may have been deleted since it was last verified
+            return OpenAI::Client(APIKey).GetFile(ENTRY->FileID).then(
+                [this, pTrace, SPAN_ID, APIKey, FileName, MimeType, Payload, FILE_KEY, ENTRY = *ENTRY](pplx::task<web::json::value> GetFileTask) -> pplx::task<std::string>
+                {
+                    Tracing::TraceScope Scope(pTrace, SPAN_ID);
+                    try
+                    {
+                        const auto JFILE = GetFileTask.get();
+                        if (!JFILE.has_number_field("bytes") || JFILE.at("bytes").as_number().to_int64() == static_cast<int64_t>(ENTRY.Size))
+                        {
+                            Touch(FILE_KEY, GetNow());
+                            TraceLookup(pTrace, SPAN_ID, "verified");
+                            return pplx::task_from_result(ENTRY.FileID);
+                        }
+                    }
+                    catch (const OpenAI::APIError& Error)
+                    {
+                        if (Error.GetStatus() != web::http::status_codes::NotFound)
+                        {
+                            Log::Warning("uploads", "Failed to verify a cached file, it is uploaded again", {{"file_id", ENTRY.FileID}, {"error", Error.what()}});
+                        }
+                    }
+                    catch (const std::exception& Exception)
+                    {
+                        Log::Warning("uploads", "Failed to verify a cached file, it is uploaded again", {{"file_id", ENTRY.FileID}, {"error", Exception.what()}});
+                    }
+
+                    // Drop the entry even if the upload fails, so the file isn't offered again
+                    Remove(FILE_KEY);
+                    TraceLookup(pTrace, SPAN_ID, "stale");
+                    return UploadAndStore(APIKey, FileName, MimeType, Payload, FILE_KEY);
+                });
+        });
+}
+
+pplx::task<std::string> UploadCache::UploadAndStore(const std::string& APIKey, const std::string& FileName, const std::string& MimeType, OpenAI::FilePayload Payload,
+                                                    const Key& FileKey)
+{
+    const auto SIZE = Payload.GetSize();
+    return OpenAI::Client(APIKey)
+        .UploadFile(FileName, MimeType, std::move(Payload), FileKey.Purpose)
+        .then(
+            [this, FileKey, SIZE](const web::json::value& JFile)
+            {
+                auto       FileID = JFile.at("id").as_string();
+                const auto NOW    = GetNow();
+                Store(FileKey, {FileID, SIZE, NOW});
+                return FileID;
+            });
+}
+
+bool UploadCache::IsEnabled()
+{
+    std::lock_guard<std::mutex> LockGuard(m_Mutex);
+    return m_pConnection && m_Options.TTL.count() > 0;
+}
+
+std::optional<UploadCache::Entry> UploadCache::Find(const Key& FileKey)
+{
+    std::lock_guard<std::mutex> LockGuard(m_Mutex);
+    try
+    {
+        const auto OLDEST = GetNow() - std::chrono::duration_cast<std::chrono::seconds>(m_Options.TTL).count();
+
+        std::optional<Entry> FoundEntry;
+        m_pConnection->FindEntry << FileKey.ContentHash << FileKey.KeyHash << FileKey.Purpose << OLDEST >>
+            [&FoundEntry](const std::string& FileIDArg, const int64_t BytesArg, const int64_t VerifiedAtArg)
+        { FoundEntry = Entry {FileIDArg, static_cast<size_t>(BytesArg), VerifiedAtArg}; };
+        return FoundEntry;
+    }
+    catch (const sqlite::sqlite_exception& Exception)
+    {
+        Log::Error("uploads", "Upload cache query failed", {{"error", Exception.what()}});
+        return std::nullopt;
+    }
+}
+
+void UploadCache::Store(const Key& FileKey, const Entry& FileEntry)
+{
+    std::lock_guard<std::mutex> LockGuard(m_Mutex);
+    try
+    {
+        m_pConnection->StoreEntry << FileKey.ContentHash << FileKey.KeyHash << FileKey.Purpose << FileEntry.FileID << static_cast<int64_t>(FileEntry.Size)
+                                  << FileEntry.VerifiedAt << FileEntry.VerifiedAt;
+        m_pConnection->StoreEntry.execute();
+    }
+    catch (const sqlite::sqlite_exception& Exception)
+    {
+        Log::Error("uploads", "Upload cache insert failed", {{"file_id", FileEntry.FileID}, {"error", Exception.what()}});
+    }
+}
+
+void UploadCache::Touch(const Key& FileKey, const int64_t VERIFIED_AT)
+{
+    std::lock_guard<std::mutex> LockGuard(m_Mutex);
+    try
+    {
+        m_pConnection->TouchEntry << VERIFIED_AT << FileKey.ContentHash << FileKey.KeyHash << FileKey.Purpose;
+        m_pConnection->TouchEntry.execute();
+    }
+    catch (const sqlite::sqlite_exception& Exception)
+    {
+        Log::Error("uploads", "Upload cache update failed", {{"error", Exception.what()}});
+    }
+}
+
+void UploadCache::Remove(const Key& FileKey)
+{
+    std::lock_guard<std::mutex> LockGuard(m_Mutex);
+    try
+    {
+        m_pConnection->RemoveEntry << FileKey.ContentHash << FileKey.KeyHash << FileKey.Purpose;
+        m_pConnection->RemoveEntry.execute();
+    }
+    catch (const sqlite::sqlite_exception& Exception)
+    {
+        Log::Error("uploads", "Upload cache delete failed", {{"error", Exception.what()}});
+    }
+}
@@ -0,0 +1,814 @@
+#include "Upstream.hpp"
+#include "Logger.hpp"
+#include "Metrics.hpp"
+#include "TimerQueue.hpp"
+#include "Tracing.hpp"
+
+#include <cpprest/asyncrt_utils.h>
+#include <cpprest/http_listener.h>
+#include <cpprest/producerconsumerstream.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+using namespace ORION;
+using namespace ORION::Upstream;
+
+namespace
+{
+    /// @brief  The base URL when neither the settings nor OPENAI_BASE_URL set one
+    constexpr std::string_view DEFAULT_BASE_URL = "https://api.openai.com/v1/";
+
+    /// @brief  The size of the reads from a response body that is being recorded
+    constexpr size_t RECORD_READ_SIZE = 16 * 1024;
+
+    /// @brief  A request and its response, as kept in a cassette
+    struct Exchange
+    {
+        /// @brief  A piece of the body, and when it arrived (counted from the arrival of the headers)
+        struct Chunk
+        {
+            double                     AtMilliseconds = 0.0;
+            std::vector<unsigned char> Data;
+        };
+
+        std::string                                      Method;
+        std::string                                      Path;
+        web::http::status_code                           Status = web::http::status_codes::OK;
+        std::string                                      Reason;
+        std::vector<std::pair<std::string, std::string>> Headers;
+        double                                           LatencyMilliseconds = 0.0;
+        std::vector<Chunk>                               Chunks;
+
+        /// @brief  Convert the exchange to a line of the cassette
+        web::json::value ToJson() const
+        {
+            auto JHeaders = web::json::value::object();
+            for (const auto& [Name, Value] : Headers)
+            {
+                JHeaders[Name] = web::json::value::string(Value);
+            }
+
+            auto JChunks = web::json::value::array();
+            for (const auto& CHUNK : Chunks)
+            {
+                auto JChunk     = web::json::value::object();
+                JChunk["at_ms"] = web::json::value::number(CHUNK.AtMilliseconds);
+                JChunk["data"]  = web::json::value::string(utility::conversions::to_base64(CHUNK.Data));
+
+                JChunks[JChunks.size()] = JChunk;
+            }
+
+            auto JExchange          = web::json::value::object();
+            JExchange["method"]     = web::json::value::string(Method);
+            JExchange["path"]       = web::json::value::string(Path);
+            JExchange["status"]     = web::json::value::number(Status);
+            JExchange["reason"]     = web::json::value::string(Reason);
+            JExchange["headers"]    = JHeaders;
+            JExchange["latency_ms"] = web::json::value::number(LatencyMilliseconds);
+            JExchange["chunks"]     = JChunks;
+            return JExchange;
+        }
+
+        /// @brief  Read an exchange from a line of the cassette. Throws web::json::json_exception if a field is missing
+        static Exchange FromJson(const web::json::value& JExchange)
+        {
+            Exchange Loaded;
+            Loaded.Method              = JExchange.at("method").as_string();
+            Loaded.Path                = JExchange.at("path").as_string();
+            Loaded.Status              = static_cast<web::http::status_code>(JExchange.at("status").as_integer());
+            Loaded.Reason              = JExchange.at("reason").as_string();
+            Loaded.LatencyMilliseconds = JExchange.at("latency_ms").as_double();
+
+            for (const auto& [Name, JValue] : JExchange.at("headers").as_object())
+            {
+                Loaded.Headers.emplace_back(Name, JValue.as_string());
+            }
+
+            for (const auto& JChunk : JExchange.at("chunks").as_array())
+            {
+                Loaded.Chunks.push_back({JChunk.at("at_ms").as_double(), utility::conversions::from_base64(JChunk.at("data").as_string())});
+            }
+            return Loaded;
+        }
+    };
+
+    /// @brief  The key requests are matched to recorded responses by
+    std::string GetExchangeKey(const std::string& Method, const std::string& Path)
+    {
+        return Method + " " + Path;
+    }
+
+    /// @brief  Get the path of a request relative to the base URL, with its query
+    std::string GetRequestPath(const web::http::http_request& Request)
+    {
+        auto Path = Request.request_uri().to_string();
+        Path.erase(0, Path.find_first_not_of('/'));
+        return Path;
+    }
+
+    /// @brief  Appends recorded exchanges to a cassette
+    class CassetteRecorder final
+    {
+    public:
+        /// @brief  Open the cassette for appending
+        bool Open(const std::string& FilePath, std::string& OutError)
+        {
+            m_File.open(FilePath, std::ios::out | std::ios::app);
+            if (!m_File)
+            {
+                OutError = "The cassette " + FilePath + " can't be opened for recording";
+                return false;
+            }
+            return true;
+        }
+
+        /// @brief  Append an exchange. Flushed right away, so a recording survives the server being killed
+        void Append(const Exchange& InExchange)
+        {
+            const auto LINE = InExchange.ToJson().serialize();
+
+            std::lock_guard<std::mutex> Lock(m_Mutex);
+            m_File << LINE << '\n';
+            m_File.flush();
+        }
+
+    private:
+        std::ofstream m_File;
+        std::mutex    m_Mutex;
+    };
+
+    /// @brief  Hands out the exchanges of a cassette, per method and path in the order they were recorded
+    class CassettePlayer final
+    {
+    public:
+        /// @brief  Load the cassette
+        bool Load(const std::string& FilePath, std::string& OutError)
+        {
+            std::ifstream File(FilePath);
+            if (!File)
+            {
+                OutError = "The cassette " + FilePath + " can't be opened for replay";
+                return false;
+            }
+
+            size_t      LineNumber = 0;
+            size_t      Count      = 0;
+            std::string Line;
+            while (std::getline(File, Line))
+            {
+                ++LineNumber;
+                if (Line.find_first_not_of(" \t\r") == std::string::npos)
+                {
+                    continue;
+                }
+
+                try
+                {
+                    auto pExchange = std::make_shared<const Exchange>(Exchange::FromJson(web::json::value::parse(Line)));
+                    m_Tracks[GetExchangeKey(pExchange->Method, pExchange->Path)].Exchanges.push_back(std::move(pExchange));
+                    ++Count;
+                }
+                catch (const std::exception& Exception)
+                {
+                    OutError = "Line " + std::to_string(LineNumber) + " of the cassette " + FilePath + " is invalid: " + Exception.what();
+                    return false;
+                }
+            }
+
+            if (Count == 0)
+            {
+                OutError = "The cassette " + FilePath + " has no exchanges";
+                return false;
+            }
+            return true;
+        }
+
+        /// @brief  Get the next recorded exchange of a method and path, or nullptr if there is none
+        std::shared_ptr<const Exchange> Next(const std::string& Key)
+        {
+            std::lock_guard<std::mutex> Lock(m_Mutex);
+
+            const auto TRACK = m_Tracks.find(Key);
+            if (TRACK == m_Tracks.end())
+            {
+                return nullptr;
+            }
+
+            // Once the responses of a request are used up, they are replayed from the first again
+            auto& [Exchanges, NextIndex] = TRACK->second;
+            auto pExchange               = Exchanges[NextIndex];
+            NextIndex                    = (NextIndex + 1) % Exchanges.size();
+            return pExchange;
+        }
+
+    private:
+        /// @brief  The exchanges of a method and path, and the one replayed next
+        struct Track
+        {
+            std::vector<std::shared_ptr<const Exchange>> Exchanges;
+            size_t                                       NextIndex = 0;
+        };
+
+        std::map<std::string, Track> m_Tracks;
+        std::mutex                   m_Mutex;
+    };
+
+    /// @brief  Caps the requests in flight to a host (event streams only until their headers arrive). Requests over the cap wait for one to
+    ///         finish, without holding a thread
+    class ConnectionLimiter final
+    {
+    public:
+        explicit ConnectionLimiter(const std::string& Host)
+            : m_WaitingGauge(Metrics::Registry::Get().GetGauge("orion_upstream_requests_waiting", "Upstream API requests waiting for a connection to their host",
+                                                               {{"host", Host}}))
+        {
+        }
+
+        /// @brief  Take a slot. The task completes once one is free
+        /// @param  LIMIT The most requests in flight. 0 for no limit
+        pplx::task<void> Acquire(const size_t LIMIT)
+        {
+            std::lock_guard<std::mutex> Lock(m_Mutex);
+            if (LIMIT == 0 || m_InFlightCount < LIMIT)
+            {
+                ++m_InFlightCount;
+                return pplx::task_from_result();
+            }
+
+            pplx::task_completion_event<void> SlotFreed;
+            m_Waiters.push_back(SlotFreed);
+            m_WaitingGauge.Add(1);
+            return pplx::create_task(SlotFreed);
+        }
+
+        /// @brief  Give a slot back. It passes straight to the longest waiting request, if any
+        void Release()
+        {
+            std::optional<pplx::task_completion_event<void>> NextWaiter;
+            {
+                std::lock_guard<std::mutex> Lock(m_Mutex);
+                if (m_Waiters.empty())
+                {
+                    --m_InFlightCount;
+                }
+                else
+                {
+                    NextWaiter = m_Waiters.front();
+                    m_Waiters.pop_front();
+                    m_WaitingGauge.Add(-1);
+                }
+            }
+
+            if (NextWaiter)
+            {
+                NextWaiter->set();
+            }
+        }
+
+    private:
+        Metrics::Gauge&                               m_WaitingGauge;
+        size_t                                        m_InFlightCount = 0;
+        std::deque<pplx::task_completion_event<void>> m_Waiters;
+        std::mutex                                    m_Mutex;
+    };
+
+    /// @brief  Resolve the base URL: the configured one, OPENAI_BASE_URL, or the default. Always ends with a slash
+    std::string ResolveBaseURL(const std::string& ConfiguredBaseURL)
+    {
+        std::string BaseURL = ConfiguredBaseURL;
+        if (BaseURL.empty())
+        {
+            const char* pBASE_URL = std::getenv("OPENAI_BASE_URL");
+            BaseURL               = pBASE_URL && *pBASE_URL ? pBASE_URL : std::string(DEFAULT_BASE_URL);
+        }
+
+        if (BaseURL.back() != '/')
+        {
+            BaseURL += '/';
+        }
+        return BaseURL;
+    }
+
+    /// @brief  The timers that pace replayed responses. Only started by the first replay
+    TimerQueue& GetReplayTimers()
+    {
+        static TimerQueue Timers;
+        return Timers;
+    }
+
+    /// @brief  Check whether a header only concerns one connection, so it isn't passed on (the listener and client set their own)
+    bool IsHopByHopHeader(const std::string& Name)
+    {
+        static const std::vector<std::string> HEADERS = {"connection", "content-length", "host", "keep-alive", "transfer-encoding"};
+        std::string                           Lower   = Name;
+        std::transform(Lower.begin(), Lower.end(), Lower.begin(), [](const unsigned char C) { return std::tolower(C); });
+        return std::find(HEADERS.begin(), HEADERS.end(), Lower) != HEADERS.end();
+    }
+
+    /// @brief  Create a response with the status and headers of an exchange, whose body is written to a buffer (and ends when it is closed)
+    web::http::http_response CreateResponse(const Exchange& InExchange, const concurrency::streams::producer_consumer_buffer<uint8_t>& Buffer)
+    {
+        web::http::http_response Response(InExchange.Status);
+        Response.set_reason_phrase(InExchange.Reason);
+        Response.set_body(Buffer.create_istream());
+
+        // set_body sets a content type of its own; the recorded headers replace it
+        Response.headers().clear();
+        for (const auto& [Name, Value] : InExchange.Headers)
+        {
+            if (!IsHopByHopHeader(Name))
+            {
+                Response.headers().add(Name, Value);
+            }
+        }
+        return Response;
+    }
+
+    /// @brief  Get a free port on the loopback interface
+    /// @return The port, or 0 if none could be found
+    int FindFreeLoopbackPort()
+    {
+        const int SOCKET = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (SOCKET < 0)
+        {
+            return 0;
+        }
+
+        sockaddr_in Address {};
+        Address.sin_family      = AF_INET;
+        Address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        Address.sin_port        = 0;
+
+        socklen_t AddressSize = sizeof(Address);
+        int       Port        = 0;
+        if (::bind(SOCKET, reinterpret_cast<sockaddr*>(&Address), sizeof(Address)) == 0 &&
+            ::getsockname(SOCKET, reinterpret_cast<sockaddr*>(&Address), &AddressSize) == 0)
+        {
+            Port = ntohs(Address.sin_port);
+        }
+        ::close(SOCKET);
+        return Port;
+    }
+
+    /// @brief  The state of a response whose body is being recorded as it is passed on
+    struct RecordingBody
+    {
+        web::http::http_response                                UpstreamResponse;
+        concurrency::streams::producer_consumer_buffer<uint8_t> Buffer;
+        std::vector<uint8_t>                                    ReadBuffer = std::vector<uint8_t>(RECORD_READ_SIZE);
+        std::chrono::steady_clock::time_point                   HeadersArrival;
+        Exchange                                                RecordedExchange;
+        std::shared_ptr<CassetteRecorder>                       pRecorder;
+    };
+
+    /// @brief  Pass the next chunk of a response body on, noting when it arrived. Continues until the body ends, then records the exchange
+    void PumpRecordedBody(const std::shared_ptr<RecordingBody>& pBody)
+    {
+        pBody->UpstreamResponse.body().streambuf().getn(pBody->ReadBuffer.data(), pBody->ReadBuffer.size()).then(
+            [pBody](pplx::task<size_t> ReadTask)
+            {
+                size_t BytesRead = 0;
+                try
+                {
+                    BytesRead = ReadTask.get();
+                }
+                catch (const std::exception& Exception)
+                {
+                    // A broken response isn't recorded; the caller sees the same error it would have without the recording
+                    Log::Warning("upstream", "A response body failed while being recorded",
+                                 {{"path", pBody->RecordedExchange.Path}, {"error", Exception.what()}});
+                    pBody->Buffer.close(std::ios_base::out, std::current_exception()).wait();
+                    return;
+                }
+
+                if (BytesRead == 0)
+                {
+                    pBody->Buffer.close(std::ios_base::out).wait();
+                    pBody->pRecorder->Append(pBody->RecordedExchange);
+                    return;
+                }
+
+                const auto ELAPSED = std::chrono::steady_clock::now() - pBody->HeadersArrival;
+                auto&      Chunk   = pBody->RecordedExchange.Chunks.emplace_back();
+                Chunk.AtMilliseconds = std::chrono::duration<double, std::milli>(ELAPSED).count();
+                Chunk.Data.assign(pBody->ReadBuffer.begin(), pBody->ReadBuffer.begin() + static_cast<std::ptrdiff_t>(BytesRead));
+
+                pBody->Buffer.putn_nocopy(Chunk.Data.data(), Chunk.Data.size()).wait();
+                pBody->Buffer.sync().wait();
+
+                PumpRecordedBody(pBody);
+            });
+    }
+
+    /**
+     * @class CassetteServer
+     * @brief A server on the loopback interface that the OpenAI client talks to while recording or replaying.
+     *
+     * Recording, it passes each request on to the API and streams the response back as it records it; replaying, it answers with the
+     * recorded responses, paced as recorded. Either way the client receives real responses, so their bodies complete the way any other
+     * response's do.
+     */
+    class CassetteServer final
+    {
+    public:
+        /// @brief  Record the responses of the API at a base URL
+        CassetteServer(const std::string& BaseURL, std::shared_ptr<CassetteRecorder> pRecorder)
+            : m_pUpstreamClient(std::make_shared<web::http::client::http_client>(BaseURL)),
+              m_pRecorder(std::move(pRecorder))
+        {
+        }
+
+        /// @brief  Replay the responses of a cassette
+        CassetteServer(std::shared_ptr<CassettePlayer> pPlayer, const double SPEED)
+            : m_pPlayer(std::move(pPlayer)),
+              m_ReplaySpeed(SPEED)
+        {
+        }
+
+        CassetteServer(const CassetteServer&)            = delete;
+        CassetteServer& operator=(const CassetteServer&) = delete;
+
+        ~CassetteServer()
+        {
+            if (m_pListener)
+            {
+                m_pListener->close().wait();
+            }
+        }
+
+        /// @brief  Start listening on a free loopback port
+        bool Start(std::string& OutError)
+        {
+            const int PORT = FindFreeLoopbackPort();
+            if (PORT == 0)
+            {
+                OutError = "No loopback port is free for the cassette server";
+                return false;
+            }
+
+            m_URL       = "http://127.0.0.1:" + std::to_string(PORT) + "/";
+            m_pListener = std::make_unique<web::http::experimental::listener::http_listener>(m_URL);
+            m_pListener->support(
+                [this](const web::http::http_request& Request)
+                {
+                    if (m_pPlayer)
+                    {
+                        Replay(Request);
+                    }
+                    else
+                    {
+                        Record(Request);
+                    }
+                });
+            try
+            {
+                m_pListener->open().wait();
+            }
+            catch (const std::exception& Exception)
+            {
+                OutError = "The cassette server can't listen on " + m_URL + ": " + Exception.what();
+                return false;
+            }
+            return true;
+        }
+
+        /// @brief  Get the base URL of the server
+        const std::string& GetURL() const
+        {
+            return m_URL;
+        }
+
+    private:
+        /// @brief  Send a request on and record its response as the body is passed back
+        void Record(const web::http::http_request& Request)
+        {
+            const auto METHOD = Request.method();
+            const auto PATH   = GetRequestPath(Request);
+            const auto START  = std::chrono::steady_clock::now();
+
+            web::http::http_request Forwarded(METHOD);
+            Forwarded.set_request_uri(PATH);
+            for (const auto& [Name, Value] : Request.headers())
+            {
+                if (!IsHopByHopHeader(Name))
+                {
+                    Forwarded.headers().add(Name, Value);
+                }
+            }
+
+            Request.extract_vector()
+                .then(
+                    [pUpstreamClient = m_pUpstreamClient, Forwarded](std::vector<unsigned char> Body) mutable
+                    {
+                        if (!Body.empty())
+                        {
+                            // The forwarded content type is kept (set_body only sets one if there is none)
+                            Forwarded.set_body(std::move(Body));
+                        }
+                        return pUpstreamClient->request(Forwarded);
+                    })
+                .then(
+                    [Request, pRecorder = m_pRecorder, METHOD, PATH, START](pplx::task<web::http::http_response> ResponseTask)
+                    {
+                        web::http::http_response UpstreamResponse;
+                        try
+                        {
+                            UpstreamResponse = ResponseTask.get();
+                        }
+                        catch (const std::exception& Exception)
+                        {
+                            // Not recorded; the client sees a failed request
+                            Log::Warning("upstream", "A request failed while being recorded", {{"path", PATH}, {"error", Exception.what()}});
+                            Request.reply(web::http::status_codes::BadGateway, std::string(Exception.what()));
+                            return;
+                        }
+
+                        auto pBody            = std::make_shared<RecordingBody>();
+                        pBody->HeadersArrival = std::chrono::steady_clock::now();
+                        pBody->pRecorder      = pRecorder;
+
+                        auto& Recorded               = pBody->RecordedExchange;
+                        Recorded.Method              = METHOD;
+                        Recorded.Path                = PATH;
+                        Recorded.Status              = UpstreamResponse.status_code();
+                        Recorded.Reason              = UpstreamResponse.reason_phrase();
+                        Recorded.LatencyMilliseconds = std::chrono::duration<double, std::milli>(pBody->HeadersArrival - START).count();
+                        for (const auto& [Name, Value] : UpstreamResponse.headers())
+                        {
+                            Recorded.Headers.emplace_back(Name, Value);
+                        }
+
+                        pBody->UpstreamResponse = UpstreamResponse;
+                        Request.reply(CreateResponse(Recorded, pBody->Buffer));
+
+                        PumpRecordedBody(pBody);
+                    });
+        }
+
+        /// @brief  Answer a request with its next recorded response, paced as recorded (divided by the replay speed)
+        void Replay(const web::http::http_request& Request)
+        {
+            const auto METHOD    = Request.method();
+            const auto PATH      = GetRequestPath(Request);
+            auto       pExchange = m_pPlayer->Next(GetExchangeKey(METHOD, PATH));
+            if (!pExchange)
+            {
+                Log::Warning("upstream", "No recorded response for the request", {{"method", METHOD}, {"path", PATH}});
+
+                auto JError       = web::json::value::object();
+                JError["message"] = web::json::value::string("No recorded response for " + METHOD + " " + PATH);
+                auto JResponse     = web::json::value::object();
+                JResponse["error"] = JError;
+                Request.reply(web::http::status_codes::BadGateway, JResponse);
+                return;
+            }
+
+            const auto START = std::chrono::steady_clock::now();
+            const auto AT    = [START, SPEED = m_ReplaySpeed](const double MILLISECONDS)
+            {
+                return SPEED > 0.0 ? START + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double, std::milli>(MILLISECONDS / SPEED))
+                                   : START;
+            };
+
+            concurrency::streams::producer_consumer_buffer<uint8_t> Buffer;
+            auto                                                    Response = CreateResponse(*pExchange, Buffer);
+
+            // Timers due at the same time run in the order scheduled, so the chunks stay in order even without delays
+            auto& Timers = GetReplayTimers();
+            Timers.ScheduleAt(AT(pExchange->LatencyMilliseconds), [Request, Response] { Request.reply(Response); });
+
+            for (size_t Index = 0; Index < pExchange->Chunks.size(); ++Index)
+            {
+                Timers.ScheduleAt(AT(pExchange->LatencyMilliseconds + pExchange->Chunks[Index].AtMilliseconds),
+                                  [Buffer, pExchange, Index]() mutable
+                                  {
+                                      const auto& DATA = pExchange->Chunks[Index].Data;
+                                      Buffer.putn_nocopy(DATA.data(), DATA.size()).wait();
+                                      Buffer.sync().wait();
+                                  });
+            }
+
+            const double END = pExchange->LatencyMilliseconds + (pExchange->Chunks.empty() ? 0.0 : pExchange->Chunks.back().AtMilliseconds);
+            Timers.ScheduleAt(AT(END), [Buffer]() mutable { Buffer.close(std::ios_base::out).wait(); });
+        }
+
+        /// @brief  The client of the API, when recording
+        std::shared_ptr<web::http::client::http_client> m_pUpstreamClient;
+
+        /// @brief  The cassette responses are recorded to, when recording
+        std::shared_ptr<CassetteRecorder> m_pRecorder;
+
+        /// @brief  The cassette responses are replayed from, when replaying
+        std::shared_ptr<CassettePlayer> m_pPlayer;
+
+        /// @brief  The speed of a replay relative to the recording
+        double m_ReplaySpeed = 1.0;
+
+        /// @brief  The base URL of the server
+        std::string m_URL;
+
+        /// @brief  The listener, once started
+        std::unique_ptr<web::http::experimental::listener::http_listener> m_pListener;
+    };
+
+    /// @brief  The settings in effect
+    struct TransportState
+    {
+        std::string                     BaseURL;
+        ETransportMode                  Mode                  = ETransportMode::Live;
+        size_t                          MaxConnectionsPerHost = 64;
+        std::shared_ptr<CassetteServer> pCassetteServer;
+    };
+
+    std::mutex     g_StateMutex;
+    TransportState g_State {ResolveBaseURL("")};
+
+    /// @brief  The shared clients (of OpenAI, and of other APIs by base URL) and the limiters of their hosts. Guarded by g_StateMutex
+    std::shared_ptr<web::http::client::http_client>                        g_pOpenAIClient;
+    std::map<std::string, std::shared_ptr<web::http::client::http_client>> g_Clients;
+    std::map<std::string, std::shared_ptr<ConnectionLimiter>>              g_Limiters;
+
+    /// @brief  Get the limiter of the host of a base URL. The caller holds g_StateMutex
+    std::shared_ptr<ConnectionLimiter> GetLimiter(const std::string& BaseURL)
+    {
+        const web::uri BASE_URI(BaseURL);
+        const auto     HOST = BASE_URI.host() + (BASE_URI.port() > 0 ? ":" + std::to_string(BASE_URI.port()) : std::string());
+
+        auto& pLimiter = g_Limiters[HOST];
+        if (!pLimiter)
+        {
+            pLimiter = std::make_shared<ConnectionLimiter>(HOST);
+        }
+        return pLimiter;
+    }
+
+    /// @brief  Create a client with the instrumentation, connection limit and transport of a state. The caller holds g_StateMutex
+    std::shared_ptr<web::http::client::http_client> CreateClient(const std::string& BaseURL, const std::string& Service, const TransportState& State)
+    {
+        auto pClient = std::make_shared<web::http::client::http_client>(BaseURL);
+        Metrics::InstrumentClient(*pClient, Service);
+        Tracing::InstrumentClient(*pClient, Service);
+
+        // The slot is held until the body has arrived, since the connection can't be reused before. An event stream lasts as long as its run,
+        // so its slot is freed once its headers arrive; otherwise the cap would also cap the runs in flight. Replays don't use connections
+        if (State.Mode != ETransportMode::Replay)
+        {
+            pClient->add_handler(
+                [pLimiter = GetLimiter(BaseURL), LIMIT = State.MaxConnectionsPerHost](web::http::http_request Request,
+                                                                                      std::shared_ptr<web::http::http_pipeline_stage> pNextStage)
+                {
+                    return pLimiter->Acquire(LIMIT)
+                        .then([Request, pNextStage]() { return pNextStage->propagate(Request); })
+                        .then(
+                            [pLimiter](pplx::task<web::http::http_response> ResponseTask)
+                            {
+                                web::http::http_response Response;
+                                try
+                                {
+                                    Response = ResponseTask.get();
+                                }
+                                catch (...)
+                                {
+                                    pLimiter->Release();
+                                    throw;
+                                }
+
+                                if (Response.headers().content_type().find(U("text/event-stream")) == 0)
+                                {
+                                    pLimiter->Release();
+                                    return Response;
+                                }
+
+                                Response.content_ready().then(
+                                    [pLimiter](pplx::task<web::http::http_response> BodyTask)
+                                    {
+                                        try
+                                        {
+                                            BodyTask.wait();
+                                        }
+                                        catch (...)
+                                        {
+                                            // The body failed; the slot is freed all the same
+                                        }
+                                        pLimiter->Release();
+                                    });
+                                return Response;
+                            });
+                });
+        }
+
+        // A client that records or replays talks to the cassette server, which it keeps running while in use (Configure may replace it)
+        if (State.pCassetteServer)
+        {
+            pClient->add_handler([pCassetteServer = State.pCassetteServer](web::http::http_request Request, std::shared_ptr<web::http::http_pipeline_stage> pNextStage)
+                                 { return pNextStage->propagate(Request); });
+        }
+        return pClient;
+    }
+} // namespace
+
+std::string_view Upstream::GetModeName(const ETransportMode MODE)
+{
+    switch (MODE)
+    {
+        case ETransportMode::Record:
+            return "record";
+        case ETransportMode::Replay:
+            return "replay";
+        default:
+            return "live";
+    }
+}
+
+bool Upstream::Configure(const UpstreamOptions& Options, std::string& OutError)
+{
+    TransportState State;
+    State.BaseURL               = ResolveBaseURL(Options.BaseURL);
+    State.MaxConnectionsPerHost = Options.MaxConnectionsPerHost;
+
+    bool IsValid = true;
+    if (Options.Mode != ETransportMode::Live && Options.CassetteFile.empty())
+    {
+        OutError = "A cassette file is required to " + std::string(GetModeName(Options.Mode));
+        IsValid  = false;
+    }
+    else if (Options.Mode == ETransportMode::Record)
+    {
+        auto pRecorder = std::make_shared<CassetteRecorder>();
+        if ((IsValid = pRecorder->Open(Options.CassetteFile, OutError)))
+        {
+            State.pCassetteServer = std::make_shared<CassetteServer>(State.BaseURL, std::move(pRecorder));
+        }
+    }
+    else if (Options.Mode == ETransportMode::Replay)
+    {
+        auto pPlayer = std::make_shared<CassettePlayer>();
+        if ((IsValid = pPlayer->Load(Options.CassetteFile, OutError)))
+        {
+            State.pCassetteServer = std::make_shared<CassetteServer>(std::move(pPlayer), Options.ReplaySpeed);
+        }
+    }
+
+    if (State.pCassetteServer)
+    {
+        if ((IsValid = State.pCassetteServer->Start(OutError)))
+        {
+            State.Mode = Options.Mode;
+        }
+        else
+        {
+            State.pCassetteServer.reset();
+        }
+    }
+
+    // Clients are created anew on their next use, with the new settings (ones in use keep the old)
+    std::lock_guard<std::mutex> Lock(g_StateMutex);
+    g_State = std::move(State);
+    g_pOpenAIClient.reset();
+    g_Clients.clear();
+    return IsValid;
+}
+
+std::string Upstream::GetBaseURL()
+{
+    std::lock_guard<std::mutex> Lock(g_StateMutex);
+    return g_State.BaseURL;
+}
+
+std::shared_ptr<web::http::client::http_client> Upstream::GetOpenAIClient()
+{
+    std::lock_guard<std::mutex> Lock(g_StateMutex);
+    if (!g_pOpenAIClient)
+    {
+        g_pOpenAIClient = CreateClient(g_State.pCassetteServer ? g_State.pCassetteServer->GetURL() : g_State.BaseURL, "openai", g_State);
+    }
+    return g_pOpenAIClient;
+}
+
+std::shared_ptr<web::http::client::http_client> Upstream::GetClient(const std::string& BaseURL, const std::string& Service)
+{
+    std::lock_guard<std::mutex> Lock(g_StateMutex);
+
+    auto& pClient = g_Clients[BaseURL];
+    if (!pClient)
+    {
+        TransportState LiveState;
+        LiveState.MaxConnectionsPerHost = g_State.MaxConnectionsPerHost;
+        pClient                         = CreateClient(BaseURL, Service, LiveState);
+    }
+    return pClient;
+}
@@ -0,0 +1,292 @@
+#include "UserStore.hpp"
+#include "Logger.hpp"
+
+
+#include <sqlite_modern_cpp.h>
+
+using namespace ORION;
+
+namespace
+{
+    /// @brief  How long a writer waits for another writer before the query fails with SQLITE_BUSY
+    constexpr int BUSY_TIMEOUT_MS = 5000;
+
+    /// @brief  The current schema version (PRAGMA user_version)
+    constexpr int SCHEMA_VERSION = 1;
+
+    /// @brief  Open a connection to the database. Each connection is only used by one thread at a time, so SQLite's own locking is off
+    sqlite::database OpenDatabase(const std::filesystem::path& DatabasePath)
+    {
+        sqlite::sqlite_config Config;
+        Config.flags = sqlite::OpenFlags::READWRITE | sqlite::OpenFlags::CREATE | sqlite::OpenFlags::NOMUTEX;
+
+        sqlite::database Database {DatabasePath.string(), Config};
+
+        int BusyTimeout = 0;
+        Database << "PRAGMA busy_timeout = " + std::to_string(BUSY_TIMEOUT_MS) + ";" >> BusyTimeout;
+
+        // WAL only needs a sync at checkpoints
+        Database << "PRAGMA synchronous = NORMAL;";
+        return Database;
+    }
+
+    /// @brief  Migrate the schema to the current version. Runs once, when the store is opened
+    void Migrate(sqlite::database& Database)
+    {
+        // WAL is persistent, but older databases were created without it
+        std::string JournalMode;
+        Database << "PRAGMA journal_mode = WAL;" >> JournalMode;
+        if (JournalMode != "wal")
+        {
+            Log::Warning("users", "WAL is not available", {{"journal_mode", JournalMode}});
+        }
+
+        int Version = 0;
+        Database << "PRAGMA user_version;" >> Version;
+        if (Version >= SCHEMA_VERSION)
+        {
+            return;
+        }
+
+        Database << "BEGIN IMMEDIATE;";
+        try
+        {
+            if (Version < 1)
+            {
+                Database << "CREATE TABLE IF NOT EXISTS users (user_id TEXT PRIMARY KEY, orion_id TEXT, username TEXT, password TEXT);";
+
+                // Usernames are unique; databases that already contain duplicates (possible before the index existed) get a plain index
+                try
+                {
+                    Database << "CREATE UNIQUE INDEX IF NOT EXISTS users_username ON users (username);";
+                }
+                catch (const sqlite::errors::constraint&)
+                {
+                    Log::Warning("users", "The users table contains duplicate usernames, they are not indexed as unique");
+                    Database << "CREATE INDEX IF NOT EXISTS users_username ON users (username);";
+                }
+            }
+
+            Database << "PRAGMA user_version = " + std::to_string(SCHEMA_VERSION) + ";";
+            Database << "COMMIT;";
+        }
+        catch (...)
+        {
+            Database << "ROLLBACK;";
+            throw;
+        }
+    }
+} // namespace
+
+struct UserStore::Connection
+{
+    explicit Connection(const std::filesystem::path& DatabasePath)
+        : Database(OpenDatabase(DatabasePath)),
+          FindByUserID(Database << "SELECT user_id, orion_id FROM users WHERE user_id = ?;"),
+          FindByUsername(Database << "SELECT user_id, orion_id, password FROM users WHERE username = ?;"),
+          CountByUsername(Database << "SELECT COUNT(*) FROM users WHERE username = ?;"),
+          InsertUser(Database << "INSERT INTO users (user_id, orion_id, username, password) VALUES (?, ?, ?, ?);")
+    {
+        // Unused binders execute when destroyed; these are only executed explicitly
+        FindByUserID.used(true);
+        FindByUsername.used(true);
+        CountByUsername.used(true);
+        InsertUser.used(true);
+    }
+
+    /// @brief  The connection
+    sqlite::database Database;
+
+    /// @brief  The prepared statements
+    sqlite::database_binder FindByUserID;
+    sqlite::database_binder FindByUsername;
+    sqlite::database_binder CountByUsername;
+    sqlite::database_binder InsertUser;
+};
+
+class UserStore::ConnectionLease
+{
+public:
+    ConnectionLease(UserStore& Store, Connection* pConnection) : m_Store(Store), m_pConnection(pConnection)
+    {
+    }
+
+    ConnectionLease(const ConnectionLease&)            = delete;
+    ConnectionLease& operator=(const ConnectionLease&) = delete;
+
+    ~ConnectionLease()
+    {
+        if (m_pConnection)
+        {
+            {
+                std::lock_guard<std::mutex> LockGuard(m_Store.m_PoolMutex);
+                m_Store.m_IdleConnections.push_back(m_pConnection);
+            }
+            m_Store.m_PoolConditionVariable.notify_one();
+        }
+    }
+
+    Connection* operator->() const
+    {
+        return m_pConnection;
+    }
+
+    explicit operator bool() const
+    {
+        return m_pConnection != nullptr;
+    }
+
+private:
+    UserStore&  m_Store;
+    Connection* m_pConnection;
+};
+
+UserStore::UserStore(std::filesystem::path DatabasePath, const size_t CONNECTION_COUNT)
+    : m_DatabasePath(std::move(DatabasePath)),
+      m_ConnectionCount(std::max<size_t>(CONNECTION_COUNT, 1))
+{
+}
+
+UserStore::~UserStore() = default;
+
+bool UserStore::Open()
+{
+    if (!m_Connections.empty())
+    {
+        return true;
+    }
+
+    try
+    {
+        std::filesystem::create_directories(m_DatabasePath.parent_path());
+
+        // Migrate before the statements are prepared, they need the schema
+        {
+            auto Database = OpenDatabase(m_DatabasePath);
+            Migrate(Database);
+        }
+
+        std::vector<std::unique_ptr<Connection>> Connections;
+        for (size_t Index = 0; Index < m_ConnectionCount; ++Index)
+        {
+            Connections.push_back(std::make_unique<Connection>(m_DatabasePath));
+        }
+
+        std::lock_guard<std::mutex> LockGuard(m_PoolMutex);
+        m_Connections = std::move(Connections);
+        for (const auto& pConnection : m_Connections)
+        {
+            m_IdleConnections.push_back(pConnection.get());
+        }
+        return true;
+    }
+    catch (const std::exception& Exception)
+    {
+        Log::Error("users", "Failed to open the database", {{"path", m_DatabasePath.string()}, {"error", Exception.what()}});
+        return false;
+    }
+}
+
+UserStore::ELoginResult UserStore::Login(const std::string& UsernameLower, const std::string& Password, const std::string& UserID, User& OutUser)
+{
+    auto Lease = AcquireConnection();
+    if (!Lease)
+    {
+        return ELoginResult::Error;
+    }
+
+    try
+    {
+        // A returning session logs in by id (primary key)
+        if (!UserID.empty())
+        {
+            Lease->FindByUserID << UserID >> [&OutUser](const std::string& IDArg, const std::string& OrionIDArg) { OutUser = {IDArg, OrionIDArg}; };
+            if (OutUser)
+            {
+                return ELoginResult::Success;
+            }
+        }
+
+        // One lookup on the username index tells both whether the user exists and whether the password matches
+        bool HasUser = false;
+        Lease->FindByUsername << UsernameLower >>
+            [&OutUser, &HasUser, &Password](const std::string& IDArg, const std::string& OrionIDArg, const std::string& PasswordArg)
+        {
+            HasUser = true;
+            if (!OutUser && PasswordArg == Password)
+            {
+                OutUser = {IDArg, OrionIDArg};
+            }
+        };
+
+        return OutUser ? ELoginResult::Success : HasUser ? ELoginResult::InvalidPassword : ELoginResult::UnknownUser;
+    }
+    catch (const sqlite::sqlite_exception& Exception)
+    {
+        Log::Error("users", "Login query failed", {{"error", Exception.what()}});
+        return ELoginResult::Error;
+    }
+}
+
+bool UserStore::IsUsernameTaken(const std::string& UsernameLower)
+{
+    auto Lease = AcquireConnection();
+    if (!Lease)
+    {
+        return false;
+    }
+
+    try
+    {
+        int UserCount = 0;
+        Lease->CountByUsername << UsernameLower >> UserCount;
+        return UserCount > 0;
+    }
+    catch (const sqlite::sqlite_exception& Exception)
+    {
+        Log::Error("users", "Username query failed", {{"error", Exception.what()}});
+        return false;
+    }
+}
+
+UserStore::EAddResult UserStore::AddUser(const User& NewUser, const std::string& UsernameLower, const std::string& Password)
+{
+    auto Lease = AcquireConnection();
+    if (!Lease)
+    {
+        return EAddResult::Error;
+    }
+
+    try
+    {
+        Lease->InsertUser << NewUser.UserID << NewUser.OrionID << UsernameLower << Password;
+        Lease->InsertUser.execute();
+        return EAddResult::Added;
+    }
+    catch (const sqlite::errors::constraint&)
+    {
+        // Another registration took the name between the check and the insert
+        return EAddResult::UsernameTaken;
+    }
+    catch (const sqlite::sqlite_exception& Exception)
+    {
+        Log::Error("users", "Insert failed", {{"error", Exception.what()}});
+        return EAddResult::Error;
+    }
+}
+
+UserStore::ConnectionLease UserStore::AcquireConnection()
+{
+    std::unique_lock<std::mutex> Lock(m_PoolMutex);
+    if (m_Connections.empty())
+    {
+        // Not opened
+        return ConnectionLease(*this, nullptr);
+    }
+
+    m_PoolConditionVariable.wait(Lock, [this]() { return !m_IdleConnections.empty(); });
+
+    auto* pConnection = m_IdleConnections.back();
+    m_IdleConnections.pop_back();
+    return ConnectionLease(*this, pConnection);
+}
@@ -0,0 +1,370 @@
+/**
+ * @brief Generates the embedded asset bundle (EmbeddedAssets.hpp) of the Orion library.
+ *
+ * Usage: OrionAssetBundler <output.cpp> <assets directory> <relative asset path>...
+ *
+ * Text assets are minified (whitespace only: indentation, trailing blanks and empty lines, plus CSS comments), every asset is
+ * compressed with gzip and brotli, and a perfect hash table over the paths is searched for. The result is written as a C++
+ * translation unit of constant arrays.
+ */
+
+#include "Compression.hpp"
+#include "EmbeddedAssets.hpp"
+#include "MimeTypes.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace ORION;
+
+namespace
+{
+    /// @brief  An asset being bundled
+    struct BundledAsset
+    {
+        std::string Path;
+        std::string ContentType;
+        std::string Tag;
+        std::string Content;
+        std::string GzipContent;
+        std::string BrotliContent;
+    };
+
+    /// @brief  Trim the indentation and trailing whitespace of a line
+    std::string_view TrimLine(const std::string_view& Line)
+    {
+        const auto FIRST = Line.find_first_not_of(" \t\r");
+        if (FIRST == std::string_view::npos)
+        {
+            return {};
+        }
+        const auto LAST = Line.find_last_not_of(" \t\r");
+        return Line.substr(FIRST, LAST - FIRST + 1);
+    }
+
+    /// @brief  Minify JavaScript (or HTML with inline scripts) by trimming lines and dropping empty ones. Lines are kept so automatic
+    ///         semicolon insertion is unaffected; lines inside template literals are kept verbatim
+    std::string MinifyLines(const std::string& Source)
+    {
+        enum class EState
+        {
+            Code,
+            SingleQuote,
+            DoubleQuote,
+            Template,
+            BlockComment,
+        };
+
+        std::string        Result;
+        EState             State = EState::Code;
+        std::istringstream SourceStream(Source);
+        std::string        Line;
+
+        while (std::getline(SourceStream, Line))
+        {
+            // A line starting inside a template literal is part of its value
+            const bool IS_VERBATIM = State == EState::Template;
+
+            for (size_t Index = 0; Index < Line.size(); ++Index)
+            {
+                const char C = Line[Index];
+                switch (State)
+                {
+                    case EState::Code:
+                        if (C == '\'')
+                        {
+                            State = EState::SingleQuote;
+                        }
+                        else if (C == '"')
+                        {
+                            State = EState::DoubleQuote;
+                        }
+                        else if (C == '`')
+                        {
+                            State = EState::Template;
+                        }
+                        else if (C == '/' && Index + 1 < Line.size() && Line[Index + 1] == '/')
+                        {
+                            // Line comment: skip the rest of the line
+                            Index = Line.size();
+                        }
+                        else if (C == '/' && Index + 1 < Line.size() && Line[Index + 1] == '*')
+                        {
+                            State = EState::BlockComment;
+                            ++Index;
+                        }
+                        break;
+                    case EState::SingleQuote:
+                    case EState::DoubleQuote:
+                    case EState::Template:
+                        if (C == '\\')
+                        {
+                            ++Index;
+                        }
+                        else if ((State == EState::SingleQuote && C == '\'') || (State == EState::DoubleQuote && C == '"') || (State == EState::Template && C == '`'))
+                        {
+                            State = EState::Code;
+                        }
+                        break;
+                    case EState::BlockComment:
+                        if (C == '*' && Index + 1 < Line.size() && Line[Index + 1] == '/')
+                        {
+                            State = EState::Code;
+                            ++Index;
+                        }
+                        break;
+                }
+            }
+
+            // Quotes can't span lines; an unterminated one was something the scan doesn't understand (e.g. a regex literal)
+            if (State == EState::SingleQuote || State == EState::DoubleQuote)
+            {
+                State = EState::Code;
+            }
+
+            if (IS_VERBATIM)
+            {
+                Result.append(Line).append("\n");
+            }
+            else if (const auto TRIMMED = TrimLine(Line); !TRIMMED.empty())
+            {
+                Result.append(TRIMMED).append("\n");
+            }
+        }
+
+        return Result;
+    }
+
+    /// @brief  Minify CSS by removing comments, then trimming lines
+    std::string MinifyCSS(const std::string& Source)
+    {
+        std::string WithoutComments;
+        for (size_t Index = 0; Index < Source.size(); ++Index)
+        {
+            if (Source.compare(Index, 2, "/*") == 0)
+            {
+                const auto END = Source.find("*/", Index + 2);
+                Index          = END == std::string::npos ? Source.size() : END + 1;
+                continue;
+            }
+            WithoutComments.push_back(Source[Index]);
+        }
+
+        std::string        Result;
+        std::istringstream SourceStream(WithoutComments);
+        std::string        Line;
+        while (std::getline(SourceStream, Line))
+        {
+            if (const auto TRIMMED = TrimLine(Line); !TRIMMED.empty())
+            {
+                Result.append(TRIMMED).append("\n");
+            }
+        }
+        return Result;
+    }
+
+    /// @brief  Hash content into a hex tag (FNV-1a, 64 bit)
+    std::string HashContent(const std::string& Content)
+    {
+        std::ostringstream TagStream;
+        TagStream << std::hex << std::setw(16) << std::setfill('0') << EmbeddedAssets::HashPath(Content, 0);
+        return TagStream.str();
+    }
+
+    /// @brief  Write bytes as the initializer of a char array
+    void WriteBytes(std::ostream& Output, const std::string& Bytes)
+    {
+        for (size_t Index = 0; Index < Bytes.size(); ++Index)
+        {
+            Output << static_cast<int>(static_cast<signed char>(Bytes[Index])) << (Index % 32 == 31 ? ",\n" : ",");
+        }
+    }
+
+    /// @brief  Find a seed for which every path hashes to a different slot
+    /// @return The seed, or nothing if none was found for this slot count
+    std::optional<uint64_t> FindSeed(const std::vector<BundledAsset>& Assets, const size_t SLOT_COUNT)
+    {
+        std::vector<bool> UsedSlots(SLOT_COUNT);
+        for (uint64_t Seed = 0; Seed < 1'000'000; ++Seed)
+        {
+            std::fill(UsedSlots.begin(), UsedSlots.end(), false);
+
+            bool HasCollision = false;
+            for (const auto& Asset : Assets)
+            {
+                const auto SLOT = EmbeddedAssets::HashPath(Asset.Path, Seed) & (SLOT_COUNT - 1);
+                if (UsedSlots[SLOT])
+                {
+                    HasCollision = true;
+                    break;
+                }
+                UsedSlots[SLOT] = true;
+            }
+
+            if (!HasCollision)
+            {
+                return Seed;
+            }
+        }
+        return std::nullopt;
+    }
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3)
+    {
+        std::cerr << "Usage: " << argv[0] << " <output.cpp> <assets directory> <relative asset path>..." << std::endl;
+        return 1;
+    }
+
+    const std::filesystem::path OUTPUT_FILE = argv[1];
+    const std::filesystem::path ASSETS_DIR  = argv[2];
+
+    std::vector<BundledAsset> Assets;
+    size_t                    OriginalBytes = 0;
+
+    for (int ArgIndex = 3; ArgIndex < argc; ++ArgIndex)
+    {
+        BundledAsset Asset;
+        Asset.Path        = std::filesystem::path(argv[ArgIndex]).generic_string();
+        Asset.ContentType = MimeTypes::GetMimeType(Asset.Path);
+
+        std::ifstream File(ASSETS_DIR / Asset.Path, std::ios::binary);
+        if (!File.is_open())
+        {
+            std::cerr << "Failed to open " << (ASSETS_DIR / Asset.Path) << std::endl;
+            return 1;
+        }
+        Asset.Content.assign(std::istreambuf_iterator<char>(File), std::istreambuf_iterator<char>());
+        OriginalBytes += Asset.Content.size();
+
+        if (Asset.ContentType.find("javascript") != std::string::npos || Asset.ContentType.find("html") != std::string::npos)
+        {
+            Asset.Content = MinifyLines(Asset.Content);
+        }
+        else if (Asset.ContentType.find("css") != std::string::npos)
+        {
+            Asset.Content = MinifyCSS(Asset.Content);
+        }
+
+        Asset.Tag = HashContent(Asset.Content);
+
+        if (Compression::IsCompressible(Asset.ContentType))
+        {
+            if (auto Gzipped = Compression::Gzip(Asset.Content, 9); Gzipped && Gzipped->size() < Asset.Content.size())
+            {
+                Asset.GzipContent = std::move(*Gzipped);
+            }
+            if (auto Brotlied = Compression::Brotli(Asset.Content, 11); Brotlied && Brotlied->size() < Asset.Content.size())
+            {
+                Asset.BrotliContent = std::move(*Brotlied);
+            }
+        }
+
+        Assets.push_back(std::move(Asset));
+    }
+
+    // Grow the (power of two) table until a collision free seed is found; 4 slots per asset usually succeeds within a few hundred seeds
+    size_t                  SlotCount = 4;
+    std::optional<uint64_t> Seed;
+    while (SlotCount < Assets.size() * 4)
+    {
+        SlotCount *= 2;
+    }
+    while (!(Seed = FindSeed(Assets, SlotCount)))
+    {
+        SlotCount *= 2;
+    }
+
+    std::vector<int> Slots(SlotCount, -1);
+    for (size_t Index = 0; Index < Assets.size(); ++Index)
+    {
+        Slots[EmbeddedAssets::HashPath(Assets[Index].Path, *Seed) & (SlotCount - 1)] = static_cast<int>(Index);
+    }
+
+    std::ostringstream Output;
+    Output << "// Generated by OrionAssetBundler. Do not edit.\n\n";
+    Output << "#include \"EmbeddedAssets.hpp\"\n\n";
+    Output << "using namespace ORION;\n\n";
+    Output << "namespace\n{\n";
+
+    const auto WRITE_ARRAY = [&Output](const std::string& Name, const std::string& Bytes)
+    {
+        if (!Bytes.empty())
+        {
+            Output << "constexpr char " << Name << "[] = {\n";
+            WriteBytes(Output, Bytes);
+            Output << "};\n";
+        }
+    };
+    const auto ARRAY_VIEW = [](const std::string& Name, const std::string& Bytes)
+    { return Bytes.empty() ? std::string("std::string_view()") : "std::string_view(" + Name + ", sizeof(" + Name + "))"; };
+
+    size_t BundledBytes = 0;
+    for (size_t Index = 0; Index < Assets.size(); ++Index)
+    {
+        const auto PREFIX = "ASSET_" + std::to_string(Index);
+        Output << "// " << Assets[Index].Path << "\n";
+        WRITE_ARRAY(PREFIX + "_CONTENT", Assets[Index].Content);
+        WRITE_ARRAY(PREFIX + "_GZIP", Assets[Index].GzipContent);
+        WRITE_ARRAY(PREFIX + "_BROTLI", Assets[Index].BrotliContent);
+        BundledBytes += Assets[Index].Content.size();
+    }
+
+    Output << "\nconstexpr EmbeddedAssets::Asset ASSETS[] = {\n";
+    for (size_t Index = 0; Index < Assets.size(); ++Index)
+    {
+        const auto& Asset  = Assets[Index];
+        const auto  PREFIX = "ASSET_" + std::to_string(Index);
+        Output << "    {\"" << Asset.Path << "\", \"" << Asset.ContentType << "\", \"" << Asset.Tag << "\", " << ARRAY_VIEW(PREFIX + "_CONTENT", Asset.Content) << ", "
+               << ARRAY_VIEW(PREFIX + "_GZIP", Asset.GzipContent) << ", " << ARRAY_VIEW(PREFIX + "_BROTLI", Asset.BrotliContent) << "},\n";
+    }
+    if (Assets.empty())
+    {
+        Output << "    {},\n";
+    }
+    Output << "};\n\n";
+
+    Output << "constexpr size_t   ASSET_COUNT = " << Assets.size() << ";\n";
+    Output << "constexpr uint64_t SEED        = " << *Seed << "ull;\n";
+    Output << "constexpr int      SLOTS[]     = {";
+    for (size_t Index = 0; Index < Slots.size(); ++Index)
+    {
+        Output << Slots[Index] << (Index + 1 < Slots.size() ? "," : "");
+    }
+    Output << "};\n";
+    Output << "} // namespace\n\n";
+
+    Output << "const EmbeddedAssets::Asset* EmbeddedAssets::Find(const std::string_view& Path)\n{\n";
+    Output << "    const int INDEX = SLOTS[HashPath(Path, SEED) & (sizeof(SLOTS) / sizeof(SLOTS[0]) - 1)];\n";
+    Output << "    return INDEX >= 0 && ASSETS[INDEX].Path == Path ? &ASSETS[INDEX] : nullptr;\n}\n\n";
+    Output << "const EmbeddedAssets::Asset* EmbeddedAssets::GetAssets()\n{\n    return ASSETS;\n}\n\n";
+    Output << "size_t EmbeddedAssets::GetAssetCount()\n{\n    return ASSET_COUNT;\n}\n";
+
+    // Only touch the output when it changed, so the library isn't rebuilt needlessly
+    std::ifstream ExistingFile(OUTPUT_FILE, std::ios::binary);
+    if (const std::string EXISTING {std::istreambuf_iterator<char>(ExistingFile), std::istreambuf_iterator<char>()}; EXISTING == Output.str())
+    {
+        return 0;
+    }
+    ExistingFile.close();
+
+    std::filesystem::create_directories(OUTPUT_FILE.parent_path());
+    std::ofstream OutputFile(OUTPUT_FILE, std::ios::binary | std::ios::trunc);
+    OutputFile << Output.str();
+    if (!OutputFile)
+    {
+        std::cerr << "Failed to write " << OUTPUT_FILE << std::endl;
+        return 1;
+    }
+
+    std::cout << "Embedded " << Assets.size() << " assets (" << OriginalBytes / 1024 << " KiB, " << BundledBytes / 1024 << " KiB minified)" << std::endl;
+    return 0;
+}
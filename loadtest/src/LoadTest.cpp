@@ -0,0 +1,735 @@
+/**
+ * @brief Load generator for OrionServer: simulates users that register, log in, listen to /orion/events and chat.
+ *
+ * Usage: OrionLoadTest [--name value]... (see --help)
+ *
+ * Each simulated user registers (and logs in), opens its /orion/events stream and then, for each message, posts /orion/send_message and
+ * waits for the reply on the stream; optionally it has the reply read out with /orion/speak and a recording transcribed with
+ * /orion/transcribe. Users start spread over the ramp-up time and pause for the think time between messages.
+ *
+ * The report lists the throughput and, per operation, the mean and tail latency:
+ *  - ttft:  from posting a message to its first message.delta event (time to first token, as the user sees it)
+ *  - reply: from posting a message to its message.completed event
+ *  - every request on its own (register, login, events (until the stream is open), send_message, speak, transcribe)
+ *
+ * Run it against a server that talks to the OpenAI stand-in (OrionOpenAIStub), so no API costs are incurred and the upstream latency
+ * is under control:
+ *
+ *   OrionOpenAIStub --tokens-per-second 50 --tool-call-rate 0.2 &
+ *   OPENAI_BASE_URL=http://127.0.0.1:8081/v1 OPENAI_API_KEY=stub OrionServer &
+ *   OrionLoadTest --users 50 --messages 10
+ */
+
+#include <cpprest/containerstream.h>
+#include <cpprest/http_client.h>
+#include <cpprest/json.h>
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    /// @brief  The settings of the load test
+    struct LoadTestOptions
+    {
+        /// @brief  The URL of the server
+        std::string ServerURL = "https://127.0.0.1:5000";
+
+        /// @brief  The number of simulated users
+        size_t Users = 10;
+
+        /// @brief  The number of messages each user sends
+        size_t MessagesPerUser = 5;
+
+        /// @brief  The time the users' starts are spread over
+        std::chrono::milliseconds RampUp {5000};
+
+        /// @brief  The pause between a reply and the next message of a user
+        std::chrono::milliseconds ThinkTime {1000};
+
+        /// @brief  The time a reply may take before it counts as failed
+        std::chrono::milliseconds ReplyTimeout {120000};
+
+        /// @brief  The message the users send
+        std::string Message = "Hello ORION, this is a load test. Please reply with a short paragraph.";
+
+        /// @brief  Whether the users have each reply read out with /orion/speak
+        bool IsSpeakEnabled = true;
+
+        /// @brief  A recording the users have transcribed with /orion/transcribe after each reply (empty to skip transcription)
+        std::string TranscribeFile;
+
+        /// @brief  The prefix of the usernames of the simulated users (a suffix makes them unique per run)
+        std::string UsernamePrefix = "loadtest";
+
+        /// @brief  The file the report is also written to as JSON (empty to only print it)
+        std::string ReportFile;
+    };
+
+    /// @brief  A setting of the command line
+    struct Setting
+    {
+        std::string_view                                                        Name;
+        std::string_view                                                        Description;
+        std::function<bool(LoadTestOptions& Options, const std::string& Value)> Apply;
+    };
+
+    /// @brief  Parse a non-negative number
+    template <typename T>
+    bool ParseNumber(const std::string& Value, T& OutNumber)
+    {
+        const auto [END, ERROR_CODE] = std::from_chars(Value.data(), Value.data() + Value.size(), OutNumber);
+        return !Value.empty() && ERROR_CODE == std::errc() && END == Value.data() + Value.size();
+    }
+
+    /// @brief  Parse a duration in milliseconds
+    bool ParseMilliseconds(const std::string& Value, std::chrono::milliseconds& OutDuration)
+    {
+        int64_t Milliseconds = 0;
+        if (!ParseNumber(Value, Milliseconds) || Milliseconds < 0)
+        {
+            return false;
+        }
+        OutDuration = std::chrono::milliseconds(Milliseconds);
+        return true;
+    }
+
+    /// @brief  Parse a switch (on/off, true/false, yes/no, 1/0)
+    bool ParseSwitch(const std::string& Value, bool& OutSwitch)
+    {
+        if (Value == "on" || Value == "true" || Value == "yes" || Value == "1")
+        {
+            OutSwitch = true;
+            return true;
+        }
+        if (Value == "off" || Value == "false" || Value == "no" || Value == "0")
+        {
+            OutSwitch = false;
+            return true;
+        }
+        return false;
+    }
+
+    /// @brief  The settings, in the order they are listed in the usage
+    const std::vector<Setting>& GetSettings()
+    {
+        static const std::vector<Setting> SETTINGS = {
+            {"server", "URL of the server (default https://127.0.0.1:5000; certificates aren't verified)",
+             [](auto& Options, const auto& Value)
+             {
+                 Options.ServerURL = Value;
+                 return !Value.empty();
+             }},
+            {"users", "Number of simulated users (default 10)", [](auto& Options, const auto& Value) { return ParseNumber(Value, Options.Users) && Options.Users > 0; }},
+            {"messages", "Number of messages each user sends (default 5)", [](auto& Options, const auto& Value) { return ParseNumber(Value, Options.MessagesPerUser); }},
+            {"ramp-up-ms", "Time the users' starts are spread over (default 5000)", [](auto& Options, const auto& Value) { return ParseMilliseconds(Value, Options.RampUp); }},
+            {"think-ms", "Pause between a reply and the next message of a user (default 1000)",
+             [](auto& Options, const auto& Value) { return ParseMilliseconds(Value, Options.ThinkTime); }},
+            {"reply-timeout-ms", "Time a reply may take before it counts as failed (default 120000)",
+             [](auto& Options, const auto& Value) { return ParseMilliseconds(Value, Options.ReplyTimeout); }},
+            {"message", "Message the users send",
+             [](auto& Options, const auto& Value)
+             {
+                 Options.Message = Value;
+                 return !Value.empty();
+             }},
+            {"speak", "Have each reply read out with /orion/speak: on or off (default on)",
+             [](auto& Options, const auto& Value) { return ParseSwitch(Value, Options.IsSpeakEnabled); }},
+            {"transcribe-file", "Recording to transcribe with /orion/transcribe after each reply (default none)",
+             [](auto& Options, const auto& Value)
+             {
+                 Options.TranscribeFile = Value;
+                 return std::ifstream(Value, std::ios::binary).good();
+             }},
+            {"username-prefix", "Prefix of the usernames of the simulated users (default loadtest)",
+             [](auto& Options, const auto& Value)
+             {
+                 Options.UsernamePrefix = Value;
+                 return !Value.empty();
+             }},
+            {"report-file", "File the report is also written to as JSON",
+             [](auto& Options, const auto& Value)
+             {
+                 Options.ReportFile = Value;
+                 return !Value.empty();
+             }},
+        };
+        return SETTINGS;
+    }
+
+    /// @brief  Get the usage of the load test
+    std::string GetUsage(const std::string& ProgramName)
+    {
+        std::ostringstream Usage;
+        Usage << "Usage: " << ProgramName << " [--name value]...\n\n";
+        for (const auto& SETTING : GetSettings())
+        {
+            Usage << "  --" << SETTING.Name << std::string(SETTING.Name.size() < 20 ? 20 - SETTING.Name.size() : 1, ' ') << SETTING.Description << "\n";
+        }
+        return Usage.str();
+    }
+
+    /// @brief  Get the milliseconds between two points in time
+    double ToMilliseconds(const Clock::duration& Duration)
+    {
+        return std::chrono::duration<double, std::milli>(Duration).count();
+    }
+
+    /**
+     * @class Results
+     * @brief The latencies and errors of each operation, collected from all users.
+     */
+    class Results final
+    {
+    public:
+        /// @brief  Record the latency of a successful operation
+        void Record(const std::string& Operation, const Clock::duration& Latency)
+        {
+            std::lock_guard<std::mutex> Lock(m_Mutex);
+            m_Operations[Operation].Latencies.push_back(ToMilliseconds(Latency));
+        }
+
+        /// @brief  Record a failed operation
+        void RecordError(const std::string& Operation, const std::string& Error)
+        {
+            std::lock_guard<std::mutex> Lock(m_Mutex);
+            auto& Stats = m_Operations[Operation];
+            ++Stats.ErrorCount;
+            if (Stats.FirstError.empty())
+            {
+                Stats.FirstError = Error;
+            }
+        }
+
+        /// @brief  Record a message the server turned away (429 or 503) and that was retried
+        void RecordRejection()
+        {
+            ++m_RejectionCount;
+        }
+
+        /// @brief  Print the report, and write it as JSON if a file is given
+        /// @return Whether any operation failed
+        bool Report(const LoadTestOptions& Options, const Clock::duration& Elapsed)
+        {
+            std::lock_guard<std::mutex> Lock(m_Mutex);
+
+            const double SECONDS    = std::chrono::duration<double>(Elapsed).count();
+            const auto   REPLY_ITER = m_Operations.find("reply");
+            const size_t REPLIES    = REPLY_ITER != m_Operations.end() ? REPLY_ITER->second.Latencies.size() : 0;
+
+            size_t RequestCount = 0;
+            bool   HasErrors    = false;
+            for (const auto& [OPERATION, STATS] : m_Operations)
+            {
+                if (OPERATION != "ttft" && OPERATION != "reply")
+                {
+                    RequestCount += STATS.Latencies.size() + STATS.ErrorCount;
+                }
+                HasErrors |= STATS.ErrorCount > 0;
+            }
+
+            auto JReport                      = web::json::value::object();
+            JReport[U("users")]               = static_cast<int64_t>(Options.Users);
+            JReport[U("messages_per_user")]   = static_cast<int64_t>(Options.MessagesPerUser);
+            JReport[U("duration_seconds")]    = SECONDS;
+            JReport[U("replies")]             = static_cast<int64_t>(REPLIES);
+            JReport[U("replies_per_second")]  = SECONDS > 0.0 ? REPLIES / SECONDS : 0.0;
+            JReport[U("requests")]            = static_cast<int64_t>(RequestCount);
+            JReport[U("requests_per_second")] = SECONDS > 0.0 ? RequestCount / SECONDS : 0.0;
+            JReport[U("rejections")]          = static_cast<int64_t>(m_RejectionCount.load());
+
+            std::cout << std::fixed << std::setprecision(1);
+            std::cout << "\nUsers: " << Options.Users << ", messages per user: " << Options.MessagesPerUser << ", duration: " << SECONDS << " s\n";
+            std::cout << "Replies: " << REPLIES << " (" << std::setprecision(2) << (SECONDS > 0.0 ? REPLIES / SECONDS : 0.0) << "/s), requests: " << RequestCount << " ("
+                      << (SECONDS > 0.0 ? RequestCount / SECONDS : 0.0) << "/s), rejected by admission control and retried: " << m_RejectionCount.load() << "\n\n";
+            std::cout << std::setprecision(1);
+            std::cout << std::left << std::setw(14) << "operation" << std::right << std::setw(8) << "count" << std::setw(8) << "errors" << std::setw(10) << "mean"
+                      << std::setw(10) << "p50" << std::setw(10) << "p90" << std::setw(10) << "p99" << std::setw(10) << "max" << "  (ms)\n";
+
+            auto JOperations = web::json::value::object();
+            for (auto& [OPERATION, Stats] : m_Operations)
+            {
+                auto& Latencies = Stats.Latencies;
+                std::sort(Latencies.begin(), Latencies.end());
+
+                const auto PERCENTILE = [&Latencies](const double FRACTION)
+                {
+                    if (Latencies.empty())
+                    {
+                        return 0.0;
+                    }
+                    // Nearest rank
+                    const auto RANK = static_cast<size_t>(std::ceil(FRACTION * Latencies.size()));
+                    return Latencies[std::min(std::max<size_t>(RANK, 1), Latencies.size()) - 1];
+                };
+                const double MEAN = Latencies.empty() ? 0.0 : std::accumulate(Latencies.begin(), Latencies.end(), 0.0) / Latencies.size();
+
+                std::cout << std::left << std::setw(14) << OPERATION << std::right << std::setw(8) << Latencies.size() << std::setw(8) << Stats.ErrorCount << std::setw(10) << MEAN
+                          << std::setw(10) << PERCENTILE(0.5) << std::setw(10) << PERCENTILE(0.9) << std::setw(10) << PERCENTILE(0.99) << std::setw(10)
+                          << (Latencies.empty() ? 0.0 : Latencies.back()) << "\n";
+
+                auto JOperation          = web::json::value::object();
+                JOperation[U("count")]   = static_cast<int64_t>(Latencies.size());
+                JOperation[U("errors")]  = static_cast<int64_t>(Stats.ErrorCount);
+                JOperation[U("mean_ms")] = MEAN;
+                JOperation[U("p50_ms")]  = PERCENTILE(0.5);
+                JOperation[U("p90_ms")]  = PERCENTILE(0.9);
+                JOperation[U("p99_ms")]  = PERCENTILE(0.99);
+                JOperation[U("max_ms")]  = Latencies.empty() ? 0.0 : Latencies.back();
+                if (!Stats.FirstError.empty())
+                {
+                    JOperation[U("first_error")] = web::json::value::string(Stats.FirstError);
+                }
+                JOperations[OPERATION] = JOperation;
+            }
+            JReport[U("operations")] = JOperations;
+
+            for (const auto& [OPERATION, STATS] : m_Operations)
+            {
+                if (!STATS.FirstError.empty())
+                {
+                    std::cout << "\nFirst " << OPERATION << " error: " << STATS.FirstError;
+                }
+            }
+            std::cout << std::endl;
+
+            if (!Options.ReportFile.empty())
+            {
+                std::ofstream ReportFile(Options.ReportFile);
+                ReportFile << JReport.serialize() << std::endl;
+            }
+
+            return HasErrors;
+        }
+
+    private:
+        /// @brief  The results of an operation
+        struct OperationStats
+        {
+            std::vector<double> Latencies;
+            size_t              ErrorCount = 0;
+            std::string         FirstError;
+        };
+
+        std::map<std::string, OperationStats> m_Operations;
+        std::atomic<size_t>                   m_RejectionCount = 0;
+        std::mutex                            m_Mutex;
+    };
+
+    /**
+     * @class EventListener
+     * @brief The /orion/events stream of a user. Reads the stream on its own thread and notes when the reply to the last message starts and
+     *        completes.
+     */
+    class EventListener final
+    {
+    public:
+        ~EventListener()
+        {
+            Close();
+        }
+
+        /// @brief  Open the stream
+        /// @return An error, or nothing if the stream is open
+        std::optional<std::string> Open(const LoadTestOptions& Options, const web::http::client::http_client_config& Config, const std::string& UserID)
+        {
+            // Events arrive minutes apart at most, but the stream stays open for the whole test
+            auto StreamConfig = Config;
+            StreamConfig.set_timeout(std::chrono::hours(24));
+            m_pClient = std::make_unique<web::http::client::http_client>(Options.ServerURL, StreamConfig);
+
+            web::http::http_request EventsRequest(web::http::methods::GET);
+            EventsRequest.set_request_uri(U("/orion/events"));
+            EventsRequest.headers().add(U("X-User-Id"), UserID);
+            EventsRequest.headers().add(U("Accept"), U("text/event-stream"));
+
+            try
+            {
+                const auto RESPONSE = m_pClient->request(EventsRequest, m_Cancellation.get_token()).get();
+                if (RESPONSE.status_code() != web::http::status_codes::OK)
+                {
+                    return "HTTP " + std::to_string(RESPONSE.status_code());
+                }
+                m_ReaderThread = std::thread(&EventListener::ReaderThreadHandler, this, RESPONSE.body());
+                return std::nullopt;
+            }
+            catch (const std::exception& Exception)
+            {
+                return std::string(Exception.what());
+            }
+        }
+
+        /// @brief  Forget the events of the previous reply. Call before posting a message
+        void BeginMessage()
+        {
+            std::lock_guard<std::mutex> Lock(m_Mutex);
+            m_FirstDelta.reset();
+            m_Completed.reset();
+        }
+
+        /// @brief  Wait for the reply to the last message to complete
+        /// @return When the first delta and the completion arrived, or nothing if the reply didn't complete in time or the stream closed
+        std::optional<std::pair<Clock::time_point, Clock::time_point>> WaitForReply(const std::chrono::milliseconds TIMEOUT)
+        {
+            std::unique_lock<std::mutex> Lock(m_Mutex);
+            m_ConditionVariable.wait_for(Lock, TIMEOUT, [this] { return m_Completed.has_value() || m_IsClosed; });
+            if (!m_Completed)
+            {
+                return std::nullopt;
+            }
+            return std::make_pair(*m_FirstDelta, *m_Completed);
+        }
+
+        /// @brief  Close the stream
+        void Close()
+        {
+            m_Cancellation.cancel();
+            if (m_ReaderThread.joinable())
+            {
+                m_ReaderThread.join();
+            }
+            m_pClient.reset();
+        }
+
+    private:
+        void ReaderThreadHandler(concurrency::streams::istream Body)
+        {
+            std::string EventName;
+            try
+            {
+                while (true)
+                {
+                    concurrency::streams::container_buffer<std::string> LineBuffer;
+                    Body.read_line(LineBuffer).get();
+                    const auto& LINE = LineBuffer.collection();
+
+                    if (LINE.empty())
+                    {
+                        if (Body.is_eof())
+                        {
+                            break;
+                        }
+
+                        // The end of an event. A run can complete a message more than once (the message, then the run), and a tool call
+                        // completes a step before the reply starts, so a reply is complete at the first completion after a delta
+                        std::lock_guard<std::mutex> Lock(m_Mutex);
+                        if (EventName == "message.delta" && !m_FirstDelta)
+                        {
+                            m_FirstDelta = Clock::now();
+                        }
+                        else if (EventName == "message.completed" && m_FirstDelta && !m_Completed)
+                        {
+                            m_Completed = Clock::now();
+                            m_ConditionVariable.notify_all();
+                        }
+                        EventName.clear();
+                    }
+                    else if (LINE.rfind("event: ", 0) == 0)
+                    {
+                        EventName = LINE.substr(7);
+                    }
+                }
+            }
+            catch (const std::exception&)
+            {
+                // Closed by the server or cancelled
+            }
+
+            std::lock_guard<std::mutex> Lock(m_Mutex);
+            m_IsClosed = true;
+            m_ConditionVariable.notify_all();
+        }
+
+        std::unique_ptr<web::http::client::http_client> m_pClient;
+        pplx::cancellation_token_source                 m_Cancellation;
+        std::thread                                     m_ReaderThread;
+
+        /// @brief  When the reply to the last message started and completed
+        std::optional<Clock::time_point> m_FirstDelta;
+        std::optional<Clock::time_point> m_Completed;
+        bool                             m_IsClosed = false;
+
+        std::mutex              m_Mutex;
+        std::condition_variable m_ConditionVariable;
+    };
+
+    /**
+     * @class SimulatedUser
+     * @brief A user of the load test. Runs its session on the calling thread.
+     */
+    class SimulatedUser final
+    {
+    public:
+        SimulatedUser(const LoadTestOptions& Options, const std::vector<unsigned char>& Recording, Results& InResults, std::string Username)
+            : m_Options(Options)
+            , m_Recording(Recording)
+            , m_Results(InResults)
+            , m_Username(std::move(Username))
+        {
+            m_Config.set_validate_certificates(false);
+            m_Config.set_timeout(std::chrono::duration_cast<std::chrono::seconds>(Options.ReplyTimeout));
+            m_pClient = std::make_unique<web::http::client::http_client>(Options.ServerURL, m_Config);
+        }
+
+        /// @brief  Register, open the event stream and send the messages
+        void Run()
+        {
+            if (!Register() || !Login())
+            {
+                return;
+            }
+
+            EventListener Events;
+            const auto    EVENTS_START = Clock::now();
+            if (const auto ERROR = Events.Open(m_Options, m_Config, m_UserID))
+            {
+                m_Results.RecordError("events", *ERROR);
+                return;
+            }
+            m_Results.Record("events", Clock::now() - EVENTS_START);
+
+            for (size_t Index = 0; Index < m_Options.MessagesPerUser; ++Index)
+            {
+                if (Index > 0)
+                {
+                    std::this_thread::sleep_for(m_Options.ThinkTime);
+                }
+
+                Events.BeginMessage();
+                const auto SEND_START = Clock::now();
+                if (!SendMessage())
+                {
+                    continue;
+                }
+
+                const auto REPLY = Events.WaitForReply(m_Options.ReplyTimeout);
+                if (!REPLY)
+                {
+                    m_Results.RecordError("reply", "No reply within " + std::to_string(m_Options.ReplyTimeout.count()) + " ms");
+                    continue;
+                }
+                m_Results.Record("ttft", REPLY->first - SEND_START);
+                m_Results.Record("reply", REPLY->second - SEND_START);
+
+                if (m_Options.IsSpeakEnabled)
+                {
+                    auto JBody          = web::json::value::object();
+                    JBody[U("message")] = web::json::value::string(U("This is the reply of a load test being read out."));
+                    TimeRequest("speak", web::http::methods::POST, U("/orion/speak"), JBody);
+                }
+
+                if (!m_Recording.empty())
+                {
+                    web::http::http_request TranscribeRequest(web::http::methods::POST);
+                    TranscribeRequest.set_request_uri(U("/orion/transcribe"));
+                    TranscribeRequest.headers().add(U("X-User-Id"), m_UserID);
+                    TranscribeRequest.set_body(m_Recording);
+                    TimeRequest("transcribe", TranscribeRequest);
+                }
+            }
+
+            Events.Close();
+        }
+
+    private:
+        bool Register()
+        {
+            auto JBody           = web::json::value::object();
+            JBody[U("username")] = web::json::value::string(m_Username);
+            JBody[U("password")] = web::json::value::string(U("loadtest"));
+
+            const auto JRESPONSE = TimeRequest("register", web::http::methods::POST, U("/register"), JBody);
+            if (!JRESPONSE || !JRESPONSE->has_string_field(U("user_id")))
+            {
+                return false;
+            }
+            m_UserID = JRESPONSE->at(U("user_id")).as_string();
+            return true;
+        }
+
+        bool Login()
+        {
+            auto JBody          = web::json::value::object();
+            JBody[U("user_id")] = web::json::value::string(m_UserID);
+            return TimeRequest("login", web::http::methods::POST, U("/login"), JBody).has_value();
+        }
+
+        /// @brief  Post the message. Retries when the server turns it away because of its admission limits
+        bool SendMessage()
+        {
+            auto JBody          = web::json::value::object();
+            JBody[U("message")] = web::json::value::string(m_Options.Message);
+
+            const auto DEADLINE = Clock::now() + m_Options.ReplyTimeout;
+            while (true)
+            {
+                web::http::http_request SendRequest(web::http::methods::POST);
+                SendRequest.set_request_uri(U("/orion/send_message"));
+                SendRequest.headers().add(U("X-User-Id"), m_UserID);
+                SendRequest.set_body(JBody);
+
+                const auto START = Clock::now();
+                try
+                {
+                    const auto RESPONSE = m_pClient->request(SendRequest).get();
+                    RESPONSE.content_ready().wait();
+
+                    const auto STATUS = RESPONSE.status_code();
+                    if (STATUS == web::http::status_codes::OK)
+                    {
+                        m_Results.Record("send_message", Clock::now() - START);
+                        return true;
+                    }
+                    if ((STATUS == web::http::status_codes::TooManyRequests || STATUS == web::http::status_codes::ServiceUnavailable) && Clock::now() < DEADLINE)
+                    {
+                        m_Results.RecordRejection();
+
+                        int RetryAfterSeconds = 1;
+                        if (const auto RETRY_AFTER_ITER = RESPONSE.headers().find(U("Retry-After")); RETRY_AFTER_ITER != RESPONSE.headers().end())
+                        {
+                            RetryAfterSeconds = std::max(1, std::atoi(RETRY_AFTER_ITER->second.c_str()));
+                        }
+                        std::this_thread::sleep_for(std::chrono::seconds(RetryAfterSeconds));
+                        continue;
+                    }
+                    m_Results.RecordError("send_message", "HTTP " + std::to_string(STATUS));
+                }
+                catch (const std::exception& Exception)
+                {
+                    m_Results.RecordError("send_message", Exception.what());
+                }
+                return false;
+            }
+        }
+
+        /// @brief  Send a JSON request as the user and record its latency (until the whole response is received)
+        /// @return The JSON response (null if it isn't JSON), or nothing if the request failed
+        std::optional<web::json::value> TimeRequest(const std::string& Operation, const web::http::method& Method, const std::string& Path, const web::json::value& JBody)
+        {
+            web::http::http_request Request(Method);
+            Request.set_request_uri(Path);
+            if (!m_UserID.empty())
+            {
+                Request.headers().add(U("X-User-Id"), m_UserID);
+            }
+            Request.set_body(JBody);
+            return TimeRequest(Operation, Request);
+        }
+
+        std::optional<web::json::value> TimeRequest(const std::string& Operation, web::http::http_request& Request)
+        {
+            const auto START = Clock::now();
+            try
+            {
+                const auto RESPONSE = m_pClient->request(Request).get();
+                const auto BODY     = RESPONSE.extract_vector().get();
+                if (RESPONSE.status_code() != web::http::status_codes::OK)
+                {
+                    m_Results.RecordError(Operation, "HTTP " + std::to_string(RESPONSE.status_code()) + ": " + std::string(BODY.begin(), BODY.end()));
+                    return std::nullopt;
+                }
+                m_Results.Record(Operation, Clock::now() - START);
+
+                const auto CONTENT_TYPE = RESPONSE.headers().content_type();
+                if (CONTENT_TYPE.find("json") == std::string::npos)
+                {
+                    return web::json::value::null();
+                }
+                return web::json::value::parse(std::string(BODY.begin(), BODY.end()));
+            }
+            catch (const std::exception& Exception)
+            {
+                m_Results.RecordError(Operation, Exception.what());
+                return std::nullopt;
+            }
+        }
+
+        const LoadTestOptions&                          m_Options;
+        const std::vector<unsigned char>&               m_Recording;
+        Results&                                        m_Results;
+        const std::string                               m_Username;
+        std::string                                     m_UserID;
+        web::http::client::http_client_config           m_Config;
+        std::unique_ptr<web::http::client::http_client> m_pClient;
+    };
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    LoadTestOptions Options;
+    for (int ArgIndex = 1; ArgIndex < argc; ++ArgIndex)
+    {
+        const std::string ARGUMENT = argv[ArgIndex];
+        if (ARGUMENT == "--help" || ARGUMENT == "-h")
+        {
+            std::cout << GetUsage(argv[0]);
+            return 0;
+        }
+
+        const auto SETTING_ITER = std::find_if(GetSettings().begin(), GetSettings().end(), [&ARGUMENT](const Setting& S) { return "--" + std::string(S.Name) == ARGUMENT; });
+        if (SETTING_ITER == GetSettings().end() || ArgIndex + 1 >= argc)
+        {
+            std::cerr << (SETTING_ITER == GetSettings().end() ? "Unknown option " : "Missing the value of ") << ARGUMENT << std::endl << std::endl << GetUsage(argv[0]);
+            return 1;
+        }
+        if (!SETTING_ITER->Apply(Options, argv[++ArgIndex]))
+        {
+            std::cerr << "Invalid value '" << argv[ArgIndex] << "' for " << ARGUMENT << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<unsigned char> Recording;
+    if (!Options.TranscribeFile.empty())
+    {
+        std::ifstream RecordingFile(Options.TranscribeFile, std::ios::binary);
+        Recording.assign(std::istreambuf_iterator<char>(RecordingFile), std::istreambuf_iterator<char>());
+    }
+
+    // Usernames are unique per run, so runs don't collide with the users of earlier ones
+    const auto RUN_ID = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+
+    std::cout << "Simulating " << Options.Users << " users against " << Options.ServerURL << std::endl;
+
+    Results                  LoadTestResults;
+    std::vector<std::thread> UserThreads;
+    const auto               START = Clock::now();
+    for (size_t Index = 0; Index < Options.Users; ++Index)
+    {
+        const auto START_DELAY = Options.RampUp * Index / Options.Users;
+        UserThreads.emplace_back(
+            [&, Index, START_DELAY]
+            {
+                std::this_thread::sleep_for(START_DELAY);
+                SimulatedUser User(Options, Recording, LoadTestResults, Options.UsernamePrefix + "-" + std::to_string(RUN_ID) + "-" + std::to_string(Index));
+                User.Run();
+            });
+    }
+
+    for (auto& UserThread : UserThreads)
+    {
+        UserThread.join();
+    }
+
+    const bool HAS_ERRORS = LoadTestResults.Report(Options, Clock::now() - START);
+    return HAS_ERRORS ? 2 : 0;
+}
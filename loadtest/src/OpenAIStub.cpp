@@ -0,0 +1,845 @@
+/**
+ * @brief A local stand-in for the parts of the OpenAI API Orion uses, for load tests that must not hit (or pay for) the real API.
+ *
+ * Usage: OrionOpenAIStub [--name value]... (see --help)
+ *
+ * Point OrionServer at it with OPENAI_BASE_URL=http://127.0.0.1:8081/v1 (and any OPENAI_API_KEY). It serves:
+ *  - /v1/assistants (list, create, update), /v1/chat/completions and /v1/embeddings
+ *  - /v1/threads, /v1/threads/{id}/messages (create, list) and /v1/threads/{id}/runs: runs stream Server-Sent Events like the real API,
+ *    one token per thread.message.delta at a configurable rate, and a configurable share of runs first ask for a tool call
+ *    (thread.run.requires_action) that Orion executes and answers with /runs/{id}/submit_tool_outputs
+ *  - /v1/audio/speech (silent audio of a configurable size), /v1/audio/transcriptions and /v1/files
+ *
+ * Responses are timed by one timer thread (a TimerQueue) rather than a sleeping thread per request, so the stub itself stays cheap at
+ * thousands of concurrent streams and the numbers measured are Orion's.
+ */
+
+#include "TimerQueue.hpp"
+
+#include <cpprest/http_listener.h>
+#include <cpprest/json.h>
+#include <cpprest/producerconsumerstream.h>
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <pthread.h>
+
+namespace
+{
+    /// @brief  The settings of the stub
+    struct StubOptions
+    {
+        /// @brief  The URL the stub listens on (the /v1 prefix is part of it)
+        std::string ListenURL = "http://127.0.0.1:8081/v1";
+
+        /// @brief  The rate tokens of a reply are streamed at
+        double TokensPerSecond = 50.0;
+
+        /// @brief  The number of tokens of a reply
+        size_t TokensPerReply = 60;
+
+        /// @brief  The time from the start of a run to its first token (the model "thinking")
+        std::chrono::milliseconds FirstTokenDelay {400};
+
+        /// @brief  The latency added to every non-streaming response
+        std::chrono::milliseconds ResponseDelay {20};
+
+        /// @brief  The share of runs (0-1) that ask for a tool call before replying
+        double ToolCallRate = 0.0;
+
+        /// @brief  The tool those runs call, and its arguments (a JSON object, as a string)
+        std::string ToolName      = "recall_knowledge";
+        std::string ToolArguments = R"({"knowledge_subject_and_tags":["load","test"]})";
+
+        /// @brief  The number of dimensions of an embedding
+        size_t EmbeddingDimensions = 256;
+
+        /// @brief  The size of the audio returned by /audio/speech
+        size_t SpeechBytes = 32 * 1024;
+    };
+
+    /// @brief  A setting of the command line
+    struct Setting
+    {
+        std::string_view                                                    Name;
+        std::string_view                                                    Description;
+        std::function<bool(StubOptions& Options, const std::string& Value)> Apply;
+    };
+
+    /// @brief  Parse a non-negative number
+    template <typename T>
+    bool ParseNumber(const std::string& Value, T& OutNumber)
+    {
+        const auto [END, ERROR_CODE] = std::from_chars(Value.data(), Value.data() + Value.size(), OutNumber);
+        return !Value.empty() && ERROR_CODE == std::errc() && END == Value.data() + Value.size();
+    }
+
+    /// @brief  Parse a non-negative decimal number
+    bool ParseDecimal(const std::string& Value, double& OutNumber)
+    {
+        char* pEnd = nullptr;
+        OutNumber  = std::strtod(Value.c_str(), &pEnd);
+        return !Value.empty() && pEnd == Value.c_str() + Value.size() && OutNumber >= 0.0;
+    }
+
+    /// @brief  Parse a duration in milliseconds
+    bool ParseMilliseconds(const std::string& Value, std::chrono::milliseconds& OutDuration)
+    {
+        int64_t Milliseconds = 0;
+        if (!ParseNumber(Value, Milliseconds) || Milliseconds < 0)
+        {
+            return false;
+        }
+        OutDuration = std::chrono::milliseconds(Milliseconds);
+        return true;
+    }
+
+    /// @brief  The settings, in the order they are listed in the usage
+    const std::vector<Setting>& GetSettings()
+    {
+        static const std::vector<Setting> SETTINGS = {
+            {"listen", "URL to listen on, including the /v1 prefix (default http://127.0.0.1:8081/v1)",
+             [](auto& Options, const auto& Value)
+             {
+                 Options.ListenURL = Value;
+                 return !Value.empty();
+             }},
+            {"tokens-per-second", "Rate the tokens of a reply are streamed at (default 50)",
+             [](auto& Options, const auto& Value) { return ParseDecimal(Value, Options.TokensPerSecond) && Options.TokensPerSecond > 0.0; }},
+            {"tokens-per-reply", "Number of tokens of a reply (default 60)", [](auto& Options, const auto& Value) { return ParseNumber(Value, Options.TokensPerReply); }},
+            {"first-token-ms", "Time from the start of a run to its first token (default 400)",
+             [](auto& Options, const auto& Value) { return ParseMilliseconds(Value, Options.FirstTokenDelay); }},
+            {"response-ms", "Latency added to every non-streaming response (default 20)",
+             [](auto& Options, const auto& Value) { return ParseMilliseconds(Value, Options.ResponseDelay); }},
+            {"tool-call-rate", "Share of runs, 0 to 1, that call a tool before replying (default 0)",
+             [](auto& Options, const auto& Value) { return ParseDecimal(Value, Options.ToolCallRate) && Options.ToolCallRate <= 1.0; }},
+            {"tool-name", "Tool those runs call (default recall_knowledge)",
+             [](auto& Options, const auto& Value)
+             {
+                 Options.ToolName = Value;
+                 return !Value.empty();
+             }},
+            {"tool-arguments", "Arguments of the tool call, as a JSON object",
+             [](auto& Options, const auto& Value)
+             {
+                 Options.ToolArguments = Value;
+                 try
+                 {
+                     return web::json::value::parse(Value).is_object();
+                 }
+                 catch (const web::json::json_exception&)
+                 {
+                     return false;
+                 }
+             }},
+            {"embedding-dimensions", "Number of dimensions of an embedding (default 256)",
+             [](auto& Options, const auto& Value) { return ParseNumber(Value, Options.EmbeddingDimensions) && Options.EmbeddingDimensions > 0; }},
+            {"speech-bytes", "Size of the audio returned by /audio/speech (default 32768)",
+             [](auto& Options, const auto& Value) { return ParseNumber(Value, Options.SpeechBytes); }},
+        };
+        return SETTINGS;
+    }
+
+    /// @brief  Get the usage of the stub
+    std::string GetUsage(const std::string& ProgramName)
+    {
+        std::ostringstream Usage;
+        Usage << "Usage: " << ProgramName << " [--name value]...\n\n";
+        for (const auto& SETTING : GetSettings())
+        {
+            Usage << "  --" << SETTING.Name << std::string(SETTING.Name.size() < 22 ? 22 - SETTING.Name.size() : 1, ' ') << SETTING.Description << "\n";
+        }
+        return Usage.str();
+    }
+
+    /// @brief  An event of a run's stream, and the time to wait before sending it
+    struct StreamEvent
+    {
+        std::chrono::steady_clock::duration Delay;
+        std::string                         Name;
+        std::string                         Data;
+    };
+
+    /**
+     * @class OpenAIStub
+     * @brief The stand-in server. Keeps the assistants, threads and messages it was asked to create in memory.
+     */
+    class OpenAIStub final
+    {
+    public:
+        explicit OpenAIStub(StubOptions Options)
+            : m_Options(std::move(Options))
+            , m_Listener(m_Options.ListenURL)
+        {
+            m_Listener.support([this](const web::http::http_request& Request) { HandleRequest(Request); });
+        }
+
+        /// @brief  Start listening
+        bool Start()
+        {
+            try
+            {
+                m_Listener.open().wait();
+                return true;
+            }
+            catch (const std::exception& Exception)
+            {
+                std::cerr << "Failed to listen on " << m_Options.ListenURL << ": " << Exception.what() << std::endl;
+                return false;
+            }
+        }
+
+        /// @brief  Stop listening
+        void Stop()
+        {
+            m_Listener.close().wait();
+        }
+
+        /// @brief  Print the number of requests served per endpoint
+        void PrintRequestCounts() const
+        {
+            std::lock_guard<std::mutex> Lock(m_Mutex);
+            for (const auto& [ENDPOINT, COUNT] : m_RequestCounts)
+            {
+                std::cout << "  " << ENDPOINT << ": " << COUNT << std::endl;
+            }
+        }
+
+    private:
+        /// @brief  A message of a thread
+        struct Message
+        {
+            std::string ID;
+            std::string Role;
+            std::string Text;
+        };
+
+        /// @brief  A run whose stream may still be open
+        struct Run
+        {
+            std::string       ThreadID;
+            std::atomic<bool> IsCancelled = false;
+        };
+
+        /// @brief  Route a request by method and path (relative to /v1)
+        void HandleRequest(const web::http::http_request& Request)
+        {
+            const auto  SEGMENTS = web::uri::split_path(web::uri::decode(Request.relative_uri().path()));
+            const auto& METHOD   = Request.method();
+            const auto  COUNT    = SEGMENTS.size();
+
+            auto IsRoute = [&](const web::http::method& RouteMethod, std::initializer_list<const char*> Route)
+            {
+                if (METHOD != RouteMethod || COUNT != Route.size())
+                {
+                    return false;
+                }
+                size_t Index = 0;
+                for (const char* pSegment : Route)
+                {
+                    // * matches an id
+                    if (std::string_view(pSegment) != "*" && SEGMENTS[Index] != pSegment)
+                    {
+                        return false;
+                    }
+                    ++Index;
+                }
+                return true;
+            };
+
+            std::string Endpoint;
+            if (IsRoute(web::http::methods::GET, {"assistants"}))
+            {
+                Endpoint = "GET assistants";
+                HandleListAssistants(Request);
+            }
+            else if (IsRoute(web::http::methods::POST, {"assistants"}))
+            {
+                Endpoint = "POST assistants";
+                HandleCreateAssistant(Request);
+            }
+            else if (IsRoute(web::http::methods::POST, {"assistants", "*"}))
+            {
+                Endpoint = "POST assistants/:id";
+                ReplyJsonLater(Request, JsonObject({{"id", SEGMENTS[1]}, {"object", "assistant"}}));
+            }
+            else if (IsRoute(web::http::methods::POST, {"chat", "completions"}))
+            {
+                Endpoint = "POST chat/completions";
+                HandleChatCompletions(Request);
+            }
+            else if (IsRoute(web::http::methods::POST, {"embeddings"}))
+            {
+                Endpoint = "POST embeddings";
+                HandleEmbeddings(Request);
+            }
+            else if (IsRoute(web::http::methods::POST, {"threads"}))
+            {
+                Endpoint = "POST threads";
+                HandleCreateThread(Request);
+            }
+            else if (IsRoute(web::http::methods::POST, {"threads", "*", "messages"}))
+            {
+                Endpoint = "POST threads/:id/messages";
+                HandleCreateMessage(Request, SEGMENTS[1]);
+            }
+            else if (IsRoute(web::http::methods::GET, {"threads", "*", "messages"}))
+            {
+                Endpoint = "GET threads/:id/messages";
+                HandleListMessages(Request, SEGMENTS[1]);
+            }
+            else if (IsRoute(web::http::methods::POST, {"threads", "*", "runs"}))
+            {
+                Endpoint = "POST threads/:id/runs";
+                HandleCreateRun(Request, SEGMENTS[1]);
+            }
+            else if (IsRoute(web::http::methods::POST, {"threads", "*", "runs", "*", "submit_tool_outputs"}))
+            {
+                Endpoint = "POST threads/:id/runs/:id/submit_tool_outputs";
+                HandleSubmitToolOutputs(Request, SEGMENTS[1], SEGMENTS[3]);
+            }
+            else if (IsRoute(web::http::methods::POST, {"threads", "*", "runs", "*", "cancel"}))
+            {
+                Endpoint = "POST threads/:id/runs/:id/cancel";
+                HandleCancelRun(Request, SEGMENTS[3]);
+            }
+            else if (IsRoute(web::http::methods::POST, {"audio", "speech"}))
+            {
+                Endpoint = "POST audio/speech";
+                HandleSpeech(Request);
+            }
+            else if (IsRoute(web::http::methods::POST, {"audio", "transcriptions"}))
+            {
+                Endpoint = "POST audio/transcriptions";
+                ReplyJsonLater(Request, JsonObject({{"text", "This is a transcription from the OpenAI stand-in."}}));
+            }
+            else if (IsRoute(web::http::methods::POST, {"files"}))
+            {
+                Endpoint = "POST files";
+                HandleUploadFile(Request);
+            }
+            else if (IsRoute(web::http::methods::GET, {"files", "*"}))
+            {
+                Endpoint = "GET files/:id";
+                ReplyJsonLater(Request, JsonObject({{"id", SEGMENTS[1]}, {"object", "file"}, {"purpose", "assistants"}}));
+            }
+            else if (IsRoute(web::http::methods::GET, {"files", "*", "content"}))
+            {
+                Endpoint = "GET files/:id/content";
+                m_Timers.Schedule(m_Options.ResponseDelay, [Request] { Request.reply(web::http::status_codes::OK, "File content from the OpenAI stand-in.\n", "text/plain"); });
+            }
+            else
+            {
+                Endpoint              = "unknown";
+                auto JError           = web::json::value::object();
+                JError[U("message")]  = web::json::value::string("The OpenAI stand-in doesn't implement " + METHOD + " " + Request.relative_uri().path());
+                auto JResponse        = web::json::value::object();
+                JResponse[U("error")] = JError;
+                Request.reply(web::http::status_codes::NotFound, JResponse);
+            }
+
+            std::lock_guard<std::mutex> Lock(m_Mutex);
+            ++m_RequestCounts[Endpoint];
+        }
+
+        void HandleListAssistants(const web::http::http_request& Request)
+        {
+            auto JData = web::json::value::array();
+            {
+                std::lock_guard<std::mutex> Lock(m_Mutex);
+                for (const auto& ASSISTANT_ID : m_AssistantIDs)
+                {
+                    JData[JData.size()] = JsonObject({{"id", ASSISTANT_ID}, {"object", "assistant"}});
+                }
+            }
+
+            auto JResponse       = JsonObject({{"object", "list"}});
+            JResponse[U("data")] = JData;
+            ReplyJsonLater(Request, JResponse);
+        }
+
+        void HandleCreateAssistant(const web::http::http_request& Request)
+        {
+            const auto ASSISTANT_ID = GenerateID("asst_");
+            {
+                std::lock_guard<std::mutex> Lock(m_Mutex);
+                m_AssistantIDs.insert(ASSISTANT_ID);
+            }
+            ReplyJsonLater(Request, JsonObject({{"id", ASSISTANT_ID}, {"object", "assistant"}}));
+        }
+
+        void HandleChatCompletions(const web::http::http_request& Request)
+        {
+            Request.extract_json().then(
+                [this, Request](const pplx::task<web::json::value>& ExtractJsonTask)
+                {
+                    // Answer with the last message, which is what Orion asks to be rewritten (its instructions)
+                    std::string Content = "OK";
+                    try
+                    {
+                        const auto JMESSAGES = ExtractJsonTask.get().at(U("messages")).as_array();
+                        if (JMESSAGES.size() > 0)
+                        {
+                            Content = JMESSAGES.at(JMESSAGES.size() - 1).at(U("content")).as_string();
+                        }
+                    }
+                    catch (const std::exception&)
+                    {
+                    }
+
+                    auto JMessage         = JsonObject({{"role", "assistant"}, {"content", Content}});
+                    auto JChoice          = JsonObject({{"finish_reason", "stop"}});
+                    JChoice[U("index")]   = 0;
+                    JChoice[U("message")] = JMessage;
+
+                    auto JResponse          = JsonObject({{"id", GenerateID("chatcmpl-")}, {"object", "chat.completion"}});
+                    JResponse[U("choices")] = web::json::value::array({JChoice});
+                    ReplyJsonLater(Request, JResponse);
+                });
+        }
+
+        void HandleEmbeddings(const web::http::http_request& Request)
+        {
+            Request.extract_json().then(
+                [this, Request](const pplx::task<web::json::value>& ExtractJsonTask)
+                {
+                    std::vector<std::string> Inputs;
+                    try
+                    {
+                        const auto JINPUT = ExtractJsonTask.get().at(U("input"));
+                        if (JINPUT.is_string())
+                        {
+                            Inputs.push_back(JINPUT.as_string());
+                        }
+                        else
+                        {
+                            for (const auto& JItem : JINPUT.as_array())
+                            {
+                                Inputs.push_back(JItem.as_string());
+                            }
+                        }
+                    }
+                    catch (const std::exception&)
+                    {
+                    }
+
+                    // The same text always gets the same vector, so similarity checks are stable between runs
+                    auto JData = web::json::value::array();
+                    for (size_t Index = 0; Index < Inputs.size(); ++Index)
+                    {
+                        std::mt19937                           Generator(static_cast<uint32_t>(std::hash<std::string> {}(Inputs[Index])));
+                        std::uniform_real_distribution<double> Distribution(-1.0, 1.0);
+
+                        auto JEmbedding = web::json::value::array(m_Options.EmbeddingDimensions);
+                        for (size_t Dimension = 0; Dimension < m_Options.EmbeddingDimensions; ++Dimension)
+                        {
+                            JEmbedding[Dimension] = Distribution(Generator);
+                        }
+
+                        auto JItem            = JsonObject({{"object", "embedding"}});
+                        JItem[U("index")]     = static_cast<int>(Index);
+                        JItem[U("embedding")] = JEmbedding;
+                        JData[Index]          = JItem;
+                    }
+
+                    auto JResponse       = JsonObject({{"object", "list"}, {"model", "text-embedding-3-small"}});
+                    JResponse[U("data")] = JData;
+                    ReplyJsonLater(Request, JResponse);
+                });
+        }
+
+        void HandleCreateThread(const web::http::http_request& Request)
+        {
+            const auto THREAD_ID = GenerateID("thread_");
+            {
+                std::lock_guard<std::mutex> Lock(m_Mutex);
+                m_Threads[THREAD_ID];
+            }
+            ReplyJsonLater(Request, JsonObject({{"id", THREAD_ID}, {"object", "thread"}}));
+        }
+
+        void HandleCreateMessage(const web::http::http_request& Request, const std::string& ThreadID)
+        {
+            Request.extract_json().then(
+                [this, Request, ThreadID](const pplx::task<web::json::value>& ExtractJsonTask)
+                {
+                    std::string Text;
+                    try
+                    {
+                        const auto JCONTENT = ExtractJsonTask.get().at(U("content"));
+                        Text                = JCONTENT.is_string() ? JCONTENT.as_string() : JCONTENT.serialize();
+                    }
+                    catch (const std::exception&)
+                    {
+                    }
+
+                    const auto MESSAGE_ID = GenerateID("msg_");
+                    {
+                        std::lock_guard<std::mutex> Lock(m_Mutex);
+                        m_Threads[ThreadID].push_back({MESSAGE_ID, "user", Text});
+                    }
+                    ReplyJsonLater(Request, JsonObject({{"id", MESSAGE_ID}, {"object", "thread.message"}, {"thread_id", ThreadID}, {"role", "user"}}));
+                });
+        }
+
+        void HandleListMessages(const web::http::http_request& Request, const std::string& ThreadID)
+        {
+            auto JData = web::json::value::array();
+            {
+                std::lock_guard<std::mutex> Lock(m_Mutex);
+                if (const auto THREAD_ITER = m_Threads.find(ThreadID); THREAD_ITER != m_Threads.end())
+                {
+                    for (const auto& MESSAGE : THREAD_ITER->second)
+                    {
+                        auto JMessage          = JsonObject({{"id", MESSAGE.ID}, {"object", "thread.message"}, {"role", MESSAGE.Role}});
+                        JMessage[U("content")] = web::json::value::array({TextContent(MESSAGE.Text)});
+                        JData[JData.size()]    = JMessage;
+                    }
+                }
+            }
+
+            auto JResponse       = JsonObject({{"object", "list"}});
+            JResponse[U("data")] = JData;
+            ReplyJsonLater(Request, JResponse);
+        }
+
+        void HandleCreateRun(const web::http::http_request& Request, const std::string& ThreadID)
+        {
+            const auto RUN_ID = GenerateID("run_");
+            auto       pRun   = std::make_shared<Run>();
+            pRun->ThreadID    = ThreadID;
+            {
+                std::lock_guard<std::mutex> Lock(m_Mutex);
+                m_Runs[RUN_ID] = pRun;
+            }
+
+            const bool IS_TOOL_CALL = [this]
+            {
+                std::lock_guard<std::mutex> Lock(m_Mutex);
+                return std::uniform_real_distribution<double>(0.0, 1.0)(m_Random) < m_Options.ToolCallRate;
+            }();
+
+            StreamRun(Request, RUN_ID, pRun, IS_TOOL_CALL ? BuildToolCallEvents(RUN_ID, ThreadID) : BuildReplyEvents(RUN_ID, ThreadID));
+        }
+
+        void HandleSubmitToolOutputs(const web::http::http_request& Request, const std::string& ThreadID, const std::string& RunID)
+        {
+            std::shared_ptr<Run> pRun;
+            {
+                std::lock_guard<std::mutex> Lock(m_Mutex);
+                if (const auto RUN_ITER = m_Runs.find(RunID); RUN_ITER != m_Runs.end())
+                {
+                    pRun = RUN_ITER->second;
+                }
+            }
+            if (!pRun)
+            {
+                Request.reply(web::http::status_codes::NotFound, JsonObject({{"error", "No run " + RunID}}));
+                return;
+            }
+
+            // The stream of a tool call ends when the tool is called; the reply comes on the stream of the submission
+            auto Events = BuildReplyEvents(RunID, ThreadID);
+            Events.insert(Events.begin(), StreamEvent {m_Options.ResponseDelay, "thread.run.in_progress",
+                                                       JsonObject({{"id", RunID}, {"object", "thread.run"}, {"status", "in_progress"}}).serialize()});
+            StreamRun(Request, RunID, pRun, std::move(Events));
+        }
+
+        void HandleCancelRun(const web::http::http_request& Request, const std::string& RunID)
+        {
+            std::shared_ptr<Run> pRun;
+            {
+                std::lock_guard<std::mutex> Lock(m_Mutex);
+                if (const auto RUN_ITER = m_Runs.find(RunID); RUN_ITER != m_Runs.end())
+                {
+                    pRun = RUN_ITER->second;
+                }
+            }
+            if (pRun)
+            {
+                pRun->IsCancelled = true;
+            }
+            ReplyJsonLater(Request, JsonObject({{"id", RunID}, {"object", "thread.run"}, {"status", "cancelling"}}));
+        }
+
+        void HandleSpeech(const web::http::http_request& Request)
+        {
+            const auto SPEECH_BYTES = m_Options.SpeechBytes;
+            m_Timers.Schedule(m_Options.ResponseDelay,
+                              [Request, SPEECH_BYTES]
+                              {
+                                  web::http::http_response Response(web::http::status_codes::OK);
+                                  Response.set_body(std::vector<unsigned char>(SPEECH_BYTES, 0));
+                                  Response.headers().set_content_type(U("audio/mpeg"));
+                                  Request.reply(Response);
+                              });
+        }
+
+        void HandleUploadFile(const web::http::http_request& Request)
+        {
+            Request.extract_vector().then(
+                [this, Request](const pplx::task<std::vector<unsigned char>>& ExtractTask)
+                {
+                    size_t Bytes = 0;
+                    try
+                    {
+                        Bytes = ExtractTask.get().size();
+                    }
+                    catch (const std::exception&)
+                    {
+                    }
+
+                    auto JResponse        = JsonObject({{"id", GenerateID("file-")}, {"object", "file"}, {"purpose", "assistants"}});
+                    JResponse[U("bytes")] = static_cast<int64_t>(Bytes);
+                    ReplyJsonLater(Request, JResponse);
+                });
+        }
+
+        /// @brief  The events of a run that replies with a message
+        std::vector<StreamEvent> BuildReplyEvents(const std::string& RunID, const std::string& ThreadID)
+        {
+            const auto MESSAGE_ID  = GenerateID("msg_");
+            const auto TOKEN_DELAY = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / m_Options.TokensPerSecond));
+
+            const auto JRUN        = JsonObject({{"id", RunID}, {"object", "thread.run"}, {"thread_id", ThreadID}, {"status", "in_progress"}});
+            auto       JMessage    = JsonObject({{"id", MESSAGE_ID}, {"object", "thread.message"}, {"thread_id", ThreadID}, {"role", "assistant"}});
+            JMessage[U("content")] = web::json::value::array();
+
+            std::vector<StreamEvent> Events;
+            Events.push_back({m_Options.ResponseDelay, "thread.run.created", JRUN.serialize()});
+            Events.push_back({{}, "thread.message.created", JMessage.serialize()});
+            Events.push_back({{}, "thread.message.in_progress", JMessage.serialize()});
+
+            std::string Text;
+            for (size_t Index = 0; Index < m_Options.TokensPerReply; ++Index)
+            {
+                const std::string TOKEN = (Index == 0 ? "Token" : " token") + std::to_string(Index);
+                Text += TOKEN;
+
+                auto JDelta                         = web::json::value::object();
+                JDelta[U("content")]                = web::json::value::array({TextContent(TOKEN)});
+                JDelta[U("content")][0][U("index")] = 0;
+
+                auto JMessageDelta        = JsonObject({{"id", MESSAGE_ID}, {"object", "thread.message.delta"}});
+                JMessageDelta[U("delta")] = JDelta;
+
+                Events.push_back({Index == 0 ? std::chrono::steady_clock::duration(m_Options.FirstTokenDelay) : TOKEN_DELAY, "thread.message.delta", JMessageDelta.serialize()});
+            }
+
+            JMessage[U("content")] = web::json::value::array({TextContent(Text)});
+            Events.push_back({TOKEN_DELAY, "thread.message.completed", JMessage.serialize()});
+            Events.push_back({{}, "thread.run.completed", JsonObject({{"id", RunID}, {"object", "thread.run"}, {"thread_id", ThreadID}, {"status", "completed"}}).serialize()});
+
+            {
+                std::lock_guard<std::mutex> Lock(m_Mutex);
+                m_Threads[ThreadID].push_back({MESSAGE_ID, "assistant", Text});
+            }
+            return Events;
+        }
+
+        /// @brief  The events of a run that calls a tool (the run waits for the outputs of the call)
+        std::vector<StreamEvent> BuildToolCallEvents(const std::string& RunID, const std::string& ThreadID)
+        {
+            const auto CALL_ID = GenerateID("call_");
+            const auto STEP_ID = GenerateID("step_");
+
+            auto JFunction                = JsonObject({{"name", m_Options.ToolName}, {"arguments", m_Options.ToolArguments}});
+            auto JToolCall                = JsonObject({{"id", CALL_ID}, {"type", "function"}});
+            JToolCall[U("function")]      = JFunction;
+            auto JStepDetails             = JsonObject({{"type", "tool_calls"}});
+            JStepDetails[U("tool_calls")] = web::json::value::array({JToolCall});
+
+            auto JStep               = JsonObject({{"id", STEP_ID}, {"object", "thread.run.step"}, {"run_id", RunID}, {"type", "tool_calls"}});
+            JStep[U("step_details")] = JStepDetails;
+
+            auto JStepDelta               = web::json::value::object();
+            JStepDelta[U("step_details")] = JStepDetails;
+            auto JStepDeltaEvent          = JsonObject({{"id", STEP_ID}, {"object", "thread.run.step.delta"}});
+            JStepDeltaEvent[U("delta")]   = JStepDelta;
+
+            auto JSubmitToolOutputs                   = web::json::value::object();
+            JSubmitToolOutputs[U("tool_calls")]       = web::json::value::array({JToolCall});
+            auto JRequiredAction                      = JsonObject({{"type", "submit_tool_outputs"}});
+            JRequiredAction[U("submit_tool_outputs")] = JSubmitToolOutputs;
+            auto JRun                                 = JsonObject({{"id", RunID}, {"object", "thread.run"}, {"thread_id", ThreadID}, {"status", "requires_action"}});
+            JRun[U("required_action")]                = JRequiredAction;
+
+            std::vector<StreamEvent> Events;
+            Events.push_back({m_Options.ResponseDelay, "thread.run.created",
+                              JsonObject({{"id", RunID}, {"object", "thread.run"}, {"thread_id", ThreadID}, {"status", "queued"}}).serialize()});
+            Events.push_back({m_Options.FirstTokenDelay, "thread.run.step.created", JStep.serialize()});
+            Events.push_back({{}, "thread.run.step.delta", JStepDeltaEvent.serialize()});
+            Events.push_back({{}, "thread.run.requires_action", JRun.serialize()});
+            return Events;
+        }
+
+        /// @brief  Reply with a Server-Sent Event stream and send its events on time. The stream ends with the done event, early if the run
+        ///         is cancelled
+        void StreamRun(const web::http::http_request& Request, const std::string& RunID, const std::shared_ptr<Run>& pRun, std::vector<StreamEvent> Events)
+        {
+            concurrency::streams::producer_consumer_buffer<uint8_t> Buffer;
+
+            web::http::http_response Response(web::http::status_codes::OK);
+            Response.headers().add(U("Cache-Control"), U("no-cache"));
+            Response.set_body(Buffer.create_istream(), U("text/event-stream"));
+            Request.reply(Response);
+
+            auto pEvents = std::make_shared<std::vector<StreamEvent>>(std::move(Events));
+            SendStreamEvent(Buffer, pRun, pEvents, 0, RunID);
+        }
+
+        /// @brief  Schedule the event of a stream at an index, which schedules the next one once it is sent
+        void SendStreamEvent(concurrency::streams::producer_consumer_buffer<uint8_t> Buffer,
+                             std::shared_ptr<Run>                                    pRun,
+                             std::shared_ptr<std::vector<StreamEvent>>               pEvents,
+                             const size_t                                            INDEX,
+                             const std::string&                                      RunID)
+        {
+            const bool IS_DONE = INDEX >= pEvents->size() || pRun->IsCancelled;
+            const auto DELAY   = IS_DONE ? std::chrono::steady_clock::duration::zero() : (*pEvents)[INDEX].Delay;
+
+            m_Timers.Schedule(DELAY,
+                              [this, Buffer, pRun, pEvents, INDEX, IS_DONE, RunID]() mutable
+                              {
+                                  if (IS_DONE)
+                                  {
+                                      if (pRun->IsCancelled)
+                                      {
+                                          WriteEvent(Buffer, "thread.run.cancelled", JsonObject({{"id", RunID}, {"object", "thread.run"}, {"status", "cancelled"}}).serialize());
+                                      }
+                                      WriteEvent(Buffer, "done", "[DONE]");
+                                      Buffer.close(std::ios_base::out);
+                                      return;
+                                  }
+
+                                  const auto& EVENT = (*pEvents)[INDEX];
+                                  WriteEvent(Buffer, EVENT.Name, EVENT.Data);
+                                  SendStreamEvent(Buffer, pRun, pEvents, INDEX + 1, RunID);
+                              });
+        }
+
+        /// @brief  Write a Server-Sent Event to a stream
+        static void WriteEvent(concurrency::streams::producer_consumer_buffer<uint8_t>& Buffer, const std::string& Name, const std::string& Data)
+        {
+            const std::string PAYLOAD = "event: " + Name + "\ndata: " + Data + "\n\n";
+            Buffer.putn_nocopy(reinterpret_cast<const uint8_t*>(PAYLOAD.data()), PAYLOAD.size()).wait();
+            Buffer.sync().wait();
+        }
+
+        /// @brief  Reply with JSON once the response delay has passed
+        void ReplyJsonLater(const web::http::http_request& Request, web::json::value JResponse)
+        {
+            m_Timers.Schedule(m_Options.ResponseDelay, [Request, JResponse = std::move(JResponse)] { Request.reply(web::http::status_codes::OK, JResponse); });
+        }
+
+        /// @brief  Generate an id with the prefix the API uses for the kind of object
+        std::string GenerateID(const std::string& Prefix)
+        {
+            std::ostringstream ID;
+            ID << Prefix << std::hex << m_NextID.fetch_add(1);
+            return ID.str();
+        }
+
+        /// @brief  Create a JSON object of string fields
+        static web::json::value JsonObject(std::initializer_list<std::pair<std::string, std::string>> Fields)
+        {
+            auto JObject = web::json::value::object();
+            for (const auto& [KEY, VALUE] : Fields)
+            {
+                JObject[KEY] = web::json::value::string(VALUE);
+            }
+            return JObject;
+        }
+
+        /// @brief  Create the text content item of a message
+        static web::json::value TextContent(const std::string& Text)
+        {
+            auto JText              = web::json::value::object();
+            JText[U("value")]       = web::json::value::string(Text);
+            JText[U("annotations")] = web::json::value::array();
+            auto JContent           = JsonObject({{"type", "text"}});
+            JContent[U("text")]     = JText;
+            return JContent;
+        }
+
+        StubOptions m_Options;
+
+        web::http::experimental::listener::http_listener m_Listener;
+
+        /// @brief  Times the responses and stream events
+        ORION::TimerQueue m_Timers;
+
+        /// @brief  The objects created through the API
+        std::set<std::string>                                   m_AssistantIDs;
+        std::map<std::string, std::vector<Message>>             m_Threads;
+        std::map<std::string, std::shared_ptr<Run>>             m_Runs;
+        std::map<std::string, uint64_t>                         m_RequestCounts;
+        std::atomic<uint64_t>                                   m_NextID = 1;
+        std::mt19937                                            m_Random {std::random_device {}()};
+        mutable std::mutex                                      m_Mutex;
+    };
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    StubOptions Options;
+    for (int ArgIndex = 1; ArgIndex < argc; ++ArgIndex)
+    {
+        const std::string ARGUMENT = argv[ArgIndex];
+        if (ARGUMENT == "--help" || ARGUMENT == "-h")
+        {
+            std::cout << GetUsage(argv[0]);
+            return 0;
+        }
+
+        const auto SETTING_ITER = std::find_if(GetSettings().begin(), GetSettings().end(), [&ARGUMENT](const Setting& S) { return "--" + std::string(S.Name) == ARGUMENT; });
+        if (SETTING_ITER == GetSettings().end() || ArgIndex + 1 >= argc)
+        {
+            std::cerr << (SETTING_ITER == GetSettings().end() ? "Unknown option " : "Missing the value of ") << ARGUMENT << std::endl << std::endl << GetUsage(argv[0]);
+            return 1;
+        }
+        if (!SETTING_ITER->Apply(Options, argv[++ArgIndex]))
+        {
+            std::cerr << "Invalid value '" << argv[ArgIndex] << "' for " << ARGUMENT << std::endl;
+            return 1;
+        }
+    }
+
+    // Block SIGTERM and SIGINT before any thread is started, so they are only delivered to the sigwait below
+    sigset_t StopSignals;
+    sigemptyset(&StopSignals);
+    sigaddset(&StopSignals, SIGTERM);
+    sigaddset(&StopSignals, SIGINT);
+    pthread_sigmask(SIG_BLOCK, &StopSignals, nullptr);
+
+    OpenAIStub Stub(Options);
+    if (!Stub.Start())
+    {
+        return 1;
+    }
+    std::cout << "OpenAI stand-in listening on " << Options.ListenURL << " (" << Options.TokensPerSecond << " tokens/s, " << Options.TokensPerReply
+              << " tokens per reply, tool call rate " << Options.ToolCallRate << ")" << std::endl;
+
+    int Signal = 0;
+    sigwait(&StopSignals, &Signal);
+
+    Stub.Stop();
+    std::cout << "Requests served:" << std::endl;
+    Stub.PrintRequestCounts();
+    return 0;
+}
@@ -1,4 +1,5 @@
 #include "CreateAutonomousActionPlanFunctionTool.hpp"
+#include "Logger.hpp"
 #include "Orion.hpp"
 
 using namespace ORION;
@@ -13,7 +14,7 @@ std::string CreateAutonomousActionPlanFunctionTool::Execute(Orion& Orion, const
 
         if (!Parameters.has_field(NAME_PLAN_STEPS.data()))
         {
-            std::cout << __func__ << ": The plan_steps are required" << std::endl;
+            Log::Warning("plugins.autonomy", "The plan_steps are required");
 
             auto Response                                                   = web::json::value::object();
             Response[FunctionReturnResults::NAME_ORION_INSTRUCTIONS.data()] = web::json::value::string("The plan_steps are required");
@@ -32,7 +33,7 @@ std::string CreateAutonomousActionPlanFunctionTool::Execute(Orion& Orion, const
     }
     catch (const std::exception& Exception)
     {
-        std::cout << "Failed to change the voice: " << Exception.what() << std::endl;
+        Log::Error("plugins.autonomy", "Failed to create the action plan", {{"error", Exception.what()}});
 
         auto ErrorObject                                       = web::json::value::object();
         ErrorObject[FunctionReturnResults::NAME_RESULT.data()] = web::json::value::string("Error: " + std::string(Exception.what()));
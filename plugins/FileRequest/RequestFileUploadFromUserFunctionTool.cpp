@@ -1,3 +1,4 @@
+#include "Logger.hpp"
 #include "Orion.hpp"
 #include "OrionWebServer.hpp"
 #include "RequestFileUploadFromUserFunctionTool.hpp"
@@ -10,7 +11,10 @@ using FunctionResults = FunctionTool::Statics::FunctionResults;
 
 std::string RequestFileUploadFromUserFunctionTool::Execute(Orion& Orion, const web::json::value& Parameters)
 {
-    std::cout << std::endl << __func__ << ": " << Parameters.serialize() << std::endl;
+    if (Log::Logger::Get().IsEnabled(Log::ELevel::Debug, "plugins.file_request"))
+    {
+        Log::Debug("plugins.file_request", "Requesting a file upload", {{"parameters", Parameters.serialize()}});
+    }
 
     // Get the file path from the parameters
     std::string FilePath = Parameters.has_field(U("file_path")) ? Parameters.at(U("file_path")).as_string() : "";
@@ -48,7 +52,7 @@ std::string RequestFileUploadFromUserFunctionTool::Execute(Orion& Orion, const w
     // Send an SSE event to the client to upload the file.
     web::json::value EventObject = web::json::value::object();
     EventObject[U("file_path")]  = web::json::value::string(FilePath);
-    Orion.GetWebServer().SendServerEvent(U(OrionWebServer::SSEOrionEventNames::UPLOAD_FILE_REQUESTED), EventObject);
+    Orion.GetWebServer().SendServerEvent(Orion.GetUserID(), U(OrionWebServer::SSEOrionEventNames::UPLOAD_FILE_REQUESTED), EventObject);
 
     // Tell Orion that the user is about to upload a file and to wait for the file to be uploaded.
     web::json::value ResponseObject                     = web::json::value::object();
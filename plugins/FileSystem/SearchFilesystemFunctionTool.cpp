@@ -1,4 +1,5 @@
 #include "SearchFilesystemFunctionTool.hpp"
+#include "Logger.hpp"
 #include "Orion.hpp"
 
 #include <filesystem>
@@ -22,7 +23,7 @@ std::string SearchFilesystemFunctionTool::Execute(Orion& Orion, const web::json:
         // Check if directory exists
         if (!std::filesystem::exists(SearchDirectory))
         {
-            std::cerr << "Directory does not exist: " << SearchDirectory << std::endl;
+            Log::Warning("plugins.filesystem", "Directory does not exist", {{"directory", SearchDirectory.string()}});
             return std::string(R"({"message": "Directory does not exist"})");
         }
 
@@ -88,13 +89,13 @@ std::string SearchFilesystemFunctionTool::Execute(Orion& Orion, const web::json:
         }
         else
         {
-            std::cerr << "No file name provided" << std::endl;
+            Log::Warning("plugins.filesystem", "No file name provided");
             return std::string(R"({"message": "No file name provided"})");
         }
     }
     catch (const std::exception& Exception)
     {
-        std::cerr << Exception.what() << '\n';
+        Log::Error("plugins.filesystem", "Failed to search the filesystem", {{"error", Exception.what()}});
         return std::string(R"({"message": "Failed to search the filesystem: )") + Exception.what() + R"("})";
     }
 }
\ No newline at end of file
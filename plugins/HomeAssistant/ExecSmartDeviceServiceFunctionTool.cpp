@@ -1,4 +1,5 @@
 #include "ExecSmartDeviceServiceFunctionTool.hpp"
+#include "Logger.hpp"
 #include "Orion.hpp"
 
 using namespace ORION;
@@ -15,7 +16,7 @@ std::string ExecSmartDeviceServiceFunctionTool::Execute(Orion& Orion, const web:
     }
     catch (const std::exception& Exception)
     {
-        std::cerr << "Failed to execute the smart device service function: " << Exception.what() << std::endl;
+        Log::Error("plugins.home_assistant", "Failed to execute the smart device service function", {{"error", Exception.what()}});
         return std::string(R"({"message": "Failed to execute the smart device service function: )") + Exception.what() + "\"}";
     }
 }
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "ListSmartDevicesFunctionTool.hpp"
+#include "Logger.hpp"
 #include "Orion.hpp"
 
 using namespace ORION;
@@ -14,7 +15,7 @@ std::string ListSmartDevicesFunctionTool::Execute(Orion& Orion, const web::json:
     }
     catch (const std::exception& Exception)
     {
-        std::cerr << "Failed to list the smart devices: " << Exception.what() << std::endl;
+        Log::Error("plugins.home_assistant", "Failed to list the smart devices", {{"error", Exception.what()}});
         return std::string(R"({"message": "Failed to list the smart devices: )") + Exception.what() + R"("})";
     }
 }
\ No newline at end of file
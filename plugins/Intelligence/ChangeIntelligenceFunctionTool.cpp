@@ -1,4 +1,5 @@
 #include "ChangeIntelligenceFunctionTool.hpp"
+#include "Logger.hpp"
 #include "Orion.hpp"
 
 using namespace ORION;
@@ -49,7 +50,7 @@ std::string ChangeIntelligenceFunctionTool::Execute(Orion& Orion, const web::jso
             }
             else
             {
-                std::cout << __func__ << ": Unknown intelligence: " << INTELLIGENCE << std::endl;
+                Log::Warning("plugins.intelligence", "Unknown intelligence", {{"intelligence", INTELLIGENCE}});
 
                 auto JFunctionResult                                 = web::json::value::object();
                 JFunctionResult[FunctionResults::NAME_RESULT.data()] = web::json::value::string("Unknown intelligence: " + INTELLIGENCE);
@@ -60,7 +61,7 @@ std::string ChangeIntelligenceFunctionTool::Execute(Orion& Orion, const web::jso
     }
     catch (const std::exception& Exception)
     {
-        std::cout << __func__ << ": Failed to change the intelligence: " << Exception.what() << std::endl;
+        Log::Error("plugins.intelligence", "Failed to change the intelligence", {{"error", Exception.what()}});
 
         auto JFunctionResult                                 = web::json::value::object();
         JFunctionResult[FunctionResults::NAME_RESULT.data()] = web::json::value::string("Failed to change the intelligence: " + std::string(Exception.what()));
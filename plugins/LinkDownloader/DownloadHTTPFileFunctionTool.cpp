@@ -1,4 +1,5 @@
 #include "DownloadHTTPFileFunctionTool.hpp"
+#include "Logger.hpp"
 #include "Orion.hpp"
 
 #include <filesystem>
@@ -9,7 +10,10 @@ using FunctionResultStatics = FunctionTool::Statics::FunctionResults;
 
 std::string DownloadHTTPFileFunctionTool::Execute(Orion& Orion, const web::json::value& Parameters)
 {
-    std::cout << std::endl << "DownloadHTTPFileFunctionTool::Execute: " << Parameters.serialize() << std::endl;
+    if (Log::Logger::Get().IsEnabled(Log::ELevel::Debug, "plugins.link_downloader"))
+    {
+        Log::Debug("plugins.link_downloader", "Downloading a file", {{"parameters", Parameters.serialize()}});
+    }
 
     // Get the file name from the link
     std::string FileName = Parameters.at(U("link")).as_string();
@@ -49,10 +53,15 @@ std::string DownloadHTTPFileFunctionTool::Execute(Orion& Orion, const web::json:
         std::filesystem::create_directories(DOWNLOAD_PATH.parent_path());
     }
 
-    // Save the file stream to the file
-    std::ofstream File(DOWNLOAD_PATH, std::ios::binary);
+    // Save the file stream to a temporary file, then replace the file. Large downloads are served from a memory mapping, which must not
+    // see the file being truncated under it
+    auto TemporaryPath = DOWNLOAD_PATH;
+    TemporaryPath += ".part";
+
+    std::ofstream File(TemporaryPath, std::ios::binary);
     File.write(reinterpret_cast<const char*>(DOWNLOAD_FILE_LINK_RESPONSE_VECTOR.data()), DOWNLOAD_FILE_LINK_RESPONSE_VECTOR.size());
     File.close();
+    std::filesystem::rename(TemporaryPath, DOWNLOAD_PATH);
 
     auto Response = web::json::value::object();
     Response[FunctionResultStatics::NAME_ORION_INSTRUCTIONS.data()] =
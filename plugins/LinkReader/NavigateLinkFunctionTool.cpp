@@ -1,4 +1,5 @@
 #include "NavigateLinkFunctionTool.hpp"
+#include "Logger.hpp"
 #include "MimeTypes.hpp"
 #include "Orion.hpp"
 
@@ -13,7 +14,7 @@ using FunctionResultStatics = FunctionTool::Statics::FunctionResults;
 
 std::string NavigateLinkFunctionTool::Execute(Orion& Orion, const web::json::value& Parameters)
 {
-    std::cout << "NavigateLinkFunctionTool::Execute: " << Parameters.at("link").as_string() << std::endl;
+    Log::Info("plugins.link_reader", "Navigating to a link", {{"link", Parameters.at("link").as_string()}});
 
     // Check if link is a file
     if (MimeTypes::GetMimeType(Parameters.at("link").as_string()) != "application/octet-stream")
@@ -45,7 +46,7 @@ std::string NavigateLinkFunctionTool::Execute(Orion& Orion, const web::json::val
         ErrorObject[FunctionResultStatics::NAME_RESULT.data()]             = web::json::value::string("The content of the link is not html");
         ErrorObject[FunctionResultStatics::NAME_ORION_INSTRUCTIONS.data()] = web::json::value::string("The content of the link is not html. Try a different link.");
 
-        std::cout << std::endl << "NavigateLinkFunctionTool::Execute: " << ErrorObject.serialize() << std::endl;
+        Log::Warning("plugins.link_reader", "The content of the link is not html");
 
         return ErrorObject.serialize();
     }
@@ -167,7 +168,11 @@ std::string NavigateLinkFunctionTool::Execute(Orion& Orion, const web::json::val
                 NavigateLinkResult[FunctionResultStatics::NAME_USER_QUERY.data()] = Parameters.at(FunctionResultStatics::NAME_USER_QUERY.data());
                 NavigateLinkResult[FunctionResultStatics::NAME_RESULT.data()]     = web::json::value::string(Content);
 
-                std::cout << std::endl << "NavigateLinkFunctionTool::Execute: " << NavigateLinkResult.serialize() << std::endl;
+                // The result holds the whole page; serialize it only when it is logged
+                if (Log::Logger::Get().IsEnabled(Log::ELevel::Debug, "plugins.link_reader"))
+                {
+                    Log::Debug("plugins.link_reader", "Read the link", {{"result", NavigateLinkResult.serialize()}});
+                }
 
                 return NavigateLinkResult.serialize();
             }
@@ -183,7 +188,11 @@ std::string NavigateLinkFunctionTool::Execute(Orion& Orion, const web::json::val
 
         NavigateLinkResult[FunctionResultStatics::NAME_USER_QUERY.data()] = Parameters.at(FunctionResultStatics::NAME_USER_QUERY.data());
 
-        std::cout << std::endl << "NavigateLinkFunctionTool::Execute: " << NavigateLinkResult.serialize() << std::endl;
+        // The result holds the whole page; serialize it only when it is logged
+        if (Log::Logger::Get().IsEnabled(Log::ELevel::Debug, "plugins.link_reader"))
+        {
+            Log::Debug("plugins.link_reader", "Read the link", {{"result", NavigateLinkResult.serialize()}});
+        }
 
         return NavigateLinkResult.serialize();
     }
@@ -1,5 +1,6 @@
 #include "RecallKnowledgeFunctionTool.hpp"
 #include "Knowledge.hpp"
+#include "Logger.hpp"
 #include "Orion.hpp"
 #include "OrionWebServer.hpp"
 
@@ -166,8 +167,11 @@ std::string RecallKnowledgeFunctionTool::Execute(Orion& Orion, const web::json::
                                        "sufficient, try to gather more information from the user to help them better. Make sure the knowledge is "
                                        "interpreted in the correct context."));
 
-        // Log the recalled memories
-        std::cout << std::endl << std::endl << "Recalled Memories: " << std::endl << JSearchResults.serialize() << std::endl << std::endl;
+        // Log the recalled memories (serializing them is only worth it when they are logged)
+        if (Log::Logger::Get().IsEnabled(Log::ELevel::Debug, "plugins.memory"))
+        {
+            Log::Debug("plugins.memory", "Recalled memories", {{"memories", JSearchResults.serialize()}});
+        }
 
         return JSearchResults.serialize();
     }
@@ -1,4 +1,5 @@
 #include "ChangeVoiceFunctionTool.hpp"
+#include "Logger.hpp"
 #include "Orion.hpp"
 
 using namespace ORION;
@@ -57,13 +58,13 @@ std::string ChangeVoiceFunctionTool::Execute(Orion& Orion, const web::json::valu
         }
         else
         {
-            std::cerr << "Unknown voice: " << VOICE << std::endl;
+            Log::Warning("plugins.voices", "Unknown voice", {{"voice", VOICE}});
             return std::string(R"({"message": "Unknown voice"})");
         }
     }
     catch (const std::exception& Exception)
     {
-        std::cerr << "Failed to change the voice: " << Exception.what() << std::endl;
+        Log::Error("plugins.voices", "Failed to change the voice", {{"error", Exception.what()}});
         return std::string(R"({"message": "Failed to change the voice: )") + Exception.what() + R"("})";
     }
 }
\ No newline at end of file
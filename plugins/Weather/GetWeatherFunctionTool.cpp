@@ -1,4 +1,5 @@
 #include "GetWeatherFunctionTool.hpp"
+#include "Logger.hpp"
 #include "Orion.hpp"
 
 using namespace ORION;
@@ -19,8 +20,8 @@ std::string GetWeatherFunctionTool::Execute(Orion& Orion, const web::json::value
         Location = Parameters.at("location").as_string();
     }
 
-    // Create a new http_client to send the request
-    web::http::client::http_client OpenWeatherMapClient(U("https://api.openweathermap.org/data/2.5/"));
+    // Get the shared client of the OpenWeatherMap api
+    const auto pOpenWeatherMapClient = Orion.GetHttpClient(U("https://api.openweathermap.org/data/2.5/"), "openweathermap");
 
     // Create a new http_request to get the weather
     web::http::http_request GetWeatherRequest(web::http::methods::GET);
@@ -38,7 +39,7 @@ std::string GetWeatherFunctionTool::Execute(Orion& Orion, const web::json::value
 
     // Send the request and get the response
 
-    if (const web::http::http_response GET_WEATHER_RESPONSE = OpenWeatherMapClient.request(GetWeatherRequest).get();
+    if (const web::http::http_response GET_WEATHER_RESPONSE = pOpenWeatherMapClient->request(GetWeatherRequest).get();
         GET_WEATHER_RESPONSE.status_code() == web::http::status_codes::OK)
     {
         const web::json::value RESPONSE_DATA_JSON = GET_WEATHER_RESPONSE.extract_json().get();
@@ -46,8 +47,7 @@ std::string GetWeatherFunctionTool::Execute(Orion& Orion, const web::json::value
     }
     else
     {
-        std::cerr << "Failed to get the weather" << std::endl;
-        std::cout << GET_WEATHER_RESPONSE.to_string() << std::endl;
+        Log::Error("plugins.weather", "Failed to get the weather", {{"response", GET_WEATHER_RESPONSE.to_string()}});
         return std::string(R"({"message": "Failed to get the weather. )" + GET_WEATHER_RESPONSE.to_string() + R"("})");
     }
 }
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "WebSearchFunctionTool.hpp"
+#include "Logger.hpp"
 #include "Orion.hpp"
 
 using namespace ORION;
@@ -7,11 +8,11 @@ using FunctionResultStatics = FunctionTool::Statics::FunctionResults;
 
 std::string WebSearchFunctionTool::Execute(Orion& Orion, const web::json::value& Parameters)
 {
-    std::cout << "WebSearchFunctionTool::Execute: " << Parameters.at(U("query")).as_string() << std::endl;
+    Log::Info("plugins.web_search", "Searching the web", {{"query", Parameters.at(U("query")).as_string()}});
 
-    // Create the http_client to send the request.  We use googles custom search api
-    web::http::client::http_client SearchClient(U("https://www.googleapis.com"));
-    web::http::uri_builder         SearchURIBuilder(U("customsearch/v1"));
+    // Get the shared client to send the request.  We use googles custom search api
+    const auto             pSearchClient = Orion.GetHttpClient(U("https://www.googleapis.com"), "google_search");
+    web::http::uri_builder SearchURIBuilder(U("customsearch/v1"));
     SearchURIBuilder.append_query(U("key"), U(Orion.GetGoogleAPIKey()));
     SearchURIBuilder.append_query(U("q"), Parameters.at(U("query")).as_string());
     SearchURIBuilder.append_query(U("cx"), U(Orion.GetGoogleCustomSearchEngineID()));
@@ -19,7 +20,7 @@ std::string WebSearchFunctionTool::Execute(Orion& Orion, const web::json::value&
     // Send the request
     web::http::http_request SearchRequest(web::http::methods::GET);
     SearchRequest.set_request_uri(SearchURIBuilder.to_string());
-    const auto SEARCH_RESPONSE = SearchClient.request(SearchRequest).get();
+    const auto SEARCH_RESPONSE = pSearchClient->request(SearchRequest).get();
 
     if (SEARCH_RESPONSE.status_code() != web::http::status_codes::OK)
     {
@@ -58,7 +59,7 @@ std::string WebSearchFunctionTool::Execute(Orion& Orion, const web::json::value&
     // Serialize the result to a string
     const auto RESULT = SearchResult.serialize();
 
-    std::cout << "WebSearchFunctionTool::Execute: " << RESULT << std::endl;
+    Log::Debug("plugins.web_search", "Search results", {{"result", RESULT}});
 
     // Return the result
     return RESULT;
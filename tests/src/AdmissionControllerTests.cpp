@@ -0,0 +1,135 @@
+#include "AdmissionController.hpp"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <thread>
+
+using namespace ORION;
+
+namespace
+{
+    using EDecision = AdmissionController::EDecision;
+
+    /// @brief  Options with a bucket that never refills, so the tests don't depend on timing
+    AdmissionControlOptions GetFixedOptions(const double BURST_SIZE, const size_t MAX_IN_FLIGHT_RUNS = 0)
+    {
+        AdmissionControlOptions Options;
+        Options.TokensPerSecond = 0.0;
+        Options.BurstSize       = BURST_SIZE;
+        Options.MaxInFlightRuns = MAX_IN_FLIGHT_RUNS;
+        return Options;
+    }
+} // namespace
+
+TEST(AdmissionControllerTest, AdmitsABurstThenRateLimits)
+{
+    AdmissionController Controller(GetFixedOptions(3.0));
+
+    for (int Index = 0; Index < 3; ++Index)
+    {
+        const auto ADMISSION = Controller.TryAdmit("alice");
+        EXPECT_EQ(ADMISSION.Decision, EDecision::Admitted);
+        EXPECT_NE(ADMISSION.pTicket, nullptr);
+    }
+
+    const auto ADMISSION = Controller.TryAdmit("alice");
+    EXPECT_EQ(ADMISSION.Decision, EDecision::RateLimited);
+    EXPECT_EQ(ADMISSION.pTicket, nullptr);
+    EXPECT_EQ(ADMISSION.RetryAfter, std::chrono::seconds(60));
+}
+
+TEST(AdmissionControllerTest, TellsARateLimitedUserWhenTheNextTokenArrives)
+{
+    AdmissionControlOptions Options;
+    Options.TokensPerSecond = 0.5;
+    Options.BurstSize       = 1.0;
+    AdmissionController Controller(Options);
+
+    EXPECT_EQ(Controller.TryAdmit("alice").Decision, EDecision::Admitted);
+
+    const auto ADMISSION = Controller.TryAdmit("alice");
+    EXPECT_EQ(ADMISSION.Decision, EDecision::RateLimited);
+    EXPECT_EQ(ADMISSION.RetryAfter, std::chrono::seconds(2));
+}
+
+TEST(AdmissionControllerTest, KeepsABucketPerUser)
+{
+    AdmissionController Controller(GetFixedOptions(1.0));
+
+    EXPECT_EQ(Controller.TryAdmit("alice").Decision, EDecision::Admitted);
+    EXPECT_EQ(Controller.TryAdmit("alice").Decision, EDecision::RateLimited);
+    EXPECT_EQ(Controller.TryAdmit("bob").Decision, EDecision::Admitted);
+}
+
+TEST(AdmissionControllerTest, RefillsTheBucketOverTime)
+{
+    AdmissionControlOptions Options;
+    Options.TokensPerSecond = 100.0;
+    Options.BurstSize       = 1.0;
+    AdmissionController Controller(Options);
+
+    EXPECT_EQ(Controller.TryAdmit("alice").Decision, EDecision::Admitted);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_EQ(Controller.TryAdmit("alice").Decision, EDecision::Admitted);
+}
+
+TEST(AdmissionControllerTest, CapsTheRunsInFlightWithoutSpendingTokens)
+{
+    AdmissionController Controller(GetFixedOptions(3.0, 2));
+
+    auto First  = Controller.TryAdmit("alice");
+    auto Second = Controller.TryAdmit("bob");
+    ASSERT_EQ(First.Decision, EDecision::Admitted);
+    ASSERT_EQ(Second.Decision, EDecision::Admitted);
+
+    const auto OVERLOADED = Controller.TryAdmit("alice");
+    EXPECT_EQ(OVERLOADED.Decision, EDecision::Overloaded);
+    EXPECT_EQ(OVERLOADED.RetryAfter, std::chrono::seconds(1));
+
+    // The ticket frees its slot, and the rejected request didn't cost alice a token
+    First.pTicket.reset();
+    const auto THIRD = Controller.TryAdmit("alice");
+    EXPECT_EQ(THIRD.Decision, EDecision::Admitted);
+    EXPECT_EQ(Controller.TryAdmit("alice").Decision, EDecision::Overloaded);
+    EXPECT_EQ(Controller.GetStats().InFlight, 2u);
+}
+
+TEST(AdmissionControllerTest, RefusesNewRunsWhileDraining)
+{
+    AdmissionController Controller(GetFixedOptions(5.0));
+
+    auto Admission = Controller.TryAdmit("alice");
+    ASSERT_EQ(Admission.Decision, EDecision::Admitted);
+
+    Controller.BeginDrain();
+    EXPECT_TRUE(Controller.IsDraining());
+
+    const auto DRAINING = Controller.TryAdmit("bob");
+    EXPECT_EQ(DRAINING.Decision, EDecision::Draining);
+    EXPECT_EQ(DRAINING.RetryAfter, std::chrono::seconds(1));
+
+    // The run in flight keeps the controller busy until its ticket is gone
+    EXPECT_FALSE(Controller.WaitForInFlightRuns(std::chrono::milliseconds(10)));
+    Admission.pTicket.reset();
+    EXPECT_TRUE(Controller.WaitForInFlightRuns(std::chrono::milliseconds(10)));
+}
+
+TEST(AdmissionControllerTest, CountsTheDecisions)
+{
+    AdmissionController Controller(GetFixedOptions(1.0, 1));
+
+    auto Admission = Controller.TryAdmit("alice");
+    Controller.TryAdmit("alice");
+    Controller.TryAdmit("bob");
+    Controller.BeginDrain();
+    Controller.TryAdmit("carol");
+
+    const auto STATS = Controller.GetStats();
+    EXPECT_EQ(STATS.Admitted, 1u);
+    EXPECT_EQ(STATS.RateLimited, 1u);
+    EXPECT_EQ(STATS.Overloaded, 1u);
+    EXPECT_EQ(STATS.Draining, 1u);
+    EXPECT_EQ(STATS.InFlight, 1u);
+}
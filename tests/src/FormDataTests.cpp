@@ -0,0 +1,170 @@
+// Before cpprest, whose U() macro breaks the templates of gtest
+#include <gtest/gtest.h>
+
+#include "FormData.hpp"
+
+#include <cpprest/containerstream.h>
+
+#include <string>
+#include <vector>
+
+using namespace ORION;
+
+namespace
+{
+    /// @brief  The boundary of the bodies
+    const std::string BOUNDARY = "XyZ";
+
+    /// @brief  The headers of a field part
+    std::string GetFieldHeaders(const std::string& Name)
+    {
+        return "Content-Disposition: form-data; name=\"" + Name + "\"\r\n\r\n";
+    }
+
+    /// @brief  Read the parts of a body
+    std::vector<FormData::Part> Read(const std::string& Body, const FormData::ReadOptions& Options = {})
+    {
+        return FormData::ReadAsync(concurrency::streams::bytestream::open_istream(Body), BOUNDARY, Options).get();
+    }
+
+    /// @brief  Read a body that is expected to be rejected
+    /// @return The status of the error, or 0 if the body was read
+    web::http::status_code GetErrorStatus(const std::string& Body, const FormData::ReadOptions& Options = {})
+    {
+        try
+        {
+            Read(Body, Options);
+        }
+        catch (const FormData::ParseError& Error)
+        {
+            return Error.GetStatus();
+        }
+        return 0;
+    }
+
+    /// @brief  Get the content of a file part
+    std::string GetContent(const FormData::Part& FilePart)
+    {
+        std::string Content;
+        if (FilePart.File)
+        {
+            FilePart.File->Read([&Content](const unsigned char* pData, const size_t SIZE) { Content.append(reinterpret_cast<const char*>(pData), SIZE); });
+        }
+        return Content;
+    }
+} // namespace
+
+TEST(FormDataTest, GetsTheBoundaryOfAFormDataContentType)
+{
+    EXPECT_EQ(FormData::GetBoundary("multipart/form-data; boundary=XyZ"), "XyZ");
+    EXPECT_EQ(FormData::GetBoundary("Multipart/Form-Data; charset=utf-8; Boundary=\"a b;c\""), "a b;c");
+    EXPECT_EQ(FormData::GetBoundary("multipart/form-data; boundary=" + std::string(70, 'b')), std::string(70, 'b'));
+}
+
+TEST(FormDataTest, RejectsOtherContentTypesAndBadBoundaries)
+{
+    EXPECT_EQ(FormData::GetBoundary("application/json"), "");
+    EXPECT_EQ(FormData::GetBoundary("multipart/mixed; boundary=XyZ"), "");
+    EXPECT_EQ(FormData::GetBoundary("multipart/form-data"), "");
+    EXPECT_EQ(FormData::GetBoundary("multipart/form-data; boundary="), "");
+    EXPECT_EQ(FormData::GetBoundary("multipart/form-data; boundary=" + std::string(71, 'b')), "");
+}
+
+TEST(FormDataTest, ReadsFieldsAndFiles)
+{
+    const std::string BODY = "--XyZ\r\n" + GetFieldHeaders("message") + "Hello\r\nworld\r\n"
+                             "--XyZ\r\n"
+                             "Content-Disposition: form-data; name=\"files\"; filename=\"a \\\"b\\\".txt\"\r\n"
+                             "Content-Type: text/plain\r\n\r\n"
+                             "file\r\n--Xy content\r\n"
+                             "--XyZ--\r\n";
+
+    const auto PARTS = Read(BODY);
+    ASSERT_EQ(PARTS.size(), 2u);
+
+    EXPECT_EQ(PARTS[0].Name, "message");
+    EXPECT_EQ(PARTS[0].Value, "Hello\r\nworld");
+    EXPECT_TRUE(PARTS[0].FileName.empty());
+    EXPECT_FALSE(PARTS[0].File.has_value());
+
+    EXPECT_EQ(PARTS[1].Name, "files");
+    EXPECT_EQ(PARTS[1].FileName, "a \"b\".txt");
+    EXPECT_EQ(PARTS[1].ContentType, "text/plain");
+    ASSERT_TRUE(PARTS[1].File.has_value());
+    EXPECT_EQ(PARTS[1].File->GetSize(), 18u);
+    EXPECT_EQ(GetContent(PARTS[1]), "file\r\n--Xy content");
+}
+
+TEST(FormDataTest, IgnoresThePreambleAndEpilogue)
+{
+    const std::string BODY = "This is a preamble\r\n--XyZ\r\n" + GetFieldHeaders("message") + "Hello\r\n--XyZ--\r\nThis is an epilogue";
+
+    const auto PARTS = Read(BODY);
+    ASSERT_EQ(PARTS.size(), 1u);
+    EXPECT_EQ(PARTS[0].Value, "Hello");
+}
+
+TEST(FormDataTest, ReadsADelimiterSplitBetweenChunks)
+{
+    // The body is read 64 KiB at a time: the delimiter after the file starts 3 bytes before the end of the first chunk
+    const std::string HEAD    = "--XyZ\r\nContent-Disposition: form-data; name=\"file\"; filename=\"big.bin\"\r\n\r\n";
+    const std::string CONTENT = std::string(64 * 1024 - HEAD.size() - 3, 'x');
+
+    const auto PARTS = Read(HEAD + CONTENT + "\r\n--XyZ\r\n" + GetFieldHeaders("after") + "value\r\n--XyZ--");
+    ASSERT_EQ(PARTS.size(), 2u);
+    EXPECT_EQ(GetContent(PARTS[0]), CONTENT);
+    EXPECT_EQ(PARTS[1].Value, "value");
+}
+
+TEST(FormDataTest, MovesFilesPastTheMemoryLimitToTemporaryFiles)
+{
+    FormData::ReadOptions Options;
+    Options.MemoryLimit = 16;
+
+    std::string Content;
+    for (int Index = 0; Index < 10; ++Index)
+    {
+        Content += "0123456789";
+    }
+
+    const auto PARTS = Read("--XyZ\r\nContent-Disposition: form-data; name=\"file\"; filename=\"digits.txt\"\r\n\r\n" + Content + "\r\n--XyZ--", Options);
+    ASSERT_EQ(PARTS.size(), 1u);
+    ASSERT_TRUE(PARTS[0].File.has_value());
+    EXPECT_EQ(PARTS[0].File->GetSize(), Content.size());
+    EXPECT_EQ(GetContent(PARTS[0]), Content);
+}
+
+TEST(FormDataTest, RejectsBodiesOverTheLimits)
+{
+    const std::string BODY = "--XyZ\r\n" + GetFieldHeaders("message") + "Hello\r\n--XyZ--";
+
+    FormData::ReadOptions SmallBody;
+    SmallBody.MaxSize = BODY.size() - 1;
+    EXPECT_EQ(GetErrorStatus(BODY, SmallBody), web::http::status_codes::RequestEntityTooLarge);
+
+    FormData::ReadOptions SmallField;
+    SmallField.MaxFieldSize = 4;
+    EXPECT_EQ(GetErrorStatus(BODY, SmallField), web::http::status_codes::RequestEntityTooLarge);
+
+    // Headers that never end
+    EXPECT_EQ(GetErrorStatus("--XyZ\r\nX-Padding: " + std::string(70 * 1024, 'a')), web::http::status_codes::RequestEntityTooLarge);
+}
+
+TEST(FormDataTest, RejectsMalformedBodies)
+{
+    const std::vector<std::string> MALFORMED = {
+        "",
+        "No boundary at all",
+        "--XyZ\r\n" + GetFieldHeaders("message") + "No closing boundary",
+        "--XyZ\r\n" + GetFieldHeaders("message") + "Hello\r\n--XyZ",
+        "--XyZ trailing text\r\n" + GetFieldHeaders("message") + "Hello\r\n--XyZ--",
+        "--XyZ\r\nContent-Disposition: form-data\r\n\r\nNo name\r\n--XyZ--",
+        "--XyZ\r\nContent-Disposition: attachment; name=\"message\"\r\n\r\nNot form-data\r\n--XyZ--",
+        "--XyZ\r\n\r\nNo headers\r\n--XyZ--",
+    };
+
+    for (const auto& BODY : MALFORMED)
+    {
+        EXPECT_EQ(GetErrorStatus(BODY), web::http::status_codes::BadRequest) << BODY;
+    }
+}
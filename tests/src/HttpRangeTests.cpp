@@ -0,0 +1,92 @@
+#include "HttpRange.hpp"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+using namespace ORION;
+
+namespace
+{
+    using EResult = HttpRange::EResult;
+
+    /// @brief  The size of the representation the ranges are parsed against
+    constexpr uint64_t SIZE = 1000;
+
+    /// @brief  Expect a header to parse to a satisfiable range
+    void ExpectRange(const std::string& Range, const uint64_t OFFSET, const uint64_t LENGTH)
+    {
+        const auto PARSED = HttpRange::Parse(Range, SIZE);
+        EXPECT_EQ(PARSED.Result, EResult::Satisfiable) << Range;
+        EXPECT_EQ(PARSED.Offset, OFFSET) << Range;
+        EXPECT_EQ(PARSED.Length, LENGTH) << Range;
+    }
+} // namespace
+
+TEST(HttpRangeTest, ParsesAFirstAndLastPosition)
+{
+    ExpectRange("bytes=0-99", 0, 100);
+    ExpectRange("bytes=100-100", 100, 1);
+    ExpectRange("  bytes=0-0\t", 0, 1);
+}
+
+TEST(HttpRangeTest, ParsesAnOpenEndedRange)
+{
+    ExpectRange("bytes=900-", 900, 100);
+    ExpectRange("bytes=0-", 0, SIZE);
+}
+
+TEST(HttpRangeTest, ParsesASuffixRange)
+{
+    ExpectRange("bytes=-100", 900, 100);
+    ExpectRange("bytes=-5000", 0, SIZE);
+}
+
+TEST(HttpRangeTest, ClampsALastPositionPastTheEnd)
+{
+    ExpectRange("bytes=990-5000", 990, 10);
+    ExpectRange("bytes=0-18446744073709551615", 0, SIZE);
+}
+
+TEST(HttpRangeTest, RejectsRangesThatStartPastTheEnd)
+{
+    EXPECT_EQ(HttpRange::Parse("bytes=1000-", SIZE).Result, EResult::Unsatisfiable);
+    EXPECT_EQ(HttpRange::Parse("bytes=5000-6000", SIZE).Result, EResult::Unsatisfiable);
+    EXPECT_EQ(HttpRange::Parse("bytes=-0", SIZE).Result, EResult::Unsatisfiable);
+    EXPECT_EQ(HttpRange::Parse("bytes=-10", 0).Result, EResult::Unsatisfiable);
+    EXPECT_EQ(HttpRange::Parse("bytes=0-", 0).Result, EResult::Unsatisfiable);
+}
+
+TEST(HttpRangeTest, IgnoresMalformedHeaders)
+{
+    const char* const MALFORMED[] = {
+        "",
+        "bytes",
+        "bytes=",
+        "bytes=-",
+        "bytes=abc-",
+        "bytes=1-abc",
+        "bytes= 0-1",
+        "bytes=0x10-20",
+        "bytes=--5",
+        "bytes=+5-10",
+        "bytes=10-5",
+        "bytes=18446744073709551616-",
+        "bytes=-18446744073709551616",
+        "items=0-10",
+        "Bytes=0-10",
+        "bytes=0-10,20-30",
+    };
+
+    for (const std::string RANGE : MALFORMED)
+    {
+        EXPECT_EQ(HttpRange::Parse(RANGE, SIZE).Result, EResult::Ignored) << RANGE;
+    }
+}
+
+TEST(HttpRangeTest, FormatsTheContentRange)
+{
+    EXPECT_EQ(HttpRange::FormatContentRange(HttpRange::Parse("bytes=0-99", SIZE), SIZE), "bytes 0-99/1000");
+    EXPECT_EQ(HttpRange::FormatContentRange(HttpRange::Parse("bytes=-1", SIZE), SIZE), "bytes 999-999/1000");
+    EXPECT_EQ(HttpRange::FormatContentRange(HttpRange::Parse("bytes=2000-", SIZE), SIZE), "bytes */1000");
+}
@@ -0,0 +1,54 @@
+// Before cpprest, whose U() macro breaks the templates of gtest
+#include <gtest/gtest.h>
+
+#include "Metrics.hpp"
+
+#include <string>
+#include <vector>
+
+using namespace ORION;
+
+TEST(MetricsTest, CollapsesOpenAIIDsInEndpointLabels)
+{
+    EXPECT_EQ(Metrics::GetEndpointLabel("/v1/threads/thread_abc123/runs/run_def456"), "threads/:id/runs/:id");
+    EXPECT_EQ(Metrics::GetEndpointLabel("/v1/threads/thread_abc123/messages"), "threads/:id/messages");
+    EXPECT_EQ(Metrics::GetEndpointLabel("/v1/files/file-XyZ123/content"), "files/:id/content");
+    EXPECT_EQ(Metrics::GetEndpointLabel("/v1/assistants/asst_abc"), "assistants/:id");
+}
+
+TEST(MetricsTest, CollapsesGeneratedIDsInEndpointLabels)
+{
+    EXPECT_EQ(Metrics::GetEndpointLabel("/users/3f2504e0-4f89-11d3-9a0c-0305e82c3301"), "users/:id");
+    EXPECT_EQ(Metrics::GetEndpointLabel("/blobs/9b74c9897bac770ffc029102a200c5de/raw"), "blobs/:id/raw");
+}
+
+TEST(MetricsTest, KeepsVersionsAndWordsInEndpointLabels)
+{
+    EXPECT_EQ(Metrics::GetEndpointLabel("/customsearch/v1"), "customsearch/v1");
+    EXPECT_EQ(Metrics::GetEndpointLabel("/data/2.5/weather"), "data/2.5/weather");
+    EXPECT_EQ(Metrics::GetEndpointLabel("/api/v2/items/42"), "api/v2/items/42");
+    EXPECT_EQ(Metrics::GetEndpointLabel("/v1/chat/completions"), "chat/completions");
+    EXPECT_EQ(Metrics::GetEndpointLabel("/v1/audio/speech"), "audio/speech");
+}
+
+TEST(MetricsTest, NormalizesEmptySegmentsInEndpointLabels)
+{
+    EXPECT_EQ(Metrics::GetEndpointLabel(""), "/");
+    EXPECT_EQ(Metrics::GetEndpointLabel("/"), "/");
+    EXPECT_EQ(Metrics::GetEndpointLabel("/v1/"), "/");
+    EXPECT_EQ(Metrics::GetEndpointLabel("//v1//models//"), "models");
+}
+
+TEST(MetricsTest, CountsHistogramValuesInInclusiveBuckets)
+{
+    Metrics::Histogram Histogram({1.0, 0.1, 0.5});
+    EXPECT_EQ(Histogram.GetUpperBounds(), (std::vector<double> {0.1, 0.5, 1.0}));
+
+    for (const double VALUE : {0.05, 0.1, 0.3, 1.0, 7.0})
+    {
+        Histogram.Observe(VALUE);
+    }
+
+    EXPECT_EQ(Histogram.GetBucketCounts(), (std::vector<uint64_t> {2, 1, 1, 1}));
+    EXPECT_DOUBLE_EQ(Histogram.GetSum(), 8.45);
+}
@@ -0,0 +1,211 @@
+// Before cpprest, whose U() macro breaks the templates of gtest
+#include <gtest/gtest.h>
+
+#include "OrionEventDispatcher.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace ORION;
+
+namespace
+{
+    /// @brief  How long a test waits for the shard thread to deliver
+    constexpr auto DELIVERY_TIMEOUT = std::chrono::seconds(5);
+
+    /// @brief  A subscriber that keeps the events it is sent
+    class RecordingSink final
+    {
+    public:
+        /// @brief  Get the sink to subscribe with. The recording must outlive the subscription
+        OrionEventDispatcher::EventSink GetSink()
+        {
+            return [this](const std::vector<const OrionEventDispatcher::RecordedEvent*>& Events)
+            {
+                std::lock_guard<std::mutex> Lock(m_Mutex);
+                for (const auto* pEvent : Events)
+                {
+                    m_Events.push_back(*pEvent);
+                }
+                m_ConditionVariable.notify_all();
+            };
+        }
+
+        /// @brief  Wait until a number of events has been received
+        /// @return Whether they were received in time
+        bool WaitFor(const size_t COUNT)
+        {
+            std::unique_lock<std::mutex> Lock(m_Mutex);
+            return m_ConditionVariable.wait_for(Lock, DELIVERY_TIMEOUT, [this, COUNT] { return m_Events.size() >= COUNT; });
+        }
+
+        /// @brief  Get the sequence numbers of the events received, in order
+        std::vector<uint64_t> GetSequences()
+        {
+            std::lock_guard<std::mutex> Lock(m_Mutex);
+
+            std::vector<uint64_t> Sequences;
+            for (const auto& Event : m_Events)
+            {
+                Sequences.push_back(Event.Sequence);
+            }
+            return Sequences;
+        }
+
+        /// @brief  Get the events received, in order
+        std::vector<OrionEventDispatcher::RecordedEvent> GetEvents()
+        {
+            std::lock_guard<std::mutex> Lock(m_Mutex);
+            return m_Events;
+        }
+
+    private:
+        std::vector<OrionEventDispatcher::RecordedEvent> m_Events;
+        std::mutex                                       m_Mutex;
+        std::condition_variable                          m_ConditionVariable;
+    };
+
+    /// @brief  Dispatch numbered events to a user and wait until a subscriber has received them
+    void DispatchAndWait(OrionEventDispatcher& Dispatcher, RecordingSink& Sink, const std::string& UserID, const size_t COUNT)
+    {
+        const size_t ALREADY_RECEIVED = Sink.GetSequences().size();
+        for (size_t Index = 0; Index < COUNT; ++Index)
+        {
+            auto JData     = web::json::value::object();
+            JData["index"] = web::json::value::number(static_cast<int64_t>(Index));
+            Dispatcher.Dispatch(UserID, "test.event", std::move(JData));
+        }
+        ASSERT_TRUE(Sink.WaitFor(ALREADY_RECEIVED + COUNT));
+    }
+} // namespace
+
+TEST(OrionEventDispatcherTest, AssignsIncreasingSequencesPerUser)
+{
+    OrionEventDispatcher Dispatcher(2, 8);
+    Dispatcher.Start();
+
+    RecordingSink Alice;
+    RecordingSink Bob;
+    Dispatcher.Subscribe("alice", Alice.GetSink());
+    Dispatcher.Subscribe("bob", Bob.GetSink());
+
+    DispatchAndWait(Dispatcher, Alice, "alice", 3);
+    DispatchAndWait(Dispatcher, Bob, "bob", 2);
+
+    EXPECT_EQ(Alice.GetSequences(), (std::vector<uint64_t> {1, 2, 3}));
+    EXPECT_EQ(Bob.GetSequences(), (std::vector<uint64_t> {1, 2}));
+}
+
+TEST(OrionEventDispatcherTest, ReplaysTheEventsAfterTheLastEventID)
+{
+    OrionEventDispatcher Dispatcher(1, 4);
+    Dispatcher.Start();
+
+    RecordingSink Live;
+    Dispatcher.Subscribe("alice", Live.GetSink());
+    DispatchAndWait(Dispatcher, Live, "alice", 6);
+
+    RecordingSink Reconnected;
+    Dispatcher.Subscribe("alice", Reconnected.GetSink(), Dispatcher.FormatEventID(3));
+    EXPECT_EQ(Reconnected.GetSequences(), (std::vector<uint64_t> {4, 5, 6}));
+
+    // New events follow the replayed ones
+    DispatchAndWait(Dispatcher, Reconnected, "alice", 1);
+    EXPECT_EQ(Reconnected.GetSequences(), (std::vector<uint64_t> {4, 5, 6, 7}));
+}
+
+TEST(OrionEventDispatcherTest, ReplaysNothingToAClientThatIsUpToDate)
+{
+    OrionEventDispatcher Dispatcher(1, 4);
+    Dispatcher.Start();
+
+    RecordingSink Live;
+    Dispatcher.Subscribe("alice", Live.GetSink());
+    DispatchAndWait(Dispatcher, Live, "alice", 2);
+
+    RecordingSink Reconnected;
+    Dispatcher.Subscribe("alice", Reconnected.GetSink(), Dispatcher.FormatEventID(2));
+    EXPECT_TRUE(Reconnected.GetEvents().empty());
+}
+
+TEST(OrionEventDispatcherTest, ResyncsAClientWhoseEventsAreNoLongerBuffered)
+{
+    OrionEventDispatcher Dispatcher(1, 4);
+    Dispatcher.Start();
+
+    RecordingSink Live;
+    Dispatcher.Subscribe("alice", Live.GetSink());
+    DispatchAndWait(Dispatcher, Live, "alice", 6);
+
+    // Event 2 was overwritten (the buffer holds 3 to 6)
+    RecordingSink Reconnected;
+    Dispatcher.Subscribe("alice", Reconnected.GetSink(), Dispatcher.FormatEventID(1));
+
+    const auto EVENTS = Reconnected.GetEvents();
+    ASSERT_EQ(EVENTS.size(), 1u);
+    EXPECT_EQ(EVENTS[0].Name, OrionEventDispatcher::RESYNC_EVENT_NAME);
+    EXPECT_EQ(EVENTS[0].Sequence, 6u);
+}
+
+TEST(OrionEventDispatcherTest, ResyncsAClientWithAnInvalidOrForeignEventID)
+{
+    OrionEventDispatcher Dispatcher(1, 4);
+    Dispatcher.Start();
+
+    RecordingSink Live;
+    Dispatcher.Subscribe("alice", Live.GetSink());
+    DispatchAndWait(Dispatcher, Live, "alice", 2);
+
+    // Malformed, from another run of the server (another epoch), and from the future
+    for (const auto& LAST_EVENT_ID : {std::string("garbage"), std::string("1-1"), Dispatcher.FormatEventID(3) + "x", Dispatcher.FormatEventID(9)})
+    {
+        RecordingSink Reconnected;
+        const auto    SUBSCRIPTION_ID = Dispatcher.Subscribe("alice", Reconnected.GetSink(), LAST_EVENT_ID);
+        Dispatcher.Unsubscribe("alice", SUBSCRIPTION_ID);
+
+        const auto EVENTS = Reconnected.GetEvents();
+        ASSERT_EQ(EVENTS.size(), 1u) << LAST_EVENT_ID;
+        EXPECT_EQ(EVENTS[0].Name, OrionEventDispatcher::RESYNC_EVENT_NAME) << LAST_EVENT_ID;
+    }
+}
+
+TEST(OrionEventDispatcherTest, ResyncsEveryReconnectWithoutAReplayBuffer)
+{
+    OrionEventDispatcher Dispatcher(1, 0);
+    Dispatcher.Start();
+
+    RecordingSink Live;
+    Dispatcher.Subscribe("alice", Live.GetSink());
+    DispatchAndWait(Dispatcher, Live, "alice", 2);
+    EXPECT_EQ(Live.GetSequences(), (std::vector<uint64_t> {1, 2}));
+
+    RecordingSink Reconnected;
+    Dispatcher.Subscribe("alice", Reconnected.GetSink(), Dispatcher.FormatEventID(1));
+
+    const auto EVENTS = Reconnected.GetEvents();
+    ASSERT_EQ(EVENTS.size(), 1u);
+    EXPECT_EQ(EVENTS[0].Name, OrionEventDispatcher::RESYNC_EVENT_NAME);
+}
+
+TEST(OrionEventDispatcherTest, StopsDeliveringToUnsubscribedClients)
+{
+    OrionEventDispatcher Dispatcher(1, 4);
+    Dispatcher.Start();
+
+    RecordingSink Staying;
+    RecordingSink Leaving;
+    Dispatcher.Subscribe("alice", Staying.GetSink());
+    const auto SUBSCRIPTION_ID = Dispatcher.Subscribe("alice", Leaving.GetSink());
+    DispatchAndWait(Dispatcher, Leaving, "alice", 1);
+    ASSERT_TRUE(Staying.WaitFor(1));
+
+    Dispatcher.Unsubscribe("alice", SUBSCRIPTION_ID);
+    DispatchAndWait(Dispatcher, Staying, "alice", 1);
+
+    EXPECT_EQ(Staying.GetSequences(), (std::vector<uint64_t> {1, 2}));
+    EXPECT_EQ(Leaving.GetSequences(), (std::vector<uint64_t> {1}));
+    EXPECT_EQ(Dispatcher.GetStats().Subscribers, 1u);
+}
@@ -0,0 +1,101 @@
+// Before cpprest, whose U() macro breaks the templates of gtest
+#include <gtest/gtest.h>
+
+#include "UploadCache.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace ORION;
+
+namespace
+{
+    /// @brief  The API key the files are keyed with
+    const std::string API_KEY = "sk-test-0123456789";
+
+    /// @brief  Get a payload of text in memory
+    OpenAI::FilePayload GetPayload(const std::string& Text)
+    {
+        return OpenAI::FilePayload::FromMemory(std::vector<unsigned char>(Text.begin(), Text.end()));
+    }
+
+    /// @brief  A file that is removed when the test ends
+    class TemporaryFile final
+    {
+    public:
+        explicit TemporaryFile(const std::string& Text)
+            : m_Path(std::filesystem::temp_directory_path() / ("orion-upload-cache-test-" + std::string(::testing::UnitTest::GetInstance()->current_test_info()->name())))
+        {
+            std::ofstream(m_Path, std::ios::binary) << Text;
+        }
+
+        ~TemporaryFile()
+        {
+            std::error_code Error;
+            std::filesystem::remove(m_Path, Error);
+        }
+
+        /// @brief  Get the path of the file
+        std::string GetPath() const
+        {
+            return m_Path.string();
+        }
+
+    private:
+        /// @brief  The path of the file
+        std::filesystem::path m_Path;
+    };
+} // namespace
+
+TEST(UploadCacheTest, HashesTheContentWithSHA256)
+{
+    const auto KEY = UploadCache::GetKey(API_KEY, GetPayload("abc"), "assistants");
+    EXPECT_EQ(KEY.ContentHash, "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+    EXPECT_EQ(KEY.Purpose, "assistants");
+
+    const auto EMPTY_KEY = UploadCache::GetKey(API_KEY, GetPayload(""), "assistants");
+    EXPECT_EQ(EMPTY_KEY.ContentHash, "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+}
+
+TEST(UploadCacheTest, KeysTheSameContentTheSameWayWhereverItIs)
+{
+    const TemporaryFile FILE("The same attachment");
+
+    const auto MEMORY_KEY = UploadCache::GetKey(API_KEY, GetPayload("The same attachment"), "assistants");
+    const auto FILE_KEY   = UploadCache::GetKey(API_KEY, OpenAI::FilePayload::FromFile(FILE.GetPath()), "assistants");
+    EXPECT_EQ(MEMORY_KEY.ContentHash, FILE_KEY.ContentHash);
+    EXPECT_EQ(MEMORY_KEY.KeyHash, FILE_KEY.KeyHash);
+
+    EXPECT_NE(MEMORY_KEY.ContentHash, UploadCache::GetKey(API_KEY, GetPayload("Another attachment"), "assistants").ContentHash);
+
+    // Base64 is keyed by its decoded content
+    const auto BASE64_KEY = UploadCache::GetKey(API_KEY, OpenAI::FilePayload::FromBase64("YWJj", nullptr), "assistants");
+    EXPECT_EQ(BASE64_KEY.ContentHash, UploadCache::GetKey(API_KEY, GetPayload("abc"), "assistants").ContentHash);
+}
+
+TEST(UploadCacheTest, SeparatesTheFilesOfEachAPIKey)
+{
+    const auto KEY       = UploadCache::GetKey(API_KEY, GetPayload("abc"), "assistants");
+    const auto OTHER_KEY = UploadCache::GetKey("sk-test-another", GetPayload("abc"), "assistants");
+    EXPECT_EQ(KEY.ContentHash, OTHER_KEY.ContentHash);
+    EXPECT_NE(KEY.KeyHash, OTHER_KEY.KeyHash);
+
+    // Only the hash of the API key is stored
+    EXPECT_EQ(KEY.KeyHash.size(), 64u);
+    EXPECT_EQ(KEY.KeyHash.find(API_KEY), std::string::npos);
+}
+
+TEST(UploadCacheTest, SeparatesTheFilesOfEachPurpose)
+{
+    const auto ASSISTANTS_KEY = UploadCache::GetKey(API_KEY, GetPayload("abc"), "assistants");
+    const auto VISION_KEY     = UploadCache::GetKey(API_KEY, GetPayload("abc"), "vision");
+    EXPECT_EQ(ASSISTANTS_KEY.ContentHash, VISION_KEY.ContentHash);
+    EXPECT_NE(ASSISTANTS_KEY.Purpose, VISION_KEY.Purpose);
+}
+
+TEST(UploadCacheTest, FailsToKeyAFileThatCantBeRead)
+{
+    EXPECT_THROW(UploadCache::GetKey(API_KEY, OpenAI::FilePayload::FromFile("/nonexistent/orion-upload"), "assistants"), std::runtime_error);
+}